@@ -34,26 +34,12 @@ int main()
               << " s)" << std::endl;
     std::cout << "" << std::endl;
 
-	//
-	   
-    metric::CramervonMises<std::vector<double>, double> distance_2(0.0001);
+	// the reference sample is sorted once for many samples
 
     t1 = std::chrono::steady_clock::now();
-    result = distance_2(samples_1, samples_2);
+    auto results = distance_1.batch(samples_1, { samples_2, samples_1 });
     t2 = std::chrono::steady_clock::now();
-    std::cout << "result: " << result
-              << " (Time = " << double(std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()) / 1000000
-              << " s)" << std::endl;
-    std::cout << "" << std::endl;
-
-	//
-	   
-    metric::CramervonMises<std::vector<double>, double> distance_3(0.1);
-
-    t1 = std::chrono::steady_clock::now();
-    result = distance_3(samples_1, samples_2);
-    t2 = std::chrono::steady_clock::now();
-    std::cout << "result: " << result
+    std::cout << "batch results: " << results[0] << " " << results[1]
               << " (Time = " << double(std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()) / 1000000
               << " s)" << std::endl;
     std::cout << "" << std::endl;
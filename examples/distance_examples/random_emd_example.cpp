@@ -48,24 +48,10 @@ int main()
               << " s)" << std::endl;
     std::cout << "" << std::endl;
 
-	//
-	   
-    metric::RandomEMD<std::vector<double>, double> distance_2(0.0001);
-
-    t1 = std::chrono::steady_clock::now();
-    result = distance_2(samples_1, samples_2);
-    t2 = std::chrono::steady_clock::now();
-    std::cout << "result: " << result
-              << " (Time = " << double(std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()) / 1000000
-              << " s)" << std::endl;
-    std::cout << "" << std::endl;
-
-	//
-	   
-    metric::RandomEMD<std::vector<double>, double> distance_3(0.1);
+	// quantile sketches summarize large samples in bounded memory
 
     t1 = std::chrono::steady_clock::now();
-    result = distance_3(samples_1, samples_2);
+    result = distance_1(metric::QuantileSketch<double>(samples_1), metric::QuantileSketch<double>(samples_2));
     t2 = std::chrono::steady_clock::now();
     std::cout << "result: " << result
               << " (Time = " << double(std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count()) / 1000000
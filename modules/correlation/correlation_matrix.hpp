@@ -0,0 +1,229 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+
+#ifndef _METRIC_CORRELATION_CORRELATION_MATRIX_HPP
+#define _METRIC_CORRELATION_CORRELATION_MATRIX_HPP
+
+#include "../../3rdparty/blaze/Math.h"
+#include "../utils/ThreadPool.hpp"
+#include "../utils/Semaphore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace metric {
+
+/**
+ * @brief progress of a correlation matrix, called with the number of finished and of all tasks,
+ * preparations of channels and evaluations of pairs; returning false cancels the remaining tasks
+ */
+using matrix_progress = std::function<bool(size_t, size_t)>;
+
+/**
+ * @brief symmetric matrix of a measure between all pairs of channels, holding a limited number of channels prepared
+ *
+ * Channels are split into blocks of block channels. Pairs within a block are evaluated after the preparation of the
+ * block, pairs of two blocks after the preparation of the second one, so at most two blocks are prepared at once and
+ * channels are prepared again for every later block. release(i) is called when the structures of the channel i are
+ * no longer needed. prepare and evaluate are called concurrently on a thread pool, release from the calling thread.
+ * The progress is reported from the calling thread after every task. Pairs not evaluated after a cancellation are
+ * NaN. An exception of a task cancels the rest and is rethrown.
+ *
+ * @param count number of channels
+ * @param block number of channels of a block, 0 for all channels in one block
+ * @param prepare void(size_t i), computes the structures of the channel i shared by its pairs
+ * @param evaluate double(size_t i, size_t j), measure of the pair from the prepared structures
+ * @param release void(size_t i), frees the structures of the channel i
+ * @param progress called after every task, may be empty
+ * @param threads pool size, 0 for the number of hardware threads
+ * @return symmetric matrix of the measure
+ */
+template <typename Prepare, typename Evaluate, typename Release>
+blaze::SymmetricMatrix<blaze::DynamicMatrix<double>> correlation_matrix(size_t count, size_t block, Prepare prepare,
+    Evaluate evaluate, Release release, const matrix_progress& progress = nullptr, size_t threads = 0)
+{
+    if (block == 0 || block > count) {
+        block = count;
+    }
+
+    // channels prepared, pairs evaluated and channels released afterwards by every step
+    struct step {
+        std::vector<size_t> prepared;
+        std::vector<std::pair<size_t, size_t>> pairs;
+        std::vector<size_t> released;
+    };
+    std::vector<step> steps;
+    auto channels = [&](size_t b) {
+        std::vector<size_t> result;
+        for (size_t i = b * block; i < std::min(count, (b + 1) * block); ++i) {
+            result.push_back(i);
+        }
+        return result;
+    };
+    const size_t blocks = block == 0 ? 0 : (count + block - 1) / block;
+    for (size_t a = 0; a < blocks; ++a) {
+        const auto first = channels(a);
+        step within { first, {}, {} };
+        for (size_t i : first) {
+            for (size_t j = i; j <= first.back(); ++j) {
+                within.pairs.emplace_back(i, j);
+            }
+        }
+        if (a + 1 == blocks) {
+            within.released = first;
+        }
+        steps.push_back(std::move(within));
+        for (size_t b = a + 1; b < blocks; ++b) {
+            const auto second = channels(b);
+            step across { second, {}, second };
+            for (size_t i : first) {
+                for (size_t j : second) {
+                    across.pairs.emplace_back(i, j);
+                }
+            }
+            if (b + 1 == blocks) {
+                across.released.insert(across.released.end(), first.begin(), first.end());
+            }
+            steps.push_back(std::move(across));
+        }
+    }
+
+    size_t total = 0;
+    for (const auto& s : steps) {
+        total += s.prepared.size() + s.pairs.size();
+    }
+
+    blaze::SymmetricMatrix<blaze::DynamicMatrix<double>> result(count);
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = i; j < count; ++j) {
+            result(i, j) = std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    threads = std::max<size_t>(1, std::min(threads, total));
+
+    if (threads == 1) {
+        size_t done = 0;
+        for (const auto& s : steps) {
+            for (size_t i : s.prepared) {
+                prepare(i);
+                if (progress && !progress(++done, total)) {
+                    return result;
+                }
+            }
+            for (const auto& [i, j] : s.pairs) {
+                result(i, j) = evaluate(i, j);
+                if (progress && !progress(++done, total)) {
+                    return result;
+                }
+            }
+            for (size_t i : s.released) {
+                release(i);
+            }
+        }
+        return result;
+    }
+
+    // tasks are skipped after a cancellation, the calling thread still waits for all of them
+    std::vector<double> values;
+    ThreadPool pool(threads);
+    Semaphore sem;
+    std::atomic<bool> cancelled(false);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto run = [&](auto task) {
+        pool.execute([&, task]() {
+            if (!cancelled) {
+                try {
+                    task();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    cancelled = true;
+                }
+            }
+            sem.notify();
+        });
+    };
+    size_t done = 0;
+    auto wait = [&](size_t tasks) {
+        for (size_t t = 0; t < tasks; ++t) {
+            sem.wait();
+            ++done;
+            if (progress && !cancelled && !progress(done, total)) {
+                cancelled = true;
+            }
+        }
+    };
+
+    try {
+        for (const auto& s : steps) {
+            for (size_t i : s.prepared) {
+                run([&, i]() { prepare(i); });
+            }
+            wait(s.prepared.size());
+            values.assign(s.pairs.size(), std::numeric_limits<double>::quiet_NaN());
+            for (size_t p = 0; p < s.pairs.size(); ++p) {
+                run([&, p]() { values[p] = evaluate(s.pairs[p].first, s.pairs[p].second); });
+            }
+            wait(s.pairs.size());
+            for (size_t p = 0; p < s.pairs.size(); ++p) {
+                result(s.pairs[p].first, s.pairs[p].second) = values[p];
+            }
+            for (size_t i : s.released) {
+                release(i);
+            }
+        }
+    } catch (...) {
+        cancelled = true;
+        pool.close();
+        throw;
+    }
+    pool.close();
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return result;
+}
+
+/**
+ * @brief symmetric matrix of a measure between all pairs of channels
+ *
+ * prepare(i) is called once for every channel, then evaluate(i, j) for every pair i <= j, both concurrently
+ * on a thread pool. The progress is reported from the calling thread after every task. Pairs not evaluated
+ * after a cancellation are NaN. An exception of a task cancels the rest and is rethrown.
+ *
+ * @param count number of channels
+ * @param prepare void(size_t i), computes the structures of the channel i shared by its pairs
+ * @param evaluate double(size_t i, size_t j), measure of the pair from the prepared structures
+ * @param progress called after every task, may be empty
+ * @param threads pool size, 0 for the number of hardware threads
+ * @return symmetric matrix of the measure
+ */
+template <typename Prepare, typename Evaluate>
+blaze::SymmetricMatrix<blaze::DynamicMatrix<double>> correlation_matrix(size_t count, Prepare prepare,
+    Evaluate evaluate, const matrix_progress& progress = nullptr, size_t threads = 0)
+{
+    return correlation_matrix(count, 0, prepare, evaluate, [](size_t) {}, progress, threads);
+}
+
+}  // namespace metric
+
+#endif
@@ -13,7 +13,10 @@ Copyright (c) 2019 Panda Team
 #include "estimator_helpers.hpp"
 #include "epmgp.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <thread>
 #include <vector>
 #include <limits>
 
@@ -358,7 +361,8 @@ double estimate(
         const Functor& entropy,
         const size_t sampleSize,
         const double threshold,
-        size_t maxIterations
+        size_t maxIterations,
+        const estimate_logger& logger
 ){
     using T = type_traits::underlying_type_t<Container>;
     using V = type_traits::index_value_type_t<Container>;
@@ -387,25 +391,24 @@ double estimate(
     // Create vector container for fast random access
     const std::vector<V> vectorA(data.begin(), data.end());
 
-    // Create samples
-    std::vector<V> sampleA;
-    sampleA.reserve(sampleSize);
-
-    std::vector<double> entropyValues;
-    double mu = 0;
-    for (auto i = 1; i <= maxIterations; ++i) {
-        size_t start = (i - 1) * sampleSize;
-        size_t end = std::min(i * sampleSize - 1, dataSize - 1);
+    // subsamples are evaluated concurrently, the convergence is checked in the order of subsamples
+    auto sample_entropy = [&](size_t i) {
+        size_t start = i * sampleSize;
+        size_t end = std::min((i + 1) * sampleSize - 1, dataSize - 1);
 
         // Create samples
-        sampleA.clear();
-
+        std::vector<V> sampleA;
+        sampleA.reserve(sampleSize);
         for (auto j = start; j < end; ++j) {
             sampleA.push_back(vectorA[indexes[j]]);
         }
 
-        // Get sample mgc value
-        double sample_entopy = entropy(sampleA);
+        return entropy(sampleA);
+    };
+
+    std::vector<double> entropyValues;
+    double mu = 0;
+    auto converged = [&](size_t, double sample_entopy) {
         entropyValues.push_back(sample_entopy);
 
         std::sort(entropyValues.begin(), entropyValues.end());
@@ -424,12 +427,13 @@ double estimate(
         }
 
         auto convergence = entropy_details::peak2ems(diff) / n;
-        std::cout << n << " " << convergence << " " << sample_entopy << " " << mu << std::endl;
-
-        if (convergence < threshold) {
-            return mu;
+        if (logger) {
+            logger(n, convergence, sample_entopy, mu);
         }
-    }
+
+        return convergence < threshold;
+    };
+    evaluate_in_waves(maxIterations, sample_entropy, converged);
 
     return mu;
 }
@@ -443,7 +447,8 @@ double estimate(
     const Functor& f,
     const size_t sampleSize,
     const double threshold,
-    size_t maxIterations
+    size_t maxIterations,
+    const estimate_logger& logger
 )
 {
     using T = type_traits::underlying_type_t<Container>;
@@ -477,29 +482,27 @@ double estimate(
     const std::vector<V> vectorA(a.begin(), a.end());
     const std::vector<V> vectorB(b.begin(), b.end());
 
-    /* Create samples */
-    std::vector<V> sampleA;
-    std::vector<V> sampleB;
-    sampleA.reserve(sampleSize);
-    sampleB.reserve(sampleSize);
-
-    std::vector<double> mgcValues;
-    double mu = 0;
-    for (auto i = 1; i <= maxIterations; ++i) {
-        size_t start = (i - 1) * sampleSize;
-        size_t end = std::min(i * sampleSize - 1, dataSize - 1);
+    /* subsamples are evaluated concurrently, the convergence is checked in the order of subsamples */
+    auto sample_value = [&](size_t i) {
+        size_t start = i * sampleSize;
+        size_t end = std::min((i + 1) * sampleSize - 1, dataSize - 1);
 
         /* Create samples */
-        sampleA.clear();
-        sampleB.clear();
-
+        std::vector<V> sampleA;
+        std::vector<V> sampleB;
+        sampleA.reserve(sampleSize);
+        sampleB.reserve(sampleSize);
         for (auto j = start; j < end; ++j) {
             sampleA.push_back(vectorA[indexes[j]]);
             sampleB.push_back(vectorB[indexes[j]]);
         }
 
-        /* Get sample mgc value */
-        double mgc = f(sampleA, sampleB);
+        return f(sampleA, sampleB);
+    };
+
+    std::vector<double> mgcValues;
+    double mu = 0;
+    auto converged = [&](size_t, double mgc) {
         mgcValues.push_back(mgc);
 
         std::sort(mgcValues.begin(), mgcValues.end());
@@ -518,15 +521,271 @@ double estimate(
         }
 
         auto convergence = peak2ems(diff) / n;
+        if (logger) {
+            logger(n, convergence, mgc, mu);
+        }
+
+        return convergence < threshold;
+    };
+    evaluate_in_waves(maxIterations, sample_value, converged);
+
+    return mu;
+}
+
+
+
+// Kozachenko-Leonenko estimate from the sum of logs of distances to the k-th neighbours of n points of dimension d
+template <typename T, typename Metric>
+double knn_entropy(double log_sum, double n, double d, size_t k, const Metric& metric, double logbase)
+{
+    double entropyEstimate = log_sum * d / n; // mean log * d
+    //entropyEstimate += boost::math::digamma(N) - boost::math::digamma(k) + d*std::log(2.0);
+    entropyEstimate += digamma(n) - digamma(k) + d*std::log(2.0);
+
+    if constexpr (!std::is_same<Metric, typename metric::Chebyshev<T>>::value) {
+        double p = 1; // Manhatten and other metrics (TODO check if it is correct for them!)
+        if constexpr (std::is_same<Metric, typename metric::Euclidean<T>>::value) {
+            p = 2; // Euclidean
+        } else if constexpr (std::is_same<Metric, typename metric::P_norm<T>>::value) {
+            p = metric.p; // general Minkowsky
+        }
+        //entropyEstimate += d * std::log(std::tgamma(1 + 1 / p)) - std::log(std::tgamma(1 + d / p)); // boost
+        entropyEstimate += d * std::log(tgamma(1 + 1 / p)) - std::log(tgamma(1 + d / p));
+    }
+    return entropyEstimate / std::log(logbase);
+}
+
 
-        if (convergence < threshold) {
-            return mu;
+
+// scratch of the kpN estimate for a chunk of points, every thread has its own
+struct kpn_workspace {
+    blaze::DynamicMatrix<double> Nodes;
+    blaze::DynamicVector<double> x_vector;
+    // one EP problem per point of the chunk, solved together
+    epmgp::workspace<double> ep;
+
+    kpn_workspace(size_t p, size_t d, size_t chunk)
+        : Nodes(p, d, 0)
+        , x_vector(d, 0)
+    {
+        ep.resize(chunk, d);
+        for (auto& problem : ep.problems) {
+            problem.m.resize(d);
+            problem.K.resize(d, d);
+            problem.lowerB.resize(d);
+            problem.upperB.resize(d);
         }
     }
+};
 
-    return mu;
+// points handed out to a thread at once
+constexpr size_t kpn_chunk = 16;
+
+// calls f(begin, end, workspace) for chunks of [0, n) on threads, 0 for hardware threads, every thread creates its
+// workspace with make_workspace()
+template <typename MakeWorkspace, typename F>
+void parallel_points(size_t n, MakeWorkspace make_workspace, F f, size_t threads_count = 0)
+{
+    std::atomic<size_t> next_chunk(0);
+    auto worker = [&]() {
+        auto workspace = make_workspace();
+        for (size_t begin = kpn_chunk * next_chunk++; begin < n; begin = kpn_chunk * next_chunk++) {
+            f(begin, std::min(n, begin + kpn_chunk), workspace);
+        }
+    };
+
+    const size_t chunks = (n + kpn_chunk - 1) / kpn_chunk;
+    if (threads_count == 0) {
+        threads_count = std::thread::hardware_concurrency();
+    }
+    threads_count = std::min(chunks, threads_count);
+    if (threads_count <= 1) {
+        worker();
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threads_count; ++t) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// kpN parameters altered to the number of points
+struct kpn_parameters {
+    size_t n;
+    size_t k;
+    size_t p;
+
+    kpn_parameters(size_t n, size_t k, size_t p)
+        : n(n)
+        , k(k)
+        , p(p)
+    {
+        if (this->p >= n)
+            this->p = n - 1; // TODO we need to signal somehow that parameters are altered
+        if (this->k >= this->p)
+            this->k = this->p - 1;
+        if (this->p < 3)
+            this->p = 3;
+        if (this->k < 2)
+            this->k = 2;
+    }
+};
+
+// EP problem of a point from its p nearest neighbours, record(i) is the data of the neighbour i
+template <typename Neighbour>
+void kpn_problem(Neighbour record, const kpn_parameters& param, size_t d,
+    blaze::DynamicMatrix<double>& Nodes, epmgp::workspace<double>::problem& problem)
+{
+    auto& K = problem.K;
+    auto& mu = problem.m;
+    const size_t p_ = param.p;
+
+    Nodes.resize(p_, d, false);
+    blaze::reset(mu);
+    for (size_t p_idx= 0; p_idx < p_; ++p_idx) { // r v realizations from the tree
+        const auto& node_data = record(p_idx);
+        for (size_t d_idx = 0; d_idx < d; ++d_idx) { // dimensions
+            Nodes(p_idx, d_idx) = node_data[d_idx];
+            mu[d_idx] += node_data[d_idx];
+        }
+    }
+    mu = mu/p_;
+    Nodes = Nodes - blaze::expand(blaze::trans(mu), Nodes.rows());
+    double offset = 1e-8;
+    //double offset = 1e-5; // TODO consider dependence on machine epsilon
+    K = (blaze::trans(Nodes) * Nodes)*p_/(p_ - 1) + blaze::IdentityMatrix<double>(d)*offset;
+}
+
+// box of the problem around the point x with the half width eps
+template <typename Record>
+void kpn_box(const Record& x, double eps, size_t d, epmgp::workspace<double>::problem& problem)
+{
+    for (size_t d_idx = 0; d_idx < d; ++d_idx) { // dimensions
+        problem.lowerB[d_idx] = x[d_idx] - eps;
+        problem.upperB[d_idx] = x[d_idx] + eps;
+    }
+}
+
+// term of the point x with the solved problem, false when EP failed
+template <typename Record>
+bool kpn_term(const Record& x, const epmgp::workspace<double>::problem& problem, size_t d,
+    blaze::DynamicVector<double>& x_vector, double& term)
+{
+    double logG = problem.logZ;
+    if (std::isnan(logG)) { // UNLIKE original Matlab code, we exclude points that result in NaN
+        return false;
+    }
+    for (size_t d_idx = 0; d_idx < d; ++d_idx)
+        x_vector[d_idx] = x[d_idx];
+    double g = mvnpdf(x_vector, problem.m, problem.K);
+    term = logG - std::log(g);
+    return true;
 }
 
+// kpN entropy from the terms of points, the terms are summed in the order of points
+inline double kpn_entropy(const std::vector<double>& terms, const std::vector<char>& is_result, size_t n, size_t k)
+{
+    double h = 0;
+    int got_results = 0;  // absents in Matlab original code
+    for (size_t i = 0; i < terms.size(); ++i) {
+        if (is_result[i]) {
+            h += terms[i];
+            got_results++;
+        }
+    }
+
+    double result;
+    if (got_results <= 20) // this absents in Matlab original code. TODO adjust min number of points
+        result = std::nan("estimation failed");
+    //result = boost::math::digamma(n) - boost::math::digamma(k) + h/n;
+    result = digamma(n) - digamma(k) + h/n;
+    return result;
+}
+
+// position of a record in X followed by Y
+struct joint_index {
+    size_t i;
+};
+
+// records of X followed by records of Y addressed by positions, so a tree over positions stores no copies of records
+template <typename C, typename Metric>
+struct joint_records {
+    const C* X = nullptr;
+    const C* Y = nullptr;
+    const Metric* metric = nullptr;
+
+    const auto& operator[](size_t i) const { return i < X->size() ? (*X)[i] : (*Y)[i - X->size()]; }
+    auto operator()(joint_index a, joint_index b) const { return (*metric)((*this)[a.i], (*this)[b.i]); }
+};
+
+template <typename Node_ptr, typename Distance, typename Record, typename IsOwn>
+void joint_knn_(Node_ptr current, Distance dist_current, const Record& query, const IsOwn& is_own,
+    std::vector<std::pair<Node_ptr, Distance>>& all, std::vector<std::pair<Node_ptr, Distance>>& own)
+{
+    // ties are ordered by IDs, which follow the order of records, so the lists do not depend on the shape of the tree
+    auto before = [](const std::pair<Node_ptr, Distance>& a, const std::pair<Node_ptr, Distance>& b) {
+        if (a.second != b.second) {
+            return a.second < b.second;
+        }
+        return b.first == nullptr || (a.first != nullptr && a.first->get_ID() < b.first->get_ID());
+    };
+    const std::pair<Node_ptr, Distance> candidate(current, dist_current);
+    auto add = [&](std::vector<std::pair<Node_ptr, Distance>>& list) {
+        if (!list.empty() && before(candidate, list.back())) {
+            list.insert(std::upper_bound(list.begin(), list.end(), candidate, before), candidate);
+            list.pop_back();
+        }
+    };
+    add(all);
+    if (is_own(current)) {
+        add(own);
+    }
+
+    const auto& children = current->get_children();
+    std::vector<int> idx(children.size());
+    std::iota(idx.begin(), idx.end(), 0);
+    std::vector<Distance> dists(children.size());
+    for (size_t i = 0; i < children.size(); ++i) {
+        dists[i] = children[i]->dist(query);
+    }
+    std::sort(idx.begin(), idx.end(), [&dists](int a, int b) { return dists[a] < dists[b]; });
+
+    for (int child_idx : idx) {
+        Node_ptr child = children[child_idx];
+        Distance bound = dists[child_idx] - 2 * child->covdist();
+        if ((!all.empty() && all.back().second >= bound) || (!own.empty() && own.back().second >= bound)) {
+            joint_knn_(child, dists[child_idx], query, is_own, all, own);
+        }
+    }
+}
+
+/**
+ * @brief nearest records of all and nearest records accepted by is_own(node) in a single traversal of the tree
+ *
+ * Subtrees are visited while they may improve any of the lists, lists are sorted by distance and equal distances
+ * by node IDs. A list of zero size is not collected.
+ */
+template <typename Tree, typename Record, typename IsOwn>
+void joint_knn(Tree& tree, const Record& query, const IsOwn& is_own, size_t n_all, size_t n_own,
+    std::vector<std::pair<typename Tree::Node_ptr, typename Tree::Distance>>& all,
+    std::vector<std::pair<typename Tree::Node_ptr, typename Tree::Distance>>& own)
+{
+    using Node_ptr = typename Tree::Node_ptr;
+    using Distance = typename Tree::Distance;
+    const std::pair<Node_ptr, Distance> dummy(nullptr, std::numeric_limits<Distance>::max());
+    all.assign(n_all, dummy);
+    own.assign(n_own, dummy);
+
+    auto root = tree.get_root();
+    joint_knn_(root, root->dist(query), query, is_own, all, own);
+
+    auto missing = [](const std::pair<Node_ptr, Distance>& e) { return e.first == nullptr; };
+    all.erase(std::find_if(all.begin(), all.end(), missing), all.end());
+    own.erase(std::find_if(own.begin(), own.end(), missing), own.end());
+}
 
 } // namespace entropy_details
 
@@ -558,7 +817,6 @@ double EntropySimple<RecType, Metric>::operator()( // non-kpN version, DEPRECATE
     //add_noise(data);
 
     double entropyEstimate = 0;
-    double log_sum = 0;
 
     metric::Tree<V, Metric> tree(data[0], -1, metric);
     for (std::size_t i = 1; i < data.size(); ++i) {
@@ -569,22 +827,7 @@ double EntropySimple<RecType, Metric>::operator()( // non-kpN version, DEPRECATE
         auto res = tree.knn(data[i], k + 1);
         entropyEstimate += std::log(res.back().second);
     }
-    double N = (double)n;
-    entropyEstimate = entropyEstimate * d / N; // mean log * d
-    //entropyEstimate += boost::math::digamma(N) - boost::math::digamma(k) + d*std::log(2.0);
-    entropyEstimate += entropy_details::digamma(N) - entropy_details::digamma(k) + d*std::log(2.0);
-
-    if constexpr (!std::is_same<Metric, typename metric::Chebyshev<T>>::value) {
-        double p = 1; // Manhatten and other metrics (TODO check if it is correct for them!)
-        if constexpr (std::is_same<Metric, typename metric::Euclidean<T>>::value) {
-            p = 2; // Euclidean
-        } else if constexpr (std::is_same<Metric, typename metric::P_norm<T>>::value) {
-            p = metric.p; // general Minkowsky
-        }
-        //entropyEstimate += d * std::log(std::tgamma(1 + 1 / p)) - std::log(std::tgamma(1 + d / p)); // boost
-        entropyEstimate += d * std::log(tgamma(1 + 1 / p)) - std::log(tgamma(1 + d / p));
-    }
-    entropyEstimate /= std::log(logbase);
+    entropyEstimate = entropy_details::knn_entropy<T>(entropyEstimate, n, d, k, metric, logbase);
     if (exp)
         return entropy_details::conv_diff_entropy(entropyEstimate); // conversion of values below 1 to exp scale
     else
@@ -601,10 +844,225 @@ double EntropySimple<RecType, Metric>::estimate(
         const Container & a,
         const size_t sampleSize,
         const double threshold,
-        size_t maxIterations
+        size_t maxIterations,
+        const estimate_logger& logger
 ) const
 {
-    return entropy_details::estimate(a, *this, sampleSize, threshold, maxIterations);
+    return entropy_details::estimate(a, *this, sampleSize, threshold, maxIterations, logger);
+}
+
+
+
+// ----------------------------------- entropy over a sliding window
+
+template <typename RecType, typename Metric>
+EntropyWindow<RecType, Metric>::EntropyWindow(size_t window, Metric metric, size_t k, bool exp)
+    : window(window)
+    , k(k)
+    , metric(metric)
+    , exp(exp)
+    , tree(std::make_unique<tree_type>(-1, metric))
+{
+    if (window <= k)
+        throw std::invalid_argument("window must be larger than k");
+    if (k == 0)
+        throw std::invalid_argument("k must be positive");
+}
+
+template <typename RecType, typename Metric>
+void EntropyWindow<RecType, Metric>::push(const RecType& record)
+{
+    if (records.size() == window) {
+        size_t oldest = records.front();
+        records.pop_front();
+        if (--points.at(oldest).count == 0) {
+            erase_point(oldest);
+        }
+    }
+
+    // a record merged into an expired node brings the point back
+    auto [node, inserted] = tree->insert_if(record, std::numeric_limits<distance_type>::epsilon());
+    auto found = nodes.find(node);
+    size_t id;
+    if (found == nodes.end()) {
+        id = next_id++;
+        auto& p = points[id];
+        p.record = inserted ? record : (*tree)[node];
+        p.node = node;
+        nodes[node] = id;
+        if (!inserted) {
+            --expired;
+        }
+        insert_point(id);
+    } else {
+        id = found->second;
+    }
+    points.at(id).count++;
+    records.push_back(id);
+
+    // the running sum accumulates rounding errors of the updates
+    if (++pushed % window == 0) {
+        log_sum = 0;
+        for (const auto& radius : radii) {
+            log_sum += std::log(radius.first);
+        }
+    }
+}
+
+template <typename RecType, typename Metric>
+double EntropyWindow<RecType, Metric>::operator()() const
+{
+    using T = type_traits::underlying_type_t<std::vector<RecType>>;
+
+    const size_t n = points.size();
+    if (n <= k)
+        return std::nan("estimation failed");
+    const double d = points.begin()->second.record.size();
+
+    double entropyEstimate = entropy_details::knn_entropy<T>(log_sum, n, d, k, metric, logbase);
+    if (exp)
+        return entropy_details::conv_diff_entropy(entropyEstimate); // conversion of values below 1 to exp scale
+    return entropyEstimate;
+}
+
+// replaces neighbours of the point, the point is accounted in log_sum when it has k neighbours
+template <typename RecType, typename Metric>
+void EntropyWindow<RecType, Metric>::set_neighbours(size_t id, std::vector<std::pair<distance_type, size_t>> neighbours)
+{
+    auto& p = points.at(id);
+    if (p.neighbours.size() == k) {
+        const auto radius = p.neighbours.back().first;
+        radii.erase(radii.find({ radius, id }));
+        log_sum -= std::log(radius);
+    }
+    for (const auto& neighbour : p.neighbours) {
+        auto& reverse = points.at(neighbour.second).reverse;
+        auto it = std::find(reverse.begin(), reverse.end(), id);
+        *it = reverse.back();
+        reverse.pop_back();
+    }
+
+    p.neighbours = std::move(neighbours);
+    for (const auto& neighbour : p.neighbours) {
+        points.at(neighbour.second).reverse.push_back(id);
+    }
+    if (p.neighbours.size() == k) {
+        const auto radius = p.neighbours.back().first;
+        radii.insert({ radius, id });
+        log_sum += std::log(radius);
+    }
+}
+
+// k nearest points of the window except the point itself, more nodes are queried while expired ones are found
+template <typename RecType, typename Metric>
+auto EntropyWindow<RecType, Metric>::nearest(size_t id) const -> std::vector<std::pair<distance_type, size_t>>
+{
+    std::vector<std::pair<distance_type, size_t>> neighbours;
+    for (unsigned count = expired == 0 ? k + 1 : 2 * (k + 1);; count *= 2) {
+        neighbours.clear();
+        const auto found = tree->knn(points.at(id).record, count);
+        for (const auto& [node, distance] : found) {
+            auto other = nodes.find(node->get_ID());
+            if (other != nodes.end() && other->second != id && neighbours.size() < k) {
+                neighbours.emplace_back(distance, other->second);
+            }
+        }
+        if (neighbours.size() == k || found.size() < count) {
+            return neighbours;
+        }
+    }
+}
+
+template <typename RecType, typename Metric>
+void EntropyWindow<RecType, Metric>::insert_point(size_t id)
+{
+    const auto& record = points.at(id).record;
+
+    // the new point takes the place of the k-th neighbour of points closer to it than that neighbour
+    auto take = [&](size_t other, distance_type distance) {
+        const auto& current = points.at(other).neighbours;
+        if (current.size() == k && !(distance < current.back().first)) {
+            return;
+        }
+        auto neighbours = current;
+        neighbours.insert(
+            std::upper_bound(neighbours.begin(), neighbours.end(), std::make_pair(distance, id)), { distance, id });
+        if (neighbours.size() > k) {
+            neighbours.pop_back();
+        }
+        set_neighbours(other, std::move(neighbours));
+    };
+
+    // while there are at most k other points all of them take it
+    if (points.size() - 1 <= k) {
+        for (const auto& [other, p] : points) {
+            if (other != id) {
+                take(other, metric(record, p.record));
+            }
+        }
+        set_neighbours(id, nearest(id));
+        return;
+    }
+
+    // points with the widest k-th neighbour distances are checked directly, a ball of the largest distance
+    // would hold most of the window, the others are closer than the next distance
+    std::vector<size_t> wide;
+    auto radius = radii.rbegin();
+    for (; radius != radii.rend() && wide.size() < wide_points; ++radius) {
+        wide.push_back(radius->second);
+    }
+    for (size_t other : wide) {
+        take(other, metric(record, points.at(other).record));
+    }
+    if (radius != radii.rend()) {
+        const auto reach = radius->first;
+        for (const auto& [node, distance] : tree->rnn(record, reach)) {
+            auto found = nodes.find(node->get_ID());
+            if (found == nodes.end() || found->second == id
+                || std::find(wide.begin(), wide.end(), found->second) != wide.end()) {
+                continue;
+            }
+            take(found->second, distance);
+        }
+    }
+
+    set_neighbours(id, nearest(id));
+}
+
+template <typename RecType, typename Metric>
+void EntropyWindow<RecType, Metric>::erase_point(size_t id)
+{
+    // the node stays in the tree, erasing it would insert its descendants again
+    nodes.erase(points.at(id).node);
+    ++expired;
+
+    // only the points having the erased one among neighbours need new neighbours
+    const auto dependent = points.at(id).reverse;
+    for (size_t other : dependent) {
+        set_neighbours(other, nearest(other));
+    }
+    set_neighbours(id, {});
+    points.erase(id);
+
+    if (points.empty()) {
+        log_sum = 0;
+    }
+    if (expired > points.size() / 4) {
+        rebuild_tree();
+    }
+}
+
+// tree of the points in the window only, neighbours do not change
+template <typename RecType, typename Metric>
+void EntropyWindow<RecType, Metric>::rebuild_tree()
+{
+    tree = std::make_unique<tree_type>(-1, metric);
+    nodes.clear();
+    expired = 0;
+    for (auto& [id, p] : points) {
+        p.node = tree->insert(p.record);
+        nodes[p.node] = id;
+    }
 }
 
 
@@ -627,73 +1085,37 @@ double Entropy<RecType, Metric>::operator()(const Container& data) const
     size_t n = data.size();
     size_t d = data[0].size();
 
-    size_t k_ = k;
-    size_t p_ = p;
-    if (p_ >= n)
-        p_ = n - 1; // TODO we need to signal somehow that parameters are altered
-    if (k_ >= p_)
-        k_ = p_ - 1;
-    if (p_ < 3)
-        p_ = 3;
-    if (k_ < 2)
-        k_ = 2;
+    const entropy_details::kpn_parameters param(n, k, p);
 
     if (n < 4)
         return std::nan("estimation failed");
 
-    double h = 0;
-    int got_results = 0;  // absents in Matlab original code
-
     metric::Tree<V, Metric> tree (data, -1, metric);
-    blaze::DynamicMatrix<double> Nodes (p_, d, 0);
-    blaze::DynamicVector<double> mu (d, 0);
-    blaze::DynamicVector<double> lb (d, 0);
-    blaze::DynamicVector<double> ub (d, 0);
-    blaze::DynamicVector<double> x_vector (d, 0);
-    for (size_t i = 0; i < n; ++i) {
-
-        auto res = tree.knn(data[i], p_);
-        auto eps = res[k_-1].second;
-
-        blaze::reset(mu);
-        for (size_t p_idx= 0; p_idx < p_; ++p_idx) { // r v realizations from the tree
-            for (size_t d_idx = 0; d_idx < d; ++d_idx) { // dimensions
-                //Nodes(p_idx, d_idx) = res[p_idx].first->data[d_idx];
-                //mu[d_idx] += res[p_idx].first->data[d_idx];
-                Nodes(p_idx, d_idx) = res[p_idx].first->get_data()[d_idx];
-                mu[d_idx] += res[p_idx].first->get_data()[d_idx];
-            }
-        }
-        mu = mu/p_;
-        Nodes = Nodes - blaze::expand(blaze::trans(mu), Nodes.rows());
-        double offset = 1e-8;
-        //double offset = 1e-5; // TODO consider dependence on machine epsilon
-        auto K = blaze::evaluate( (blaze::trans(Nodes) * Nodes)*p_/(p_ - 1) + blaze::IdentityMatrix<double>(d)*offset );
 
-        blaze::reset(lb);
-        blaze::reset(ub);
-        for (size_t d_idx = 0; d_idx < d; ++d_idx) { // dimensions
-            lb[d_idx] = data[i][d_idx] - eps;
-            ub[d_idx] = data[i][d_idx] + eps;
-            x_vector[d_idx] = data[i][d_idx];
+    // points are independent, their terms are summed in the order of points afterwards,
+    // so the result does not depend on the number of threads
+    std::vector<double> terms(n, 0);
+    std::vector<char> is_result(n, false);
+    auto chunk_terms = [&](size_t begin, size_t end, entropy_details::kpn_workspace& w) {
+        for (size_t i = begin; i < end; ++i) {
+            auto& problem = w.ep.problems[i - begin];
+            auto res = tree.knn(data[i], param.p);
+            entropy_details::kpn_problem(
+                [&](size_t j) -> const V& { return res[j].first->get_data(); }, param, d, w.Nodes, problem);
+            entropy_details::kpn_box(data[i], res[param.k - 1].second, d, problem);
         }
 
-        auto g_local = epmgp::local_gaussian_axis_aligned_hyperrectangles<double>(mu, K, lb, ub);
-        double logG = std::get<0>(g_local);
+        epmgp::local_gaussian_axis_aligned_hyperrectangles<double>(w.ep, end - begin);
 
-        if (!std::isnan(logG)) { // UNLIKE original Matlab code, we exclude points that result in NaN
-            double g = entropy_details::mvnpdf(x_vector, mu, K);
-            h += logG - std::log(g);
-            got_results++;
+        for (size_t i = begin; i < end; ++i) {
+            is_result[i] = entropy_details::kpn_term(data[i], w.ep.problems[i - begin], d, w.x_vector, terms[i]);
         }
+    };
+    entropy_details::parallel_points(
+        n, [&]() { return entropy_details::kpn_workspace(param.p, d, entropy_details::kpn_chunk); }, chunk_terms,
+        threads);
 
-    }
-
-    double result;
-    if (got_results <= 20) // this absents in Matlab original code. TODO adjust min number of points
-        result = std::nan("estimation failed");
-    //result = boost::math::digamma(n) - boost::math::digamma(k) + h/n;
-    result = entropy_details::digamma(n) - entropy_details::digamma(k) + h/n;
+    double result = entropy_details::kpn_entropy(terms, is_result, n, k);
     if (exp)
         return entropy_details::conv_diff_entropy(result); // conversion of values below 1 to exp scale
     return result;
@@ -707,10 +1129,14 @@ double Entropy<RecType, Metric>::estimate(
         const Container & a,
         const size_t sampleSize,
         const double threshold,
-        size_t maxIterations
+        size_t maxIterations,
+        const estimate_logger& logger
 ) const
 {
-    return entropy_details::estimate(a, *this, sampleSize, threshold, maxIterations);
+    // subsamples are evaluated concurrently in waves, the points of a subsample on one thread
+    Entropy single_threaded = *this;
+    single_threaded.threads = 1;
+    return entropy_details::estimate(a, single_threaded, sampleSize, threshold, maxIterations, logger);
 }
 
 
@@ -725,29 +1151,110 @@ template <typename C>
 typename std::enable_if_t<!type_traits::is_container_of_integrals_v<C>, type_traits::underlying_type_t<C>>
 VMixing_simple<RecType, Metric>::operator()(const C& Xc, const C& Yc) const { // non-kpN version, DEPRECATED
 
-    using T = type_traits::underlying_type_t<C>;
+    return mixing(Xc, Yc, 0);
+}
 
-    auto N = Xc.size();
 
-    if (N < k + 1 || Yc.size() < k + 1)
+template <typename RecType, typename Metric>
+template <typename C>
+double VMixing_simple<RecType, Metric>::mixing(const C& Xc, const C& Yc, size_t threads) const
+{
+    if (Xc.size() < size_t(k) + 1 || Yc.size() < size_t(k) + 1)
         throw std::invalid_argument("number of points in dataset must be larger than k");
 
-    std::vector<std::vector<T>> X;
-    for (const auto& e: Xc)
-        X.push_back(std::vector<T>(std::begin(e), std::end(e))); // TODO optimize
+    const auto h = joint_entropies(Xc, Yc, true, true, threads);
+    return 2 * h[0] - h[1] - h[2];
+}
 
-    std::vector<std::vector<T>> Y;
-    for (const auto& e: Yc)
-        Y.push_back(std::vector<T>(std::begin(e), std::end(e)));
 
-    std::vector<std::vector<T>> XY; // concatenation instead of combine(X, Y);
-    XY.reserve(X.size() + Y.size());
-    XY.insert(XY.end(), X.begin(), X.end());
-    XY.insert(XY.end(), Y.begin(), Y.end());
+template <typename RecType, typename Metric>
+template <typename C>
+std::array<double, 3> VMixing_simple<RecType, Metric>::joint_entropies(
+    const C& Xc, const C& Yc, bool xy, bool own, size_t threads) const
+{
+    using T = type_traits::underlying_type_t<C>;
 
-    auto e = EntropySimple<void, Metric>(metric, k);
-    auto result = 2 * e(XY) - e(Xc) - e(Yc);
-    return result;
+    auto N = Xc.size();
+    auto M = Yc.size();
+
+    // the entropies of XY, X and Y as by EntropySimple from one tree over XY, records merged into a point
+    // mark it as a point of X or Y, the own set of a query are the points of its set
+    using Joint = entropy_details::joint_records<C, Metric>;
+    const Joint joint { &Xc, &Yc, &metric };
+    metric::Tree<entropy_details::joint_index, Joint> tree(-1, joint);
+    std::vector<char> inX;
+    std::vector<char> inY;
+    for (size_t i = 0; i < N + M; ++i) {
+        auto [id, inserted] = tree.insert_if(entropy_details::joint_index { i }, std::numeric_limits<T>::epsilon());
+        if (inserted) {
+            inX.resize(id + 1, false);
+            inY.resize(id + 1, false);
+        }
+        (i < N ? inX : inY)[id] = true;
+    }
+    const size_t nXY = inX.size();
+    const size_t nX = std::count(inX.begin(), inX.end(), true);
+    const size_t nY = std::count(inY.begin(), inY.end(), true);
+
+    // log distances to the k-th neighbours of the queries of EntropySimple, summed in the order of queries
+    std::vector<double> logXY(N + M, 0);
+    std::vector<double> logOwn(N + M, 0);
+    auto chunk_logs = [&](size_t begin, size_t end, int) {
+        using Tree = metric::Tree<entropy_details::joint_index, Joint>;
+        std::vector<std::pair<typename Tree::Node_ptr, typename Tree::Distance>> all, neighbours;
+        for (size_t i = begin; i < end; ++i) {
+            const bool x = i < N;
+            const auto& mark = x ? inX : inY;
+            const bool queryXY = xy && i < nXY;
+            const bool queryOwn = own && (x ? i < nX : i - N < nY);
+            auto is_own = [&](auto node) { return mark[node->get_ID()]; };
+            entropy_details::joint_knn(tree, entropy_details::joint_index { i }, is_own, queryXY ? k + 1 : 0, queryOwn ? k + 1 : 0, all, neighbours);
+            if (queryXY) {
+                logXY[i] = std::log(all.back().second);
+            }
+            if (queryOwn) {
+                logOwn[i] = std::log(neighbours.back().second);
+            }
+        }
+    };
+    entropy_details::parallel_points(N + M, []() { return 0; }, chunk_logs, threads);
+
+    // EntropySimple from the queries [begin, end)
+    auto entropy = [&](const std::vector<double>& logs, size_t begin, size_t end, size_t n, size_t d) {
+        if (d == 0)
+            return 0.0;
+        double log_sum = 0;
+        for (size_t i = begin; i < end; ++i) {
+            log_sum += logs[i];
+        }
+        return entropy_details::knn_entropy<T>(log_sum, n, d, k, metric, 2);
+    };
+    const size_t d = Xc[0].size();
+    return { xy ? entropy(logXY, 0, nXY, nXY, d) : 0, own ? entropy(logOwn, 0, nX, nX, d) : 0,
+        own ? entropy(logOwn, N, N + nY, nY, d) : 0 };
+}
+
+
+template <typename RecType, typename Metric>
+template <typename C>
+blaze::SymmetricMatrix<blaze::DynamicMatrix<double>> VMixing_simple<RecType, Metric>::matrix(
+    const std::vector<C>& channels, const matrix_progress& progress, size_t threads) const
+{
+    // the entropy of every channel alone, pairs only add the entropy of the joint set
+    std::vector<double> own(channels.size());
+    const C empty;
+    if (k < 1)
+        throw std::invalid_argument("k must be positive");
+    auto prepare = [&](size_t i) {
+        if (channels[i].size() < size_t(k) + 1)
+            throw std::invalid_argument("number of points in dataset must be larger than k");
+        own[i] = joint_entropies(channels[i], empty, false, true, 1)[1];
+    };
+    auto evaluate = [&](size_t i, size_t j) -> double {
+        auto result = 2 * joint_entropies(channels[i], channels[j], true, false, 1)[0] - own[i] - own[j];
+        return result;
+    };
+    return correlation_matrix(channels.size(), prepare, evaluate, progress, threads);
 }
 
 
@@ -758,10 +1265,13 @@ double VMixing_simple<RecType, Metric>::estimate(
         const C& b,
         const size_t sampleSize,
         const double threshold,
-        size_t maxIterations
+        size_t maxIterations,
+        const estimate_logger& logger
 ) const
 {
-    return entropy_details::estimate(a, b, *this, sampleSize, threshold, maxIterations);
+    // subsamples are evaluated concurrently in waves, the points of a subsample on one thread
+    auto single_threaded = [this](const auto& X, const auto& Y) { return mixing(X, Y, 1); };
+    return entropy_details::estimate(a, b, single_threaded, sampleSize, threshold, maxIterations, logger);
 }
 
 
@@ -771,29 +1281,140 @@ template <typename C>
 typename std::enable_if_t<!type_traits::is_container_of_integrals_v<C>, type_traits::underlying_type_t<C>>
 VMixing<RecType, Metric>::operator()(const C& Xc, const C& Yc) const {
 
-    using T = type_traits::underlying_type_t<C>;
+    return mixing(Xc, Yc, 0);
+}
 
-    auto N = Xc.size();
 
-    if (N < k + 1 || Yc.size() < k + 1)
+template <typename RecType, typename Metric>
+template <typename C>
+double VMixing<RecType, Metric>::mixing(const C& Xc, const C& Yc, size_t threads) const
+{
+    if (Xc.size() < size_t(k) + 1 || Yc.size() < size_t(k) + 1)
         throw std::invalid_argument("number of points in dataset must be larger than k");
 
-    std::vector<std::vector<T>> X;
-    for (const auto& e: Xc)
-        X.push_back(std::vector<T>(std::begin(e), std::end(e))); // TODO optimize
+    const auto h = joint_entropies(Xc, Yc, true, true, threads);
+    return 2 * h[0] - h[1] - h[2];
+}
 
-    std::vector<std::vector<T>> Y;
-    for (const auto& e: Yc)
-        Y.push_back(std::vector<T>(std::begin(e), std::end(e)));
 
-    std::vector<std::vector<T>> XY; // concatenation instead of combine(X, Y);
-    XY.reserve(X.size() + Y.size());
-    XY.insert(XY.end(), X.begin(), X.end());
-    XY.insert(XY.end(), Y.begin(), Y.end());
+template <typename RecType, typename Metric>
+template <typename C>
+std::array<double, 3> VMixing<RecType, Metric>::joint_entropies(
+    const C& Xc, const C& Yc, bool xy, bool own, size_t threads) const
+{
+    auto N = Xc.size();
+    auto M = Yc.size();
+
+    // the entropies of XY, X and Y as by Entropy from one tree over XY, every point gets the neighbours
+    // among XY and among its own set in one traversal, both problems are solved in the same EP batch
+    using Joint = entropy_details::joint_records<C, Metric>;
+    using Tree = metric::Tree<entropy_details::joint_index, Joint>;
+    const Joint joint { &Xc, &Yc, &metric };
+    std::vector<entropy_details::joint_index> indexes(N + M);
+    for (size_t i = 0; i < N + M; ++i) {
+        indexes[i].i = i;
+    }
+    Tree tree(indexes, -1, joint);
+
+    const entropy_details::kpn_parameters paramXY(N + M, k, p);
+    const entropy_details::kpn_parameters paramX(N, k, p);
+    const entropy_details::kpn_parameters paramY(M, k, p);
+    const size_t d = Xc[0].size();
+
+    std::vector<double> termsXY(N + M, 0);
+    std::vector<double> termsOwn(N + M, 0);
+    std::vector<char> is_resultXY(N + M, false);
+    std::vector<char> is_resultOwn(N + M, false);
+    // sets of less than 4 points are not estimated, their neighbours would be less than p
+    const bool solveXY = xy && N + M >= 4;
+    const bool solveX = own && N >= 4;
+    const bool solveY = own && M >= 4;
+    // problems of a point follow each other in the batch, slots of problems not solved are none
+    const size_t stride = xy && own ? 2 : 1;
+    const size_t none = std::numeric_limits<size_t>::max();
+    auto chunk_terms = [&](size_t begin, size_t end, entropy_details::kpn_workspace& w) {
+        std::vector<std::pair<typename Tree::Node_ptr, typename Tree::Distance>> all, neighbours;
+        std::vector<size_t> slotXY(end - begin, none);
+        std::vector<size_t> slotOwn(end - begin, none);
+        size_t slots = 0;
+        for (size_t i = begin; i < end; ++i) {
+            const bool x = i < N;
+            const auto& paramOwn = x ? paramX : paramY;
+            const bool solveOwn = x ? solveX : solveY;
+            if (!solveXY && !solveOwn) {
+                continue;
+            }
+            auto is_own = [&](auto node) { return (node->get_data().i < N) == x; };
+            entropy_details::joint_knn(tree, entropy_details::joint_index { i }, is_own, solveXY ? paramXY.p : 0,
+                solveOwn ? paramOwn.p : 0, all, neighbours);
+
+            if (solveXY) {
+                slotXY[i - begin] = slots;
+                auto& problemXY = w.ep.problems[slots++];
+                entropy_details::kpn_problem(
+                    [&](size_t j) -> const auto& { return joint[all[j].first->get_data().i]; }, paramXY, d, w.Nodes,
+                    problemXY);
+                entropy_details::kpn_box(joint[i], all[paramXY.k - 1].second, d, problemXY);
+            }
+            if (solveOwn) {
+                slotOwn[i - begin] = slots;
+                auto& problemOwn = w.ep.problems[slots++];
+                entropy_details::kpn_problem(
+                    [&](size_t j) -> const auto& { return joint[neighbours[j].first->get_data().i]; }, paramOwn, d,
+                    w.Nodes, problemOwn);
+                entropy_details::kpn_box(joint[i], neighbours[paramOwn.k - 1].second, d, problemOwn);
+            }
+        }
+
+        epmgp::local_gaussian_axis_aligned_hyperrectangles<double>(w.ep, slots);
 
-    auto e = Entropy<void, Metric>(metric, k, p);
-    auto result = 2 * e(XY) - e(Xc) - e(Yc);
-    return result;
+        for (size_t i = begin; i < end; ++i) {
+            if (slotXY[i - begin] != none) {
+                is_resultXY[i] = entropy_details::kpn_term(
+                    joint[i], w.ep.problems[slotXY[i - begin]], d, w.x_vector, termsXY[i]);
+            }
+            if (slotOwn[i - begin] != none) {
+                is_resultOwn[i] = entropy_details::kpn_term(
+                    joint[i], w.ep.problems[slotOwn[i - begin]], d, w.x_vector, termsOwn[i]);
+            }
+        }
+    };
+    entropy_details::parallel_points(N + M,
+        [&]() { return entropy_details::kpn_workspace(paramXY.p, d, stride * entropy_details::kpn_chunk); }, chunk_terms,
+        threads);
+
+    auto entropy = [&](const std::vector<double>& terms, const std::vector<char>& is_result, size_t begin,
+                       size_t end, size_t k_) {
+        if (end - begin < 4)
+            return std::nan("estimation failed");
+        return entropy_details::kpn_entropy(std::vector<double>(terms.begin() + begin, terms.begin() + end),
+            std::vector<char>(is_result.begin() + begin, is_result.begin() + end), end - begin, k_);
+    };
+    return { xy ? entropy(termsXY, is_resultXY, 0, N + M, k) : 0, own ? entropy(termsOwn, is_resultOwn, 0, N, k) : 0,
+        own ? entropy(termsOwn, is_resultOwn, N, N + M, k) : 0 };
+}
+
+
+template <typename RecType, typename Metric>
+template <typename C>
+blaze::SymmetricMatrix<blaze::DynamicMatrix<double>> VMixing<RecType, Metric>::matrix(
+    const std::vector<C>& channels, const matrix_progress& progress, size_t threads) const
+{
+    // the entropy of every channel alone, pairs only add the entropy of the joint set
+    std::vector<double> own(channels.size());
+    const C empty;
+    if (k < 1)
+        throw std::invalid_argument("k must be positive");
+    auto prepare = [&](size_t i) {
+        if (channels[i].size() < size_t(k) + 1)
+            throw std::invalid_argument("number of points in dataset must be larger than k");
+        own[i] = joint_entropies(channels[i], empty, false, true, 1)[1];
+    };
+    auto evaluate = [&](size_t i, size_t j) -> double {
+        auto result = 2 * joint_entropies(channels[i], channels[j], true, false, 1)[0] - own[i] - own[j];
+        return result;
+    };
+    return correlation_matrix(channels.size(), prepare, evaluate, progress, threads);
 }
 
 
@@ -804,10 +1425,13 @@ double VMixing<RecType, Metric>::estimate(
         const C& b,
         const size_t sampleSize,
         const double threshold,
-        size_t maxIterations
+        size_t maxIterations,
+        const estimate_logger& logger
 ) const
 {
-    return entropy_details::estimate(a, b, *this, sampleSize, threshold, maxIterations);
+    // subsamples are evaluated concurrently in waves, the points of a subsample on one thread
+    auto single_threaded = [this](const auto& X, const auto& Y) { return mixing(X, Y, 1); };
+    return entropy_details::estimate(a, b, single_threaded, sampleSize, threshold, maxIterations, logger);
 }
 
 
@@ -12,6 +12,15 @@ Copyright (c) 2020 Panda Team
 #include "../../3rdparty/blaze/Blaze.h"
 #include "../distance/k-related/Standards.hpp"
 #include "../../modules/utils/type_traits.hpp"
+#include "../utils/subsample_waves.hpp"
+#include "correlation_matrix.hpp"
+#include "../space/tree.hpp"
+
+#include <array>
+#include <deque>
+#include <memory>
+#include <set>
+#include <unordered_map>
 
 namespace metric {
 
@@ -41,7 +50,8 @@ public:
             const Container & a,
             const size_t sampleSize = 250,
             const double threshold = 0.05,
-            size_t maxIterations = 1000
+            size_t maxIterations = 1000,
+            const estimate_logger& logger = nullptr
     ) const;
 
 private:
@@ -54,15 +64,107 @@ private:
 
 
 
+/**
+ * @brief EntropySimple over a sliding window of the last records, updated on every record
+ *
+ * Points of the window are kept in a cover tree, every point keeps its k nearest neighbours and the points having it
+ * among their neighbours. An arriving record changes the neighbours of the points closer to it than their k-th
+ * neighbour, an expiring one of the points having it among neighbours, only their log distances are updated.
+ * Expired points stay in the tree and are skipped by queries until they are a quarter of the points of the
+ * window, then the tree is built again. As in EntropySimple records closer than epsilon to a point of the window
+ * are merged into the point.
+ */
+template <typename RecType, typename Metric = metric::Euclidean<typename RecType::value_type>>
+class EntropyWindow {
+public:
+    /**
+     * @brief Construct a new EntropyWindow object
+     *
+     * @param window number of last records the entropy is estimated from
+     * @param metric distance between records
+     * @param k neighbour the distance is taken to
+     * @param exp convert values below 1 to exp scale
+     */
+    explicit EntropyWindow(size_t window, Metric metric = Metric(), size_t k = 3, bool exp = false);
+
+    /**
+     * @brief add record to the window, the oldest record expires when the window is full
+     *
+     * @param record new record
+     */
+    void push(const RecType& record);
+
+    /**
+     * @brief entropy of records in the window
+     *
+     * @return entropy estimate, NaN until there are more than k distinct records
+     */
+    double operator()() const;
+
+    /**
+     * @brief number of records in the window
+     */
+    size_t size() const { return records.size(); }
+
+private:
+    using tree_type = metric::Tree<RecType, Metric>;
+    using distance_type = typename tree_type::Distance;
+
+    struct point {
+        RecType record;
+        // node of the record in the tree
+        size_t node = 0;
+        // records of the window merged into the point
+        size_t count = 0;
+        // k nearest other points with distances, ascending
+        std::vector<std::pair<distance_type, size_t>> neighbours;
+        // points having this one among neighbours
+        std::vector<size_t> reverse;
+    };
+
+    size_t window;
+    size_t k;
+    Metric metric;
+    bool exp;
+    double logbase = 2;
+
+    std::unique_ptr<tree_type> tree;
+    // point of every node of the tree in the window, expired nodes have none
+    std::unordered_map<size_t, size_t> nodes;
+    size_t expired = 0;
+    // point of every record in the window, oldest first
+    std::deque<size_t> records;
+    std::unordered_map<size_t, point> points;
+    size_t next_id = 0;
+    // k-th neighbour distances of points and the sum of their logs, summed again every window records
+    std::set<std::pair<distance_type, size_t>> radii;
+    // number of points with the widest distances checked without the tree on arrival
+    static constexpr size_t wide_points = 128;
+    double log_sum = 0;
+    size_t pushed = 0;
+
+    void set_neighbours(size_t id, std::vector<std::pair<distance_type, size_t>> neighbours);
+    std::vector<std::pair<distance_type, size_t>> nearest(size_t id) const;
+    void insert_point(size_t id);
+    void erase_point(size_t id);
+    void rebuild_tree();
+};
+
+
 // https://hal.inria.fr/hal-01272527/document
 template <typename RecType, typename Metric = metric::Chebyshev<typename RecType::value_type>>
 class Entropy {
 public:
-    Entropy(Metric metric = Metric(), size_t k = 7, size_t p = 70, bool exp = false) :
+    /**
+     * @param threads number of threads the points are spread over, 0 for the number of hardware threads,
+     * the result does not depend on it
+     */
+    Entropy(Metric metric = Metric(), size_t k = 7, size_t p = 70, bool exp = false, size_t threads = 0) :
         metric(metric),
         k(k),
         p(p),
-        exp(exp) {}
+        exp(exp),
+        threads(threads) {}
 
     template <typename Container>
     double operator()(const Container& data) const;
@@ -72,7 +174,8 @@ public:
             const Container & a,
             const size_t sampleSize = 250,
             const double threshold = 0.05,
-            size_t maxIterations = 1000
+            size_t maxIterations = 1000,
+            const estimate_logger& logger = nullptr
     ) const;
 
 private:
@@ -80,6 +183,7 @@ private:
     size_t p;
     Metric metric;
     bool exp;
+    size_t threads;
 };
 
 
@@ -103,12 +207,34 @@ public:
             const C& b,
             const size_t sampleSize = 250,
             const double threshold = 0.05,
-            size_t maxIterations = 1000
+            size_t maxIterations = 1000,
+            const estimate_logger& logger = nullptr
     ) const;
 
+    /**
+     * @brief VMixing of all pairs of channels, the entropy of every channel alone is computed once,
+     * pairs are evaluated concurrently
+     *
+     * @param channels datasets of the same dimension
+     * @param progress called after every channel and pair, returning false cancels the rest, which stays NaN
+     * @param threads pool size, 0 for the number of hardware threads
+     * @return symmetric matrix with matrix(i, j) equal to the VMixing of channels i and j for i <= j
+     */
+    template <typename C>
+    blaze::SymmetricMatrix<blaze::DynamicMatrix<double>> matrix(const std::vector<C>& channels,
+        const matrix_progress& progress = nullptr, size_t threads = 0) const;
+
 private:
     int k;
     Metric metric;
+
+    // VMixing of Xc and Yc with the points spread over threads, 0 for the number of hardware threads
+    template <typename C>
+    double mixing(const C& Xc, const C& Yc, size_t threads) const;
+
+    // entropies of XY, X and Y from one tree over XY, the first one only with xy, the others only with own
+    template <typename C>
+    std::array<double, 3> joint_entropies(const C& Xc, const C& Yc, bool xy, bool own, size_t threads = 0) const;
 };
 
 
@@ -131,13 +257,35 @@ public:
             const C& b,
             const size_t sampleSize = 250,
             const double threshold = 0.05,
-            size_t maxIterations = 1000
+            size_t maxIterations = 1000,
+            const estimate_logger& logger = nullptr
     ) const;
 
+    /**
+     * @brief VMixing of all pairs of channels, the entropy of every channel alone is computed once,
+     * pairs are evaluated concurrently
+     *
+     * @param channels datasets of the same dimension
+     * @param progress called after every channel and pair, returning false cancels the rest, which stays NaN
+     * @param threads pool size, 0 for the number of hardware threads
+     * @return symmetric matrix with matrix(i, j) equal to the VMixing of channels i and j for i <= j
+     */
+    template <typename C>
+    blaze::SymmetricMatrix<blaze::DynamicMatrix<double>> matrix(const std::vector<C>& channels,
+        const matrix_progress& progress = nullptr, size_t threads = 0) const;
+
 private:
     int k;
     int p;
     Metric metric;
+
+    // VMixing of Xc and Yc with the points spread over threads, 0 for the number of hardware threads
+    template <typename C>
+    double mixing(const C& Xc, const C& Yc, size_t threads) const;
+
+    // entropies of XY, X and Y from one tree over XY, the first one only with xy, the others only with own
+    template <typename C>
+    std::array<double, 3> joint_entropies(const C& Xc, const C& Yc, bool xy, bool own, size_t threads = 0) const;
 };
 
 
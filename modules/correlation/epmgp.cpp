@@ -34,9 +34,13 @@ const double inf = std::numeric_limits<double>::infinity();
 // https://stackoverflow.com/questions/39777360/accurate-computation-of-scaled-complementary-error-function-erfcx
 double erfcx_double (double x)
 {
-    double a, d, e, m, p, q, r, s, t;
+    return erfcx_from_abs(x, erfcx_abs(fmax (x, 0.0 - x))); // NaN preserving absolute value computation
+}
+
 
-    a = fmax (x, 0.0 - x); // NaN preserving absolute value computation
+inline double erfcx_abs(double a)
+{
+    double d, e, m, p, q, r, t;
 
     /* Compute q = (a-4)/(a+4) accurately. [0,INF) -> [-1,1] */
     m = a - 4.0;
@@ -84,6 +88,13 @@ double erfcx_double (double x)
 
     /* Handle argument of infinity */
     if (a > 0x1.fffffffffffffp1023) r = 0.0;
+    return r;
+}
+
+
+inline double erfcx_from_abs(double x, double r)
+{
+    double d, e, s;
 
     /* Handle negative arguments: erfcx(x) = 2*exp(x*x) - erfcx(|x|) */
     if (x < 0.0) {
@@ -99,23 +110,37 @@ double erfcx_double (double x)
 }
 
 
-template <typename T>
-auto truncNormMoments(
-    std::vector<T> lowerBIN,
-    std::vector<T> upperBIN,
-    std::vector<T> muIN,
-    std::vector<T> sigmaIN
-) -> std::tuple<std::vector<T>, std::vector<T>, std::vector<T>>
+inline void erfcx_abs(const double* x, double* r, size_t count)
 {
-    size_t n = lowerBIN.size();
+    for (size_t i = 0; i < count; ++i) {
+        r[i] = erfcx_abs(fmax (x[i], 0.0 - x[i]));
+    }
+}
 
-    assert(upperBIN.size()==n && muIN.size()==n && sigmaIN.size()==n);
 
-    std::vector<T> logZhatOUT (n, 0);
-    std::vector<T> muHatOUT (n, 0);
-    std::vector<T> sigmaHatOUT (n, 0);
+template <typename T>
+void truncNormMoments(
+    size_t count,
+    const T* lowerBIN,
+    const T* upperBIN,
+    const T* muIN,
+    const T* sigmaIN,
+    T* logZhatOUT,
+    T* muHatOUT,
+    T* sigmaHatOUT,
+    double* erfcx_buffer
+)
+{
+    // standardized bounds, then erfcx of their absolute values in one pass, erfcx of both signs is derived from it
+    for (size_t i = 0; i<count; ++i) {
+        erfcx_buffer[i] = (lowerBIN[i] - muIN[i])/(std::sqrt(2*sigmaIN[i]));
+        erfcx_buffer[count + i] = (upperBIN[i] - muIN[i])/(std::sqrt(2*sigmaIN[i]));
+    }
+    erfcx_abs(erfcx_buffer, erfcx_buffer + 2*count, 2*count);
 
-    for (size_t i = 0; i<n; ++i) {
+    auto erfcx_of = [](T x, double r) { return (T)erfcx_from_abs((double)x, r); };
+
+    for (size_t i = 0; i<count; ++i) {
 
         auto lowerB = lowerBIN[i];
         auto upperB = upperBIN[i];
@@ -126,8 +151,10 @@ auto truncNormMoments(
 
         T logZhat, meanConst, varConst;
 
-        auto a = (lowerB - mu)/(std::sqrt(2*sigma));
-        auto b = (upperB - mu)/(std::sqrt(2*sigma));
+        auto a = T(erfcx_buffer[i]);
+        auto b = T(erfcx_buffer[count + i]);
+        const double ra = erfcx_buffer[2*count + i];
+        const double rb = erfcx_buffer[3*count + i];
 
         if (std::isinf(a) && std::isinf(b)) {
             if (sgn(a)==sgn(b)) {
@@ -150,53 +177,53 @@ auto truncNormMoments(
             } else {
                 if (a == -inf) {
                     if (b > 26) {
-                        auto logZhatOtherTail = std::log(0.5) + std::log(erfcx(b)) - b*b;
+                        auto logZhatOtherTail = std::log(0.5) + std::log(erfcx_of(b, rb)) - b*b;
                         logZhat = std::log(1 - std::exp(logZhatOtherTail));
                     }
                     else
-                        logZhat = std::log(0.5) + std::log(erfcx(-b)) - b*b;
-                    meanConst = -2/erfcx(-b);
-                    varConst = -2/erfcx(-b)*(upperB + mu);
+                        logZhat = std::log(0.5) + std::log(erfcx_of(-b, rb)) - b*b;
+                    meanConst = -2/erfcx_of(-b, rb);
+                    varConst = -2/erfcx_of(-b, rb)*(upperB + mu);
                 } else {
                     if (b == inf) {
                         if (a < -26) {
-                            auto logZhatOtherTail = std::log(0.5) + std::log(erfcx(-a)) - a*a;
+                            auto logZhatOtherTail = std::log(0.5) + std::log(erfcx_of(-a, ra)) - a*a;
                             logZhat = std::log(1 - std::exp(logZhatOtherTail));
                             //logZhat = 0; // lim[-Inf]logZhat = 0
                         } else {
-                            logZhat = std::log(0.5) + std::log(erfcx(a)) - a*a;
+                            logZhat = std::log(0.5) + std::log(erfcx_of(a, ra)) - a*a;
                         }
-                        meanConst = 2/erfcx(a);
-                        varConst = 2/erfcx(a)*(lowerB + mu);
+                        meanConst = 2/erfcx_of(a, ra);
+                        varConst = 2/erfcx_of(a, ra)*(lowerB + mu);
                     } else {
                         if (sgn(a)==sgn(b)) {
                             auto abs_a = std::abs(a);
                             auto abs_b = std::abs(b);
                             auto maxab = (abs_a < abs_b) ? abs_b : abs_a;
                             auto minab = (abs_a < abs_b) ? abs_a : abs_b;
-                            logZhat = std::log(0.5) - minab*minab + std::log( std::abs( std::exp(-(maxab*maxab - minab*minab))*erfcx(maxab) - erfcx(minab) ) );
-                            meanConst = 2*sgn(a)*( 1/((erfcx(std::abs(a)) - std::exp(a*a - b*b)*erfcx(std::abs(b)))) - 1/((std::exp(b*b - a*a)*erfcx(std::abs(a)) - erfcx(std::abs(b)))) );
-                            varConst =  2*sgn(a)*( (lowerB + mu)/((erfcx(std::abs(a)) - std::exp(a*a - b*b)*erfcx(std::abs(b)))) - (upperB + mu)/((std::exp(b*b - a*a)*erfcx(std::abs(a)) - erfcx(std::abs(b)))) );
+                            logZhat = std::log(0.5) - minab*minab + std::log( std::abs( std::exp(-(maxab*maxab - minab*minab))*erfcx_of(maxab, abs_a < abs_b ? rb : ra) - erfcx_of(minab, abs_a < abs_b ? ra : rb) ) );
+                            meanConst = 2*sgn(a)*( 1/((erfcx_of(std::abs(a), ra) - std::exp(a*a - b*b)*erfcx_of(std::abs(b), rb))) - 1/((std::exp(b*b - a*a)*erfcx_of(std::abs(a), ra) - erfcx_of(std::abs(b), rb))) );
+                            varConst =  2*sgn(a)*( (lowerB + mu)/((erfcx_of(std::abs(a), ra) - std::exp(a*a - b*b)*erfcx_of(std::abs(b), rb))) - (upperB + mu)/((std::exp(b*b - a*a)*erfcx_of(std::abs(a), ra) - erfcx_of(std::abs(b), rb))) );
                         } else {
                             if (std::abs(b) >= std::abs(a)) {
                                 if (a >= -26) {
-                                    logZhat = std::log(0.5) - a*a + std::log( erfcx(a) - std::exp(-(b*b - a*a))*erfcx(b) );
-                                    meanConst = 2*(1/((erfcx(a) - std::exp(a*a - b*b)*erfcx(b))) - 1/((std::exp(b*b - a*a)*erfcx(a) - erfcx(b))));
-                                    varConst = 2*((lowerB + mu)/((erfcx(a) - std::exp(a*a - b*b)*erfcx(b))) - (upperB + mu)/((std::exp(b*b - a*a)*erfcx(a) - erfcx(b))));
+                                    logZhat = std::log(0.5) - a*a + std::log( erfcx_of(a, ra) - std::exp(-(b*b - a*a))*erfcx_of(b, rb) );
+                                    meanConst = 2*(1/((erfcx_of(a, ra) - std::exp(a*a - b*b)*erfcx_of(b, rb))) - 1/((std::exp(b*b - a*a)*erfcx_of(a, ra) - erfcx_of(b, rb))));
+                                    varConst = 2*((lowerB + mu)/((erfcx_of(a, ra) - std::exp(a*a - b*b)*erfcx_of(b, rb))) - (upperB + mu)/((std::exp(b*b - a*a)*erfcx_of(a, ra) - erfcx_of(b, rb))));
                                 } else {
-                                    logZhat = std::log(0.5) + std::log( 2 - std::exp(-(b*b))*erfcx(b) - std::exp(-(a*a))*erfcx(-a) );
-                                    meanConst = 2*( 1/((erfcx(a) - std::exp(a*a - b*b)*erfcx(b))) - 1/(std::exp(b*b)*2 - erfcx(b)) );
-                                    varConst = 2*( (lowerB + mu)/((erfcx(a) - std::exp(a*a - b*b)*erfcx(b))) - (upperB + mu)/(std::exp(b*b)*2 - erfcx(b)) );
+                                    logZhat = std::log(0.5) + std::log( 2 - std::exp(-(b*b))*erfcx_of(b, rb) - std::exp(-(a*a))*erfcx_of(-a, ra) );
+                                    meanConst = 2*( 1/((erfcx_of(a, ra) - std::exp(a*a - b*b)*erfcx_of(b, rb))) - 1/(std::exp(b*b)*2 - erfcx_of(b, rb)) );
+                                    varConst = 2*( (lowerB + mu)/((erfcx_of(a, ra) - std::exp(a*a - b*b)*erfcx_of(b, rb))) - (upperB + mu)/(std::exp(b*b)*2 - erfcx_of(b, rb)) );
                                 }
                             } else {
                                 if (b <= 26) {
-                                    logZhat = std::log(0.5) - b*b + std::log( erfcx(-b) - std::exp(-(a*a - b*b))*erfcx(-a));
-                                    meanConst = -2*( 1/((erfcx(-a) - std::exp(a*a - b*b)*erfcx(-b))) - 1/((std::exp(b*b - a*a)*erfcx(-a) - erfcx(-b))) );
-                                    varConst = -2*( (lowerB + mu)/((erfcx(-a) - std::exp(a*a - b*b)*erfcx(-b))) - (upperB + mu)/((std::exp(b*b - a*a)*erfcx(-a) - erfcx(-b))) );
+                                    logZhat = std::log(0.5) - b*b + std::log( erfcx_of(-b, rb) - std::exp(-(a*a - b*b))*erfcx_of(-a, ra));
+                                    meanConst = -2*( 1/((erfcx_of(-a, ra) - std::exp(a*a - b*b)*erfcx_of(-b, rb))) - 1/((std::exp(b*b - a*a)*erfcx_of(-a, ra) - erfcx_of(-b, rb))) );
+                                    varConst = -2*( (lowerB + mu)/((erfcx_of(-a, ra) - std::exp(a*a - b*b)*erfcx_of(-b, rb))) - (upperB + mu)/((std::exp(b*b - a*a)*erfcx_of(-a, ra) - erfcx_of(-b, rb))) );
                                 } else {
-                                    logZhat = std::log(0.5) + std::log( 2 - std::exp(-(a*a))*erfcx(-a) - std::exp(-(b*b))*erfcx(b) );
-                                    meanConst = -2*( 1/(erfcx(-a) - std::exp(a*a)*2) - 1/(std::exp(b*b - a*a)*erfcx(-a) - erfcx(-b)) );
-                                    varConst = -2*( (lowerB + mu)/(erfcx(-a) - std::exp(a*a)*2) - (upperB + mu)/(std::exp(b*b - a*a)*erfcx(-a) - erfcx(-b)) );
+                                    logZhat = std::log(0.5) + std::log( 2 - std::exp(-(a*a))*erfcx_of(-a, ra) - std::exp(-(b*b))*erfcx_of(b, rb) );
+                                    meanConst = -2*( 1/(erfcx_of(-a, ra) - std::exp(a*a)*2) - 1/(std::exp(b*b - a*a)*erfcx_of(-a, ra) - erfcx_of(-b, rb)) );
+                                    varConst = -2*( (lowerB + mu)/(erfcx_of(-a, ra) - std::exp(a*a)*2) - (upperB + mu)/(std::exp(b*b - a*a)*erfcx_of(-a, ra) - erfcx_of(-b, rb)) );
                                 }
                             }
                         }
@@ -213,126 +240,243 @@ auto truncNormMoments(
         sigmaHatOUT[i] = sigmaHat;
 
     }
+}
+
+
+template <typename T>
+auto truncNormMoments(
+    std::vector<T> lowerBIN,
+    std::vector<T> upperBIN,
+    std::vector<T> muIN,
+    std::vector<T> sigmaIN
+) -> std::tuple<std::vector<T>, std::vector<T>, std::vector<T>>
+{
+    size_t n = lowerBIN.size();
+
+    assert(upperBIN.size()==n && muIN.size()==n && sigmaIN.size()==n);
+
+    std::vector<T> logZhatOUT (n, 0);
+    std::vector<T> muHatOUT (n, 0);
+    std::vector<T> sigmaHatOUT (n, 0);
+    std::vector<double> erfcx_buffer (4*n, 0);
+
+    truncNormMoments(n, lowerBIN.data(), upperBIN.data(), muIN.data(), sigmaIN.data(),
+        logZhatOUT.data(), muHatOUT.data(), sigmaHatOUT.data(), erfcx_buffer.data());
 
     return std::make_tuple(logZhatOUT, muHatOUT, sigmaHatOUT);
 }
 
 
 template <typename T>
-auto local_gaussian_axis_aligned_hyperrectangles(
-    blaze::DynamicVector<T> m,
-    blaze::DynamicMatrix<T> K,
-    blaze::DynamicVector<T> lowerB,
-    blaze::DynamicVector<T> upperB
-) -> std::tuple<T, blaze::DynamicVector<T>, blaze::DynamicMatrix<T>>
+void workspace<T>::resize(size_t count, size_t n)
 {
-    size_t n = m.size();
-    assert(lowerB.size() == n && upperB.size() == n && K.rows() == n);
+    if (problems.size() < count)
+        problems.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        auto & p = problems[i];
+        p.tauSite.resize(n, false);
+        p.nuSite.resize(n, false);
+        p.tauCavity.resize(n, false);
+        p.nuCavity.resize(n, false);
+        p.KinvM.resize(n, false);
+        p.muLast.resize(n, false);
+        p.logZhat.resize(n, false);
+        p.muhat.resize(n, false);
+        p.sighat.resize(n, false);
+        p.sSiteHalf.resize(n, false);
+        p.rhs.resize(n, false);
+        p.mu.resize(n, false);
+        p.A.resize(n, n, false);
+        p.L.resize(n, n, false);
+        p.V.resize(n, n, false);
+        p.sigma.resize(n, n, false);
+    }
+    lowerB.resize(count*n);
+    upperB.resize(count*n);
+    muIn.resize(count*n);
+    sigmaIn.resize(count*n);
+    logZhat.resize(count*n);
+    muHat.resize(count*n);
+    sigmaHat.resize(count*n);
+    erfcx_buffer.resize(4*count*n);
+    active.reserve(count);
+}
+
+
+template <typename T>
+void local_gaussian_axis_aligned_hyperrectangles(workspace<T>& ws, size_t count)
+{
+    if (count == 0)
+        return;
+    size_t n = ws.problems[0].m.size();
+    ws.resize(count, n);
 
     size_t maxSteps = 200;
     T epsConverge = 1e-8;
 
-    blaze::DynamicVector<T> tauSite (K.rows(), 0);
-    blaze::DynamicVector<T> nuSite (K.rows(), 0);
+    for (size_t j = 0; j < count; ++j) {
+        auto & p = ws.problems[j];
+        assert(p.m.size() == n && p.lowerB.size() == n && p.upperB.size() == n && p.K.rows() == n);
+
+        p.KinvM = blaze::evaluate(blaze::inv(p.K) * p.m);
+        p.tauSite = 0;
+        p.nuSite = 0;
+        p.mu = (p.lowerB + p.upperB) / 2.0;
+        p.sigma = p.K;
+        p.muLast = -inf;
+        p.converged = false;
+    }
 
-    T logZ = 0;
-    blaze::DynamicVector<T> mu = (lowerB + upperB) / 2.0;
-    blaze::DynamicMatrix<T> sigma = K;
-    blaze::DynamicVector<T> KinvM = blaze::evaluate(blaze::inv(K) * m);
-    blaze::DynamicVector<T> muLast (mu.size(), 1);
-    muLast = muLast * -inf;
-    bool converged = false;
-    size_t k = 1;
+    // cavity parameters from the current state of the problem
+    auto cavity = [n](typename workspace<T>::problem & p) {
+        for (size_t i = 0; i < n; ++i) {
+            p.tauCavity[i] = 1/p.sigma(i, i) - p.tauSite[i];
+            p.nuCavity[i] = p.mu[i]/p.sigma(i, i) - p.nuSite[i];
+        }
+    };
 
-    // here we only define expressions, calculations are made inside the loop below
-    auto tauCavity = 1/blaze::diagonal(sigma) - tauSite;
-    auto nuCavity =  mu/blaze::diagonal(sigma) - nuSite;
-    blaze::DynamicVector<T> sighat (n, 0);
-    auto deltatauSite = 1.0/sighat - tauCavity - tauSite;
-    auto logZhat = blaze::DynamicVector<T>(n, 0);
-    blaze::DynamicMatrix<T> L;
+    for (size_t k = 1; k < maxSteps; ++k) {
+        ws.active.clear();
+        for (size_t j = 0; j < count; ++j) {
+            if (!ws.problems[j].converged)
+                ws.active.push_back(j);
+        }
+        if (ws.active.empty())
+            break;
+
+        // moments of all active problems in one pass
+        for (size_t a = 0; a < ws.active.size(); ++a) {
+            auto & p = ws.problems[ws.active[a]];
+            cavity(p);
+            for (size_t i = 0; i < n; ++i) {
+                ws.lowerB[a*n + i] = p.lowerB[i];
+                ws.upperB[a*n + i] = p.upperB[i];
+                ws.muIn[a*n + i] = p.nuCavity[i] * (1/p.tauCavity[i]);
+                ws.sigmaIn[a*n + i] = 1/p.tauCavity[i];
+            }
+        }
+        truncNormMoments(ws.active.size()*n, ws.lowerB.data(), ws.upperB.data(), ws.muIn.data(), ws.sigmaIn.data(),
+            ws.logZhat.data(), ws.muHat.data(), ws.sigmaHat.data(), ws.erfcx_buffer.data());
+
+        for (size_t a = 0; a < ws.active.size(); ++a) {
+            auto & p = ws.problems[ws.active[a]];
+            for (size_t i = 0; i < n; ++i) {
+                p.logZhat[i] = ws.logZhat[a*n + i];
+                p.muhat[i] = ws.muHat[a*n + i];
+                p.sighat[i] = ws.sigmaHat[a*n + i];
+
+                T deltatauSite = 1.0/p.sighat[i] - p.tauCavity[i] - p.tauSite[i];
+                p.tauSite[i] = p.tauSite[i] + deltatauSite;
+                p.nuSite[i] = p.muhat[i]/p.sighat[i] - p.nuCavity[i];
+
+                if (p.tauSite[i] < 0 || std::isnan(p.tauSite[i])) // this differs from Matlab code
+                    p.sSiteHalf[i] = 0;
+                else
+                    p.sSiteHalf[i] = std::sqrt(p.tauSite[i]);
+            }
 
-    std::vector<T> muInSTL (n, 0);
-    std::vector<T> sigmaInSTL (n, 0);
-    std::vector<T> lowerbSTL (lowerB.size(), 0);
-    std::vector<T> upperbSTL (upperB.size(), 0);
+            // A = I + S K S, V = L^-1 S K for the lower Cholesky factor L of A
+            for (size_t r = 0; r < n; ++r) {
+                for (size_t c = 0; c < n; ++c) {
+                    p.V(r, c) = p.sSiteHalf[r]*p.K(r, c);
+                    p.A(r, c) = (r == c ? 1 : 0) + p.V(r, c)*p.sSiteHalf[c];
+                }
+            }
+            blaze::llh(p.A, p.L);
+            for (size_t r = 0; r < n; ++r) {
+                for (size_t c = 0; c < r; ++c)
+                    blaze::row(p.V, r) -= p.L(r, c) * blaze::row(p.V, c);
+                blaze::row(p.V, r) /= p.L(r, r);
+            }
 
-    while (!converged && k < maxSteps) {
-        blaze::DynamicVector<T> muInBlaze ( nuCavity * (1/tauCavity) );
-        blaze::DynamicVector<T> sigmaInBlaze = 1/tauCavity;
+            p.sigma = p.K - blaze::trans(p.V)*p.V;
+            p.rhs = p.nuSite + p.KinvM;
+            p.mu = p.sigma*p.rhs;
 
-        for (size_t i = 0; i < n; ++i) {
-            muInSTL[i] = muInBlaze[i];
-            sigmaInSTL[i] = sigmaInBlaze[i];
-            lowerbSTL[i] = lowerB[i];
-            upperbSTL[i] = upperB[i];
+            T diff = 0;
+            for (size_t i = 0; i < n; ++i)
+                diff += (p.muLast[i] - p.mu[i])*(p.muLast[i] - p.mu[i]);
+            if (std::sqrt(diff) < epsConverge) // (norm(muLast-mu)) < epsConverge
+                p.converged = true;
+            else
+                p.muLast = p.mu;
         }
+    }
 
-        auto hat = truncNormMoments(lowerbSTL, upperbSTL, muInSTL, sigmaInSTL);
+    for (size_t j = 0; j < count; ++j) {
+        auto & p = ws.problems[j];
+        cavity(p);
 
-        auto logZhatSTL = std::get<0>(hat);
-        auto muhatSTL = std::get<1>(hat);
-        auto sighatSTL = std::get<2>(hat);
-        blaze::DynamicVector<T> muhat (muhatSTL.size(), 0);
-        //blaze::DynamicVector<double> sighat (sighatSTL.size(), 0); // moved outside loop
-        assert(logZhat.size() == n && muhat.size() == n && sighat.size() == n); // TODO remove after testing
+        T lZ1 = 0;
+        T lZ2 = 0;
+        T lZ3 = 0;
+        T lZ4 = 0;
+        // rhs holds diffSite = nuSite - tauSite*m
         for (size_t i = 0; i < n; ++i) {
-            logZhat[i] = logZhatSTL[i];
-            muhat[i] = muhatSTL[i];
-            sighat[i] = sighatSTL[i];
+            lZ1 += std::log(1 + p.tauSite[i]/p.tauCavity[i])*0.5 - std::log(p.L(i, i));
+            p.rhs[i] = p.nuSite[i] - p.tauSite[i]*p.m[i];
+            T tauSum = p.tauSite[i] + p.tauCavity[i];
+            lZ2 -= p.rhs[i]*p.rhs[i]/tauSum;
+            lZ3 += p.nuCavity[i]*((p.tauSite[i]*p.nuCavity[i]/p.tauCavity[i] - 2*p.nuSite[i])/tauSum);
+            lZ4 += p.tauCavity[i]*p.m[i]*((p.tauSite[i]*p.m[i] - 2*p.nuSite[i])/tauSum);
         }
+        lZ2 += blaze::dot(p.rhs, p.sigma*p.rhs);
+        p.logZ = lZ1 + 0.5*lZ2 + 0.5*lZ3 - 0.5*lZ4 + blaze::sum(p.logZhat);
+    }
+}
 
-        //auto deltatauSite = 1.0/sighat - tauCavity - tauSite; // definition moved out of loop
-        tauSite = blaze::evaluate(tauSite + deltatauSite);
-        nuSite = blaze::evaluate(muhat/sighat - nuCavity);
 
-        blaze::DiagonalMatrix<blaze::DynamicMatrix<T>> sSiteHalf (tauSite.size(), 0);
-        for (size_t i = 0; i<tauSite.size(); ++i) {
-            if (tauSite[i] < 0 || std::isnan(tauSite[i])) // this differs from Matlab code
-                sSiteHalf(i, i) = 0;
-            else
-                sSiteHalf(i, i) = std::sqrt(tauSite[i]);
-        }
-        blaze::IdentityMatrix<T> eye (K.rows());
-        blaze::llh(eye + sSiteHalf*K*sSiteHalf, L);
-        L = blaze::trans(L); // get lower from upper
-        //L = eye + sSiteHalf*K*sSiteHalf; // TODO remove
-        //std::cout << "L:\n" << L << "\n";
-        //blaze::potrf(L, 'U'); // LAPACK issue
-        //std::cout << "L_chol:\n" << L << "\n";
-        auto V = blaze::inv(blaze::trans(L)) * (sSiteHalf*K);
-        sigma = K - blaze::trans(V)*V;
-        mu = sigma*(nuSite + KinvM);
-        blaze::DynamicVector<T> diff = muLast - mu;
+template <typename T>
+std::vector<T> local_gaussian_axis_aligned_hyperrectangles_batch(
+    const std::vector<blaze::DynamicVector<T>>& m,
+    const std::vector<blaze::DynamicMatrix<T>>& K,
+    const std::vector<blaze::DynamicVector<T>>& lowerB,
+    const std::vector<blaze::DynamicVector<T>>& upperB,
+    workspace<T>& ws
+)
+{
+    size_t count = m.size();
+    assert(K.size() == count && lowerB.size() == count && upperB.size() == count);
+    if (count == 0)
+        return {};
+
+    ws.resize(count, m[0].size());
+    for (size_t j = 0; j < count; ++j) {
+        ws.problems[j].m = m[j];
+        ws.problems[j].K = K[j];
+        ws.problems[j].lowerB = lowerB[j];
+        ws.problems[j].upperB = upperB[j];
+    }
+    local_gaussian_axis_aligned_hyperrectangles(ws, count);
 
-        if (std::sqrt(blaze::trans(diff) * diff) < epsConverge) // (norm(muLast-mu)) < epsConverge
-            converged = true;
-        else
-            muLast = mu;
+    std::vector<T> logZ (count, 0);
+    for (size_t j = 0; j < count; ++j)
+        logZ[j] = ws.problems[j].logZ;
+    return logZ;
+}
 
-        k++;
-    }
 
-    T lZ1 = 0;
-    blaze::DiagonalMatrix<blaze::DynamicMatrix<T>> tau (n, 0);
-    blaze::DiagonalMatrix<blaze::DynamicMatrix<T>> diagTauSite (n, 0);
-    blaze::DiagonalMatrix<blaze::DynamicMatrix<T>> diagTauCavity (n, 0);
-    //blaze::DynamicMatrix<double> diagTauSite (n, n, 0);
-    //blaze::DynamicMatrix<double> diagTauCavity (n, n, 0);
+template <typename T>
+auto local_gaussian_axis_aligned_hyperrectangles(
+    blaze::DynamicVector<T> m,
+    blaze::DynamicMatrix<T> K,
+    blaze::DynamicVector<T> lowerB,
+    blaze::DynamicVector<T> upperB
+) -> std::tuple<T, blaze::DynamicVector<T>, blaze::DynamicMatrix<T>>
+{
+    size_t n = m.size();
+    assert(lowerB.size() == n && upperB.size() == n && K.rows() == n);
 
-    for (size_t i = 0; i<n; ++i) {
-        lZ1 += std::log(1 + tauSite[i]/tauCavity[i])*0.5 - std::log(L(i, i));
-        tau(i, i) = 1/(tauCavity[i] + tauSite[i]);
-        diagTauSite(i, i) = tauSite[i];
-        diagTauCavity(i, i) = tauCavity[i];
-    }
-    blaze::DynamicVector<T> diffSite (nuSite - tauSite*m);
-    T lZ2 = 0.5*(blaze::trans(diffSite)*(sigma-tau)*diffSite);
-    auto lZ3 = 0.5*( blaze::trans(nuCavity)*( blaze::inv(diagTauSite + diagTauCavity)*(tauSite*nuCavity/tauCavity - 2*nuSite) ) );
-    auto lZ4 = - 0.5*( blaze::trans(tauCavity*m)*( blaze::inv(diagTauSite + diagTauCavity)*(tauSite*m - 2*nuSite) ) );
-    logZ = lZ1 + lZ2 + lZ3 + lZ4 + blaze::sum(logZhat);
+    workspace<T> ws;
+    ws.resize(1, n);
+    auto & p = ws.problems[0];
+    p.m = std::move(m);
+    p.K = std::move(K);
+    p.lowerB = std::move(lowerB);
+    p.upperB = std::move(upperB);
+    local_gaussian_axis_aligned_hyperrectangles(ws, 1);
 
-    return std::make_tuple(logZ, mu, sigma);
+    return std::make_tuple(p.logZ, std::move(p.mu), std::move(p.sigma));
 }
 
 
@@ -38,6 +38,18 @@ T erfcx_simple(T x) { // for double on x86_64, inf starts at -26
 double erfcx_double (double x);
 
 
+// erfcx_double(a) for a = |x|, shared by erfcx(x) and erfcx(-x)
+inline double erfcx_abs(double a);
+
+
+// erfcx_double(x) from r = erfcx_abs(|x|)
+inline double erfcx_from_abs(double x, double r);
+
+
+// r[i] = erfcx_abs(|x[i]|) for arrays, the loop has no branches
+inline void erfcx_abs(const double* x, double* r, size_t count);
+
+
 template <typename T>
 T erfcx(T x) { // for double, inf starts at -26 on x86_64
     return (T)erfcx_double((double)x);
@@ -53,6 +65,83 @@ auto truncNormMoments(
 ) -> std::tuple<std::vector<T>, std::vector<T>, std::vector<T>>;
 
 
+/**
+ * @brief moments of truncated normal distributions for arrays of count elements, nothing is allocated
+ *
+ * @param erfcx_buffer scratch of 4 * count values, erfcx is evaluated for all elements in one pass
+ */
+template <typename T>
+void truncNormMoments(
+    size_t count,
+    const T* lowerBIN,
+    const T* upperBIN,
+    const T* muIN,
+    const T* sigmaIN,
+    T* logZhatOUT,
+    T* muHatOUT,
+    T* sigmaHatOUT,
+    double* erfcx_buffer
+);
+
+
+/**
+ * @brief Preallocated state of a batch of EP problems of the same dimension
+ *
+ * Inputs m, K, lowerB and upperB of every problem are written to problems[i] in place, the solver leaves
+ * logZ, mu and sigma there. Buffers are reused as long as the batch size and the dimension do not grow.
+ */
+template <typename T>
+struct workspace {
+    struct problem {
+        // inputs
+        blaze::DynamicVector<T> m;
+        blaze::DynamicMatrix<T> K;
+        blaze::DynamicVector<T> lowerB;
+        blaze::DynamicVector<T> upperB;
+
+        // results
+        T logZ = 0;
+        blaze::DynamicVector<T> mu;
+        blaze::DynamicMatrix<T> sigma;
+
+        // EP state
+        blaze::DynamicVector<T> tauSite;
+        blaze::DynamicVector<T> nuSite;
+        blaze::DynamicVector<T> tauCavity;
+        blaze::DynamicVector<T> nuCavity;
+        blaze::DynamicVector<T> KinvM;
+        blaze::DynamicVector<T> muLast;
+        blaze::DynamicVector<T> logZhat;
+        blaze::DynamicVector<T> muhat;
+        blaze::DynamicVector<T> sighat;
+        blaze::DynamicVector<T> sSiteHalf;
+        blaze::DynamicVector<T> rhs;
+        blaze::DynamicMatrix<T> A;
+        blaze::DynamicMatrix<T> L;
+        blaze::DynamicMatrix<T> V;
+        bool converged = false;
+    };
+
+    std::vector<problem> problems;
+
+    // cavity parameters of the active problems in one array, and moments of the truncated normals
+    std::vector<T> lowerB;
+    std::vector<T> upperB;
+    std::vector<T> muIn;
+    std::vector<T> sigmaIn;
+    std::vector<T> logZhat;
+    std::vector<T> muHat;
+    std::vector<T> sigmaHat;
+    std::vector<double> erfcx_buffer;
+    std::vector<size_t> active;
+
+    /**
+     * @brief prepare buffers for count problems of dimension n
+     */
+    void resize(size_t count, size_t n);
+};
+
+
 template <typename T>
 auto local_gaussian_axis_aligned_hyperrectangles(
     blaze::DynamicVector<T> m,
@@ -61,6 +150,31 @@ auto local_gaussian_axis_aligned_hyperrectangles(
     blaze::DynamicVector<T> upperB
 ) -> std::tuple<T, blaze::DynamicVector<T>, blaze::DynamicMatrix<T>>;
 
+
+/**
+ * @brief solve the first count problems of the workspace, the EP iterations of all problems run in lockstep
+ *
+ * Every iteration the moments of the truncated normals of all not converged problems are computed in one pass.
+ * Results are left in ws.problems[i].logZ, mu and sigma.
+ */
+template <typename T>
+void local_gaussian_axis_aligned_hyperrectangles(workspace<T>& ws, size_t count);
+
+
+/**
+ * @brief solve many problems of the same dimension
+ *
+ * @return logZ for every problem, mu and sigma are left in ws.problems
+ */
+template <typename T>
+std::vector<T> local_gaussian_axis_aligned_hyperrectangles_batch(
+    const std::vector<blaze::DynamicVector<T>>& m,
+    const std::vector<blaze::DynamicMatrix<T>>& K,
+    const std::vector<blaze::DynamicVector<T>>& lowerB,
+    const std::vector<blaze::DynamicVector<T>>& upperB,
+    workspace<T>& ws
+);
+
 } // epmgp
 
 #include "epmgp.cpp"
@@ -9,11 +9,15 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <cstdint>
 #include <complex>
 #include <functional>
 #include <iterator>
+#include <memory>
 #include <numeric>
 #include <limits>
+#include <thread>
 #include <vector>
 
 #if defined(_MSC_VER)
@@ -54,6 +58,304 @@
 
 namespace metric {
 
+namespace mgc_details {
+
+    using rank_type = std::uint32_t;
+
+    // rows handed out to a thread at once
+    constexpr size_t rows_block = 64;
+
+    // partial sums of rows reduced in order
+    constexpr size_t reduction_slices = 64;
+
+    // calls f(begin, end) for blocks of [0, count) on the given number of threads, 0 for hardware threads
+    template <typename F>
+    void parallel_blocks(size_t count, size_t block, F f, size_t threads_count = 0)
+    {
+        if (threads_count == 0) {
+            threads_count = std::thread::hardware_concurrency();
+        }
+        const size_t blocks = (count + block - 1) / block;
+        threads_count = std::min(blocks, threads_count);
+        if (threads_count <= 1) {
+            if (count > 0) {
+                f(size_t(0), count);
+            }
+            return;
+        }
+        std::atomic<size_t> next_block(0);
+        auto worker = [&]() {
+            for (size_t begin = block * next_block++; begin < count; begin = block * next_block++) {
+                f(begin, std::min(count, begin + block));
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < threads_count; ++t) {
+            threads.emplace_back(worker);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    /**
+     * @brief columns of every row of X ordered by distance, ties in the order of columns,
+     * the ranks of ranked_distances are filtered from it
+     */
+    template <typename T>
+    blaze::DynamicMatrix<rank_type> distance_order(const DistanceMatrix<T>& X, size_t threads = 0)
+    {
+        const size_t n = X.rows();
+        blaze::DynamicMatrix<rank_type> order(n, n);
+        parallel_blocks(n, rows_block, [&](size_t begin, size_t end) {
+            // pairs are compared by value, then by column
+            std::vector<std::pair<T, rank_type>> row(n);
+            for (size_t r = begin; r < end; ++r) {
+                for (size_t c = 0; c < n; ++c) {
+                    row[c] = { X(r, c), rank_type(c) };
+                }
+                std::sort(row.begin(), row.end());
+                for (size_t k = 0; k < n; ++k) {
+                    order(r, k) = row[k].second;
+                }
+            }
+        }, threads);
+        return order;
+    }
+
+    /** @brief rank of every column in its row from the row orders of distance_order() **/
+    inline blaze::DynamicMatrix<size_t> order_ranks(const blaze::DynamicMatrix<rank_type>& order)
+    {
+        blaze::DynamicMatrix<size_t> ranks(order.rows(), order.columns());
+        for (size_t r = 0; r < order.rows(); ++r) {
+            for (size_t k = 0; k < order.columns(); ++k) {
+                ranks(r, order(r, k)) = k;
+            }
+        }
+        return ranks;
+    }
+
+    /**
+     * @brief distance matrix prepared for the local covariances, the centered matrix is not stored
+     *
+     * The matrix is the principal submatrix of rows and columns [offset, offset + size) of X.
+     * A(i, j) = X(i, j) - mean[j] for i != j and 0 on the diagonal, mean[j] is the column sum over size - 1.
+     * ranks(r, c) is the rank of X(r, c) in the row r, ties are ranked in the order of columns.
+     */
+    template <typename T>
+    struct ranked_distances {
+        const DistanceMatrix<T>& X;
+        const size_t offset;
+        const size_t size;
+        const size_t threads;
+        std::vector<T> mean;
+        blaze::DynamicMatrix<rank_type> ranks;
+        // sum of the centered entries with the column rank k, cumulative
+        std::vector<T> E;
+        // diagonal of the local variances
+        std::vector<T> variance;
+
+        /** @brief the whole matrix ranked by its distance_order() **/
+        explicit ranked_distances(const DistanceMatrix<T>& X_, size_t threads_ = 0);
+
+        /**
+         * @brief submatrix ranked by filtering the row orders of the whole matrix from distance_order,
+         * which gives the same ranks as sorting the rows of the submatrix
+         */
+        ranked_distances(const DistanceMatrix<T>& X_, const blaze::DynamicMatrix<rank_type>& order, size_t offset_,
+            size_t size_, size_t threads_ = 0);
+
+        T at(size_t i, size_t j) const { return X(offset + i, offset + j); }
+
+        T centered(size_t i, size_t j) const { return i == j ? T(0) : at(i, j) - mean[j]; }
+
+        /** @brief replace rows of ranks with the columns ordered by rank **/
+        void ranks_to_order();
+
+    private:
+        // means, column rank sums and local variances from the ranks
+        void accumulate();
+    };
+
+    template <typename T>
+    ranked_distances<T>::ranked_distances(const DistanceMatrix<T>& X_, size_t threads_)
+        : ranked_distances(X_, distance_order(X_, threads_), 0, X_.rows(), threads_)
+    {
+    }
+
+    template <typename T>
+    ranked_distances<T>::ranked_distances(const DistanceMatrix<T>& X_, const blaze::DynamicMatrix<rank_type>& order,
+        size_t offset_, size_t size_, size_t threads_)
+        : X(X_)
+        , offset(offset_)
+        , size(size_)
+        , threads(threads_)
+        , mean(size, 0)
+        , ranks(size, size)
+        , E(size, 0)
+        , variance(size, 0)
+    {
+        const size_t n = size;
+        const size_t total = X.rows();
+        parallel_blocks(n, rows_block, [&](size_t begin, size_t end) {
+            for (size_t r = begin; r < end; ++r) {
+                rank_type k = 0;
+                for (size_t m = 0; m < total; ++m) {
+                    const size_t c = order(offset + r, m);
+                    if (c >= offset && c < offset + n) {
+                        ranks(r, c - offset) = k++;
+                    }
+                }
+            }
+        }, threads);
+        accumulate();
+    }
+
+    template <typename T>
+    void ranked_distances<T>::accumulate()
+    {
+        const size_t n = size;
+
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j < n; ++j) {
+                mean[j] += at(i, j);
+            }
+        }
+        for (auto& m : mean) {
+            m /= n - 1;
+        }
+
+        // the local variance at scale k sums A(i, j) * A(j, i) over the pairs ranked not above k in both directions,
+        // rows are summed in a fixed number of slices reduced in order, so the result does not depend on threads
+        const size_t slices = std::min(reduction_slices, n);
+        std::vector<std::vector<T>> slice_E(slices, std::vector<T>(n, 0));
+        std::vector<std::vector<T>> slice_products(slices, std::vector<T>(n, 0));
+        parallel_blocks(slices, 1, [&](size_t first, size_t last) {
+            for (size_t slice = first; slice < last; ++slice) {
+                const size_t begin = n * slice / slices;
+                const size_t end = n * (slice + 1) / slices;
+                auto& block_E = slice_E[slice];
+                auto& block_products = slice_products[slice];
+                // ranks(i, j) is read by columns, so the rows i go in tiles
+                for (size_t tile = 0; tile < n; tile += rows_block) {
+                    const size_t tile_end = std::min(n, tile + rows_block);
+                    for (size_t j = begin; j < end; ++j) {
+                        for (size_t i = tile; i < tile_end; ++i) {
+                            const T a = centered(i, j);
+                            block_E[ranks(j, i)] += a;
+                            block_products[std::max(ranks(j, i), ranks(i, j))] += a * centered(j, i);
+                        }
+                    }
+                }
+            }
+        }, threads);
+
+        std::vector<T> products(n, 0);
+        for (size_t slice = 0; slice < slices; ++slice) {
+            for (size_t k = 0; k < n; ++k) {
+                E[k] += slice_E[slice][k];
+                products[k] += slice_products[slice][k];
+            }
+        }
+
+        for (size_t k = 1; k < n; ++k) {
+            E[k] += E[k - 1];
+            products[k] += products[k - 1];
+        }
+        for (size_t k = 0; k < n; ++k) {
+            variance[k] = products[k] - E[k] * E[k] / n / n;
+        }
+    }
+
+    template <typename T>
+    void ranked_distances<T>::ranks_to_order()
+    {
+        const size_t n = ranks.rows();
+        parallel_blocks(n, rows_block, [&](size_t begin, size_t end) {
+            std::vector<rank_type> order(n);
+            for (size_t r = begin; r < end; ++r) {
+                for (size_t c = 0; c < n; ++c) {
+                    order[ranks(r, c)] = rank_type(c);
+                }
+                for (size_t k = 0; k < n; ++k) {
+                    ranks(r, k) = order[k];
+                }
+            }
+        }, threads);
+    }
+
+    /**
+     * @brief local correlations of all scales (k, l) normalized by the local variances
+     *
+     * The covariance at scale (k, l) sums A(i, j) * B(j, i) over the pairs with the rank of X(j, i) in the row j
+     * not above k and the rank of Y(i, j) in the row i not above l. The sums of single scales are accumulated by
+     * blocks of k, pairs with the rank k are taken from the row order of X, so threads write disjoint rows,
+     * then the cumulative sums run along rows and along columns.
+     *
+     * @param x_order columns of the rows of X ordered by rank, as x.ranks after ranks_to_order()
+     * @param y_ranks transposed ranks of Y: rank of Y(i, j) in the row i is read from the row j
+     */
+    template <typename T>
+    blaze::DynamicMatrix<T> local_correlation(const ranked_distances<T>& x,
+        const blaze::DynamicMatrix<rank_type>& x_order, const ranked_distances<T>& y,
+        const blaze::DynamicMatrix<rank_type>& y_ranks)
+    {
+        const size_t n = x.size;
+        const size_t threads = x.threads;
+
+        blaze::DynamicMatrix<T> corr(n, n, 0);
+        parallel_blocks(n, rows_block / 4, [&](size_t begin, size_t end) {
+            for (size_t j = 0; j < n; ++j) {
+                for (size_t k = begin; k < end; ++k) {
+                    const size_t i = x_order(j, k);
+                    if (i != j) {
+                        corr(k, y_ranks(j, i)) += (x.at(j, i) - x.mean[j]) * (y.at(j, i) - y.mean[i]);
+                    }
+                }
+            }
+            for (size_t k = begin; k < end; ++k) {
+                for (size_t l = 1; l < n; ++l) {
+                    corr(k, l) += corr(k, l - 1);
+                }
+            }
+        }, threads);
+
+        parallel_blocks(n, rows_block * 4, [&](size_t begin, size_t end) {
+            for (size_t k = 1; k < n; ++k) {
+                for (size_t l = begin; l < end; ++l) {
+                    corr(k, l) += corr(k - 1, l);
+                }
+            }
+        }, threads);
+
+        parallel_blocks(n, rows_block, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                for (size_t l = 0; l < n; ++l) {
+                    T c = (corr(k, l) - x.E[k] * y.E[l] / n / n) / std::sqrt(x.variance[k] * y.variance[l]);
+                    if (std::isnan(c)) {
+                        c = 0;
+                    } else if (c > 1) {
+                        c = 1;
+                    }
+                    corr(k, l) = c;
+                }
+            }
+        }, threads);
+
+        return corr;
+    }
+
+    /** @brief local correlations of x and y, the ranks of both are replaced in place **/
+    template <typename T>
+    blaze::DynamicMatrix<T> local_correlation(ranked_distances<T>& x, ranked_distances<T>& y)
+    {
+        x.ranks_to_order();
+        blaze::transpose(y.ranks);
+        return local_correlation(x, x.ranks, y, y.ranks);
+    }
+
+}  // namespace mgc_details
+
 // computes the (pairwise) distance matrix for arbitrary random access matrix like containers.
 template <typename Container>
 Container distance_matrix(const Container& data)
@@ -77,53 +379,25 @@ Container distance_matrix(const Container& data)
 template <typename T>
 blaze::DynamicMatrix<size_t> MGC_direct::rank_distance_matrix(const DistanceMatrix<T>& data)
 {
-    blaze::DynamicMatrix<size_t> matrix(data.rows(), data.columns());
-
-    std::vector<size_t> indexes(data.rows());
-    std::iota(indexes.begin(), indexes.end(), 0);
-
-    for (int i = 0; i < data.rows(); ++i) {
-        auto row = blaze::row(data, i);
-        std::sort(indexes.begin(), indexes.end(), [&row](auto i1, auto i2) { return row[i1] < row[i2]; });
-
-        /* Fill result row */
-        auto outRow = blaze::row(matrix, i);
-        for (size_t iter = 0; iter < row.size(); ++iter) {
-            outRow[indexes[iter]] = iter;
-        }
-    }
-
-    return matrix;
+    return mgc_details::order_ranks(mgc_details::distance_order(data));
 }
 
 template <typename T>
 blaze::DynamicMatrix<size_t> MGC_direct::center_ranked_distance_matrix(const DistanceMatrix<T>& X)
 {
-    auto A = rank_distance_matrix(X);
-
-    // blaze::transpose(A);
-
-    return A;
+    return mgc_details::order_ranks(mgc_details::distance_order(X));
 }
 
 template <typename T>
 blaze::DynamicMatrix<T> MGC_direct::center_distance_matrix(const DistanceMatrix<T>& X)
 {
-    blaze::DynamicVector<T, blaze::rowVector> list_of_sums = blaze::sum<blaze::columnwise>(X);
-    list_of_sums /= X.rows() - 1;
-
+    const mgc_details::ranked_distances<T> x(X);
     blaze::DynamicMatrix<T> centered_distance_matrix(X.rows(), X.columns());
-
-    for (auto i = 0; i < X.rows(); ++i) {
-        for (auto j = 0; j < X.rows(); ++j) {
-            centered_distance_matrix(i, j) = X(i, j) - list_of_sums[j];
+    for (size_t i = 0; i < X.rows(); ++i) {
+        for (size_t j = 0; j < X.rows(); ++j) {
+            centered_distance_matrix(i, j) = x.centered(i, j);
         }
     }
-
-    for (int i = 0; i < X.rows(); ++i) {
-        centered_distance_matrix(i, i) = 0;
-    }
-
     return centered_distance_matrix;
 }
 
@@ -292,7 +566,7 @@ void MGC_direct::normalize_generalized_correlation(
         for (size_t j = 0; j < corr.rows(); ++j) {
             corr(i, j) = corr(i, j) / std::sqrt(varX(i, i) * varY(j, j));
 
-            if (isnan(corr(i, j))) {
+            if (std::isnan(corr(i, j))) {
                 corr(i, j) = 0;
             } else if (corr(i, j) > 1) {
                 corr(i, j) = 1;
@@ -302,52 +576,23 @@ void MGC_direct::normalize_generalized_correlation(
 }
 
 template <typename T>
-T MGC_direct::operator()(const DistanceMatrix<T>& X, const DistanceMatrix<T>& Y)
+T MGC_direct::operator()(const DistanceMatrix<T>& X, const DistanceMatrix<T>& Y, size_t threads)
 {
 	assert(X.rows() == Y.rows());
 
-	// center distance matrix
-    blaze::DynamicMatrix<T> A = center_distance_matrix(X);
-    blaze::DynamicMatrix<T> B = center_distance_matrix(Y);
-
-    auto RXt = center_ranked_distance_matrix(X);
-    auto RYt = center_ranked_distance_matrix(Y);
-
-    // transpose copies
-    blaze::DynamicMatrix<T> At = blaze::trans(A);
-    blaze::DynamicMatrix<T> Bt = blaze::trans(B);
-    blaze::DynamicMatrix<size_t> RX = blaze::trans(RXt);
-    blaze::DynamicMatrix<size_t> RY = blaze::trans(RYt);
-
-    // compute generalized correlation
-    auto corr = local_covariance(A, Bt, RX, RYt);  // compute all local covariances
-    auto varX = local_covariance(A, At, RX, RXt);  // compute local variances for first data
-    auto varY = local_covariance(B, Bt, RY, RYt);  // compute local variances for second data
-
-    blaze::clear(A);
-    A.shrinkToFit();
-    blaze::clear(At);
-    At.shrinkToFit();
-    blaze::clear(B);
-    B.shrinkToFit();
-    blaze::clear(Bt);
-    Bt.shrinkToFit();
-    blaze::clear(RXt);
-    RXt.shrinkToFit();
-    blaze::clear(RX);
-    RX.shrinkToFit();
-    blaze::clear(RY);
-    RY.shrinkToFit();
-    blaze::clear(RYt);
-    RYt.shrinkToFit();
-
-    // normalize the generalized correlation
-    normalize_generalized_correlation(corr, varX, varY);
-
-    blaze::clear(varX);
-    varX.shrinkToFit();
-    blaze::clear(varY);
-    varY.shrinkToFit();
+    if (X.rows() < 3) {
+        return 0;
+    }
+
+    // ranks and local variances, then all local covariances normalized in place
+    mgc_details::ranked_distances<T> x(X, threads);
+    mgc_details::ranked_distances<T> y(Y, threads);
+    auto corr = mgc_details::local_correlation(x, y);
+
+    blaze::clear(x.ranks);
+    x.ranks.shrinkToFit();
+    blaze::clear(y.ranks);
+    y.ranks.shrinkToFit();
 
     /* Find the largest connected region of significant local correlations */
     auto R = significant_local_correlation(corr /*,p=0.02*/);
@@ -361,31 +606,43 @@ template<typename T> std::vector<double> MGC_direct::xcorr(const DistanceMatrix<
 	assert(a.rows() == b.rows());
 	assert(n <= std::numeric_limits<int>::max());
 
-	std::vector<double> result;
-	result.reserve(2 * n + 1);
-
-	int s = -n;
-	if (s <= (int)n) {
-		auto g = 9;
-	}
-
-	for (int shift = -n; shift <= (int)n; ++shift) {
-		DistanceMatrix<T> aShifted;
-		DistanceMatrix<T> bShifted;
+    const size_t shifts = 2 * size_t(n) + 1;
+    std::vector<double> result(shifts, 0);
 
-		const auto start = std::abs(shift);
-		const auto length = a.rows() - start;
+    // rows of both matrices are sorted once, every shift compares a principal submatrix of a
+    // with one of b and ranks it by filtering the shared orders
+    const auto orderA = mgc_details::distance_order(a);
+    const auto orderB = mgc_details::distance_order(b);
 
-		if (shift < 0) {
-			aShifted = blaze::submatrix(a, start, start, length, length);
-			bShifted = blaze::submatrix(b, 0, 0, length, length);
-		} else {
-			aShifted = blaze::submatrix(a, 0, 0, length, length);
-			bShifted = blaze::submatrix(b, start, start, length, length);
-		}
-
-		result.push_back(operator()(aShifted, bShifted));
-	}
+    auto shifted = [&](int shift, size_t threads) -> double {
+        const size_t start = std::abs(shift);
+        if (start + 3 > a.rows()) {
+            return 0;
+        }
+        const size_t length = a.rows() - start;
+        mgc_details::ranked_distances<T> x(a, orderA, shift < 0 ? start : 0, length, threads);
+        mgc_details::ranked_distances<T> y(b, orderB, shift < 0 ? 0 : start, length, threads);
+        auto corr = mgc_details::local_correlation(x, y);
+
+        blaze::clear(x.ranks);
+        x.ranks.shrinkToFit();
+        blaze::clear(y.ranks);
+        y.ranks.shrinkToFit();
+
+        auto R = significant_local_correlation(corr);
+        return optimal_local_generalized_correlation(corr, R);
+    };
+
+    // a single shift is spread over threads itself, otherwise every thread takes whole shifts
+    if (shifts == 1) {
+        result[0] = shifted(0, 0);
+        return result;
+    }
+    mgc_details::parallel_blocks(shifts, 1, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            result[k] = shifted(int(k) - int(n), 1);
+        }
+    });
 
 	return result;
 }
@@ -403,6 +660,59 @@ double MGC<RecType1, Metric1, RecType2, Metric2>::operator()(const Container1& a
     return MGC_direct()(X, Y);
 }
 
+template <class RecType1, class Metric1, class RecType2, class Metric2>
+template <typename Container>
+blaze::SymmetricMatrix<blaze::DynamicMatrix<double>> MGC<RecType1, Metric1, RecType2, Metric2>::matrix(
+    const std::vector<Container>& channels, const matrix_progress& progress, size_t threads, size_t memory_budget) const
+{
+    // distances, row orders and transposed ranks of a channel, channels and pairs take one thread each
+    struct channel {
+        DistanceMatrix<double> X;
+        blaze::DynamicMatrix<mgc_details::rank_type> order;
+        std::unique_ptr<mgc_details::ranked_distances<double>> ranked;
+    };
+    const size_t count = channels.size();
+    for (const auto& c : channels) {
+        assert(c.size() == channels[0].size());
+    }
+    std::vector<std::unique_ptr<channel>> prepared(count);
+
+    auto prepare = [&](size_t i) {
+        auto p = std::make_unique<channel>();
+        p->X = computeDistanceMatrix<Container>(channels[i], metric1);
+        if (p->X.rows() >= 3) {
+            p->order = mgc_details::distance_order(p->X, 1);
+            p->ranked = std::make_unique<mgc_details::ranked_distances<double>>(p->X, p->order, 0, p->X.rows(), 1);
+            blaze::transpose(p->ranked->ranks);
+        }
+        prepared[i] = std::move(p);
+    };
+    auto evaluate = [&](size_t i, size_t j) -> double {
+        const auto& x = *prepared[i];
+        const auto& y = *prepared[j];
+        if (!x.ranked) {
+            return 0;
+        }
+        auto corr = mgc_details::local_correlation(*x.ranked, x.order, *y.ranked, y.ranked->ranks);
+        MGC_direct direct;
+        auto R = direct.significant_local_correlation(corr);
+        return direct.optimal_local_generalized_correlation(corr, R);
+    };
+
+    auto release = [&](size_t i) { prepared[i].reset(); };
+
+    // all channels in one block when they fit the budget, otherwise two blocks are prepared at once
+    size_t block = 0;
+    if (memory_budget > 0 && count > 0) {
+        const size_t n = channels[0].size();
+        const size_t tables = std::max<size_t>(1, n * n * (sizeof(double) + 2 * sizeof(mgc_details::rank_type)));
+        if (count * tables > memory_budget) {
+            block = std::max<size_t>(1, memory_budget / (2 * tables));
+        }
+    }
+    return correlation_matrix(count, block, prepare, evaluate, release, progress, threads);
+}
+
 template <class RecType1, class Metric1, class RecType2, class Metric2>
 template <typename Container, typename Metric>
 DistanceMatrix<double> MGC<RecType1, Metric1, RecType2, Metric2>::computeDistanceMatrix(const Container &c, const Metric & metric) const
@@ -427,7 +737,8 @@ double MGC<RecType1, Metric1, RecType2, Metric2>::estimate(
     const Container2& b,
     const size_t sampleSize,
     const double threshold,
-    size_t maxIterations
+    size_t maxIterations,
+    const estimate_logger& logger
 ) const
 {
     assert(a.size() == b.size());
@@ -458,29 +769,30 @@ double MGC<RecType1, Metric1, RecType2, Metric2>::estimate(
     const std::vector<typename Container1::value_type> vectorA(a.begin(), a.end());
     const std::vector<typename Container2::value_type> vectorB(b.begin(), b.end());
 
-    /* Create samples */
-    std::vector<typename Container1::value_type> sampleA;
-    std::vector<typename Container2::value_type> sampleB;
-    sampleA.reserve(sampleSize);
-    sampleB.reserve(sampleSize);
-
-    std::vector<double> mgcValues;
-    double mu = 0;
-    for (auto i = 1; i <= maxIterations; ++i) {
-        size_t start = (i - 1) * sampleSize;
-        size_t end = std::min(i * sampleSize - 1, dataSize - 1);
+    /* subsamples are evaluated concurrently, the convergence is checked in the order of subsamples */
+    auto sample_mgc = [&](size_t i) {
+        size_t start = i * sampleSize;
+        size_t end = std::min((i + 1) * sampleSize - 1, dataSize - 1);
 
         /* Create samples */
-        sampleA.clear();
-        sampleB.clear();
-
+        std::vector<typename Container1::value_type> sampleA;
+        std::vector<typename Container2::value_type> sampleB;
+        sampleA.reserve(sampleSize);
+        sampleB.reserve(sampleSize);
         for (auto j = start; j < end; ++j) {
             sampleA.push_back(vectorA[indexes[j]]);
             sampleB.push_back(vectorB[indexes[j]]);
         }
 
-        /* Get sample mgc value */
-        double mgc = operator()(sampleA, sampleB);
+        /* subsamples are evaluated concurrently in waves, the rows of a subsample on one thread */
+        auto X = computeDistanceMatrix(sampleA, metric1);
+        auto Y = computeDistanceMatrix(sampleB, metric2);
+        return MGC_direct()(X, Y, 1);
+    };
+
+    std::vector<double> mgcValues;
+    double mu = 0;
+    auto converged = [&](size_t, double mgc) {
         mgcValues.push_back(mgc);
 
         std::sort(mgcValues.begin(), mgcValues.end());
@@ -499,11 +811,13 @@ double MGC<RecType1, Metric1, RecType2, Metric2>::estimate(
         }
 
         auto convergence = peak2ems(diff) / n;
-
-        if (convergence < threshold) {
-            return mu;
+        if (logger) {
+            logger(n, convergence, mgc, mu);
         }
-    }
+
+        return convergence < threshold;
+    };
+    evaluate_in_waves(maxIterations, sample_mgc, converged);
 
     return mu;
 }
@@ -21,6 +21,8 @@ Copyright (c) 2018, Michael Welsch
 #define _METRIC_CORRELATION_DETAILS_MGC_HPP
 
 #include "../../3rdparty/blaze/Math.h"
+#include "../utils/subsample_waves.hpp"
+#include "correlation_matrix.hpp"
 
 namespace metric {
 
@@ -59,6 +61,7 @@ public:
      * @param sampleSize
      * @param threshold
      * @param maxIterations
+     * @param logger called with the progress after every subsample, subsamples are evaluated concurrently
      * @return estimate of the correlation betwen a and b
      */
     template <typename Container1, typename Container2>
@@ -67,7 +70,8 @@ public:
         const Container2& b,
         const size_t sampleSize = 250,
         const double threshold = 0.05,
-        size_t maxIterations = 1000
+        size_t maxIterations = 1000,
+        const estimate_logger& logger = nullptr
     ) const;
 
 	/** @brief return vector of mgc values calculated for different data shifts
@@ -79,6 +83,24 @@ public:
 	template <typename Container1, typename Container2>
     std::vector<double> xcorr(const Container1& a, const Container2& b, const int n) const;
 
+	/** @brief return matrix of mgc values between all pairs of channels
+	 *
+	 * Distance matrix, row orders and ranks of every channel are computed once and shared by its pairs,
+	 * pairs are evaluated concurrently. They take 16 N^2 bytes per channel of N records. When the tables of all
+	 * channels exceed the memory budget, channels are prepared in blocks that fit it and prepared again for
+	 * the pairs of later blocks, tables of at least two channels are held.
+	 *
+	 * @param channels containers of values of type RecType1 of the same size, compared with Metric1
+	 * @param progress called after every preparation of a channel and every pair, returning false cancels the
+	 * rest, which stays NaN
+	 * @param threads pool size, 0 for the number of hardware threads
+	 * @param memory_budget bytes of the prepared tables, 0 for no limit
+	 * @return symmetric matrix with matrix(i, j) equal to the mgc of channels i and j for i <= j
+	 */
+	template <typename Container>
+	blaze::SymmetricMatrix<blaze::DynamicMatrix<double>> matrix(const std::vector<Container>& channels,
+		const matrix_progress& progress = nullptr, size_t threads = 0, size_t memory_budget = 0) const;
+
 	/**
 	 * @brief return distance matrix
 	 *
@@ -105,12 +127,17 @@ struct MGC_direct {
      * @tparam T value type of input
      * @param a distance matrix
      * @param b distance matrix
+     * @param threads number of threads the rows are spread over, 0 for the number of hardware threads
      * @return sample MGC statistic within [-1,1]
      */
     template <typename T>
-    T operator()(const DistanceMatrix<T>& a, const DistanceMatrix<T>& b);
+    T operator()(const DistanceMatrix<T>& a, const DistanceMatrix<T>& b, size_t threads = 0);
 
     /** @brief return vector of mgc values calculated for different data shifts
+     *
+     * Rows of a and b are sorted once for all shifts, shifts are evaluated concurrently.
+     * Shifts leaving less than 3 records give 0.
+     *
      * @param a distance matrix
      * @param b distance matrix
      * @param n number of delayed computations in +/- direction
@@ -122,36 +149,43 @@ struct MGC_direct {
     /**
      * @brief Computes the centered distance matrix
      *
+     * @deprecated operator() does not store the centered matrix
      * @tparam T value type of input matrix
      * @param X distance matrix
      * @return   centered distance matrix
      */
     template <typename T>
-    blaze::DynamicMatrix<T> center_distance_matrix(const DistanceMatrix<T>& X);
+    [[deprecated("operator() does not store the centered matrix")]] blaze::DynamicMatrix<T> center_distance_matrix(
+        const DistanceMatrix<T>& X);
 
     /**
-     * @brief
+     * @brief Computes ranks of the distances in every row, ties are ranked in the order of columns
      *
+     * @deprecated operator() ranks the rows itself
      * @tparam T value type of input matrix
      * @param data distance matrix
-     * @return
+     * @return matrix with the rank of data(r, c) in the row r at (r, c)
      */
     template <typename T>
-    blaze::DynamicMatrix<size_t> rank_distance_matrix(const DistanceMatrix<T>& data);
+    [[deprecated("operator() ranks the rows itself")]] blaze::DynamicMatrix<size_t> rank_distance_matrix(
+        const DistanceMatrix<T>& data);
 
     /**
-     * @brief Computes the ranked centered distance matrix
+     * @brief Computes the ranked centered distance matrix, the same as rank_distance_matrix()
      *
+     * @deprecated operator() ranks the rows itself
      * @tparam T value type of input matrix
      * @param X distance matrix
      * @return  ranked centered distance matrix
      */
     template <typename T>
-    blaze::DynamicMatrix<size_t> center_ranked_distance_matrix(const DistanceMatrix<T>& X);
+    [[deprecated("operator() ranks the rows itself")]] blaze::DynamicMatrix<size_t> center_ranked_distance_matrix(
+        const DistanceMatrix<T>& X);
 
     /**
      * @brief Computes all local correlations
      *
+     * @deprecated operator() accumulates the local covariances from the rank tables without dense matrices
      * @tparam T value type of input matrices
      * @param A properly transformed distance matrix;
      * @param B properly transformed distance matrix;
@@ -160,18 +194,20 @@ struct MGC_direct {
      * @return all local covariances matrix
      */
     template <typename T>
-    blaze::DynamicMatrix<T> local_covariance(const blaze::DynamicMatrix<T>& A, const blaze::DynamicMatrix<T>& B,
+    [[deprecated("operator() accumulates the local covariances from the rank tables")]] blaze::DynamicMatrix<T>
+    local_covariance(const blaze::DynamicMatrix<T>& A, const blaze::DynamicMatrix<T>& B,
         const blaze::DynamicMatrix<size_t>& RX, const blaze::DynamicMatrix<size_t>& RY);
 
     /**
      * @brief
      *
+     * @deprecated operator() normalizes the local covariances in place
      * @param corr[out]
      * @param varX [in]
      * @param varY [in]
      */
     template <typename T>
-    void normalize_generalized_correlation(
+    [[deprecated("operator() normalizes the local covariances in place")]] void normalize_generalized_correlation(
         blaze::DynamicMatrix<T>& corr, const blaze::DynamicMatrix<T>& varX, const blaze::DynamicMatrix<T>& varY);
 
     /**
@@ -27,10 +27,12 @@ Copyright (c) PANDA Team
 
 #include "distance/k-related/Standards.hpp"
 #include "distance/k-related/L1.hpp"
+#include "distance/k-related/ProductQuantizer.hpp"
 
 #include "distance/k-structured/SSIM.hpp"
 #include "distance/k-structured/TWED.hpp"
 #include "distance/k-structured/EMD.hpp"
+#include "distance/k-structured/Sinkhorn.hpp"
 #include "distance/k-structured/Edit.hpp"
 #include "distance/k-structured/Kohonen.hpp"
 
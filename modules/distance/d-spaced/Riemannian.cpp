@@ -3,6 +3,12 @@
 #include "../../../modules/utils/type_traits.hpp"
 #include "../../utils/wrappers/lapack.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 
 namespace metric {
 
@@ -220,6 +226,82 @@ double peak2ems(const std::vector<double>& data)
 
 
 
+// side of the square blocks of pairs in distance_matrix
+constexpr size_t block_size = 64;
+
+/**
+ * @brief Distance matrix of a set: sign * d(i, j) in the upper triangle, sums of distances on the diagonal
+ *
+ * Every pair is measured once, pairs are visited in square blocks so the records of a block stay in cache.
+ * The diagonal is summed afterwards in the order of the row by row traversal.
+ */
+template <typename C, typename Metric, typename V>
+void distance_matrix(const C& set, const Metric& metric, const V sign, blaze::DynamicMatrix<V>& matrix)
+{
+    const size_t n = set.size();
+    matrix.resize(n, n, false);
+    matrix = 0;
+    for (size_t bi = 0; bi < n; bi += block_size) {
+        const size_t ei = std::min(n, bi + block_size);
+        for (size_t bj = bi; bj < n; bj += block_size) {
+            const size_t ej = std::min(n, bj + block_size);
+            for (size_t i = bi; i < ei; ++i) {
+                for (size_t j = std::max(bj, i + 1); j < ej; ++j) {
+                    matrix(i, j) = sign * metric(set[i], set[j]);
+                }
+            }
+        }
+    }
+    for (size_t k = 0; k < n; ++k) {
+        V sum = 0;
+        for (size_t i = 0; i < k; ++i) {
+            sum += sign * matrix(i, k);
+        }
+        for (size_t j = k + 1; j < n; ++j) {
+            sum += sign * matrix(k, j);
+        }
+        matrix(k, k) = sum;
+    }
+}
+
+
+
+// norm of logarithms of generalized eigenvalues, eigenvalues not above epsilon are ignored
+template <typename T>
+T log_norm(blaze::DynamicVector<T>& eigenValues)
+{
+    for (T& e : eigenValues) {
+        if (e <= std::numeric_limits<T>::epsilon()) {
+            e = 1;
+        }
+    }
+    return sqrt(blaze::sum(blaze::pow(blaze::log(eigenValues), 2)));
+}
+
+
+
+// distance between a set and the prepared reference, A, eigenValues and work are buffers reused between calls
+template <typename C, typename Metric, typename V>
+double prepared_distance(const C& Xc, const Metric& metric, const prepared_reference<V>& reference,
+    blaze::DynamicMatrix<V>& A, blaze::DynamicVector<V>& eigenValues, std::vector<double>& work)
+{
+    distance_matrix(Xc, metric, V(-1), A); // Laplacian matrix
+    sygv_factorized(A, reference.factor, eigenValues, work);
+    return log_norm(eigenValues);
+}
+
+
+
+template <typename C, typename V>
+void check_size(const C& Xc, const prepared_reference<V>& reference)
+{
+    if (Xc.size() != reference.matrix.rows()) {
+        throw std::invalid_argument("set size must match the reference size");
+    }
+}
+
+
+
 
 template <typename Container, typename Functor>
 double estimate(
@@ -228,7 +310,8 @@ double estimate(
     const Functor& f,
     const size_t sampleSize,
     const double threshold,
-    size_t maxIterations
+    size_t maxIterations,
+    const estimate_logger& logger
 )
 {
     using T = type_traits::underlying_type_t<Container>;
@@ -262,29 +345,27 @@ double estimate(
     const std::vector<V> vectorA(a.begin(), a.end());
     const std::vector<V> vectorB(b.begin(), b.end());
 
-    /* Create samples */
-    std::vector<V> sampleA;
-    std::vector<V> sampleB;
-    sampleA.reserve(sampleSize);
-    sampleB.reserve(sampleSize);
-
-    std::vector<double> mgcValues;
-    double mu = 0;
-    for (auto i = 1; i <= maxIterations; ++i) {
-        size_t start = (i - 1) * sampleSize;
-        size_t end = std::min(i * sampleSize - 1, dataSize - 1);
+    /* subsamples are evaluated concurrently, the convergence is checked in the order of subsamples */
+    auto sample_value = [&](size_t i) {
+        size_t start = i * sampleSize;
+        size_t end = std::min((i + 1) * sampleSize - 1, dataSize - 1);
 
         /* Create samples */
-        sampleA.clear();
-        sampleB.clear();
-
+        std::vector<V> sampleA;
+        std::vector<V> sampleB;
+        sampleA.reserve(sampleSize);
+        sampleB.reserve(sampleSize);
         for (auto j = start; j < end; ++j) {
             sampleA.push_back(vectorA[indexes[j]]);
             sampleB.push_back(vectorB[indexes[j]]);
         }
 
-        /* Get sample mgc value */
-        double mgc = f(sampleA, sampleB);
+        return f(sampleA, sampleB);
+    };
+
+    std::vector<double> mgcValues;
+    double mu = 0;
+    auto converged = [&](size_t, double mgc) {
         mgcValues.push_back(mgc);
 
         std::sort(mgcValues.begin(), mgcValues.end());
@@ -303,11 +384,13 @@ double estimate(
         }
 
         auto convergence = peak2ems(diff) / n;
-
-        if (convergence < threshold) {
-            return mu;
+        if (logger) {
+            logger(n, convergence, mgc, mu);
         }
-    }
+
+        return convergence < threshold;
+    };
+    evaluate_in_waves(maxIterations, sample_value, converged);
 
     return mu;
 }
@@ -406,29 +489,10 @@ template <typename C>
 double RiemannianDistance<RecType, Metric>::operator()(const C& Xc, const C& Yc) const {
     using V = metric::type_traits::underlying_type_t<C>;
 
-    blaze::DynamicMatrix<V> distancesX (Xc.size(), Xc.size(), 0);
-    blaze::DynamicMatrix<V> distancesY (Yc.size(), Yc.size(), 0);
-
-    for (size_t i = 0; i<Xc.size(); ++i) {
-        for (size_t j = 0; j<Xc.size(); ++j) {
-            auto d = metric(Xc[i], Xc[j]);
-            if (i < j) { // upper triangular area only
-                distancesX(i, j) = -d; // Laplacian matrix
-                distancesX(i, i) += d;
-                distancesX(j, j) += d;
-            }
-        }
-    }
-    for (size_t i = 0; i<Yc.size(); ++i) {
-        for (size_t j = 0; j<Yc.size(); ++j) {
-            auto d = metric(Yc[i], Yc[j]);
-            if (i < j) { // upper triangular area only
-                distancesY(i, j) = d;
-                distancesY(i, i) += d;
-                distancesY(j, j) += d;
-            }
-        }
-    }
+    blaze::DynamicMatrix<V> distancesX;
+    blaze::DynamicMatrix<V> distancesY;
+    riemannian_details::distance_matrix(Xc, metric, V(-1), distancesX); // Laplacian matrix
+    riemannian_details::distance_matrix(Yc, metric, V(1), distancesY);
     return matDistance(distancesX, distancesY); // applying Riemannian to these distance matrices
 }
 
@@ -438,13 +502,81 @@ template <typename T>
 T RiemannianDistance<RecType, Metric>::matDistance(blaze::DynamicMatrix<T> A, blaze::DynamicMatrix<T> B) const {
     blaze::DynamicVector<T> eigenValues;
     sygv(A, B, eigenValues);
+    return riemannian_details::log_norm(eigenValues);
+}
 
-    for (T& e : eigenValues) {
-        if (e <= std::numeric_limits<T>::epsilon()) {
-            e = 1;
+
+template <typename RecType, typename Metric>
+template <typename C>
+auto RiemannianDistance<RecType, Metric>::prepare(const C& Yc) const
+    -> riemannian_details::prepared_reference<type_traits::underlying_type_t<C>>
+{
+    using V = metric::type_traits::underlying_type_t<C>;
+
+    riemannian_details::prepared_reference<V> reference;
+    riemannian_details::distance_matrix(Yc, metric, V(1), reference.matrix);
+    reference.factor = reference.matrix;
+    if (potrf(reference.factor) != 0) {
+        throw std::invalid_argument("distance matrix of the reference set must be positive definite");
+    }
+    return reference;
+}
+
+
+template <typename RecType, typename Metric>
+template <typename C, typename V>
+double RiemannianDistance<RecType, Metric>::operator()(
+    const C& Xc, const riemannian_details::prepared_reference<V>& reference) const
+{
+    riemannian_details::check_size(Xc, reference);
+    blaze::DynamicMatrix<V> A;
+    blaze::DynamicVector<V> eigenValues;
+    std::vector<double> work;
+    return riemannian_details::prepared_distance(Xc, metric, reference, A, eigenValues, work);
+}
+
+
+template <typename RecType, typename Metric>
+template <typename C>
+std::vector<double> RiemannianDistance<RecType, Metric>::batch(const C& reference, const std::vector<C>& candidates) const
+{
+    return batch(prepare(reference), candidates);
+}
+
+
+template <typename RecType, typename Metric>
+template <typename C, typename V>
+std::vector<double> RiemannianDistance<RecType, Metric>::batch(
+    const riemannian_details::prepared_reference<V>& reference, const std::vector<C>& candidates) const
+{
+    for (auto& candidate : candidates) {
+        riemannian_details::check_size(candidate, reference);
+    }
+
+    std::vector<double> result(candidates.size());
+    std::atomic<size_t> next_candidate(0);
+    auto worker = [&]() {
+        blaze::DynamicMatrix<V> A;
+        blaze::DynamicVector<V> eigenValues;
+        std::vector<double> work;
+        for (size_t k = next_candidate++; k < candidates.size(); k = next_candidate++) {
+            result[k] = riemannian_details::prepared_distance(candidates[k], metric, reference, A, eigenValues, work);
         }
+    };
+
+    const size_t threads_count = std::min<size_t>(candidates.size(), std::thread::hardware_concurrency());
+    if (threads_count <= 1) {
+        worker();
+        return result;
     }
-    return sqrt(blaze::sum(blaze::pow(blaze::log(eigenValues), 2)));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threads_count; ++t) {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return result;
 }
 
 
@@ -456,10 +588,11 @@ double RiemannianDistance<RecType, Metric>::estimate(
         const Container & b,
         const size_t sampleSize,
         const double threshold,
-        size_t maxIterations
+        size_t maxIterations,
+        const estimate_logger& logger
 ) const
 {
-    return riemannian_details::estimate(a, b, *this, sampleSize, threshold, maxIterations);
+    return riemannian_details::estimate(a, b, *this, sampleSize, threshold, maxIterations, logger);
 }
 
 }
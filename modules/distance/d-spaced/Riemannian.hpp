@@ -2,11 +2,30 @@
 #define PANDA_METRIC_RIEMANNIAN_HPP
 
 #include "../../../modules/distance/k-related/Standards.hpp"
+#include "../../../modules/utils/type_traits.hpp"
+#include "../../../modules/utils/subsample_waves.hpp"
 
+#include <vector>
 
 
 namespace metric {
 
+namespace riemannian_details {
+
+/**
+ * @brief Reference set of the Riemannian distance prepared for comparisons with many candidates.
+ *
+ * Keeps the distance matrix of the reference set and its Cholesky factor, so every comparison only builds the
+ * candidate matrix and solves the reduced eigenproblem.
+ */
+template <typename V>
+struct prepared_reference {
+    blaze::DynamicMatrix<V> matrix;
+    blaze::DynamicMatrix<V> factor;
+};
+
+}
+
 
 template <typename RecType, typename Metric = Euclidean<typename RecType::value_type>>
 class RiemannianDistance {
@@ -16,6 +35,46 @@ public:
     template <typename C>
     double operator()(const C& Xc, const C& Yc) const;
 
+    /**
+     * @brief Build the distance matrix of the reference set and factorize it once
+     *
+     * @param Yc reference set, takes the place of the second argument of operator()
+     * @return prepared reference for operator() and batch
+     */
+    template <typename C>
+    riemannian_details::prepared_reference<type_traits::underlying_type_t<C>> prepare(const C& Yc) const;
+
+    /**
+     * @brief Calculate distance between a set and the prepared reference, same as operator()(Xc, Yc)
+     *
+     * @param Xc set of the reference size
+     * @param reference prepared reference set
+     * @return distance
+     */
+    template <typename C, typename V>
+    double operator()(const C& Xc, const riemannian_details::prepared_reference<V>& reference) const;
+
+    /**
+     * @brief Calculate distances between many sets and one reference set, candidates are evaluated concurrently
+     *
+     * @param reference reference set, takes the place of the second argument of operator()
+     * @param candidates sets of the reference size
+     * @return distance from every candidate to the reference
+     */
+    template <typename C>
+    std::vector<double> batch(const C& reference, const std::vector<C>& candidates) const;
+
+    /**
+     * @brief Calculate distances between many sets and the prepared reference, candidates are evaluated concurrently
+     *
+     * @param reference prepared reference set
+     * @param candidates sets of the reference size
+     * @return distance from every candidate to the reference
+     */
+    template <typename C, typename V>
+    std::vector<double> batch(
+        const riemannian_details::prepared_reference<V>& reference, const std::vector<C>& candidates) const;
+
     template<typename T>
     T matDistance(blaze::DynamicMatrix<T> A, blaze::DynamicMatrix<T> B) const;
 
@@ -25,7 +84,8 @@ public:
             const Container& b,
             const size_t sampleSize = 250,
             const double threshold = 0.05,
-            size_t maxIterations = 1000
+            size_t maxIterations = 1000,
+            const estimate_logger& logger = nullptr
     ) const;
 
 private:
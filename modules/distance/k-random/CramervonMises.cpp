@@ -7,41 +7,52 @@ Copyright (c) 2020 Panda Team
 */
 
 #include "CramervonMises.hpp"
-#include "../../utils/poor_mans_quantum.hpp"
+#include "empirical_cdf.hpp"
+
+#include <cmath>
 
 namespace metric {
 
+namespace CramervonMises_details {
+
+    /** integral of the squared difference of the empirical CDFs of sorted samples **/
+    template <typename D, typename Sample>
+    D merge(const Sample& a, const Sample& b)
+    {
+        D area = 0;
+        empirical_cdf_details::sweep<D>(empirical_cdf_details::unit_steps<Sample> { a },
+            empirical_cdf_details::unit_steps<Sample> { b }, [&](D cdf_a, D cdf_b, auto value, auto next) {
+                D difference = cdf_a - cdf_b;
+                area += difference * difference * D(next - value);
+            });
+        return std::sqrt(area);
+    }
+
+}  // namespace CramervonMises_details
+
 template <typename Sample, typename D>
 auto CramervonMises<Sample, D>::operator()(const Sample& sample_1, const Sample& sample_2) const -> distance_type
 {
-	PMQ pmq_1(sample_1);
-	PMQ pmq_2(sample_2);
-		
-	// find the sum of squared differences between the two cdfs
-
-	Sample concat_data;
-	for (int i = 0; i < sample_1.size(); i++)
-	{
-		concat_data.push_back(sample_1[i]);
-	}
-	for (int i = 0; i < sample_2.size(); i++)
-	{
-		concat_data.push_back(sample_2[i]);
-	}
-	std::sort(concat_data.begin(), concat_data.end());
-
-	//
-	
-	D area = 0;
-	double step = (concat_data[concat_data.size() - 1] - concat_data[0]) * precision;
-
-	for (double value = concat_data[0]; value <= concat_data[concat_data.size() - 1]; value += step)
-	{
-		area += (pmq_1.cdf(value) - pmq_2.cdf(value)) * (pmq_1.cdf(value) - pmq_2.cdf(value)) * step;
-	}
-
-    return sqrt(area);
+    thread_local Sample buffer_1;
+    thread_local Sample buffer_2;
+    return CramervonMises_details::merge<D>(empirical_cdf_details::sorted(sample_1, buffer_1),
+        empirical_cdf_details::sorted(sample_2, buffer_2));
 }
 
+template <typename Sample, typename D>
+auto CramervonMises<Sample, D>::batch(const Sample& reference, const std::vector<Sample>& samples) const
+    -> std::vector<distance_type>
+{
+    Sample reference_buffer;
+    thread_local Sample buffer;
+    const Sample& sorted_reference = empirical_cdf_details::sorted(reference, reference_buffer);
+
+    std::vector<distance_type> result;
+    result.reserve(samples.size());
+    for (auto& sample : samples) {
+        result.push_back(CramervonMises_details::merge<D>(sorted_reference, empirical_cdf_details::sorted(sample, buffer)));
+    }
+    return result;
+}
 
 }  // namespace metric
@@ -9,6 +9,8 @@ Copyright (c) 2020 Panda Team
 #ifndef _METRIC_DISTANCE_K_RANDOM_CRAMER_VON_MISES_HPP
 #define _METRIC_DISTANCE_K_RANDOM_CRAMER_VON_MISES_HPP
 
+#include <vector>
+
 namespace metric {
 
 /**
@@ -16,7 +18,8 @@ namespace metric {
  *
  * The Cramér-von Mises (CM) distance is obtained by summing the squared difference between the two empirical CDFs along the x-axis (and then taking the square root of the sum to make it an actual distance). 
  * The relationship between the CM distance and the EMD is analogous to that of the L1 and L2 norms. 
- * CDFs is calculated by PMQ.
+ * The empirical CDFs are step functions, so the integral is summed exactly over the gaps between the values of both samples,
+ * which are sorted (sorted samples are used as is) and swept in a single merge, O(n log n).
  * 
  * @tparam Sample - sample type
  * @tparam D - distance return type
@@ -35,11 +38,10 @@ public:
     /**
      * @brief Construct a new Cramer-von Nises object
      *
-     * @param precision  for integration. Should be in (0, 1). Less means more accurate.
+     * @deprecated the integration is exact and does not use a step, use the default constructor
+     * @param precision ignored
      */
-    explicit CramervonMises(double precision) : precision(precision)
-    {
-    }
+    [[deprecated("the integration is exact, precision is not used")]] explicit CramervonMises(double /*precision*/) {}
 
     /**
      * @brief calculate Cramer-von Nises distance between two samples
@@ -50,8 +52,14 @@ public:
      */
     distance_type operator()(const Sample& sample_1, const Sample& sample_2) const;
 
-private:
-	double precision = 0.01;
+    /**
+     * @brief calculate Cramer-von Nises distances between one reference sample and many samples, the reference is sorted once
+     *
+     * @param reference reference sample
+     * @param samples samples to compare with the reference
+     * @return distances from the reference to every sample
+     */
+    std::vector<distance_type> batch(const Sample& reference, const std::vector<Sample>& samples) const;
 };
 
 
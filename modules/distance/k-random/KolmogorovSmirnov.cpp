@@ -7,40 +7,53 @@ Copyright (c) 2020 Panda Team
 */
 
 #include "KolmogorovSmirnov.hpp"
-#include "../../utils/poor_mans_quantum.hpp"
+#include "empirical_cdf.hpp"
+
+#include <algorithm>
+#include <cmath>
 
 namespace metric {
 
+namespace KolmogorovSmirnov_details {
+
+    /** largest difference of the empirical CDFs of sorted samples, evaluated after every distinct value **/
+    template <typename D, typename Sample>
+    D merge(const Sample& a, const Sample& b)
+    {
+        D max_difference = 0;
+        empirical_cdf_details::sweep<D>(empirical_cdf_details::unit_steps<Sample> { a },
+            empirical_cdf_details::unit_steps<Sample> { b }, [&](D cdf_a, D cdf_b, auto, auto) {
+                max_difference = std::max(max_difference, std::abs(cdf_a - cdf_b));
+            });
+        return max_difference;
+    }
+
+}  // namespace KolmogorovSmirnov_details
+
 template <typename Sample, typename D>
 auto KolmogorovSmirnov<Sample, D>::operator()(const Sample& sample_1, const Sample& sample_2) const -> distance_type
 {
-	PMQ pmq_1(sample_1);
-	PMQ pmq_2(sample_2);
-		
-	// find the most difference between distributions
-
-	Sample concat_data;
-	for (int i = 0; i < sample_1.size(); i++)
-	{
-		concat_data.push_back(sample_1[i]);
-	}
-	for (int i = 0; i < sample_2.size(); i++)
-	{
-		concat_data.push_back(sample_2[i]);
-	}
-	std::sort(concat_data.begin(), concat_data.end());
-	
-	D max_difference = 0;
-	for (int i = 0; i < concat_data.size(); i++)
-	{
-		if (abs(pmq_1.cdf(concat_data[i]) - pmq_2.cdf(concat_data[i])) > max_difference)
-		{
-			max_difference = abs(pmq_1.cdf(concat_data[i]) - pmq_2.cdf(concat_data[i]));
-		}
-	}
-
-    return max_difference;
+    thread_local Sample buffer_1;
+    thread_local Sample buffer_2;
+    return KolmogorovSmirnov_details::merge<D>(empirical_cdf_details::sorted(sample_1, buffer_1),
+        empirical_cdf_details::sorted(sample_2, buffer_2));
 }
 
+template <typename Sample, typename D>
+auto KolmogorovSmirnov<Sample, D>::batch(const Sample& reference, const std::vector<Sample>& samples) const
+    -> std::vector<distance_type>
+{
+    Sample reference_buffer;
+    thread_local Sample buffer;
+    const Sample& sorted_reference = empirical_cdf_details::sorted(reference, reference_buffer);
+
+    std::vector<distance_type> result;
+    result.reserve(samples.size());
+    for (auto& sample : samples) {
+        result.push_back(
+            KolmogorovSmirnov_details::merge<D>(sorted_reference, empirical_cdf_details::sorted(sample, buffer)));
+    }
+    return result;
+}
 
 }  // namespace metric
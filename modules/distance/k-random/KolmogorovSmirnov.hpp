@@ -9,14 +9,17 @@ Copyright (c) 2020 Panda Team
 #ifndef _METRIC_DISTANCE_K_RANDOM_KOLMOGOROV_SMIRNOV_HPP
 #define _METRIC_DISTANCE_K_RANDOM_KOLMOGOROV_SMIRNOV_HPP
 
+#include <vector>
+
 namespace metric {
 	
 
 /**
  * @brief
  *
- * To compare the two samples, we construct their empirical cumulative distribution functions (CDF). CDFs is calculated by PMQ. 
+ * To compare the two samples, we construct their empirical cumulative distribution functions (CDF). 
  * The Kolmogorov-Smirnov (KS) distance is defined to be the largest absolute difference between the two empirical CDFs evaluated at any point.
+ * The samples are sorted (sorted samples are used as is) and the step CDFs are compared in a single merge of both samples, O(n log n).
  * 
  * @tparam Sample - sample type
  * @tparam D - distance return type
@@ -40,6 +43,15 @@ public:
      * @return distance
      */
     distance_type operator()(const Sample& sample_1, const Sample& sample_2) const;
+
+    /**
+     * @brief calculate Kolmogorov-Smirnov distances between one reference sample and many samples, the reference is sorted once
+     *
+     * @param reference reference sample
+     * @param samples samples to compare with the reference
+     * @return distances from the reference to every sample
+     */
+    std::vector<distance_type> batch(const Sample& reference, const std::vector<Sample>& samples) const;
 };
 
 
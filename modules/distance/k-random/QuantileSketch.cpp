@@ -0,0 +1,161 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+
+#include "QuantileSketch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace metric {
+
+template <typename T>
+QuantileSketch<T>::QuantileSketch(std::size_t k, unsigned seed)
+    : k(k)
+    , levels(1)
+    , generator(seed)
+{
+    if (k < 2) {
+        throw std::invalid_argument("sketch accuracy parameter must be at least 2");
+    }
+}
+
+template <typename T>
+template <typename Container, typename>
+QuantileSketch<T>::QuantileSketch(const Container& sample, std::size_t k, unsigned seed)
+    : QuantileSketch(k, seed)
+{
+    for (auto& value : sample) {
+        insert(value);
+    }
+}
+
+template <typename T>
+std::size_t QuantileSketch<T>::capacity(std::size_t level) const
+{
+    // top level has capacity k, every level below 2/3 of the level above
+    double c = k * std::pow(2.0 / 3.0, double(levels.size() - 1 - level));
+    return std::max(std::size_t(2), std::size_t(std::ceil(c)));
+}
+
+template <typename T>
+void QuantileSketch<T>::compact(std::size_t level)
+{
+    if (level + 1 == levels.size()) {
+        levels.emplace_back();
+    }
+    auto& items = levels[level];
+    std::sort(items.begin(), items.end());
+
+    // odd item stays at the level, pairs give one item of double weight to the next level
+    std::size_t pairs = items.size() / 2;
+    std::size_t offset = generator() & 1;
+    auto& next = levels[level + 1];
+    for (std::size_t i = 0; i < pairs; ++i) {
+        next.push_back(items[2 * i + offset]);
+    }
+    if (items.size() % 2 == 1) {
+        items[0] = items.back();
+        items.resize(1);
+    } else {
+        items.clear();
+    }
+}
+
+template <typename T>
+void QuantileSketch<T>::compress()
+{
+    for (std::size_t level = 0; level < levels.size(); ++level) {
+        if (levels[level].size() >= capacity(level)) {
+            compact(level);
+        }
+    }
+}
+
+template <typename T>
+void QuantileSketch<T>::insert(value_type value)
+{
+    levels[0].push_back(value);
+    ++n;
+    if (levels[0].size() >= capacity(0)) {
+        compress();
+    }
+}
+
+template <typename T>
+void QuantileSketch<T>::merge(const QuantileSketch& other)
+{
+    if (other.levels.size() > levels.size()) {
+        levels.resize(other.levels.size());
+    }
+    for (std::size_t level = 0; level < other.levels.size(); ++level) {
+        levels[level].insert(levels[level].end(), other.levels[level].begin(), other.levels[level].end());
+    }
+    n += other.n;
+    compress();
+}
+
+template <typename T>
+std::size_t QuantileSketch<T>::size() const
+{
+    std::size_t result = 0;
+    for (auto& level : levels) {
+        result += level.size();
+    }
+    return result;
+}
+
+template <typename T>
+auto QuantileSketch<T>::items() const -> std::vector<std::pair<value_type, std::size_t>>
+{
+    std::vector<std::pair<value_type, std::size_t>> result;
+    result.reserve(size());
+    for (std::size_t level = 0; level < levels.size(); ++level) {
+        for (auto& value : levels[level]) {
+            result.emplace_back(value, std::size_t(1) << level);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+template <typename T>
+double QuantileSketch<T>::cdf(value_type x) const
+{
+    if (n == 0) {
+        throw std::invalid_argument("sketch is empty");
+    }
+    std::size_t weight = 0;
+    for (std::size_t level = 0; level < levels.size(); ++level) {
+        for (auto& value : levels[level]) {
+            if (!(x < value)) {
+                weight += std::size_t(1) << level;
+            }
+        }
+    }
+    return double(weight) / n;
+}
+
+template <typename T>
+auto QuantileSketch<T>::quantile(double q) const -> value_type
+{
+    if (n == 0) {
+        throw std::invalid_argument("sketch is empty");
+    }
+    auto sorted = items();
+    std::size_t weight = 0;
+    for (auto& item : sorted) {
+        weight += item.second;
+        if (weight >= q * n) {
+            return item.first;
+        }
+    }
+    return sorted.back().first;
+}
+
+}  // namespace metric
@@ -0,0 +1,114 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+
+#ifndef _METRIC_DISTANCE_K_RANDOM_QUANTILE_SKETCH_HPP
+#define _METRIC_DISTANCE_K_RANDOM_QUANTILE_SKETCH_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace metric {
+
+/**
+ * @class QuantileSketch
+ *
+ * @brief Mergeable quantile sketch of a stream of values (KLL compactors).
+ *
+ * Values are kept in levels, an item of level h stands for 2^h observations. When a level is over its capacity it is
+ * sorted and every other item, starting at a random offset, is promoted to the next level. Capacities decrease
+ * geometrically towards the lower levels, so the sketch keeps O(k log(n / k)) items and the rank error is about n / k.
+ * Sketches of different windows are merged level by level, which makes rolling windows cheap to compare.
+ *
+ * @tparam T value type
+ */
+template <typename T>
+class QuantileSketch {
+public:
+    using value_type = T;
+
+    /**
+     * @brief Construct an empty sketch
+     *
+     * @param k accuracy parameter, capacity of the top level
+     * @param seed seed of the compaction offsets
+     */
+    explicit QuantileSketch(std::size_t k = 200, unsigned seed = 0);
+
+    /**
+     * @brief Construct a sketch of the sample
+     *
+     * @param sample values
+     * @param k accuracy parameter, capacity of the top level
+     * @param seed seed of the compaction offsets
+     */
+    template <typename Container, typename = decltype(std::begin(std::declval<const Container&>()))>
+    explicit QuantileSketch(const Container& sample, std::size_t k = 200, unsigned seed = 0);
+
+    /**
+     * @brief add an observation
+     *
+     * @param value
+     */
+    void insert(value_type value);
+
+    /**
+     * @brief add all observations of other sketch
+     *
+     * @param other sketch of the same value type
+     */
+    void merge(const QuantileSketch& other);
+
+    /**
+     * @brief number of observations
+     */
+    std::size_t count() const { return n; }
+
+    /**
+     * @brief number of retained items
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief retained items in ascending order with their weights (number of observations they stand for)
+     */
+    std::vector<std::pair<value_type, std::size_t>> items() const;
+
+    /**
+     * @brief estimate of the cdf
+     *
+     * @param x
+     * @return share of observations not greater than x
+     */
+    double cdf(value_type x) const;
+
+    /**
+     * @brief estimate of the quantile
+     *
+     * @param q probability in [0, 1]
+     * @return smallest retained value with cdf not less than q
+     */
+    value_type quantile(double q) const;
+
+private:
+    std::size_t k;
+    std::size_t n = 0;
+    std::vector<std::vector<value_type>> levels;
+    std::mt19937 generator;
+
+    std::size_t capacity(std::size_t level) const;
+    void compact(std::size_t level);
+    void compress();
+};
+
+}  // namespace metric
+
+#include "QuantileSketch.cpp"
+#endif
@@ -7,41 +7,68 @@ Copyright (c) 2020 Panda Team
 */
 
 #include "RandomEMD.hpp"
-#include "../../utils/poor_mans_quantum.hpp"
+#include "empirical_cdf.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
 
 namespace metric {
 
+namespace RandomEMD_details {
+
+    /** area between the step CDFs of two weighted samples sorted by value, see empirical_cdf_details::sweep **/
+    template <typename D, typename A, typename B>
+    D area_between(const A& a, const B& b)
+    {
+        D area = 0;
+        empirical_cdf_details::sweep<D>(a, b, [&](D cdf_a, D cdf_b, auto value, auto next) {
+            area += std::abs(cdf_a - cdf_b) * D(next - value);
+        });
+        return area;
+    }
+
+    /** retained items of a quantile sketch **/
+    template <typename T>
+    struct sketch_steps {
+        std::vector<std::pair<T, std::size_t>> items;
+        std::size_t count;
+        std::size_t size() const { return items.size(); }
+        T value(std::size_t i) const { return items[i].first; }
+        std::size_t weight(std::size_t i) const { return items[i].second; }
+        std::size_t total() const { return count; }
+    };
+
+}  // namespace RandomEMD_details
+
 template <typename Sample, typename D>
 auto RandomEMD<Sample, D>::operator()(const Sample& sample_1, const Sample& sample_2) const -> distance_type
 {
-	PMQ pmq_1(sample_1);
-	PMQ pmq_2(sample_2);
-		
-	// find the area between distributions
-
-	Sample concat_data;
-	for (int i = 0; i < sample_1.size(); i++)
-	{
-		concat_data.push_back(sample_1[i]);
-	}
-	for (int i = 0; i < sample_2.size(); i++)
-	{
-		concat_data.push_back(sample_2[i]);
-	}
-	std::sort(concat_data.begin(), concat_data.end());
-
-	//
-	
-	D area = 0;
-	double step = (concat_data[concat_data.size() - 1] - concat_data[0]) * precision;
-
-	for (double value = concat_data[0]; value <= concat_data[concat_data.size() - 1]; value += step)
-	{
-		area += abs(pmq_1.cdf(value) - pmq_2.cdf(value)) * step;
-	}
-
-    return area;
+    return exact(sample_1, sample_2);
 }
 
 
+template <typename Sample, typename D>
+auto RandomEMD<Sample, D>::exact(const Sample& sample_1, const Sample& sample_2) const -> distance_type
+{
+    thread_local Sample buffer_1;
+    thread_local Sample buffer_2;
+    empirical_cdf_details::unit_steps<Sample> steps_1 { empirical_cdf_details::sorted(sample_1, buffer_1) };
+    empirical_cdf_details::unit_steps<Sample> steps_2 { empirical_cdf_details::sorted(sample_2, buffer_2) };
+    return RandomEMD_details::area_between<D>(steps_1, steps_2);
+}
+
+template <typename Sample, typename D>
+template <typename T>
+auto RandomEMD<Sample, D>::operator()(const QuantileSketch<T>& sketch_1, const QuantileSketch<T>& sketch_2) const
+    -> distance_type
+{
+    if (sketch_1.count() == 0 || sketch_2.count() == 0) {
+        throw std::invalid_argument("sketches must not be empty");
+    }
+    RandomEMD_details::sketch_steps<T> steps_1 { sketch_1.items(), sketch_1.count() };
+    RandomEMD_details::sketch_steps<T> steps_2 { sketch_2.items(), sketch_2.count() };
+    return RandomEMD_details::area_between<D>(steps_1, steps_2);
+}
+
 }  // namespace metric
@@ -9,6 +9,8 @@ Copyright (c) 2020 Panda Team
 #ifndef _METRIC_DISTANCE_K_RANDOM_EMD_HPP
 #define _METRIC_DISTANCE_K_RANDOM_EMD_HPP
 
+#include "QuantileSketch.hpp"
+
 namespace metric {
 	
 
@@ -36,14 +38,13 @@ struct RandomEMD {
     /**
      * @brief Construct a new EMD object
      *
-     * @param precision used for integration. Should be in (0, 1). Less means more accurate.
+     * @deprecated the integration is exact and does not use a step, use the default constructor
+     * @param precision ignored
      */
-    explicit RandomEMD(double precision) : precision(precision)
-    {
-    }
+    [[deprecated("the integration is exact, precision is not used")]] explicit RandomEMD(double /*precision*/) {}
 
     /**
-     * @brief calculate EMD distance between two samples
+     * @brief calculate EMD distance between two samples, the same as exact()
      *
      * @param sample_1 first sample
      * @param sample_2 second sample
@@ -51,8 +52,31 @@ struct RandomEMD {
      */
     distance_type operator()(const Sample& sample_1, const Sample& sample_2) const;
 
-private:
-	const double precision = 0.01;
+    /**
+     * @brief calculate exact EMD distance between empirical distributions of two samples
+     *
+     * The area between the step CDFs is integrated exactly in a single merge of the sorted samples,
+     * sorted samples are used as is, O(n log n) otherwise. Samples of a single value and samples that do not
+     * overlap are handled as any other samples.
+     *
+     * @param sample_1 first sample
+     * @param sample_2 second sample
+     * @return distance
+     */
+    distance_type exact(const Sample& sample_1, const Sample& sample_2) const;
+
+    /**
+     * @brief calculate EMD distance between distributions summarized by quantile sketches
+     *
+     * Retained items of the sketches are compared as weighted samples, memory and time do not depend on the number
+     * of observations.
+     *
+     * @param sketch_1 first sketch
+     * @param sketch_2 second sketch
+     * @return distance
+     */
+    template <typename T>
+    distance_type operator()(const QuantileSketch<T>& sketch_1, const QuantileSketch<T>& sketch_2) const;
 };
 
 
@@ -0,0 +1,85 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+
+#ifndef _METRIC_DISTANCE_K_RANDOM_EMPIRICAL_CDF_HPP
+#define _METRIC_DISTANCE_K_RANDOM_EMPIRICAL_CDF_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+namespace metric {
+
+namespace empirical_cdf_details {
+
+    /** sample itself if it is sorted already, otherwise sorted copy in buffer **/
+    template <typename Sample>
+    const Sample& sorted(const Sample& sample, Sample& buffer)
+    {
+        if (sample.empty()) {
+            throw std::invalid_argument("samples must not be empty");
+        }
+        if (std::is_sorted(sample.begin(), sample.end())) {
+            return sample;
+        }
+        buffer.assign(sample.begin(), sample.end());
+        std::sort(buffer.begin(), buffer.end());
+        return buffer;
+    }
+
+    /** sorted sample, every value has unit weight **/
+    template <typename Sample>
+    struct unit_steps {
+        const Sample& sample;
+        std::size_t size() const { return sample.size(); }
+        auto value(std::size_t i) const { return sample[i]; }
+        std::size_t weight(std::size_t) const { return 1; }
+        std::size_t total() const { return sample.size(); }
+    };
+
+    /**
+     * @brief merge of the step CDFs of two weighted samples sorted by value
+     *
+     * f(cdf_a, cdf_b, value, next) is called for every gap between consecutive distinct values of both samples,
+     * where both CDFs are constant.
+     *
+     * @param a, b accessors: a.size(), a.value(i), a.weight(i) and a.total() weight
+     */
+    template <typename D, typename A, typename B, typename F>
+    void sweep(const A& a, const B& b, F f)
+    {
+        const std::size_t n = a.size();
+        const std::size_t m = b.size();
+        const D total_a = a.total();
+        const D total_b = b.total();
+        std::size_t i = 0;
+        std::size_t j = 0;
+        D weight_a = 0;
+        D weight_b = 0;
+        auto value = std::min(a.value(0), b.value(0));
+        while (i < n || j < m) {
+            while (i < n && !(value < a.value(i))) {
+                weight_a += a.weight(i++);
+            }
+            while (j < m && !(value < b.value(j))) {
+                weight_b += b.weight(j++);
+            }
+            if (i == n && j == m) {
+                break;
+            }
+            auto next = i == n ? b.value(j) : (j == m ? a.value(i) : std::min(a.value(i), b.value(j)));
+            f(weight_a / total_a, weight_b / total_b, value, next);
+            value = next;
+        }
+    }
+
+}  // namespace empirical_cdf_details
+
+}  // namespace metric
+
+#endif
@@ -7,109 +7,205 @@ Copyright (c) 2019 Panda Team
 */
 
 #include "L1.hpp"
+
+#include <algorithm>
+#include <cmath>
+
 namespace metric {
 
-// the UNFINISHED code for L1 metrics from the review papaer
+namespace L1_details {
+
+    /**
+     * @brief Call f(a_i, b_i) for every index stored in a or b in increasing order, missing values are zeros
+     *
+     * Merge join of the sorted index/value arrays of compressed vectors, nothing is allocated.
+     */
+    template <typename V, bool TF, typename F>
+    void merge_join(const blaze::CompressedVector<V, TF>& a, const blaze::CompressedVector<V, TF>& b, F&& f)
+    {
+        auto it1 = a.begin();
+        auto it2 = b.begin();
+        while (it1 != a.end() && it2 != b.end()) {
+            if (it1->index() < it2->index()) {
+                f(it1->value(), V(0));
+                ++it1;
+            } else if (it2->index() < it1->index()) {
+                f(V(0), it2->value());
+                ++it2;
+            } else {
+                f(it1->value(), it2->value());
+                ++it1;
+                ++it2;
+            }
+        }
+        for (; it1 != a.end(); ++it1) {
+            f(it1->value(), V(0));
+        }
+        for (; it2 != b.end(); ++it2) {
+            f(V(0), it2->value());
+        }
+    }
+
+    /** call f(a_i, b_i) for every index of dense containers, the shorter one is padded with zeros **/
+    template <typename V, typename Container, typename F>
+    void zip_padded(const Container& a, const Container& b, F&& f)
+    {
+        auto it1 = a.begin();
+        auto it2 = b.begin();
+        for (; it1 != a.end() && it2 != b.end(); ++it1, ++it2) {
+            f(V(*it1), V(*it2));
+        }
+        for (; it1 != a.end(); ++it1) {
+            f(V(*it1), V(0));
+        }
+        for (; it2 != b.end(); ++it2) {
+            f(V(0), V(*it2));
+        }
+    }
+
+    /** sum |a_i - b_i| and sum (a_i + b_i) of the Sorensen distance **/
+    template <typename V>
+    struct sorensen_sums {
+        V difference = 0;
+        V total = 0;
+
+        void operator()(V x, V y)
+        {
+            difference += std::abs(x - y);
+            total += x + y;
+        }
+
+        V distance() const { return difference == 0 ? V(0) : difference / total; }
+    };
+
+    template <typename V>
+    struct hassanat_sum {
+        V sum = 0;
+
+        void operator()(V x, V y)
+        {
+            const V min = std::min(x, y);
+            const V max = std::max(x, y);
+            if (min >= 0) {
+                sum += 1 - (1 + min) / (1 + max);
+            } else {
+                sum += 1 - 1 / (1 + max - min);
+            }
+        }
+    };
+
+    /** sum min(a_i, b_i) and sum max(a_i, b_i) of the Ruzicka distance **/
+    template <typename V>
+    struct ruzicka_sums {
+        V min = 0;
+        V max = 0;
+
+        void operator()(V x, V y)
+        {
+            min += std::min(x, y);
+            max += std::max(x, y);
+        }
+
+        V distance() const { return max == min ? V(0) : 1 - min / max; }
+    };
+
+    template <typename Metric, typename Container>
+    std::vector<typename Metric::distance_type> batch(
+        const Metric& metric, const Container& query, const std::vector<Container>& candidates)
+    {
+        std::vector<typename Metric::distance_type> result;
+        result.reserve(candidates.size());
+        for (auto& candidate : candidates) {
+            result.push_back(metric(query, candidate));
+        }
+        return result;
+    }
+
+}  // namespace L1_details
 
 template <typename V>
 template <typename Container>
 auto Sorensen<V>::operator()(const Container& a, const Container& b) const
     -> typename std::enable_if<!std::is_same<Container, V>::value, distance_type>::type
 {
-    double sum1 = 0;
-    double sum2 = 0;
-    Container z { 0 };
-    auto it1 = a.begin();
-    auto it2 = b.begin();
-
-    while (true) {
-        if (it1 == it2)  // both ends reached
-            break;
-
-        sum1 += (*it1 - *it2);
-        sum2 += (*it1 + *it2);
-
-        if (it1 + 1 != a.end() && it1 != z.begin())
-            ++it1;
-        else
-            it1 = z.begin();  // end reached, using zero against values of other vector
-        if (it2 + 1 != b.end() && it1 != z.begin())
-            ++it2;
-        else
-            it2 = z.begin();
-    }
-
-    if (sum1 < 0)
-        sum1 = -sum1;
-    return sum1 / sum2;  // here the type is changed
+    L1_details::sorensen_sums<distance_type> sums;
+    L1_details::zip_padded<distance_type>(a, b, sums);
+    return sums.distance();
 }
 
 template <typename V>
 auto Sorensen<V>::operator()(const blaze::CompressedVector<V>& a, const blaze::CompressedVector<V>& b) const
     -> distance_type
 {
-    double sum1 = 0;
-    double sum2 = 0;
-    blaze::CompressedVector<V> z { 0 };
-    auto it1 = a.begin();
-    auto it2 = b.begin();
-
-    while (true) {
-        if (it1 == it2)  // both ends reached
-            break;
-
-        sum1 += (it1->value() - it2->value());
-        sum2 += (it1->value() + it2->value());
-
-        // TODO implement element skipping!!
-
-        if (it1 + 1 != a.end() && it1 != z.begin())
-            ++it1;
-        else
-            it1 = z.begin();  // end reached, using zero against values of other vector
-        if (it2 + 1 != b.end() && it1 != z.begin())
-            ++it2;
-        else
-            it2 = z.begin();
-    }
+    L1_details::sorensen_sums<distance_type> sums;
+    L1_details::merge_join(a, b, sums);
+    return sums.distance();
+}
+
+template <typename V>
+template <typename Container>
+auto Sorensen<V>::batch(const Container& query, const std::vector<Container>& candidates) const
+    -> std::vector<distance_type>
+{
+    return L1_details::batch(*this, query, candidates);
+}
 
-    if (sum1 < 0)
-        sum1 = -sum1;
-    return sum1 / sum2;  // here the type is changed
+template <typename Value>
+double sorensen(const blaze::CompressedVector<Value>& a, const blaze::CompressedVector<Value>& b)
+{
+    return Sorensen<Value>()(a, b);
 }
 
 template <typename V>
 template <typename Container>
 auto Hassanat<V>::operator()(const Container& A, const Container& B) const -> distance_type
 {
-    value_type sum = 0;
-    value_type min;
-    value_type max;
-    for (auto it1 = A.begin(), it2 = B.begin(); it1 != A.end() || it2 != B.end(); ++it1, ++it2) {
-        min=std::min(*it1,*it2);
-        max=std::max(*it1,*it2);
-        if (min>=0){
-            sum += 1- (1+min)/(1+max);
-        }
-        else{
-            sum += 1- (1+min+min)/(1+max+min);
-        }
+    L1_details::hassanat_sum<value_type> sum;
+    L1_details::zip_padded<value_type>(A, B, sum);
+    return sum.sum;
+}
 
-    }
-    return sum;
+template <typename V>
+auto Hassanat<V>::operator()(const blaze::CompressedVector<V>& A, const blaze::CompressedVector<V>& B) const
+    -> distance_type
+{
+    L1_details::hassanat_sum<value_type> sum;
+    L1_details::merge_join(A, B, sum);
+    return sum.sum;
+}
+
+template <typename V>
+template <typename Container>
+auto Hassanat<V>::batch(const Container& query, const std::vector<Container>& candidates) const
+    -> std::vector<distance_type>
+{
+    return L1_details::batch(*this, query, candidates);
 }
 
 template <typename V>
 template <typename Container>
 auto Ruzicka<V>::operator()(const Container& A, const Container& B) const -> distance_type
 {
-    value_type sum = 0;
-    value_type min;
-    value_type max;
-    for (auto it1 = A.begin(), it2 = B.begin(); it1 != A.end() || it2 != B.end(); ++it1, ++it2) {
-        sum += std::max(*it1,*it2)/min=std::min(*it1,*it2);
-    }
-    return double(1) - sum;
+    L1_details::ruzicka_sums<value_type> sums;
+    L1_details::zip_padded<value_type>(A, B, sums);
+    return sums.distance();
+}
+
+template <typename V>
+auto Ruzicka<V>::operator()(const blaze::CompressedVector<V>& A, const blaze::CompressedVector<V>& B) const
+    -> distance_type
+{
+    L1_details::ruzicka_sums<value_type> sums;
+    L1_details::merge_join(A, B, sums);
+    return sums.distance();
+}
+
+template <typename V>
+template <typename Container>
+auto Ruzicka<V>::batch(const Container& query, const std::vector<Container>& candidates) const
+    -> std::vector<distance_type>
+{
+    return L1_details::batch(*this, query, candidates);
 }
 
 }  // namespace metric
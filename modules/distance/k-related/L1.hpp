@@ -11,8 +11,18 @@ Copyright (c) 2019 Panda Team
 
 #include "../../../3rdparty/blaze/Blaze.h"
 
+#include <vector>
+
 namespace metric {
 
+/**
+ * @class Sorensen
+ *
+ * @brief Sorensen (Bray-Curtis) distance sum |a_i - b_i| / sum (a_i + b_i)
+ *
+ * Vectors of different size are compared as if the shorter one was padded with zeros.
+ * Compressed vectors are compared by a merge of their nonzero elements, nothing is allocated.
+ */
 template <typename V = double>
 class Sorensen {
 public:
@@ -21,28 +31,46 @@ public:
     explicit Sorensen() = default;
 
     /**
-     * @brief
+     * @brief Calculate Sorensen distance between dense vectors
      *
-     * @param a
-     * @param b
-     * @return
+     * @param a first vector
+     * @param b second vector
+     * @return Sorensen distance between a and b
      */
     template <typename Container>
     typename std::enable_if<!std::is_same<Container, V>::value, distance_type>::type
     operator()(const Container& a, const Container& b) const;
 
     /**
-     * @brief
+     * @brief Calculate Sorensen distance between sparse vectors in O(nonzeros)
      *
-     * @param a
-     * @param b
-     * @return
+     * @param a first vector
+     * @param b second vector
+     * @return Sorensen distance between a and b
      */
     distance_type operator()(const blaze::CompressedVector<V>& a, const blaze::CompressedVector<V>& b) const;
 
+    /**
+     * @brief Calculate Sorensen distances between one vector and many vectors
+     *
+     * @param query vector
+     * @param candidates vectors
+     * @return distances from query to every candidate
+     */
+    template <typename Container>
+    std::vector<distance_type> batch(const Container& query, const std::vector<Container>& candidates) const;
+
     // TODO add support of 1D random values passed in simple containers
 };
 
+/**
+ * @class Hassanat
+ *
+ * @brief Hassanat distance, sum of 1 - (1 + min) / (1 + max) over dimensions shifted by |min| for negative minimum
+ *
+ * Dimensions where both values are zero add nothing, so compressed vectors are compared by a merge of their nonzero
+ * elements. Vectors of different size are compared as if the shorter one was padded with zeros.
+ */
 template <typename V = double>
 struct Hassanat {
     using value_type = V;
@@ -60,11 +88,38 @@ struct Hassanat {
 
     template <typename Container>
     distance_type operator()(const Container& a, const Container& b) const;
+
+    /**
+     * @brief Calculate Hassanat distance between sparse vectors in O(nonzeros)
+     *
+     * @param a first vector
+     * @param b second vector
+     * @return Hassanat distance between a and b
+     */
+    distance_type operator()(const blaze::CompressedVector<V>& a, const blaze::CompressedVector<V>& b) const;
+
+    /**
+     * @brief Calculate Hassanat distances between one vector and many vectors
+     *
+     * @param query vector
+     * @param candidates vectors
+     * @return distances from query to every candidate
+     */
+    template <typename Container>
+    std::vector<distance_type> batch(const Container& query, const std::vector<Container>& candidates) const;
 };
 
 template <typename Value>
 double sorensen(const blaze::CompressedVector<Value>& a, const blaze::CompressedVector<Value>& b);
 
+/**
+ * @class Ruzicka
+ *
+ * @brief Ruzicka distance 1 - sum min(a_i, b_i) / sum max(a_i, b_i)
+ *
+ * Dimensions where both values are zero add nothing, so compressed vectors are compared by a merge of their nonzero
+ * elements. Vectors of different size are compared as if the shorter one was padded with zeros.
+ */
 template <typename V = double>
 struct Ruzicka {
     using value_type = V;
@@ -82,6 +137,25 @@ struct Ruzicka {
 
     template <typename Container>
     distance_type operator()(const Container& a, const Container& b) const;
+
+    /**
+     * @brief Calculate Ruzicka distance between sparse vectors in O(nonzeros)
+     *
+     * @param a first vector
+     * @param b second vector
+     * @return Ruzicka distance between a and b
+     */
+    distance_type operator()(const blaze::CompressedVector<V>& a, const blaze::CompressedVector<V>& b) const;
+
+    /**
+     * @brief Calculate Ruzicka distances between one vector and many vectors
+     *
+     * @param query vector
+     * @param candidates vectors
+     * @return distances from query to every candidate
+     */
+    template <typename Container>
+    std::vector<distance_type> batch(const Container& query, const std::vector<Container>& candidates) const;
 };
 
 
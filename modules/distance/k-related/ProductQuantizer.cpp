@@ -0,0 +1,169 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+
+#include "ProductQuantizer.hpp"
+#include "../../mapping/kmeans.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace metric {
+
+template <typename T, std::size_t M>
+ProductQuantizer<T, M>::ProductQuantizer(const std::vector<std::vector<T>>& training, std::size_t subspaces,
+    std::size_t centroids, int maxiter, long long random_seed)
+{
+    if (training.empty()) {
+        throw std::invalid_argument("training set must not be empty");
+    }
+    const std::size_t dim = training[0].size();
+    if (subspaces == 0 || subspaces > dim || subspaces > M) {
+        throw std::invalid_argument("number of subspaces must be in [1, min(vector size, M)]");
+    }
+    if (centroids == 0 || centroids > 256) {
+        throw std::invalid_argument("number of centroids must be in [1, 256]");
+    }
+    if (centroids > training.size()) {
+        throw std::invalid_argument("number of centroids must not exceed the number of training vectors");
+    }
+    k = centroids;
+
+    // the remainder of dim / subspaces goes to the first subspaces
+    offsets.resize(subspaces + 1);
+    offsets[0] = 0;
+    for (std::size_t j = 0; j < subspaces; ++j) {
+        offsets[j + 1] = offsets[j] + dim / subspaces + (j < dim % subspaces ? 1 : 0);
+    }
+
+    codebooks.resize(subspaces);
+    symmetric_tables.resize(subspaces);
+    std::vector<std::vector<T>> slice(training.size());
+    for (std::size_t j = 0; j < subspaces; ++j) {
+        for (std::size_t i = 0; i < training.size(); ++i) {
+            slice[i].assign(training[i].begin() + offsets[j], training[i].begin() + offsets[j + 1]);
+        }
+        auto [assignments, means, counts] = metric::kmeans(slice, int(k), maxiter, "Euclidean", random_seed);
+        codebooks[j] = std::move(means);
+
+        auto& table = symmetric_tables[j];
+        table.assign(k * k, 0);
+        for (std::size_t a = 0; a < k; ++a) {
+            for (std::size_t b = a + 1; b < k; ++b) {
+                T sum = 0;
+                for (std::size_t d = 0; d < codebooks[j][a].size(); ++d) {
+                    T diff = codebooks[j][a][d] - codebooks[j][b][d];
+                    sum += diff * diff;
+                }
+                table[a * k + b] = sum;
+                table[b * k + a] = sum;
+            }
+        }
+    }
+}
+
+template <typename T, std::size_t M>
+template <typename Container>
+std::vector<T> ProductQuantizer<T, M>::lookup_table(const Container& v) const
+{
+    std::vector<T> table(subspaces() * k);
+    for (std::size_t j = 0; j < subspaces(); ++j) {
+        for (std::size_t c = 0; c < k; ++c) {
+            const auto& centroid = codebooks[j][c];
+            T sum = 0;
+            for (std::size_t d = offsets[j]; d < offsets[j + 1]; ++d) {
+                T diff = T(v[d]) - centroid[d - offsets[j]];
+                sum += diff * diff;
+            }
+            table[j * k + c] = sum;
+        }
+    }
+    return table;
+}
+
+template <typename T, std::size_t M>
+auto ProductQuantizer<T, M>::nearest_codes(const std::vector<T>& table) const -> code_type
+{
+    code_type code;
+    for (std::size_t j = 0; j < subspaces(); ++j) {
+        auto first = table.begin() + j * k;
+        code.codes[j] = std::uint8_t(std::min_element(first, first + k) - first);
+    }
+    return code;
+}
+
+template <typename T, std::size_t M>
+template <typename Container>
+auto ProductQuantizer<T, M>::encode(const Container& v) const -> code_type
+{
+    return nearest_codes(lookup_table(v));
+}
+
+template <typename T, std::size_t M>
+auto ProductQuantizer<T, M>::encode(const std::vector<std::vector<T>>& data) const -> std::vector<code_type>
+{
+    std::vector<code_type> result;
+    result.reserve(data.size());
+    for (auto& v : data) {
+        result.push_back(encode(v));
+    }
+    return result;
+}
+
+template <typename T, std::size_t M>
+template <typename Container>
+auto ProductQuantizer<T, M>::query(const Container& v) const -> code_type
+{
+    auto table = lookup_table(v);
+    code_type code = nearest_codes(table);
+    std::lock_guard<std::mutex> lock(queries->mutex);
+    queries->tables.push_back(std::move(table));
+    code.table = queries->tables.back().data();
+    return code;
+}
+
+template <typename T, std::size_t M>
+void ProductQuantizer<T, M>::release(const code_type& query) const
+{
+    std::lock_guard<std::mutex> lock(queries->mutex);
+    queries->tables.remove_if([&](const std::vector<T>& table) { return table.data() == query.table; });
+}
+
+template <typename T, std::size_t M>
+std::vector<T> ProductQuantizer<T, M>::decode(const code_type& code) const
+{
+    std::vector<T> result;
+    result.reserve(dimension());
+    for (std::size_t j = 0; j < subspaces(); ++j) {
+        const auto& centroid = codebooks[j][code.codes[j]];
+        result.insert(result.end(), centroid.begin(), centroid.end());
+    }
+    return result;
+}
+
+template <typename T, std::size_t M>
+auto ProductQuantizer<T, M>::operator()(const code_type& a, const code_type& b) const -> distance_type
+{
+    const std::size_t m = subspaces();
+    T sum = 0;
+    if (a.table || b.table) {
+        // asymmetric: lookup table of the query against codes of the other record
+        const T* table = a.table ? a.table : b.table;
+        const std::uint8_t* codes = a.table ? b.codes.data() : a.codes.data();
+        for (std::size_t j = 0; j < m; ++j) {
+            sum += table[j * k + codes[j]];
+        }
+    } else {
+        for (std::size_t j = 0; j < m; ++j) {
+            sum += symmetric_tables[j][a.codes[j] * k + b.codes[j]];
+        }
+    }
+    return std::sqrt(sum);
+}
+
+}  // namespace metric
@@ -0,0 +1,164 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+#ifndef _METRIC_DISTANCE_K_RELATED_PRODUCT_QUANTIZER_HPP
+#define _METRIC_DISTANCE_K_RELATED_PRODUCT_QUANTIZER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace metric {
+
+/**
+ * @class PQCode
+ *
+ * @brief Record compressed by ProductQuantizer: one centroid index per subspace, stored inline.
+ * Query records additionally point to a lookup table of squared distances from the query subvectors
+ * to all centroids, owned by the quantizer, which makes the distance asymmetric (ADC).
+ *
+ * @tparam M maximum number of subspaces
+ */
+template <typename T = double, std::size_t M = 16>
+struct PQCode {
+    using value_type = T;
+
+    // centroid of every subspace, entries after the number of subspaces are 0
+    std::array<std::uint8_t, M> codes {};
+    // lookup table of a query, null for encoded records
+    const T* table = nullptr;
+
+    bool operator==(const PQCode& other) const { return codes == other.codes; }
+    bool operator!=(const PQCode& other) const { return codes != other.codes; }
+};
+
+/**
+ * @class ProductQuantizer
+ *
+ * @brief Product quantization codec and distance.
+ *
+ * Vectors are split into m subspaces, each subspace is quantized with its own codebook trained by metric::kmeans.
+ * The object is the metric for PQCode records: two encoded records are compared with precomputed centroid-to-centroid
+ * tables (SDC), a query created by query() against an encoded record is compared with the query lookup table (ADC).
+ * Both approximate the Euclidean distance of the original vectors.
+ * Lookup tables of queries are kept by the quantizer and shared by its copies, e.g. the metric of a Tree,
+ * until release().
+ *
+ * @tparam M maximum number of subspaces, the size of codes
+ */
+template <typename T = double, std::size_t M = 16>
+class ProductQuantizer {
+public:
+    using value_type = T;
+    using distance_type = T;
+    using code_type = PQCode<T, M>;
+
+    ProductQuantizer() = default;
+
+    /**
+     * @brief Construct a new ProductQuantizer object and train codebooks
+     *
+     * @param training training vectors, all of the same size
+     * @param subspaces number of subspaces m, at most the vector size and M
+     * @param centroids number of centroids per subspace, at most 256 and the number of training vectors
+     * @param maxiter maximum number of kmeans iterations
+     * @param random_seed seed for kmeans initialization, -1 for random seed
+     * @throws std::invalid_argument on inconsistent parameters
+     */
+    ProductQuantizer(const std::vector<std::vector<T>>& training, std::size_t subspaces, std::size_t centroids = 256,
+        int maxiter = 100, long long random_seed = -1);
+
+    /**
+     * @brief encode vector
+     *
+     * @param v vector of the training size
+     * @return code with the nearest centroid of every subspace
+     */
+    template <typename Container>
+    code_type encode(const Container& v) const;
+
+    /**
+     * @brief encode set of vectors
+     *
+     * @param data vectors
+     * @return codes
+     */
+    std::vector<code_type> encode(const std::vector<std::vector<T>>& data) const;
+
+    /**
+     * @brief prepare query record with lookup table for asymmetric distance
+     *
+     * @param v query vector
+     * @return code pointing to the query lookup table, valid until release()
+     */
+    template <typename Container>
+    code_type query(const Container& v) const;
+
+    /**
+     * @brief free the lookup table of a query
+     *
+     * @param query code returned by query()
+     */
+    void release(const code_type& query) const;
+
+    /**
+     * @brief reconstruct vector from code
+     *
+     * @param code
+     * @return concatenation of centroids
+     */
+    std::vector<T> decode(const code_type& code) const;
+
+    /**
+     * @brief approximate Euclidean distance between two records
+     *
+     * @param a first record
+     * @param b second record
+     * @return ADC distance if one of the records is a query, SDC distance otherwise
+     */
+    distance_type operator()(const code_type& a, const code_type& b) const;
+
+    std::size_t subspaces() const { return offsets.size() - 1; }
+    std::size_t centroids() const { return k; }
+    std::size_t dimension() const { return offsets.back(); }
+
+    /**
+     * @brief codebooks
+     *
+     * @return centroids of every subspace
+     */
+    const std::vector<std::vector<std::vector<T>>>& get_codebooks() const { return codebooks; }
+
+private:
+    std::size_t k = 0;
+    std::vector<std::size_t> offsets = { 0 };
+    std::vector<std::vector<std::vector<T>>> codebooks;
+    // squared distances between centroids of a subspace, row major k x k per subspace
+    std::vector<std::vector<T>> symmetric_tables;
+    // lookup tables of queries, nodes of a list do not move, so distances read them without locking
+    struct query_tables {
+        std::mutex mutex;
+        std::list<std::vector<T>> tables;
+    };
+    std::shared_ptr<query_tables> queries = std::make_shared<query_tables>();
+
+    template <typename Container>
+    std::vector<T> lookup_table(const Container& v) const;
+
+    // code of the nearest centroid of every subspace from a lookup table
+    code_type nearest_codes(const std::vector<T>& table) const;
+};
+
+}  // namespace metric
+
+#include "ProductQuantizer.cpp"
+
+#endif  // Header Guard
@@ -0,0 +1,256 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+
+#include "Quantized.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace metric {
+
+template <typename Container>
+Int8Vector::Int8Vector(const Container& v)
+    : codes(v.size(), 0)
+{
+    double max_abs = 0;
+    for (auto it = v.begin(); it != v.end(); ++it) {
+        max_abs = std::max(max_abs, std::abs(double(*it)));
+    }
+    if (max_abs == 0) {
+        return;
+    }
+    scale = max_abs / 127.0;
+
+    std::size_t i = 0;
+    for (auto it = v.begin(); it != v.end(); ++it, ++i) {
+        auto code = std::clamp(std::lround(double(*it) / scale), -127L, 127L);
+        codes[i] = static_cast<std::int8_t>(code);
+        squared_norm += code * code;
+    }
+}
+
+inline auto Int8Vector::decode() const -> std::vector<value_type>
+{
+    std::vector<value_type> result(codes.size());
+    for (std::size_t i = 0; i < codes.size(); ++i) {
+        result[i] = scale * codes[i];
+    }
+    return result;
+}
+
+template <typename Container>
+Float16Vector::Float16Vector(const Container& v)
+    : bits(v.size())
+{
+    std::size_t i = 0;
+    for (auto it = v.begin(); it != v.end(); ++it, ++i) {
+        bits[i] = quantized_details::float_to_half(float(*it));
+    }
+}
+
+inline auto Float16Vector::operator[](std::size_t i) const -> value_type
+{
+    return quantized_details::half_to_float(bits[i]);
+}
+
+inline auto Float16Vector::decode() const -> std::vector<value_type>
+{
+    std::vector<value_type> result(bits.size());
+    for (std::size_t i = 0; i < bits.size(); ++i) {
+        result[i] = quantized_details::half_to_float(bits[i]);
+    }
+    return result;
+}
+
+namespace quantized_details {
+
+    inline std::uint16_t float_to_half(float value)
+    {
+        std::uint32_t x;
+        std::memcpy(&x, &value, sizeof(x));
+
+        std::uint32_t sign = (x >> 16) & 0x8000;
+        std::uint32_t mantissa = x & 0x007fffff;
+        std::int32_t exponent = std::int32_t((x >> 23) & 0xff) - 127 + 15;
+
+        // inf and nan
+        if (((x >> 23) & 0xff) == 0xff) {
+            return std::uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+        }
+        // overflow
+        if (exponent >= 0x1f) {
+            return std::uint16_t(sign | 0x7c00);
+        }
+        // subnormal or zero
+        if (exponent <= 0) {
+            if (exponent < -10) {
+                return std::uint16_t(sign);
+            }
+            mantissa |= 0x00800000;
+            std::uint32_t shift = std::uint32_t(14 - exponent);
+            std::uint32_t half = mantissa >> shift;
+            std::uint32_t rest = mantissa & ((1u << shift) - 1);
+            std::uint32_t halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (half & 1))) {
+                ++half;
+            }
+            return std::uint16_t(sign | half);
+        }
+
+        // normal, rounding carry may propagate into the exponent
+        std::uint32_t half = sign | (std::uint32_t(exponent) << 10) | (mantissa >> 13);
+        std::uint32_t rest = mantissa & 0x1fff;
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+            ++half;
+        }
+        return std::uint16_t(half);
+    }
+
+    inline float half_to_float(std::uint16_t bits)
+    {
+        std::uint32_t sign = std::uint32_t(bits & 0x8000) << 16;
+        std::uint32_t exponent = (bits >> 10) & 0x1f;
+        std::uint32_t mantissa = bits & 0x3ff;
+        std::uint32_t x;
+
+        if (exponent == 0) {
+            if (mantissa == 0) {
+                x = sign;
+            } else {
+                // normalize subnormal
+                exponent = 127 - 15 + 1;
+                while (!(mantissa & 0x400)) {
+                    mantissa <<= 1;
+                    --exponent;
+                }
+                mantissa &= 0x3ff;
+                x = sign | (exponent << 23) | (mantissa << 13);
+            }
+        } else if (exponent == 0x1f) {
+            x = sign | 0x7f800000 | (mantissa << 13);
+        } else {
+            x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        }
+
+        float result;
+        std::memcpy(&result, &x, sizeof(result));
+        return result;
+    }
+
+    inline std::int64_t dot(const Int8Vector& a, const Int8Vector& b)
+    {
+        // int32 partial sums can not overflow within a block: 2^16 * 127^2 < 2^31
+        constexpr std::size_t block = 1 << 16;
+        const std::size_t n = std::min(a.codes.size(), b.codes.size());
+        const std::int8_t* pa = a.codes.data();
+        const std::int8_t* pb = b.codes.data();
+
+        std::int64_t sum = 0;
+        for (std::size_t begin = 0; begin < n; begin += block) {
+            const std::size_t end = std::min(n, begin + block);
+            std::int32_t partial = 0;
+            for (std::size_t i = begin; i < end; ++i) {
+                partial += std::int32_t(pa[i]) * std::int32_t(pb[i]);
+            }
+            sum += partial;
+        }
+        return sum;
+    }
+
+    inline double squared_euclidean(const Int8Vector& a, const Int8Vector& b)
+    {
+        // |a - b|^2 = sa^2 |ca|^2 + sb^2 |cb|^2 - 2 sa sb <ca, cb>
+        double result = a.scale * a.scale * double(a.squared_norm) + b.scale * b.scale * double(b.squared_norm)
+            - 2 * a.scale * b.scale * double(dot(a, b));
+        return std::max(result, 0.0);
+    }
+
+    inline double manhatten(const Int8Vector& a, const Int8Vector& b)
+    {
+        const std::size_t n = std::min(a.codes.size(), b.codes.size());
+        const float sa = float(a.scale);
+        const float sb = float(b.scale);
+
+        float sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            sum += std::abs(sa * a.codes[i] - sb * b.codes[i]);
+        }
+        return sum;
+    }
+
+    inline double cosine(const Int8Vector& a, const Int8Vector& b)
+    {
+        // scales cancel out
+        double similarity = double(dot(a, b)) / std::sqrt(double(a.squared_norm) * double(b.squared_norm));
+        return std::acos(std::clamp(similarity, -1.0, 1.0)) / M_PI;
+    }
+
+    inline double squared_euclidean(const Float16Vector& a, const Float16Vector& b)
+    {
+        const std::size_t n = std::min(a.bits.size(), b.bits.size());
+        float sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            float d = half_to_float(a.bits[i]) - half_to_float(b.bits[i]);
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    inline double manhatten(const Float16Vector& a, const Float16Vector& b)
+    {
+        const std::size_t n = std::min(a.bits.size(), b.bits.size());
+        float sum = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            sum += std::abs(half_to_float(a.bits[i]) - half_to_float(b.bits[i]));
+        }
+        return sum;
+    }
+
+    inline double cosine(const Float16Vector& a, const Float16Vector& b)
+    {
+        const std::size_t n = std::min(a.bits.size(), b.bits.size());
+        float dot = 0, denom_a = 0, denom_b = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            float x = half_to_float(a.bits[i]);
+            float y = half_to_float(b.bits[i]);
+            dot += x * y;
+            denom_a += x * x;
+            denom_b += y * y;
+        }
+        double similarity = dot / (std::sqrt(double(denom_a)) * std::sqrt(double(denom_b)));
+        return std::acos(std::clamp(similarity, -1.0, 1.0)) / M_PI;
+    }
+
+}  // namespace quantized_details
+
+template <typename RecType, typename Container, typename Metric>
+auto rerank(const RecType& query, const std::vector<std::size_t>& ids, const Container& records, std::size_t k,
+    const Metric& metric)
+    -> std::vector<std::pair<std::size_t, typename std::invoke_result<Metric, const RecType&, const RecType&>::type>>
+{
+    using Distance = typename std::invoke_result<Metric, const RecType&, const RecType&>::type;
+
+    std::vector<std::pair<std::size_t, Distance>> result;
+    result.reserve(ids.size());
+    for (auto id : ids) {
+        result.emplace_back(id, metric(query, records[id]));
+    }
+
+    k = std::min(k, result.size());
+    std::partial_sort(result.begin(), result.begin() + k, result.end(),
+        [](const auto& lhs, const auto& rhs) { return lhs.second < rhs.second; });
+    result.resize(k);
+    return result;
+}
+
+}  // namespace metric
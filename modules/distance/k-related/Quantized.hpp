@@ -0,0 +1,145 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+#ifndef _METRIC_DISTANCE_K_RELATED_QUANTIZED_HPP
+#define _METRIC_DISTANCE_K_RELATED_QUANTIZED_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace metric {
+
+/**
+ * @class Int8Vector
+ *
+ * @brief Scalar quantized record: every value is stored as an int8 code with one scale per vector,
+ * x[i] ~ scale * codes[i]. The sum of squared codes is kept to compute L2 and cosine kernels from one
+ * integer dot product.
+ */
+struct Int8Vector {
+    using value_type = double;
+
+    std::vector<std::int8_t> codes;
+    double scale = 0;
+    std::int64_t squared_norm = 0;
+
+    Int8Vector() = default;
+
+    /**
+     * @brief Quantize a full precision vector
+     *
+     * @param v STL-like container of floating point values
+     */
+    template <typename Container>
+    explicit Int8Vector(const Container& v);
+
+    std::size_t size() const { return codes.size(); }
+
+    /**
+     * @brief decoded value
+     *
+     * @param i index
+     * @return scale * codes[i]
+     */
+    value_type operator[](std::size_t i) const { return scale * codes[i]; }
+
+    /**
+     * @brief decode record back to full precision
+     *
+     * @return vector of decoded values
+     */
+    inline std::vector<value_type> decode() const;
+};
+
+/**
+ * @class Float16Vector
+ *
+ * @brief Record stored as IEEE 754 half precision values (round to nearest even)
+ */
+struct Float16Vector {
+    using value_type = float;
+
+    std::vector<std::uint16_t> bits;
+
+    Float16Vector() = default;
+
+    /**
+     * @brief Convert a full precision vector
+     *
+     * @param v STL-like container of floating point values
+     */
+    template <typename Container>
+    explicit Float16Vector(const Container& v);
+
+    std::size_t size() const { return bits.size(); }
+
+    /**
+     * @brief decoded value
+     *
+     * @param i index
+     * @return value converted to float
+     */
+    inline value_type operator[](std::size_t i) const;
+
+    /**
+     * @brief decode record back to single precision
+     *
+     * @return vector of decoded values
+     */
+    inline std::vector<value_type> decode() const;
+};
+
+namespace quantized_details {
+
+    /**
+     * @brief convert float to half precision bits
+     */
+    inline std::uint16_t float_to_half(float value);
+
+    /**
+     * @brief convert half precision bits to float
+     */
+    inline float half_to_float(std::uint16_t bits);
+
+    /**
+     * @brief integer dot product of codes
+     */
+    inline std::int64_t dot(const Int8Vector& a, const Int8Vector& b);
+
+    inline double squared_euclidean(const Int8Vector& a, const Int8Vector& b);
+    inline double manhatten(const Int8Vector& a, const Int8Vector& b);
+    inline double cosine(const Int8Vector& a, const Int8Vector& b);
+
+    inline double squared_euclidean(const Float16Vector& a, const Float16Vector& b);
+    inline double manhatten(const Float16Vector& a, const Float16Vector& b);
+    inline double cosine(const Float16Vector& a, const Float16Vector& b);
+
+}  // namespace quantized_details
+
+/**
+ * @brief Re-rank candidates found on quantized records using full precision records
+ *
+ * @param query full precision query
+ * @param ids candidate ids, i.e. indices into records
+ * @param records full precision records
+ * @param k number of nearest records to return
+ * @param metric full precision metric
+ * @return k pairs of (id, distance) sorted by distance
+ */
+template <typename RecType, typename Container, typename Metric>
+auto rerank(const RecType& query, const std::vector<std::size_t>& ids, const Container& records, std::size_t k,
+    const Metric& metric = Metric())
+    -> std::vector<std::pair<std::size_t, typename std::invoke_result<Metric, const RecType&, const RecType&>::type>>;
+
+}  // namespace metric
+
+#include "Quantized.cpp"
+
+#endif  // Header Guard
@@ -49,6 +49,18 @@ double Euclidean<V>::operator()(
     return blaze::norm(a - b);
 }
 
+template <typename V>
+auto Euclidean<V>::operator()(const Int8Vector& a, const Int8Vector& b) const -> distance_type
+{
+    return std::sqrt(quantized_details::squared_euclidean(a, b));
+}
+
+template <typename V>
+auto Euclidean<V>::operator()(const Float16Vector& a, const Float16Vector& b) const -> distance_type
+{
+    return std::sqrt(quantized_details::squared_euclidean(a, b));
+}
+
 template <typename V>
 template <typename Container>
 auto Euclidean_thresholded<V>::operator()(const Container& a, const Container& b) const -> distance_type
@@ -178,6 +190,18 @@ auto Manhatten<V>::operator()(const Container& a, const Container& b) const -> d
     return sum;
 }
 
+template <typename V>
+auto Manhatten<V>::operator()(const Int8Vector& a, const Int8Vector& b) const -> distance_type
+{
+    return quantized_details::manhatten(a, b);
+}
+
+template <typename V>
+auto Manhatten<V>::operator()(const Float16Vector& a, const Float16Vector& b) const -> distance_type
+{
+    return quantized_details::manhatten(a, b);
+}
+
 template <typename V>
 template <typename Container>
 auto P_norm<V>::operator()(const Container& a, const Container& b) const -> distance_type
@@ -203,6 +227,18 @@ auto Cosine<V>::operator()(const Container& A, const Container& B) const -> dist
     return std::acos(dot / (std::sqrt(denom_a) * std::sqrt(denom_b))) / M_PI;
 }
 
+template <typename V>
+auto Cosine<V>::operator()(const Int8Vector& a, const Int8Vector& b) const -> distance_type
+{
+    return quantized_details::cosine(a, b);
+}
+
+template <typename V>
+auto Cosine<V>::operator()(const Float16Vector& a, const Float16Vector& b) const -> distance_type
+{
+    return quantized_details::cosine(a, b);
+}
+
 template <typename V>
 template <typename Container>
 auto Weierstrass<V>::operator()(const Container& A, const Container& B) const -> distance_type
@@ -12,6 +12,7 @@ Copyright (c) 2018 Michael Welsch
 #include <vector>
 #include <cmath>
 
+#include "Quantized.hpp"
 
 namespace metric {
 
@@ -58,6 +59,24 @@ struct Euclidean {
     template <template <typename, bool> class Container, typename ValueType, bool F> // detect Blaze object by signature
     double operator()(
         const Container<ValueType, F> & a, const Container<ValueType, F> & b) const;
+
+    /**
+     * @brief Calculate Euclidean distance for int8 quantized records
+     *
+     * @param a first record
+     * @param b second record
+     * @return Euclidean distance between a and b
+     */
+    distance_type operator()(const Int8Vector& a, const Int8Vector& b) const;
+
+    /**
+     * @brief Calculate Euclidean distance for half precision records
+     *
+     * @param a first record
+     * @param b second record
+     * @return Euclidean distance between a and b
+     */
+    distance_type operator()(const Float16Vector& a, const Float16Vector& b) const;
 };
 
 /**
@@ -83,6 +102,24 @@ struct Manhatten {
 
     template <typename Container>
     distance_type operator()(const Container& a, const Container& b) const;
+
+    /**
+     * @brief Calculate Manhatten distance for int8 quantized records
+     *
+     * @param a first record
+     * @param b second record
+     * @return Manhatten distance between a and b
+     */
+    distance_type operator()(const Int8Vector& a, const Int8Vector& b) const;
+
+    /**
+     * @brief Calculate Manhatten distance for half precision records
+     *
+     * @param a first record
+     * @param b second record
+     * @return Manhatten distance between a and b
+     */
+    distance_type operator()(const Float16Vector& a, const Float16Vector& b) const;
 };
 
 /**
@@ -314,6 +351,24 @@ struct Cosine {
      */
     template <typename Container>
     distance_type operator()(const Container& a, const Container& b) const;
+
+    /**
+     * @brief calculate cosine similariy between two int8 quantized records
+     *
+     * @param a first record
+     * @param b second record
+     * @return cosine similarity between a and b
+     */
+    distance_type operator()(const Int8Vector& a, const Int8Vector& b) const;
+
+    /**
+     * @brief calculate cosine similariy between two half precision records
+     *
+     * @param a first record
+     * @param b second record
+     * @return cosine similarity between a and b
+     */
+    distance_type operator()(const Float16Vector& a, const Float16Vector& b) const;
 };
 
 template <typename V = double>
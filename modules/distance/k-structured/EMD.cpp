@@ -22,7 +22,6 @@ Copyright (c) 2018 Michael Welsch
 #include <algorithm>
 #include <cmath>
 #include <iostream>
-#include <list>
 #include <numeric>
 #include <type_traits>
 #include <utility>
@@ -139,6 +138,45 @@ namespace EMD_details {
         return distM;
     }
 
+    template <typename V>
+    std::vector<std::vector<V>> default_ground_matrix(std::size_t rows, std::size_t cols)
+    {
+        std::vector<std::vector<V>> matrix(rows, std::vector<V>(cols, 0));
+        if (rows == 1 && cols == 1) {
+            matrix[0][0] = 1;
+            return matrix;
+        }
+        int t = std::min(rows, cols) / 2;  // by default, ground distance saturates at the half of maximum distance possible
+
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < cols; j++) {
+                matrix[i][j] = std::min(t,
+                    std::abs((int)(i - j)));  // non-square matrix is supported here, BUT IS NOT SUPPORTED IN THE EMD IMPL
+            }
+        }
+        return matrix;
+    }
+
+    /**
+     * @brief Saturate ground distance at threshold.
+     * Thresholded ground distances keep the metric properties and make the solver faster: only entries below the
+     * threshold become edges of the flow network.
+     *
+     * @param C ground distance matrix
+     * @param threshold
+     * @return matrix with entries min(C[i][j], threshold)
+     */
+    template <typename T>
+    std::vector<std::vector<T>> thresholded_ground_matrix(std::vector<std::vector<T>> C, T threshold)
+    {
+        for (auto& row : C) {
+            for (auto& value : row) {
+                value = std::min(value, threshold);
+            }
+        }
+        return C;
+    }
+
     enum FLOW_TYPE_T { NO_FLOW = 0, WITHOUT_TRANSHIPMENT_FLOW, WITHOUT_EXTRA_MASS_FLOW };
 
     /// returns the flow from/to transhipment vertex given flow F which was computed using
@@ -271,31 +309,79 @@ namespace EMD_details {
     };
     //------------------------------------------------------------------------------
 
+    //------------------------------------------------------------------------------
+    /**
+     * @brief Flow network and buffers of min_cost_flow, kept between problems so that solving many problems
+     * (see EMD::batch) does not reallocate them.
+     *
+     * Adjacency lists are only cleared, the number of lists never shrinks, so the first nodes() lists of a problem
+     * are used and the rest stay empty.
+     */
+    template <typename T>
+    struct flow_workspace {
+        // c[i] - edges that goes from node i. first is the second nod
+        std::vector<std::vector<edge<T>>> c;
+        // x - the flow is returned in it
+        std::vector<std::vector<edge0<T>>> x;
+        // reduced costs for forward edges and reduced costs and capacity for backward edges
+        std::vector<std::vector<edge1<T>>> r_cost_forward;
+        std::vector<std::vector<edge2<T>>> r_cost_cap_backward;
+        // shortest path distances, predecessors and the heap of the Dijkstra search
+        std::vector<T> d;
+        std::vector<size_t> prev;
+        std::vector<size_t> nodes_to_Q;
+        std::vector<edge3<T>> Q;
+        std::vector<size_t> final_nodes;
+
+        /**
+         * @brief Clear the network for a problem with given number of nodes
+         */
+        void reset(size_t nodes)
+        {
+            clear_lists(c, nodes);
+            clear_lists(x, nodes);
+            clear_lists(r_cost_forward, nodes);
+            clear_lists(r_cost_cap_backward, nodes);
+        }
+
+    private:
+        template <typename E>
+        static void clear_lists(std::vector<std::vector<E>>& lists, size_t nodes)
+        {
+            for (auto& list : lists) {
+                list.clear();
+            }
+            if (lists.size() < nodes) {
+                lists.resize(nodes);
+            }
+        }
+    };
+
     //------------------------------------------------------------------------------
     template <typename T>
     class min_cost_flow {
 
         size_t _num_nodes;
-        std::vector<size_t> _nodes_to_Q;
 
     public:
         // e - supply(positive) and demand(negative).
-        // c[i] - edges that goes from node i. first is the second nod
-        // x - the flow is returned in it
-        T operator()(std::vector<T>& e, const std::vector<std::list<edge<T>>>& c, std::vector<std::list<edge0<T>>>& x)
+        // w.c[i] - edges that goes from node i, filled by the caller after w.reset(e.size())
+        // w.x - the flow is returned in it
+        T operator()(std::vector<T>& e, flow_workspace<T>& w)
         {
-            assert(e.size() == c.size());
-            assert(x.size() == c.size());
+            assert(w.c.size() >= e.size());
+            assert(w.x.size() >= e.size());
 
             _num_nodes = e.size();
-            _nodes_to_Q.resize(_num_nodes);
+            w.nodes_to_Q.resize(_num_nodes);
+            auto& c = w.c;
+            auto& x = w.x;
 
             // init flow
             {
                 for (size_t from = 0; from < _num_nodes; ++from) {
                     {
-                        for (typename std::list<edge<T>>::const_iterator it = c[from].begin(); it != c[from].end();
-                             ++it) {
+                        for (auto it = c[from].begin(); it != c[from].end(); ++it) {
                             x[from].push_back(edge0<T>(it->_to, it->_cost, 0));
                             x[it->_to].push_back(edge0<T>(from, -it->_cost, 0));
                         }
@@ -305,12 +391,11 @@ namespace EMD_details {
 
             // reduced costs for forward edges (c[i,j]-pi[i]+pi[j])
             // Note that for forward edges the residual capacity is infinity
-            std::vector<std::list<edge1<T>>> r_cost_forward(_num_nodes);
+            auto& r_cost_forward = w.r_cost_forward;
             {
                 for (size_t from = 0; from < _num_nodes; ++from) {
                     {
-                        for (typename std::list<edge<T>>::const_iterator it = c[from].begin(); it != c[from].end();
-                             ++it) {
+                        for (auto it = c[from].begin(); it != c[from].end(); ++it) {
                             r_cost_forward[from].push_back(edge1<T>(it->_to, it->_cost));
                         }
                     }
@@ -319,12 +404,11 @@ namespace EMD_details {
 
             // reduced costs and capacity for backward edges (c[j,i]-pi[j]+pi[i])
             // Since the flow at the beginning is 0, the residual capacity is also zero
-            std::vector<std::list<edge2<T>>> r_cost_cap_backward(_num_nodes);
+            auto& r_cost_cap_backward = w.r_cost_cap_backward;
             {
                 for (size_t from = 0; from < _num_nodes; ++from) {
                     {
-                        for (typename std::list<edge<T>>::const_iterator it = c[from].begin(); it != c[from].end();
-                             ++it) {
+                        for (auto it = c[from].begin(); it != c[from].end(); ++it) {
                             r_cost_cap_backward[it->_to].push_back(edge2<T>(from, -it->_cost, 0));
                         }
                     }  // it
@@ -341,8 +425,10 @@ namespace EMD_details {
             }
             T delta = static_cast<T>(std::pow(2.0l, std::ceil(std::log(static_cast<long double>(U)) / std::log(2.0))));
 
-            std::vector<T> d(_num_nodes);
-            std::vector<size_t> prev(_num_nodes);
+            auto& d = w.d;
+            auto& prev = w.prev;
+            d.resize(_num_nodes);
+            prev.resize(_num_nodes);
             delta = 1;
 
             while (true) {  // until we break when S or T is empty
@@ -363,7 +449,7 @@ namespace EMD_details {
                 delta = maxSupply;
 
                 size_t l = 0;
-                compute_shortest_path(d, prev, k, r_cost_forward, r_cost_cap_backward, e, l);
+                compute_shortest_path(w, k, e, l);
                 //---------------------------------------------------------------
                 // find delta (minimum on the path from k to l)
                 // delta= e[k];
@@ -374,7 +460,7 @@ namespace EMD_details {
                     assert(from != to);
 
                     // residual
-                    typename std::list<edge2<T>>::iterator itccb = r_cost_cap_backward[from].begin();
+                    auto itccb = r_cost_cap_backward[from].begin();
                     while ((itccb != r_cost_cap_backward[from].end()) && (itccb->_to != to)) {
                         ++itccb;
                     }
@@ -395,14 +481,14 @@ namespace EMD_details {
                     assert(from != to);
 
                     // TODO - might do here O(n) can be done in O(1)
-                    typename std::list<edge0<T>>::iterator itx = x[from].begin();
+                    auto itx = x[from].begin();
                     while (itx->_to != to) {
                         ++itx;
                     }
                     itx->_flow += delta;
 
                     // update residual for backward edges
-                    typename std::list<edge2<T>>::iterator itccb = r_cost_cap_backward[to].begin();
+                    auto itccb = r_cost_cap_backward[to].begin();
                     while ((itccb != r_cost_cap_backward[to].end()) && (itccb->_to != from)) {
                         ++itccb;
                     }
@@ -432,8 +518,7 @@ namespace EMD_details {
             {
                 for (size_t from = 0; from < _num_nodes; ++from) {
                     {
-                        for (typename std::list<edge0<T>>::const_iterator it = x[from].begin(); it != x[from].end();
-                             ++it) {
+                        for (auto it = x[from].begin(); it != x[from].end(); ++it) {
                             //                        if (it->_flow!=0) cout << from << "->" << it->_to << ": " << it->_flow
                             //                        << "x" << it->_cost << endl;
                             dist += (it->_cost * it->_flow);
@@ -446,21 +531,22 @@ namespace EMD_details {
         }  // operator()
 
     private:
-        void compute_shortest_path(std::vector<T>& d, std::vector<size_t>& prev,
-
-            size_t from, std::vector<std::list<edge1<T>>>& cost_forward,
-            std::vector<std::list<edge2<T>>>& cost_backward,
-
-            const std::vector<T>& e, size_t& l)
+        void compute_shortest_path(flow_workspace<T>& w, size_t from, const std::vector<T>& e, size_t& l)
         {
+            auto& d = w.d;
+            auto& prev = w.prev;
+            auto& cost_forward = w.r_cost_forward;
+            auto& cost_backward = w.r_cost_cap_backward;
+            auto& nodes_to_Q = w.nodes_to_Q;
 
             //----------------------------------------------------------------
             // Making heap (all inf except 0, so we are saving comparisons...)
             //----------------------------------------------------------------
-            std::vector<edge3<T>> Q(_num_nodes);
+            auto& Q = w.Q;
+            Q.resize(_num_nodes);
 
             Q[0]._to = from;
-            _nodes_to_Q[from] = 0;
+            nodes_to_Q[from] = 0;
             Q[0]._dist = 0;
 
             size_t j = 1;
@@ -468,7 +554,7 @@ namespace EMD_details {
             {
                 for (size_t i = 0; i < from; ++i) {
                     Q[j]._to = i;
-                    _nodes_to_Q[i] = j;
+                    nodes_to_Q[i] = j;
                     Q[j]._dist = std::numeric_limits<T>::max();
                     ++j;
                 }
@@ -477,7 +563,7 @@ namespace EMD_details {
             {
                 for (size_t i = from + 1; i < _num_nodes; ++i) {
                     Q[j]._to = i;
-                    _nodes_to_Q[i] = j;
+                    nodes_to_Q[i] = j;
                     Q[j]._dist = std::numeric_limits<T>::max();
                     ++j;
                 }
@@ -487,7 +573,8 @@ namespace EMD_details {
             //----------------------------------------------------------------
             // main loop
             //----------------------------------------------------------------
-            std::vector<size_t> finalNodesFlg(_num_nodes, false);
+            auto& finalNodesFlg = w.final_nodes;
+            finalNodesFlg.assign(_num_nodes, false);
             do {
                 size_t u = Q[0]._to;
 
@@ -498,32 +585,30 @@ namespace EMD_details {
                     break;
                 }
 
-                heap_remove_first(Q, _nodes_to_Q);
+                heap_remove_first(Q, nodes_to_Q);
 
                 // neighbors of u
                 {
-                    for (typename std::list<edge1<T>>::const_iterator it = cost_forward[u].begin();
-                         it != cost_forward[u].end(); ++it) {
+                    for (auto it = cost_forward[u].begin(); it != cost_forward[u].end(); ++it) {
                         assert(it->_reduced_cost >= 0);
                         T alt = d[u] + it->_reduced_cost;
                         size_t v = it->_to;
-                        if ((_nodes_to_Q[v] < Q.size()) && (alt < Q[_nodes_to_Q[v]]._dist)) {
+                        if ((nodes_to_Q[v] < Q.size()) && (alt < Q[nodes_to_Q[v]]._dist)) {
                             // cout << "u to v==" << u << " to " << v << "   " << alt << endl;
-                            heap_decrease_key(Q, _nodes_to_Q, v, alt);
+                            heap_decrease_key(Q, nodes_to_Q, v, alt);
                             prev[v] = u;
                         }
                     }
                 }  // it
                 {
-                    for (typename std::list<edge2<T>>::const_iterator it = cost_backward[u].begin();
-                         it != cost_backward[u].end(); ++it) {
+                    for (auto it = cost_backward[u].begin(); it != cost_backward[u].end(); ++it) {
                         if (it->_residual_capacity > 0) {
                             assert(it->_reduced_cost >= 0);
                             T alt = d[u] + it->_reduced_cost;
                             size_t v = it->_to;
-                            if ((_nodes_to_Q[v] < Q.size()) && (alt < Q[_nodes_to_Q[v]]._dist)) {
+                            if ((nodes_to_Q[v] < Q.size()) && (alt < Q[nodes_to_Q[v]]._dist)) {
                                 // cout << "u to v==" << u << " to " << v << "   " << alt << endl;
-                                heap_decrease_key(Q, _nodes_to_Q, v, alt);
+                                heap_decrease_key(Q, nodes_to_Q, v, alt);
                                 prev[v] = u;
                             }
                         }
@@ -537,8 +622,7 @@ namespace EMD_details {
             {
                 for (size_t from = 0; from < _num_nodes; ++from) {
                     {
-                        for (typename std::list<edge1<T>>::iterator it = cost_forward[from].begin();
-                             it != cost_forward[from].end(); ++it) {
+                        for (auto it = cost_forward[from].begin(); it != cost_forward[from].end(); ++it) {
                             if (finalNodesFlg[from]) {
                                 it->_reduced_cost += d[from] - d[l];
                             }
@@ -554,8 +638,7 @@ namespace EMD_details {
             {
                 for (size_t from = 0; from < _num_nodes; ++from) {
                     {
-                        for (typename std::list<edge2<T>>::iterator it = cost_backward[from].begin();
-                             it != cost_backward[from].end(); ++it) {
+                        for (auto it = cost_backward[from].begin(); it != cost_backward[from].end(); ++it) {
                             if (finalNodesFlg[from]) {
                                 it->_reduced_cost += d[from] - d[l];
                             }
@@ -646,9 +729,12 @@ namespace EMD_details {
         }
     }
 
-    // Forward declarations
-    template <typename T, FLOW_TYPE_T FLOW_TYPE>
-    struct emd_impl;
+    // This condition should hold:
+    // ( 2^(sizeof(CONVERT_TO_T*8)) >= ( MULT_FACTOR^2 )
+    // Note that it can be problematic to check it because
+    // of overflow problems. I simply checked it with Linux calc
+    // which has arbitrary precision.
+    constexpr double MULT_FACTOR = 1000000;
 
     /*
   Main implementation
@@ -656,52 +742,29 @@ namespace EMD_details {
     template <typename Container, FLOW_TYPE_T FLOW_TYPE>
     struct emd_impl_integral_types {
         typedef typename Container::value_type T;
+
+        template <typename Ground>
         T operator()(const Container& POrig, const Container& QOrig, const std::vector<T>& Pc,
             const std::vector<T>& Qc,  // P, Q, C replaced with Pc, Qc, Cc by Max F
-            const std::vector<std::vector<T>>& Cc,
-            // T maxC, // disabled by MaxF //now updated inside
-            T extra_mass_penalty,
-            std::vector<std::vector<T>>* F  //,
-            // T abs_diff_sum_P_sum_Q // disabled by MaxF //now updated inside
-        )
+            const Ground& ground, T extra_mass_penalty, std::vector<std::vector<T>>* F, flow_workspace<T>& workspace)
         {
+            static_assert(std::is_same<T, typename Ground::integral_type>::value, "ground distance type mismatch");
 
             //-------------------------------------------------------
             size_t N = Pc.size();
             assert(Qc.size() == N);
 
-            // bool needToSwapFlow = false; // commented by Max F
-            // re-inserted by MAx F from the original code
             // Ensuring that the supplier - P, have more mass.
-            std::vector<T> P;
-            std::vector<T> Q;
-            std::vector<std::vector<T>> C(Cc);
-            T abs_diff_sum_P_sum_Q;
-            T sum_P = 0;
-            T sum_Q = 0;
-            sum_P = std::accumulate(Pc.begin(), Pc.end(), T { 0 });
-            sum_Q = std::accumulate(Qc.begin(), Qc.end(), T { 0 });
-            // {for (std::size_t i=0; i<N; ++i) sum_P+= Pc[i];}
-            // {for (std::size_t i=0; i<N; ++i) sum_Q+= Qc[i];}
-            bool needToSwapFlow = false;
-            if (sum_Q > sum_P) {
-                needToSwapFlow = true;
-                P.assign(std::begin(Qc), std::end(Qc));
-                Q.assign(std::begin(Pc), std::end(Pc));
-                // transpose C
-                for (std::size_t i = 0; i < N; ++i) {
-                    for (std::size_t j = 0; j < N; ++j) {
-                        C[i][j] = Cc[j][i];
-                    }
-                }
-                abs_diff_sum_P_sum_Q = sum_Q - sum_P;
-            } else {
-                P.assign(std::begin(Pc), std::end(Pc));
-                Q.assign(std::begin(Qc), std::end(Qc));
-                abs_diff_sum_P_sum_Q = sum_P - sum_Q;
-            }
-            // if (needToSwapFlow) cout << "needToSwapFlow" << endl;
-            // end of re-insertion
+            // The transposed ground distance is prepared once, so swapping costs nothing here.
+            T sum_P = std::accumulate(Pc.begin(), Pc.end(), T { 0 });
+            T sum_Q = std::accumulate(Qc.begin(), Qc.end(), T { 0 });
+            const bool needToSwapFlow = sum_Q > sum_P;
+            const std::vector<T>& P = needToSwapFlow ? Qc : Pc;
+            const std::vector<T>& Q = needToSwapFlow ? Pc : Qc;
+            const auto& C = needToSwapFlow ? ground.CT : ground.C;
+            const auto& edges = needToSwapFlow ? ground.edgesT : ground.edges;
+            const T abs_diff_sum_P_sum_Q = needToSwapFlow ? sum_Q - sum_P : sum_P - sum_Q;
+            const T maxC = ground.maxC;
 
             // creating the b vector that contains all vertexes
             std::vector<T> b(2 * N + 2);
@@ -723,67 +786,26 @@ namespace EMD_details {
             b[THRESHOLD_NODE] = -abs_diff_sum_P_sum_Q;
             b[ARTIFICIAL_NODE] = 0;
             //-------------------------------------------------------
-            // original code restored by Max F
-            T maxC = 0;
-            {
-                for (std::size_t i = 0; i < N; ++i) {
-                    {
-                        for (std::size_t j = 0; j < N; ++j) {
-                            assert(C[i][j] >= 0);
-                            if (C[i][j] > maxC)
-                                maxC = C[i][j];
-                        }
-                    }
-                }
-            }
-            // end of restored code
 
             if (extra_mass_penalty == -1)
                 extra_mass_penalty = maxC;
             //-------------------------------------------------------
 
             //=============================================================
-            std::set<size_t> sources_that_flow_not_only_to_thresh;
-            std::set<size_t> sinks_that_get_flow_not_only_from_thresh;
+            // sources and sinks connected by an edge cheaper than maxC,
+            // the others flow only through the threshold node
+            std::vector<bool> not_only_thresh(2 * N, false);
             T pre_flow_cost = 0;
-            //=============================================================
-
-            //=============================================================
-            // regular edges between sinks and sources without threshold edges
-            std::vector<std::list<edge<T>>> c(b.size());
-            {
-                for (size_t i = 0; i < N; ++i) {
-                    if (b[i] == 0)
-                        continue;
-                    {
-                        for (size_t j = 0; j < N; ++j) {
-                            if (b[j + N] == 0)
-                                continue;
-                            if (C[i][j] == maxC)
-                                continue;
-                            c[i].push_back(edge<T>(j + N, C[i][j]));
-                        }
-                    }  // j
-                }
-            }  // i
-
-            // checking which are not isolated
-            {
-                for (size_t i = 0; i < N; ++i) {
-                    if (b[i] == 0)
+            for (size_t i = 0; i < N; ++i) {
+                if (b[i] == 0)
+                    continue;
+                for (auto j : edges[i]) {
+                    if (b[j + N] == 0)
                         continue;
-                    {
-                        for (size_t j = 0; j < N; ++j) {
-                            if (b[j + N] == 0)
-                                continue;
-                            if (C[i][j] == maxC)
-                                continue;
-                            sources_that_flow_not_only_to_thresh.insert(i);
-                            sinks_that_get_flow_not_only_from_thresh.insert(j + N);
-                        }
-                    }  // j
+                    not_only_thresh[i] = true;
+                    not_only_thresh[j + N] = true;
                 }
-            }  // i
+            }
 
             // converting all sinks to negative
             {
@@ -791,27 +813,6 @@ namespace EMD_details {
                     b[i] = -b[i];
                 }
             }
-            // add edges from/to threshold node,
-            // note that costs are reversed to the paper (see also remark* above)
-            // It is important that it will be this way because of remark* above.
-            {
-                for (size_t i = 0; i < N; ++i) {
-                    c[i].push_back(edge<T>(THRESHOLD_NODE, 0));
-                }
-            }
-            {
-                for (size_t j = 0; j < N; ++j) {
-                    c[THRESHOLD_NODE].push_back(edge<T>(j + N, maxC));
-                }
-            }
-
-            // artificial arcs - Note the restriction that only one edge i,j is artificial so I ignore it...
-            {
-                for (size_t i = 0; i < ARTIFICIAL_NODE; ++i) {
-                    c[i].push_back(edge<T>(ARTIFICIAL_NODE, maxC + 1));
-                    c[ARTIFICIAL_NODE].push_back(edge<T>(i, maxC + 1));
-                }
-            }
             //=============================================================
 
             //====================================================
@@ -829,9 +830,7 @@ namespace EMD_details {
             {
                 for (size_t i = 0; i < N * 2; ++i) {
                     if (b[i] != 0) {
-                        if (sources_that_flow_not_only_to_thresh.find(i) != sources_that_flow_not_only_to_thresh.end()
-                            || sinks_that_get_flow_not_only_from_thresh.find(i)
-                                != sinks_that_get_flow_not_only_from_thresh.end()) {
+                        if (not_only_thresh[i]) {
                             nodes_new_names[i] = current_node_name;
                             nodes_old_names.push_back(i);
                             ++current_node_name;
@@ -852,8 +851,8 @@ namespace EMD_details {
             ++current_node_name;
 
             std::vector<T> bb(current_node_name);
-            size_t j = 0;
             {
+                size_t j = 0;
                 for (size_t i = 0; i < b.size(); ++i) {
                     if (nodes_new_names[i] != REMOVE_NODE_FLAG) {
                         bb[j] = b[i];
@@ -862,33 +861,55 @@ namespace EMD_details {
                 }
             }
 
-            std::vector<std::list<edge<T>>> cc(bb.size());
-            {
-                for (size_t i = 0; i < c.size(); ++i) {
-                    if (nodes_new_names[i] == REMOVE_NODE_FLAG)
-                        continue;
-                    {
-                        for (typename std::list<edge<T>>::const_iterator it = c[i].begin(); it != c[i].end(); ++it) {
-                            if (nodes_new_names[it->_to] != REMOVE_NODE_FLAG) {
-                                cc[nodes_new_names[i]].push_back(edge<T>(nodes_new_names[it->_to], it->_cost));
-                            }
-                        }
+            //=============================================================
+            // edges between the remaining nodes, in the order of the original construction:
+            // regular edges without threshold edges, edges from/to threshold node
+            // (note that costs are reversed to the paper, see also remark* above),
+            // artificial arcs (note the restriction that only one edge i,j is artificial so I ignore it...)
+            const int threshold_name = nodes_new_names[THRESHOLD_NODE];
+            const int artificial_name = nodes_new_names[ARTIFICIAL_NODE];
+            workspace.reset(bb.size());
+            auto& cc = workspace.c;
+            for (size_t i = 0; i < N; ++i) {
+                if (nodes_new_names[i] == REMOVE_NODE_FLAG)
+                    continue;
+                auto& node_edges = cc[nodes_new_names[i]];
+                for (auto j : edges[i]) {
+                    if (nodes_new_names[j + N] != REMOVE_NODE_FLAG) {
+                        node_edges.push_back(edge<T>(nodes_new_names[j + N], C[i][j]));
                     }
                 }
+                node_edges.push_back(edge<T>(threshold_name, 0));
+                node_edges.push_back(edge<T>(artificial_name, maxC + 1));
+            }
+            for (size_t j = N; j < 2 * N; ++j) {
+                if (nodes_new_names[j] != REMOVE_NODE_FLAG) {
+                    cc[nodes_new_names[j]].push_back(edge<T>(artificial_name, maxC + 1));
+                }
             }
+            for (size_t j = N; j < 2 * N; ++j) {
+                if (nodes_new_names[j] != REMOVE_NODE_FLAG) {
+                    cc[threshold_name].push_back(edge<T>(nodes_new_names[j], maxC));
+                }
+            }
+            cc[threshold_name].push_back(edge<T>(artificial_name, maxC + 1));
+            for (size_t i = 0; i < ARTIFICIAL_NODE; ++i) {
+                if (nodes_new_names[i] != REMOVE_NODE_FLAG) {
+                    cc[artificial_name].push_back(edge<T>(nodes_new_names[i], maxC + 1));
+                }
+            }
+            //=============================================================
 
             min_cost_flow<T> mcf;
 
             T my_dist;
 
-            std::vector<std::list<edge0<T>>> flows(bb.size());
-
-            T mcf_dist = mcf(bb, cc, flows);
+            T mcf_dist = mcf(bb, workspace);
+            const auto& flows = workspace.x;
 
             if (FLOW_TYPE != NO_FLOW) {
-                for (size_t new_name_from = 0; new_name_from < flows.size(); ++new_name_from) {
-                    for (typename std::list<edge0<T>>::const_iterator it = flows[new_name_from].begin();
-                         it != flows[new_name_from].end(); ++it) {
+                for (size_t new_name_from = 0; new_name_from < bb.size(); ++new_name_from) {
+                    for (auto it = flows[new_name_from].begin(); it != flows[new_name_from].end(); ++it) {
                         if (new_name_from == nodes_new_names[THRESHOLD_NODE]
                             || it->_to == nodes_new_names[THRESHOLD_NODE])
                             continue;
@@ -936,86 +957,65 @@ namespace EMD_details {
     struct emd_impl {
         typedef typename Container::value_type T;
         typedef long long int CONVERT_TO_T;
-        // typedef int T;
 
+        template <typename Ground>
         T operator()(const Container& POrig, const Container& QOrig, const std::vector<T>& P, const std::vector<T>& Q,
-            const std::vector<std::vector<T>>& C,
-            // T maxC, // disabled by Max F
-            T extra_mass_penalty,
-            std::vector<std::vector<T>>* F  //,
-            // T abs_diff_sum_P_sum_Q // disabled by Max F
-        )
+            const Ground& ground, T extra_mass_penalty, std::vector<std::vector<T>>* F,
+            flow_workspace<typename Ground::integral_type>& workspace)
         {
             /*** integral types ***/
-            if (std::is_integral<T>::value) {
-                // return emd_impl_integral_types<Container, FLOW_TYPE>()(POrig, QOrig, P, Q, C, maxC, extra_mass_penalty,
-                // F, abs_diff_sum_P_sum_Q);
-                return emd_impl_integral_types<Container, FLOW_TYPE>()(POrig, QOrig, P, Q, C, extra_mass_penalty,
-                    F);  // replaced by Max F
+            if constexpr (std::is_integral<T>::value) {
+                return emd_impl_integral_types<Container, FLOW_TYPE>()(POrig, QOrig, P, Q, ground, extra_mass_penalty,
+                    F, workspace);
             }
             /*** floating types ***/
-            else if (std::is_floating_point<T>::value) {
-
-                // TODO: static assert
-                assert(sizeof(CONVERT_TO_T) >= 8);
-
-                // This condition should hold:
-                // ( 2^(sizeof(CONVERT_TO_T*8)) >= ( MULT_FACTOR^2 )
-                // Note that it can be problematic to check it because
-                // of overflow problems. I simply checked it with Linux calc
-                // which has arbitrary precision.
-                const double MULT_FACTOR = 1000000;
+            else {
+                static_assert(std::is_floating_point<T>::value, "T must be an arithmetic type");
+                static_assert(sizeof(CONVERT_TO_T) >= 8, "CONVERT_TO_T must be at least 64 bit");
 
-                // Constructing the input
+                // Constructing the input, the ground distance is already converted to CONVERT_TO_T
                 const size_t N = P.size();
                 std::vector<CONVERT_TO_T> iPOrig(N);
                 std::vector<CONVERT_TO_T> iQOrig(N);
                 std::vector<CONVERT_TO_T> iP(N);
                 std::vector<CONVERT_TO_T> iQ(N);
-                std::vector<std::vector<CONVERT_TO_T>> iC(N, std::vector<CONVERT_TO_T>(N));
-                std::vector<std::vector<CONVERT_TO_T>> iF(N, std::vector<CONVERT_TO_T>(N));
+                std::vector<std::vector<CONVERT_TO_T>> iF;
+                if (FLOW_TYPE != NO_FLOW) {
+                    iF.assign(N, std::vector<CONVERT_TO_T>(N));
+                }
 
                 // Converting to CONVERT_TO_T
                 double sumP = 0.0;
                 double sumQ = 0.0;
-                double imaxC = C[0][0];
                 for (size_t i = 0; i < N; ++i) {
                     sumP += POrig[i];
                     sumQ += QOrig[i];
-                    for (size_t j = 0; j < N; ++j) {
-                        if (C[i][j] > imaxC)
-                            imaxC = C[i][j];
-                    }
                 }
                 double minSum = std::min(sumP, sumQ);
                 double maxSum = std::max(sumP, sumQ);
                 double PQnormFactor = MULT_FACTOR / maxSum;
-                double CnormFactor = MULT_FACTOR / imaxC;
                 for (size_t i = 0; i < N; ++i) {
                     iPOrig[i] = static_cast<CONVERT_TO_T>(floor(POrig[i] * PQnormFactor + 0.5));
                     iQOrig[i] = static_cast<CONVERT_TO_T>(floor(QOrig[i] * PQnormFactor + 0.5));
                     iP[i] = static_cast<CONVERT_TO_T>(floor(P[i] * PQnormFactor + 0.5));
                     iQ[i] = static_cast<CONVERT_TO_T>(floor(Q[i] * PQnormFactor + 0.5));
-                    for (size_t j = 0; j < N; ++j) {
-                        iC[i][j] = static_cast<CONVERT_TO_T>(floor(C[i][j] * CnormFactor + 0.5));
-                        if (FLOW_TYPE != NO_FLOW) {
+                    if (FLOW_TYPE != NO_FLOW) {
+                        for (size_t j = 0; j < N; ++j) {
                             iF[i][j] = static_cast<CONVERT_TO_T>(floor(((*F)[i][j]) * PQnormFactor + 0.5));
                         }
                     }
                 }
 
                 // computing distance without extra mass penalty
-                //            double dist = emd_impl<std::vector<CONVERT_TO_T>, FLOW_TYPE>()(iPOrig, iQOrig, iP, iQ, iC,
-                //            imaxC, 0, &iF, abs_diff_sum_P_sum_Q);
-                double dist = emd_impl<std::vector<CONVERT_TO_T>, FLOW_TYPE>()(iPOrig, iQOrig, iP, iQ, iC, 0,
-                    &iF);  // replaced by Max F
+                double dist = emd_impl_integral_types<std::vector<CONVERT_TO_T>, FLOW_TYPE>()(iPOrig, iQOrig, iP, iQ,
+                    ground, 0, &iF, workspace);
                 // unnormalize
                 dist = dist / PQnormFactor;
-                dist = dist / CnormFactor;
+                dist = dist / ground.norm_factor;
 
                 // adding extra mass penalty
                 if (extra_mass_penalty == -1)
-                    extra_mass_penalty = imaxC;
+                    extra_mass_penalty = ground.max_distance;
                 dist += (maxSum - minSum) * extra_mass_penalty;
 
                 // converting flow to double
@@ -1073,44 +1073,167 @@ namespace EMD_details {
 //     return (*this)(Pc, Qc, C, extra_mass_penalty, F);
 // }
 template <typename V>
-inline auto EMD<V>::default_ground_matrix(std::size_t rows, std::size_t cols) const
-    -> std::vector<std::vector<value_type>>
+void EMD<V>::prepare_ground() const
 {
-    std::vector<std::vector<value_type>> matrix(rows, std::vector<value_type>(cols, 0));
-    if (rows == 1 && cols == 1) {
-        matrix[0][0] = 1;
-        return matrix;
+    using I = typename EMD_details::ground_distance<V>::integral_type;
+    const std::size_t N = C.size();
+
+    ground = EMD_details::ground_distance<V>();
+    if (N == 0) {
+        return;
+    }
+
+    V maxC = C[0][0];
+    for (std::size_t i = 0; i < N; ++i) {
+        for (std::size_t j = 0; j < N; ++j) {
+            assert(C[i][j] >= 0);
+            maxC = std::max(maxC, C[i][j]);
+        }
+    }
+    ground.max_distance = maxC;
+    if (!std::is_integral<V>::value) {
+        ground.norm_factor = EMD_details::MULT_FACTOR / double(maxC);
+    }
+
+    ground.C.assign(N, std::vector<I>(N));
+    ground.CT.assign(N, std::vector<I>(N));
+    for (std::size_t i = 0; i < N; ++i) {
+        for (std::size_t j = 0; j < N; ++j) {
+            I value;
+            if constexpr (std::is_integral<V>::value) {
+                value = C[i][j];
+            } else {
+                value = static_cast<I>(floor(C[i][j] * ground.norm_factor + 0.5));
+            }
+            ground.C[i][j] = value;
+            ground.CT[j][i] = value;
+            ground.maxC = std::max(ground.maxC, value);
+        }
+    }
+
+    // entries equal to the maximum are served by the threshold node
+    ground.edges.resize(N);
+    ground.edgesT.resize(N);
+    for (std::size_t i = 0; i < N; ++i) {
+        for (std::size_t j = 0; j < N; ++j) {
+            if (ground.C[i][j] != ground.maxC) {
+                ground.edges[i].push_back(j);
+            }
+            if (ground.CT[i][j] != ground.maxC) {
+                ground.edgesT[i].push_back(j);
+            }
+        }
     }
-    int t = std::min(rows, cols) / 2;  // by default, ground distance saturates at the half of maximum distance possible
 
-    for (size_t i = 0; i < rows; i++) {
-        for (size_t j = 0; j < cols; j++) {
-            matrix[i][j] = std::min(t,
-                std::abs((int)(i - j)));  // non-square matrix is supported here, BUT IS NOT SUPPORTED IN THE EMD IMPL
+    ground.row_min.assign(N, N > 1 ? maxC : 0);
+    ground.col_min.assign(N, N > 1 ? maxC : 0);
+    for (std::size_t i = 0; i < N; ++i) {
+        for (std::size_t j = 0; j < N; ++j) {
+            if (i != j) {
+                ground.row_min[i] = std::min(ground.row_min[i], C[i][j]);
+                ground.col_min[j] = std::min(ground.col_min[j], C[i][j]);
+            }
         }
     }
-    return matrix;
 }
+
 template <typename V>
-template <typename Container>
-auto EMD<V>::operator()(const Container& Pc, const Container& Qc) const -> distance_type
-// const std::vector<std::vector<typename Container::value_type>> &C,
-// //typename Container::value_type maxC, // disabled my Max F
-// typename Container::value_type extra_mass_penalty,
-// std::vector<std::vector<typename Container::value_type>> *F) const
+void EMD<V>::prepare_positions(const std::vector<std::vector<value_type>>& positions)
+{
+    const std::size_t N = positions.size();
+    const std::size_t dims = N == 0 ? 0 : positions[0].size();
+
+    // largest scale of the Euclidean distance not exceeding the ground distance, coincident bins are skipped
+    double scale = std::numeric_limits<double>::max();
+    for (std::size_t i = 0; i < N; ++i) {
+        for (std::size_t j = i + 1; j < N; ++j) {
+            double sum = 0;
+            for (std::size_t d = 0; d < dims; ++d) {
+                double diff = double(positions[i][d]) - double(positions[j][d]);
+                sum += diff * diff;
+            }
+            if (sum > 0) {
+                scale = std::min(scale, double(std::min(C[i][j], C[j][i])) / std::sqrt(sum));
+            }
+        }
+    }
+    if (scale == std::numeric_limits<double>::max()) {
+        scale = 0;
+    }
+    ground.geometric_scale = scale;
+
+    std::vector<double> mean(dims, 0);
+    for (auto& position : positions) {
+        for (std::size_t d = 0; d < dims; ++d) {
+            mean[d] += double(position[d]) / N;
+        }
+    }
+    ground.positions.assign(N, std::vector<double>(dims));
+    ground.radius = 0;
+    for (std::size_t i = 0; i < N; ++i) {
+        double sum = 0;
+        for (std::size_t d = 0; d < dims; ++d) {
+            ground.positions[i][d] = double(positions[i][d]) - mean[d];
+            sum += ground.positions[i][d] * ground.positions[i][d];
+        }
+        ground.radius = std::max(ground.radius, std::sqrt(sum));
+    }
+
+    ground.axis_order.assign(dims, std::vector<std::size_t>(N));
+    for (std::size_t d = 0; d < dims; ++d) {
+        auto& order = ground.axis_order[d];
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(),
+            [&](std::size_t a, std::size_t b) { return ground.positions[a][d] < ground.positions[b][d]; });
+    }
+}
+
+template <typename V>
+auto EMD<V>::euclidean(const std::vector<std::vector<value_type>>& positions, value_type threshold,
+    const value_type& extra_mass_penalty_) -> EMD
+{
+    const std::size_t N = positions.size();
+    std::vector<std::vector<value_type>> C_(N, std::vector<value_type>(N, 0));
+    for (std::size_t i = 0; i < N; ++i) {
+        for (std::size_t j = 0; j < N; ++j) {
+            double sum = 0;
+            for (std::size_t d = 0; d < positions[i].size(); ++d) {
+                double diff = double(positions[i][d]) - double(positions[j][d]);
+                sum += diff * diff;
+            }
+            C_[i][j] = value_type(std::sqrt(sum));
+        }
+    }
+    EMD result(EMD_details::thresholded_ground_matrix(std::move(C_), threshold), extra_mass_penalty_);
+    result.prepare_positions(positions);
+    return result;
+}
+
+template <typename V>
+void EMD<V>::init_ground(std::size_t size) const
 {
     if (!is_C_initialized) {
-        C = default_ground_matrix(Pc.size(), Pc.size());
+        C = EMD_details::default_ground_matrix<value_type>(size, size);
         is_C_initialized = true;
+        prepare_ground();
     }
+}
+
+template <typename V>
+template <typename Container>
+auto EMD<V>::operator()(const Container& Pc, const Container& Qc) const -> distance_type
+{
+    init_ground(Pc.size());
+    workspace_type workspace;
+    return solve(Pc, Qc, workspace);
+}
 
+template <typename V>
+template <typename Container>
+auto EMD<V>::solve(const Container& Pc, const Container& Qc, workspace_type& workspace) const -> distance_type
+{
     using T = value_type;
     const EMD_details::FLOW_TYPE_T FLOW_TYPE = EMD_details::NO_FLOW;
-    //    // if maxC is not given seperatly // disabled by Max F when rolled back to original version
-    //    if (maxC == std::numeric_limits<T>::min())
-    //    {
-    //        maxC = EMD_details::max_in_distance_matrix(C);
-    //    }
     if (FLOW_TYPE != EMD_details::NO_FLOW) {
         EMD_details::fillFWithZeros(*F);
     }
@@ -1139,34 +1262,112 @@ auto EMD<V>::operator()(const Container& Pc, const Container& Qc) const -> dista
         }
     }
 
-    //    // need to swap? // disabled by Max F
-    //    T sum_P = 0;
-    //    T sum_Q = 0;
-    //    {
-    //        for (size_t i = 0; i < Pc.size(); ++i)
-    //            sum_P += Pc[i];
-    //    }
-    //    {
-    //        for (size_t i = 0; i < Qc.size(); ++i)
-    //            sum_Q += Qc[i];
-    //    }
-
-    //    // need to swap?
-    //    if (sum_Q > sum_P)
-    //    {
-    //        std::swap(P, Q);
-    //    }
-
-    //    T abs_diff_sum_P_sum_Q = std::abs(sum_P - sum_Q);
-    //    T abs_diff_sum_P_sum_Q = 0; // temporary added by MAx F // TODO remove
-
-    //    return EMD_details::emd_impl<std::vector<T>, FLOW_TYPE>()(Pc, Qc, P, Q, C, maxC, extra_mass_penalty, F,
-    //    abs_diff_sum_P_sum_Q);
-    return EMD_details::emd_impl<Container, FLOW_TYPE>()(Pc, Qc, P, Q, C, extra_mass_penalty,
-        F);  // turned to original state by Max F
+    return EMD_details::emd_impl<Container, FLOW_TYPE>()(Pc, Qc, P, Q, ground, extra_mass_penalty, F,
+        workspace);  // turned to original state by Max F
 
 }  // EMD
 
+template <typename V>
+template <typename Container>
+auto EMD<V>::operator()(const Container& Pc, const Container& Qc, distance_type threshold) const -> distance_type
+{
+    distance_type bound = lower_bound(Pc, Qc);
+    if (bound > threshold) {
+        return bound;
+    }
+    return (*this)(Pc, Qc);
+}
+
+template <typename V>
+template <typename Container>
+auto EMD<V>::batch(const Container& query, const std::vector<Container>& candidates, distance_type threshold) const
+    -> std::vector<distance_type>
+{
+    init_ground(query.size());
+    workspace_type workspace;
+    std::vector<distance_type> result;
+    result.reserve(candidates.size());
+    for (auto& candidate : candidates) {
+        distance_type bound = lower_bound(query, candidate);
+        result.push_back(bound > threshold ? bound : solve(query, candidate, workspace));
+    }
+    return result;
+}
+
+template <typename V>
+template <typename Container>
+auto EMD<V>::lower_bound(const Container& Pc, const Container& Qc) const -> distance_type
+{
+    init_ground(Pc.size());
+
+    double sum_P = 0;
+    double sum_Q = 0;
+    double leave_cost = 0;
+    double arrive_cost = 0;
+    auto itP = std::begin(Pc);
+    auto itQ = std::begin(Qc);
+    for (std::size_t i = 0; itP != std::end(Pc); ++i, ++itP, ++itQ) {
+        double p = *itP;
+        double q = *itQ;
+        sum_P += p;
+        sum_Q += q;
+        // mass left after the pre-flow inside the bin
+        if (p > q) {
+            leave_cost += (p - q) * ground.row_min[i];
+        } else {
+            arrive_cost += (q - p) * ground.col_min[i];
+        }
+    }
+
+    // all the mass of the lighter histogram is transported, the extra mass is penalized
+    double penalty = extra_mass_penalty == -1 ? double(ground.max_distance) : double(extra_mass_penalty);
+    double transport = sum_P >= sum_Q ? arrive_cost : leave_cost;
+    double bound = transport + std::abs(sum_P - sum_Q) * penalty;
+
+    if (ground.geometric_scale > 0) {
+        // the transported mass differs from one of the histograms by the extra mass, which moves the centered
+        // position sum by at most extra * radius and the projected distributions by extra * extent of the axis
+        const double extra = std::abs(sum_P - sum_Q);
+        const std::size_t dims = ground.axis_order.size();
+        std::vector<double> diff(dims, 0);
+        std::vector<double> mass(Pc.size());
+        itP = std::begin(Pc);
+        itQ = std::begin(Qc);
+        for (std::size_t i = 0; itP != std::end(Pc); ++i, ++itP, ++itQ) {
+            mass[i] = double(*itP) - double(*itQ);
+            for (std::size_t d = 0; d < dims; ++d) {
+                diff[d] += mass[i] * ground.positions[i][d];
+            }
+        }
+        double norm = 0;
+        for (auto value : diff) {
+            norm += value * value;
+        }
+        double geometric = std::sqrt(norm) - extra * ground.radius;
+
+        // EMD on an axis is the integral of the difference of cumulative distributions
+        for (std::size_t d = 0; d < dims; ++d) {
+            const auto& order = ground.axis_order[d];
+            double projected = 0;
+            double cdf_diff = 0;
+            for (std::size_t k = 0; k + 1 < order.size(); ++k) {
+                cdf_diff += mass[order[k]];
+                projected += std::abs(cdf_diff) * (ground.positions[order[k + 1]][d] - ground.positions[order[k]][d]);
+            }
+            const double extent = ground.positions[order.back()][d] - ground.positions[order.front()][d];
+            geometric = std::max(geometric, projected - extra * extent);
+        }
+        bound = std::max(bound, ground.geometric_scale * std::max(geometric, 0.0) + extra * penalty);
+    }
+
+    if (!std::is_integral<V>::value) {
+        // the solver rounds every bin mass and the ground distance to MULT_FACTOR units
+        double slack = (Pc.size() + 1) * std::max(sum_P, sum_Q) * ground.max_distance / EMD_details::MULT_FACTOR;
+        bound = std::max(bound - slack, 0.0);
+    }
+    return distance_type(bound);
+}
+
 }  // namespace metric
 
 #endif
@@ -7,10 +7,61 @@ Copyright (c) 2018 Michael Welsch
 */
 #ifndef _METRIC_DISTANCE_K_STRUCTURED_EMD_HPP
 #define _METRIC_DISTANCE_K_STRUCTURED_EMD_HPP
+#include <cstddef>
+#include <limits>
+#include <type_traits>
 #include <vector>
 
 namespace metric {
 
+namespace EMD_details {
+
+    /**
+     * @brief Ground distance matrix prepared for the transportation solver.
+     *
+     * Built once per EMD object: the matrix converted to the integral solver type, its transposition, and for every
+     * row and column the entries below the maximum (threshold) distance, which are the only edges of the flow network.
+     */
+    template <typename V>
+    struct ground_distance {
+        using integral_type = typename std::conditional<std::is_integral<V>::value, V, long long>::type;
+
+        std::vector<std::vector<integral_type>> C;
+        std::vector<std::vector<integral_type>> CT;
+        integral_type maxC = 0;
+        std::vector<std::vector<std::size_t>> edges;
+        std::vector<std::vector<std::size_t>> edgesT;
+
+        // ground distance units
+        V max_distance = 0;
+        double norm_factor = 1;
+        // cheapest way to leave a bin and to arrive to a bin, used for lower bounds
+        std::vector<V> row_min;
+        std::vector<V> col_min;
+
+        // bin positions centered at their mean, the ground distance is not below geometric_scale times
+        // the Euclidean distance of positions, used for the centroid and projected lower bounds
+        std::vector<std::vector<double>> positions;
+        // bins ordered along every coordinate axis
+        std::vector<std::vector<std::size_t>> axis_order;
+        double geometric_scale = 0;
+        double radius = 0;
+    };
+
+    /**
+     * @brief Default ground distance |i - j| of bins, saturated at the half of maximum distance possible
+     *
+     * @param rows, cols size of the matrix
+     * @return ground distance matrix
+     */
+    template <typename V>
+    std::vector<std::vector<V>> default_ground_matrix(std::size_t rows, std::size_t cols);
+
+    template <typename T>
+    struct flow_workspace;
+
+}  // namespace EMD_details
+
 /**
  * @class EMD
  *
@@ -33,6 +84,7 @@ public:
         : C(C_)
         , is_C_initialized(true)
     {
+        prepare_ground();
     }
 
     /**
@@ -44,11 +96,12 @@ public:
      */
     EMD(std::size_t rows, std::size_t cols, const value_type& extra_mass_penalty_ = -1,
         std::vector<std::vector<value_type>>* F_ = nullptr)
-        : C(default_ground_matrix(rows, cols))
+        : C(EMD_details::default_ground_matrix<value_type>(rows, cols))
         , extra_mass_penalty(extra_mass_penalty_)
         , F(F_)
         , is_C_initialized(true)
     {
+        prepare_ground();
     }
 
     /**
@@ -65,8 +118,24 @@ public:
         , F(F_)
         , is_C_initialized(true)
     {
+        prepare_ground();
     }
 
+    /**
+     * @brief Construct a new EMD object with Euclidean ground distance between bins saturated at threshold
+     *
+     * As in FastEMD ground distances equal to the threshold are served by the threshold node instead of edges
+     * of the flow network. Bin positions add the centroid and projected bounds to lower_bound(), so the threshold
+     * call and batch() skip more candidates.
+     *
+     * @param positions coordinates of every bin
+     * @param threshold saturation of the ground distance
+     * @param extra_mass_penalty_
+     * @return EMD object
+     */
+    static EMD euclidean(const std::vector<std::vector<value_type>>& positions,
+        value_type threshold = std::numeric_limits<value_type>::max(), const value_type& extra_mass_penalty_ = -1);
+
     /**
      * @brief Calculate EMD distance between Pc and Qc
      *
@@ -78,6 +147,48 @@ public:
     template <typename Container>
     distance_type operator()(const Container& Pc, const Container& Qc) const;
 
+    /**
+     * @brief Calculate EMD distance between Pc and Qc, skip the solver when the lower bound exceeds threshold
+     *
+     * @tparam Container
+     * @param Pc
+     * @param Qc
+     * @param threshold
+     * @return EMD distance if the lower bound is not greater than threshold, otherwise the lower bound
+     */
+    template <typename Container>
+    distance_type operator()(const Container& Pc, const Container& Qc, distance_type threshold) const;
+
+    /**
+     * @brief Calculate EMD distances between one query and many candidates, the ground distance preparation and
+     * the buffers of the flow solver are shared
+     *
+     * @tparam Container
+     * @param query
+     * @param candidates
+     * @param threshold candidates with lower bound greater than threshold are not solved, see operator()
+     * @return distances from query to every candidate
+     */
+    template <typename Container>
+    std::vector<distance_type> batch(const Container& query, const std::vector<Container>& candidates,
+        distance_type threshold = std::numeric_limits<distance_type>::max()) const;
+
+    /**
+     * @brief Calculate lower bound of EMD distance in O(N) for any ground distance matrix
+     *
+     * Mass left after the zero cost flow inside every bin has to move at least to the closest other bin.
+     * With bin positions of euclidean() the bound is raised to the distance between the mass weighted position sums
+     * and to the EMD of positions projected on every axis.
+     * For floating point values the bound is decreased by the rounding error of the solver.
+     *
+     * @tparam Container
+     * @param Pc
+     * @param Qc
+     * @return lower bound of EMD distance between Pc and Qc
+     */
+    template <typename Container>
+    distance_type lower_bound(const Container& Pc, const Container& Qc) const;
+
     EMD(EMD&&) = default;
     EMD(const EMD&) = default;
     EMD& operator=(const EMD&) = default;
@@ -88,8 +199,15 @@ private:
     value_type extra_mass_penalty = -1;
     std::vector<std::vector<value_type>>* F = nullptr;
     mutable bool is_C_initialized = false;
+    mutable EMD_details::ground_distance<value_type> ground;
 
-    std::vector<std::vector<value_type>> default_ground_matrix(std::size_t rows, std::size_t cols) const;
+    using workspace_type = EMD_details::flow_workspace<typename EMD_details::ground_distance<value_type>::integral_type>;
+
+    void prepare_ground() const;
+    template <typename Container>
+    distance_type solve(const Container& Pc, const Container& Qc, workspace_type& workspace) const;
+    void init_ground(std::size_t size) const;
+    void prepare_positions(const std::vector<std::vector<value_type>>& positions);
 };
 
 }  // namespace metric
@@ -8,56 +8,193 @@ Copyright (c) 2018 Michael Welsch
 
 #include "Edit.hpp"
 #include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <type_traits>
 #include <vector>
 
 namespace metric {
 
-template <typename V>
-template <typename Container>
-auto Edit<V>::operator()(const Container& str1, const Container& str2) const -> distance_type
-{
-    size_t sizeA = str1.size();
-    size_t sizeB = str2.size();
+namespace Edit_details {
+
+    template <typename T>
+    constexpr bool is_byte_v = std::is_integral_v<T> && sizeof(T) == 1;
+
+    /**
+     * bit-parallel edit distance (Myers 1999, multi-word blocks by Hyyro 2003).
+     * Columns of the DP matrix are encoded as bit vectors of vertical deltas, one word per 64 pattern characters.
+     **/
+    template <typename Container>
+    int bit_parallel(const Container& pattern, const Container& text, int max_distance)
+    {
+        const std::size_t m = pattern.size();
+        const std::size_t n = text.size();
+        const std::size_t blocks = (m + 63) / 64;
+
+        // match masks of every byte value for every block, all zero between calls
+        thread_local std::vector<std::uint64_t> peq;
+        thread_local std::vector<std::uint64_t> P;
+        thread_local std::vector<std::uint64_t> M;
+        if (peq.size() < 256 * blocks) {
+            peq.resize(256 * blocks, 0);
+        }
+        for (std::size_t i = 0; i < m; i++) {
+            peq[static_cast<unsigned char>(pattern[i]) * blocks + i / 64] |= std::uint64_t(1) << (i % 64);
+        }
+        P.assign(blocks, ~std::uint64_t(0));
+        M.assign(blocks, 0);
+
+        const std::uint64_t high = std::uint64_t(1) << 63;
+        const std::uint64_t last = std::uint64_t(1) << ((m - 1) % 64);
+        int score = int(m);
+
+        for (std::size_t j = 0; j < n; j++) {
+            const std::uint64_t* eq = &peq[static_cast<unsigned char>(text[j]) * blocks];
+            // horizontal delta entering the block, first row of the matrix grows by one per column
+            int carry = 1;
+            for (std::size_t b = 0; b < blocks; b++) {
+                std::uint64_t Pv = P[b];
+                std::uint64_t Mv = M[b];
+                std::uint64_t Eq = eq[b];
 
-    // TODO: check empty strings.
+                std::uint64_t Xv = Eq | Mv;
+                if (carry < 0) {
+                    Eq |= 1;
+                }
+                std::uint64_t Xh = (((Eq & Pv) + Pv) ^ Pv) | Eq;
+                std::uint64_t Ph = Mv | ~(Xh | Pv);
+                std::uint64_t Mh = Pv & Xh;
 
-    std::vector<int> D0(sizeB + 1);
-    std::vector<int> Di(sizeB + 1);
+                std::uint64_t top = b + 1 == blocks ? last : high;
+                int hout = (Ph & top) ? 1 : ((Mh & top) ? -1 : 0);
 
-    int C1, C2, C3;
+                Ph <<= 1;
+                Mh <<= 1;
+                if (carry < 0) {
+                    Mh |= 1;
+                } else if (carry > 0) {
+                    Ph |= 1;
+                }
+                P[b] = Mh | ~(Xv | Ph);
+                M[b] = Ph & Xv;
+                carry = hout;
+            }
+            score += carry;
 
-    // first element
-    D0[0] = 0;
+            // the last row can decrease by at most one per remaining column
+            if (score - int(n - j - 1) > max_distance) {
+                score -= int(n - j - 1);
+                break;
+            }
+        }
 
-    // first row
-    for (std::size_t j = 0; j < sizeB + 1; j++) {
-        // editDistance[0][j] = j;
-        D0[j] = j;
+        for (std::size_t i = 0; i < m; i++) {
+            peq[static_cast<unsigned char>(pattern[i]) * blocks + i / 64] = 0;
+        }
+        return score;
     }
 
-    // second-->last row
-    for (std::size_t i = 1; i < sizeA + 1; i++) {
-        // every first element in row
-        Di[0] = i;
-
-        // remaining elements in row
-        for (std::size_t j = 1; j < sizeB + 1; j++) {
-            if (str1[i - 1] == str2[j - 1]) {
-                Di[j] = D0[j - 1];
-            } else {
-                C1 = D0[j];
-                C2 = Di[j - 1];
-                C3 = D0[j - 1];
-                Di[j] = (C1 < ((C2 < C3) ? C2 : C3)) ? C1 : ((C2 < C3) ? C2 : C3);  // Di[j] = std::min({C1,C2,C3});
-                Di[j] += 1;
+    /**
+     * two-row dynamic programming restricted to the diagonal band |i - j| <= max_distance (Ukkonen 1985).
+     * Cells next to the band are set to max_distance + 1, a lower bound of their true values.
+     **/
+    template <typename Container>
+    int dynamic(const Container& str1, const Container& str2, int max_distance)
+    {
+        const int sizeA = int(str1.size());
+        const int sizeB = int(str2.size());
+        const int k = max_distance;
+        const int outside = k + 1;
+
+        thread_local std::vector<int> D0;
+        thread_local std::vector<int> Di;
+        D0.resize(sizeB + 1);
+        Di.resize(sizeB + 1);
+
+        int C1, C2, C3;
+
+        // first row
+        for (int j = 0; j <= std::min(sizeB, k); j++) {
+            // editDistance[0][j] = j;
+            D0[j] = j;
+        }
+
+        // second-->last row
+        for (int i = 1; i < sizeA + 1; i++) {
+            const int lo = std::max(1, i - k);
+            const int hi = std::min(sizeB, i + k);
+
+            // every first element in row
+            Di[0] = i;
+            if (lo > 1) {
+                Di[lo - 1] = outside;
+            }
+            if (hi == i + k) {
+                D0[hi] = outside;
+            }
+
+            // remaining elements in row
+            int row_min = lo == 1 ? i : outside;
+            for (int j = lo; j <= hi; j++) {
+                if (str1[i - 1] == str2[j - 1]) {
+                    Di[j] = D0[j - 1];
+                } else {
+                    C1 = D0[j];
+                    C2 = Di[j - 1];
+                    C3 = D0[j - 1];
+                    Di[j] = (C1 < ((C2 < C3) ? C2 : C3)) ? C1 : ((C2 < C3) ? C2 : C3);  // Di[j] = std::min({C1,C2,C3});
+                    Di[j] += 1;
+                }
+                row_min = std::min(row_min, Di[j]);
+            }
+            std::swap(D0, Di);
+
+            if (row_min > k) {
+                return outside;
             }
         }
-        std::swap(D0, Di);
+
+        return D0[sizeB];  // +1 -1
     }
 
-    distance_type rvalue = D0[sizeB];  // +1 -1
+}  // namespace Edit_details
+
+template <typename V>
+template <typename Container>
+auto Edit<V>::operator()(const Container& str1, const Container& str2) const -> distance_type
+{
+    return operator()(str1, str2, std::numeric_limits<distance_type>::max());
+}
 
-    return rvalue;
+template <typename V>
+template <typename Container>
+auto Edit<V>::operator()(const Container& str1, const Container& str2, distance_type max_distance) const
+    -> distance_type
+{
+    using T = std::decay_t<decltype(str1[0])>;
+
+    const int sizeA = int(str1.size());
+    const int sizeB = int(str2.size());
+
+    if (sizeA == 0 || sizeB == 0) {
+        return sizeA + sizeB;
+    }
+    // the distance is at least the difference and at most the maximum of the lengths
+    if (std::abs(sizeA - sizeB) > max_distance) {
+        return std::abs(sizeA - sizeB);
+    }
+    max_distance = std::min(max_distance, std::max(sizeA, sizeB));
+
+    if constexpr (Edit_details::is_byte_v<T>) {
+        // the shorter string is the pattern, it defines the number of words per column
+        if (sizeA <= sizeB) {
+            return Edit_details::bit_parallel(str1, str2, max_distance);
+        }
+        return Edit_details::bit_parallel(str2, str1, max_distance);
+    } else {
+        return Edit_details::dynamic(str1, str2, max_distance);
+    }
 }
 
 }  // namespace metric
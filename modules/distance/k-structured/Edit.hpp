@@ -14,6 +14,10 @@ namespace metric {
 /**
  * @class Edit
  * @breaf Edit distance(for strings)
+ *
+ * Strings of byte sized characters are compared with the bit-parallel algorithm of Myers (multi-word version of Hyyro
+ * for strings longer than 64 characters), other containers with the classic dynamic programming.
+ *
  * @tparam
  */
 template <typename V>
@@ -32,6 +36,20 @@ struct Edit {
     template <typename Container>
     distance_type operator()(const Container& str1, const Container& str2) const;
 
+    /**
+     * @brief Calculate Edit distance bounded by max_distance
+     *
+     * Calculation stops as soon as the distance is known to exceed max_distance, useful for range and knn search.
+     *
+     * @tparam Container
+     * @param str1
+     * @param str2
+     * @param max_distance
+     * @return Edit distance if it is not greater than max_distance, otherwise some lower bound greater than max_distance
+     */
+    template <typename Container>
+    distance_type operator()(const Container& str1, const Container& str2, distance_type max_distance) const;
+
     /**
      * @brief calculate Edit distance for null terminated strings
      *
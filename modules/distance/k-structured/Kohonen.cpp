@@ -9,11 +9,88 @@ Copyright (c) 2019 PANDA Team
 #include "Kohonen.hpp"
 #include "../../../3rdparty/blaze/Blaze.h"
 #include "../../../modules/utils/poor_mans_quantum.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <thread>
 #include <vector>
 
 namespace metric {
 
+namespace Kohonen_details {
+
+	/**
+	 * @brief weighted graph in compressed sparse row format, only positive weights are edges
+	 */
+	template <typename D>
+	struct csr_graph {
+		std::vector<size_t> offsets;
+		std::vector<size_t> columns;
+		std::vector<D> weights;
+	};
+
+	template <typename D>
+	csr_graph<D> to_csr(const blaze::CompressedMatrix<D>& matrix)
+	{
+		csr_graph<D> graph;
+		graph.offsets.reserve(matrix.rows() + 1);
+		graph.offsets.push_back(0);
+		for (size_t i = 0; i < matrix.rows(); ++i)
+		{
+			for (auto it = matrix.begin(i); it != matrix.end(i); ++it)
+			{
+				if (it->value() > 0)
+				{
+					graph.columns.push_back(it->index());
+					graph.weights.push_back(it->value());
+				}
+			}
+			graph.offsets.push_back(graph.columns.size());
+		}
+		return graph;
+	}
+
+	/**
+	 * @brief Dijkstra with binary heap from one source, unreachable nodes get infinite distance and predecessor -1
+	 */
+	template <typename D>
+	void shortest_paths(const csr_graph<D>& graph, size_t source, std::vector<D>& distances, std::vector<int>& predecessor)
+	{
+		std::fill(distances.begin(), distances.end(), std::numeric_limits<D>::infinity());
+		std::fill(predecessor.begin(), predecessor.end(), -1);
+		distances[source] = 0;
+
+		using entry = std::pair<D, size_t>;
+		std::priority_queue<entry, std::vector<entry>, std::greater<entry>> queue;
+		queue.emplace(D(0), source);
+		while (!queue.empty())
+		{
+			auto [distance, node] = queue.top();
+			queue.pop();
+			if (distance > distances[node])
+			{
+				// outdated entry
+				continue;
+			}
+			for (size_t e = graph.offsets[node]; e < graph.offsets[node + 1]; ++e)
+			{
+				size_t next = graph.columns[e];
+				D candidate = distance + graph.weights[e];
+				if (candidate < distances[next])
+				{
+					distances[next] = candidate;
+					predecessor[next] = int(node);
+					queue.emplace(candidate, next);
+				}
+			}
+		}
+	}
+
+}  // namespace Kohonen_details
+
 template <typename D, typename Sample, typename Graph, typename Metric, typename Distribution>
 Kohonen<D, Sample, Graph, Metric, Distribution>::Kohonen(
 	metric::SOM<Sample, Graph, Metric, Distribution>&& som_model,
@@ -92,22 +169,84 @@ auto Kohonen<D, Sample, Graph, Metric, Distribution>::operator()(const Sample& s
     -> distance_type
 {
 	// then we calculate distributions over SOM space for samples	
-	auto bmu_1 = som_model.BMU(sample_1);
-	auto bmu_2 = som_model.BMU(sample_2);
-
-	std::vector<Sample> nodes = som_model.get_weights();
+	auto [bmu_1, to_nearest_1] = bmu(sample_1);
+	auto [bmu_2, to_nearest_2] = bmu(sample_2);
 	
 	auto direct_distance = metric(sample_1, sample_2);
-	
-	double to_nearest_1 = metric(sample_1, nodes[bmu_1]);
-	double to_nearest_2 = metric(nodes[bmu_2], sample_2);
 
-	if (direct_distance < to_nearest_1 + to_nearest_2)
+	if (direct_distance < double(to_nearest_1) + double(to_nearest_2))
 	{
 		return direct_distance;
 	}
 
-	return to_nearest_1 + distance_matrix[bmu_1][bmu_2] + to_nearest_2;
+	return double(to_nearest_1) + distance_matrix[bmu_1][bmu_2] + double(to_nearest_2);
+}
+
+
+template <typename D, typename Sample, typename Graph, typename Metric, typename Distribution>
+std::pair<size_t, D> Kohonen<D, Sample, Graph, Metric, Distribution>::find_bmu(const Sample& sample) const
+{
+	// same scan as SOM::BMU, which does not return the distance
+	const auto& nodes = som_model.get_weights();
+	D min_distance = std::numeric_limits<D>::max();
+	size_t index = 0;
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		D distance = metric(sample, nodes[i]);
+		if (distance < min_distance)
+		{
+			min_distance = distance;
+			index = i;
+		}
+	}
+	return { index, min_distance };
+}
+
+
+template <typename D, typename Sample, typename Graph, typename Metric, typename Distribution>
+std::pair<size_t, D> Kohonen<D, Sample, Graph, Metric, Distribution>::bmu(const Sample& sample) const
+{
+	size_t hash = sample.size();
+	for (auto& value : sample)
+	{
+		hash ^= std::hash<typename Sample::value_type>()(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(cache->mutex);
+		auto found = cache->entries.find(hash);
+		if (found != cache->entries.end())
+		{
+			for (auto& [record, index, distance] : found->second)
+			{
+				if (record == sample)
+				{
+					return { index, distance };
+				}
+			}
+		}
+	}
+
+	auto result = find_bmu(sample);
+
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	if (cache->size >= cache_capacity)
+	{
+		cache->entries.clear();
+		cache->size = 0;
+	}
+	cache->entries[hash].emplace_back(sample, result.first, result.second);
+	++cache->size;
+	return result;
+}
+
+
+template <typename D, typename Sample, typename Graph, typename Metric, typename Distribution>
+void Kohonen<D, Sample, Graph, Metric, Distribution>::clear_cache() const
+{
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	cache->entries.clear();
+	cache->size = 0;
 }
 
 
@@ -121,16 +260,19 @@ void Kohonen<D, Sample, Graph, Metric, Distribution>::calculate_distance_matrix(
 		make_reverese_diffusion(samples);
 	}
 
-	auto matrix = som_model.get_graph().get_matrix();
+	const auto& matrix = som_model.get_graph().get_matrix();
 	blaze::CompressedMatrix<D> blaze_matrix(matrix.rows(),  matrix.columns());
 	for (size_t i = 0; i < matrix.rows(); ++i)
 	{
-		for (size_t j = i + 1; j < matrix.columns(); ++j) 
+		// edges of the node, visited in the order of columns
+		for (auto it = matrix.begin(i); it != matrix.end(i); ++it)
 		{
-			if (matrix(i, j) > 0)
+			size_t j = it->index();
+			if (j > i && it->value() > 0)
 			{
-				blaze_matrix(i, j) = metric(nodes[i], nodes[j]);
-				blaze_matrix(j, i) = metric(nodes[i], nodes[j]);
+				auto distance = metric(nodes[i], nodes[j]);
+				blaze_matrix(i, j) = distance;
+				blaze_matrix(j, i) = distance;
 			}
 		}
 	}
@@ -140,15 +282,33 @@ void Kohonen<D, Sample, Graph, Metric, Distribution>::calculate_distance_matrix(
 		sparcify_graph(blaze_matrix);
 	}
 
-	matrix = som_model.get_graph().get_matrix();
+	// shortest paths from every node, sources run in parallel over a CSR copy of the graph
+	auto graph = Kohonen_details::to_csr(blaze_matrix);
+	const size_t nodes_count = blaze_matrix.rows();
+	distance_matrix.assign(nodes_count, std::vector<D>(nodes_count));
+	predecessors.assign(nodes_count, std::vector<int>(nodes_count));
 
-	std::vector<D> distances;
-	std::vector<int> predecessor;
-	for (auto i = 0; i < nodes.size(); i++)
+	std::atomic<size_t> next_source(0);
+	auto worker = [&]() {
+		for (size_t source = next_source++; source < nodes_count; source = next_source++)
+		{
+			Kohonen_details::shortest_paths(graph, source, distance_matrix[source], predecessors[source]);
+		}
+	};
+	const size_t threads_count = std::min<size_t>(nodes_count, std::thread::hardware_concurrency());
+	if (threads_count <= 1)
+	{
+		worker();
+		return;
+	}
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < threads_count; ++t)
 	{
-		std::tie(distances, predecessor) = calculate_distance(blaze_matrix, i, matrix.rows());
-		distance_matrix.push_back(distances);
-		predecessors.push_back(predecessor);
+		threads.emplace_back(worker);
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
 	}
 }
 
@@ -255,74 +415,6 @@ std::vector<int> Kohonen<D, Sample, Graph, Metric, Distribution>::get_shortest_p
 }
 
 
-template <typename D, typename Sample, typename Graph, typename Metric, typename Distribution>
-int Kohonen<D, Sample, Graph, Metric, Distribution>::get_closest_unmarked_node(
-    const std::vector<D>& distance,
-    const std::vector<bool>& mark,
-    int nodes_count
-) const
-{
-    D minDistance = INFINITY;
-    int closestUnmarkedNode = -1;
-    for(int i = 0; i < nodes_count; i++)
-	{
-        if( (!mark[i]) && (minDistance >= distance[i]) )
-		{
-            minDistance = distance[i];
-            closestUnmarkedNode = i;
-        }
-    }
-    return closestUnmarkedNode;
-}
-
-
-template <typename D, typename Sample, typename Graph, typename Metric, typename Distribution>
-auto Kohonen<D, Sample, Graph, Metric, Distribution>::calculate_distance(
-    const blaze::CompressedMatrix<D>& adjust_matrix,
-    int from_node,
-    int nodes_count
-) const
-    -> std::tuple<std::vector<D>, std::vector<int>>
-{
-    std::vector<bool> mark(nodes_count);
-    std::vector<D> distances(nodes_count);
-    std::vector<int> predecessor(nodes_count);
-
-	// initialize
-
-    for(int i = 0; i < nodes_count; i++)
-	{
-        mark[i] = false;
-        predecessor[i] = -1;
-        distances[i] = INFINITY;
-    }
-    distances[from_node] = 0;
-
-	//
-
-    int closestUnmarkedNode;
-    int count = 0;
-    while(count < nodes_count)
-	{
-        closestUnmarkedNode = get_closest_unmarked_node(distances, mark, nodes_count);
-		mark[closestUnmarkedNode] = true;
-		for (int i = 0; i < nodes_count; i++)
-		{
-			if (!mark[i] && adjust_matrix(closestUnmarkedNode, i) > 0)
-			{
-				if (distances[i] > distances[closestUnmarkedNode] + adjust_matrix(closestUnmarkedNode, i))
-				{
-					distances[i] = distances[closestUnmarkedNode] + adjust_matrix(closestUnmarkedNode, i);
-					predecessor[i] = closestUnmarkedNode;
-				}
-			}
-		}
-        count++;
-    }
-
-	return { distances, predecessor };
-}
-
 template <typename D, typename Sample, typename Graph, typename Metric, typename Distribution>
 std::vector<std::pair<size_t, size_t>> Kohonen<D, Sample, Graph, Metric, Distribution>::sort_indexes(const blaze::CompressedMatrix<D>& matrix) 
 {
@@ -334,12 +426,12 @@ std::vector<std::pair<size_t, size_t>> Kohonen<D, Sample, Graph, Metric, Distrib
 	std::vector<std::pair<size_t, size_t>> idx_pairs;
 	for (size_t i = 0; i < matrix.rows(); ++i)
 	{
-		for (size_t j = i + 1; j < matrix.columns(); ++j)
+		for (auto it = matrix.begin(i); it != matrix.end(i); ++it)
 		{
-			if (matrix(i, j) > 0)
+			if (it->index() > i && it->value() > 0)
 			{
-				v.push_back(matrix(i, j));
-				idx_pairs.push_back({i, j});
+				v.push_back(it->value());
+				idx_pairs.push_back({i, it->index()});
 			}
 		}
 	}
@@ -13,8 +13,32 @@ Copyright (c) 2018 Panda Team
 #include "../../utils/graph.hpp"
 #include "../../mapping/Redif.hpp"
 
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 namespace metric {
 
+namespace Kohonen_details {
+
+	/**
+	 * @brief memoized best matching units of records, keyed by the hash of the record values
+	 *
+	 * Shared by copies of the distance object, guarded by a mutex to be usable from concurrent queries.
+	 */
+	template <typename Sample, typename D>
+	struct bmu_cache {
+		std::mutex mutex;
+		// record, index of the best matching unit, distance to it
+		std::unordered_map<size_t, std::vector<std::tuple<Sample, size_t, D>>> entries;
+		size_t size = 0;
+	};
+
+}  // namespace Kohonen_details
+
 /**
  * @class Kohonen
  *
@@ -131,6 +155,34 @@ public:
      */
     distance_type operator()(const Sample& sample_1, const Sample& sample_2) const;
 
+    /**
+     * @brief Find the best matching unit of the record and the distance to it.
+	 *
+	 * The result is memoized per record, so repeated distance evaluations with the same record scan the SOM nodes only once.
+     *
+     * @param sample - record
+     * @return index of the closest SOM node and distance to it
+     */
+	std::pair<size_t, D> bmu(const Sample& sample) const;
+
+    /**
+     * @brief
+	 * Forget memoized best matching units.
+     */
+	void clear_cache() const;
+
+    /**
+     * @brief
+	 * Weights of the SOM nodes, without copying.
+     */
+	const std::vector<std::vector<typename Sample::value_type>>& weights() const { return som_model.get_weights(); }
+
+    /**
+     * @brief
+	 * Maximum number of memoized records, the cache is cleared when it is full.
+     */
+	size_t cache_capacity = 1 << 16;
+
     /**
      * @brief
 	 * Recursive function that reconstructs the shortest path backwards node by node and print it
@@ -208,10 +260,22 @@ private:
      * @brief
      */
 	Metric metric;
+
+    /**
+     * @brief
+	 * Memoized best matching units of records.
+     */
+	std::shared_ptr<Kohonen_details::bmu_cache<Sample, D>> cache = std::make_shared<Kohonen_details::bmu_cache<Sample, D>>();
+
+    /**
+     * @brief
+	 * Scan SOM nodes for the closest one.
+     */
+	std::pair<size_t, D> find_bmu(const Sample& sample) const;
 	
     /**
      * @brief
-	 * Method calculates matrix with direct (based for SOM) distances between SOM nodes.
+	 * Method calculates matrix with shortest path distances between SOM nodes, the sources are processed in parallel.
      */
 	void calculate_distance_matrix(const std::vector<Sample>& samples);
 	
@@ -240,23 +304,6 @@ private:
      */
 	std::vector<int> get_shortest_path_(std::vector<int> &path, int from_node, int to_node) const;
 
-	/**
-	 * @brief return closest node from SOM's graph that was not visited while paths calculations.
-	 * @return the index of closest nodes was not visited
-	 */
-	int get_closest_unmarked_node(
-	    const std::vector<D>& distance,
-	    const std::vector<bool>& mark,
-	    int numOfVertices
-    ) const;
-
-	/**
-	 * @brief
-	 * Computes the shortest path
-	 */
-	auto calculate_distance(const blaze::CompressedMatrix<D>& adjMatrix, int from_node, int num) const
-	    -> std::tuple<std::vector<D>, std::vector<int>>;
-
 	std::vector<std::pair<size_t, size_t>> sort_indexes(const blaze::CompressedMatrix<D>& matrix);
 };
 
@@ -8,7 +8,9 @@ Copyright (c) 2018 Michael Welsch
 #ifndef _METRIC_DISTANCE_K_STRUCTURED_SSIM_CPP
 #define _METRIC_DISTANCE_K_STRUCTURED_SSIM_CPP
 #include "SSIM.hpp"
+#include <algorithm>
 #include <cmath>
+#include <stdexcept>
 #include <vector>
 
 #ifndef M_PI
@@ -21,24 +23,109 @@ namespace SSIM_details {
     // gaussian_blur filter
     inline std::vector<std::vector<double>> gaussian_blur(size_t n)
     {
+        auto kernel = gaussian_kernel(n);
         std::vector<std::vector<double>> gauss(n, std::vector<double>(n));
-        size_t d = n / 2;
-        size_t x, y;
+        for (size_t x = 0; x < n; x++) {
+            for (size_t y = 0; y < n; y++) {
+                gauss[x][y] = kernel[x] * kernel[y];
+            }
+        }
+        return gauss;
+    }
+
+    inline std::vector<double> gaussian_kernel(size_t n)
+    {
+        std::vector<double> kernel(n);
+        double d = double(n / 2);
         double Norm = 0.0;
+        for (size_t x = 0; x < n; x++) {
+            kernel[x] = std::exp(-((x - d) * (x - d) / 2.25));
+            Norm += kernel[x];
+        }
+        for (auto& k : kernel) {
+            k /= Norm;
+        }
+        return kernel;
+    }
+
+    /** row major image buffers and filtered window statistics, reused between calls **/
+    struct Workspace {
+        std::vector<double> img1;
+        std::vector<double> img2;
+        // column sums of the current window row: mu1, mu2, E[x1^2], E[x2^2], E[x1 x2] planes
+        std::vector<double> columns;
+        // window statistics, 5 channels interleaved per window: mu1, mu2, E[x1^2], E[x2^2], E[x1 x2]
+        std::vector<double> stats;
+    };
 
-        for (x = 0; x < n; x++) {
-            for (y = 0; y < n; y++) {
-                double g = std::exp(-(((x - d) * (x - d) + (y - d) * (y - d)) / 2.25));
-                Norm += g;
-                gauss[x][y] = g;
+    template <typename Container>
+    void load(const Container& img, std::vector<double>& buffer)
+    {
+        const size_t cols = img[0].size();
+        buffer.resize(img.size() * cols);
+        for (size_t i = 0; i < img.size(); ++i) {
+            for (size_t j = 0; j < cols; ++j) {
+                buffer[i * cols + j] = img[i][j];
             }
         }
-        for (x = 0; x < n; x++) {
-            for (y = 0; y < n; y++) {
-                gauss[x][y] = gauss[x][y] / Norm;
+    }
+
+    /**
+     * @brief Gaussian window statistics of two row major images for all valid windows
+     *
+     * The window is separable: for every output row a vertical pass along the columns gives the five column sums,
+     * then a horizontal pass over them gives the statistics of the windows of the row.
+     * The result has (rows - n + 1) x (cols - n + 1) x 5 entries.
+     */
+    inline void window_statistics(Workspace& ws, size_t rows, size_t cols, const std::vector<double>& kernel)
+    {
+        const size_t n = kernel.size();
+        const size_t out_cols = cols - n + 1;
+        const size_t out_rows = rows - n + 1;
+
+        ws.columns.resize(cols * 5);
+        ws.stats.resize(out_rows * out_cols * 5);
+        double* c1 = ws.columns.data();
+        double* c2 = c1 + cols;
+        double* c11 = c2 + cols;
+        double* c22 = c11 + cols;
+        double* c12 = c22 + cols;
+
+        for (size_t i = 0; i < out_rows; ++i) {
+            std::fill(ws.columns.begin(), ws.columns.end(), 0.0);
+            for (size_t y = 0; y < n; ++y) {
+                const double k = kernel[y];
+                const double* a = ws.img1.data() + (i + y) * cols;
+                const double* b = ws.img2.data() + (i + y) * cols;
+                for (size_t j = 0; j < cols; ++j) {
+                    const double ka = k * a[j];
+                    const double kb = k * b[j];
+                    c1[j] += ka;
+                    c2[j] += kb;
+                    c11[j] += ka * a[j];
+                    c22[j] += kb * b[j];
+                    c12[j] += ka * b[j];
+                }
+            }
+
+            double* out = ws.stats.data() + i * out_cols * 5;
+            for (size_t j = 0; j < out_cols; ++j) {
+                double s1 = 0, s2 = 0, s11 = 0, s22 = 0, s12 = 0;
+                for (size_t x = 0; x < n; ++x) {
+                    const double k = kernel[x];
+                    s1 += k * c1[j + x];
+                    s2 += k * c2[j + x];
+                    s11 += k * c11[j + x];
+                    s22 += k * c22[j + x];
+                    s12 += k * c12[j + x];
+                }
+                out[5 * j] = s1;
+                out[5 * j + 1] = s2;
+                out[5 * j + 2] = s11;
+                out[5 * j + 3] = s22;
+                out[5 * j + 4] = s12;
             }
         }
-        return gauss;
     }
 }  // namespace SSIM_details
 
@@ -63,40 +150,42 @@ auto SSIM<D, V>::operator()(const Container& img1, const Container& img2) const
     if constexpr (is_vec_of_vec<Container>() != true) {
         static_assert(true, "container should be 2D");
     } else {
+        const size_t n = kernel.size();
+        const size_t rows = img1.size();
+        const size_t cols = rows > 0 ? img1[0].size() : 0;
+        if (rows < n || cols < n || img2.size() != rows || img2[0].size() != cols) {
+            throw std::invalid_argument("images must be of the same size and not smaller than the SSIM window");
+        }
+        const size_t out_rows = rows - n + 1;
+        const size_t out_cols = cols - n + 1;
+
+        thread_local SSIM_details::Workspace ws;
+        SSIM_details::load(img1, ws.img1);
+        SSIM_details::load(img2, ws.img2);
+
+        SSIM_details::window_statistics(ws, rows, cols, kernel);
+
         double sum = 0.0;
         bool is_visibility = (masking < 2.0);  // use stabilizer
 
-        // create gaussian filter matrix
-        size_t n = 11;
-        auto gauss = SSIM_details::gaussian_blur(n);
-
         double C1 = std::pow(0.01 /*K1*/ * dynamic_range, 2);
         double C2 = std::pow(0.03 /*K2*/ * dynamic_range, 2);
 
-        for (size_t i = 0; i < img1.size() - n + 1; ++i) {
-            for (size_t j = 0; j < img1[0].size() - n + 1; ++j) {
-                // initialize values
-                double mu1 = 0.0, mu2 = 0.0;
-                double sigma1 = 0.0, sigma2 = 0;
-                double corr = 0.0, sigma12 = 0;
+        for (size_t i = 0; i < out_rows; ++i) {
+            for (size_t j = 0; j < out_cols; ++j) {
+                const double* stats = ws.stats.data() + (i * out_cols + j) * 5;
+                double mu1 = stats[0];
+                double mu2 = stats[1];
+                double sigma1 = stats[2];
+                double sigma2 = stats[3];
+                double corr = stats[4];
+                double sigma12 = 0;
                 double S1 = 0;
                 double S2 = 0;
 
-                for (size_t y = 0; y < n; y++) {
-                    for (size_t x = 0; x < n; x++) {
-                        double k1 = img1[i + y][j + x];
-                        double k2 = img2[i + y][j + x];
-                        double valv = gauss[y][x];
-                        mu1 += k1 * valv;
-                        mu2 += k2 * valv;
-                        sigma1 += k1 * k1 * valv;
-                        sigma2 += k2 * k2 * valv;
-                        corr += k1 * k2 * valv;
-                    }
-                }
-
                 double visibility = 1;  // default
                 if (is_visibility) {
+                    // the Lp norms of the deviations from the window mean are not separable
                     double l2norm1 = 0.0;
                     double l2norm2 = 0.0;
                     double lpnorm1 = 0.0;
@@ -104,12 +193,12 @@ auto SSIM<D, V>::operator()(const Container& img1, const Container& img2) const
                     double sscale = n * n;
                     double C3 = C2 * std::pow(sscale, 2.0 / masking - 1.0);  // scaling
                     for (size_t y = 0; y < n; y++) {
+                        const double* row1 = ws.img1.data() + (i + y) * cols + j;
+                        const double* row2 = ws.img2.data() + (i + y) * cols + j;
                         for (size_t x = 0; x < n; x++) {
-                            double k1 = img1[i + y][j + x];
-                            double k2 = img2[i + y][j + x];
-                            double valv = gauss[y][x] * sscale;
-                            double v1 = k1 - mu1;
-                            double v2 = k2 - mu2;
+                            double valv = kernel[y] * kernel[x] * sscale;
+                            double v1 = row1[x] - mu1;
+                            double v2 = row2[x] - mu2;
                             l2norm1 += v1 * v1 * valv;
                             l2norm2 += v2 * v2 * valv;
                             lpnorm1 += std::pow(std::abs(v1), masking) * valv;
@@ -153,7 +242,7 @@ auto SSIM<D, V>::operator()(const Container& img1, const Container& img2) const
             }
         }
 
-        return sum / ((img1.size() - n + 1) * (img1[0].size() - n + 1));  // normalize the sum
+        return sum / (out_rows * out_cols);  // normalize the sum
     }
     return distance_type {};
 }
@@ -9,8 +9,18 @@ Copyright (c) 2018 Michael Welsch
 #ifndef _METRIC_DISTANCE_K_STRUCTURED_SSIM_HPP
 #define _METRIC_DISTANCE_K_STRUCTURED_SSIM_HPP
 
+#include <cstddef>
+#include <vector>
+
 namespace metric {
 
+namespace SSIM_details {
+    /**
+     * @brief normalized 1D Gaussian window, the 2D SSIM window is the outer product of it with itself
+     */
+    inline std::vector<double> gaussian_kernel(std::size_t n);
+}  // namespace SSIM_details
+
 /**
  * @class SSIM
  *
@@ -39,6 +49,8 @@ struct SSIM {
     /**
      * @brief Calculate structural similarity for images in given containers
      *
+     * Window means and variances are computed with the separable Gaussian filter over row major copies of the images.
+     *
      * @param img1 first image
      * @param img2 second image
      * @return  structural similarity
@@ -48,6 +60,9 @@ struct SSIM {
 
     typename V::value_type dynamic_range = 255.0;
     typename V::value_type masking = 2.0;
+
+    // 11 x 11 Gaussian window, separable, built once per functor
+    std::vector<double> kernel = SSIM_details::gaussian_kernel(11);
 };
 
 }  // namespace metric
@@ -0,0 +1,305 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+#ifndef _METRIC_DISTANCE_K_STRUCTURED_SINKHORN_CPP
+#define _METRIC_DISTANCE_K_STRUCTURED_SINKHORN_CPP
+#include "Sinkhorn.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+namespace metric {
+
+namespace Sinkhorn_details {
+
+    /** exp of potentials shifted by the column maximum, the shift is returned in units of epsilon **/
+    template <typename V>
+    std::vector<V> shifted_exp(const blaze::DynamicMatrix<V>& potential, V epsilon, blaze::DynamicMatrix<V>& W)
+    {
+        std::vector<V> shift(potential.columns(), -std::numeric_limits<V>::infinity());
+        for (std::size_t j = 0; j < potential.rows(); ++j) {
+            for (std::size_t b = 0; b < potential.columns(); ++b) {
+                shift[b] = std::max(shift[b], potential(j, b));
+            }
+        }
+        W.resize(potential.rows(), potential.columns(), false);
+        for (std::size_t j = 0; j < potential.rows(); ++j) {
+            for (std::size_t b = 0; b < potential.columns(); ++b) {
+                W(j, b) = std::exp((potential(j, b) - shift[b]) / epsilon);
+            }
+        }
+        for (auto& s : shift) {
+            s /= epsilon;
+        }
+        return shift;
+    }
+
+    /**
+     * @brief result(i, b) = log sum_j exp((potential(j, b) - C(i, j)) / epsilon)
+     *
+     * The sum is the product of the kernel exp(-C / epsilon) with the shifted potentials,
+     * entries where the product underflows are summed directly.
+     */
+    template <typename V>
+    void log_sum_exp(const blaze::DynamicMatrix<V>& K, const blaze::DynamicMatrix<V>& C,
+        const blaze::DynamicMatrix<V>& potential, V epsilon, blaze::DynamicMatrix<V>& W,
+        blaze::DynamicMatrix<V>& result)
+    {
+        const V inf = std::numeric_limits<V>::infinity();
+        const V tiny = std::sqrt(std::numeric_limits<V>::min());
+
+        auto shift = shifted_exp(potential, epsilon, W);
+        result = K * W;
+        for (std::size_t i = 0; i < result.rows(); ++i) {
+            for (std::size_t b = 0; b < result.columns(); ++b) {
+                if (result(i, b) > tiny) {
+                    result(i, b) = std::log(result(i, b)) + shift[b];
+                    continue;
+                }
+                V top = -inf;
+                for (std::size_t j = 0; j < potential.rows(); ++j) {
+                    top = std::max(top, (potential(j, b) - C(i, j)) / epsilon);
+                }
+                if (top == -inf) {
+                    result(i, b) = -inf;
+                    continue;
+                }
+                V sum = 0;
+                for (std::size_t j = 0; j < potential.rows(); ++j) {
+                    sum += std::exp((potential(j, b) - C(i, j)) / epsilon - top);
+                }
+                result(i, b) = top + std::log(sum);
+            }
+        }
+    }
+
+    /**
+     * @brief transport cost of the plan P(i, j) = exp((f(i) + g(j) - C(i, j)) / epsilon) for every column
+     *
+     * Row i of the plan carries the mass exp(f(i) / epsilon) sum_j K(i, j) exp(g(j) / epsilon),
+     * its cost is the mass times the K weighted mean of the row of C.
+     */
+    template <typename V>
+    std::vector<V> transport_cost(const blaze::DynamicMatrix<V>& K, const blaze::DynamicMatrix<V>& KC,
+        const blaze::DynamicMatrix<V>& C, const blaze::DynamicMatrix<V>& f, const blaze::DynamicMatrix<V>& g,
+        V epsilon)
+    {
+        const V inf = std::numeric_limits<V>::infinity();
+        const V tiny = std::sqrt(std::numeric_limits<V>::min());
+
+        blaze::DynamicMatrix<V> W;
+        auto shift = shifted_exp(g, epsilon, W);
+        blaze::DynamicMatrix<V> S = K * W;
+        blaze::DynamicMatrix<V> T = KC * W;
+
+        std::vector<V> cost(f.columns(), 0);
+        for (std::size_t i = 0; i < f.rows(); ++i) {
+            for (std::size_t b = 0; b < f.columns(); ++b) {
+                if (f(i, b) == -inf) {
+                    continue;
+                }
+                if (S(i, b) > tiny) {
+                    V mass = std::exp(f(i, b) / epsilon + std::log(S(i, b)) + shift[b]);
+                    cost[b] += mass * T(i, b) / S(i, b);
+                    continue;
+                }
+                V top = -inf;
+                for (std::size_t j = 0; j < g.rows(); ++j) {
+                    top = std::max(top, (g(j, b) - C(i, j)) / epsilon);
+                }
+                if (top == -inf) {
+                    continue;
+                }
+                V weighted = 0;
+                for (std::size_t j = 0; j < g.rows(); ++j) {
+                    weighted += std::exp((g(j, b) - C(i, j)) / epsilon - top) * C(i, j);
+                }
+                cost[b] += std::exp(f(i, b) / epsilon + top) * weighted;
+            }
+        }
+        return cost;
+    }
+
+    /** copy histogram normalized to unit mass into column of M **/
+    template <typename V, typename Container>
+    void load(const Container& h, blaze::DynamicMatrix<V>& M, std::size_t column)
+    {
+        if (std::size_t(std::distance(std::begin(h), std::end(h))) != M.rows()) {
+            throw std::invalid_argument("histogram size must match the ground distance matrix");
+        }
+        V sum = 0;
+        for (auto it = std::begin(h); it != std::end(h); ++it) {
+            sum += *it;
+        }
+        if (!(sum > 0)) {
+            throw std::invalid_argument("histograms must have positive mass");
+        }
+        std::size_t i = 0;
+        for (auto it = std::begin(h); it != std::end(h); ++it, ++i) {
+            M(i, column) = *it / sum;
+        }
+    }
+
+}  // namespace Sinkhorn_details
+
+namespace Sinkhorn_details {
+
+    template <typename V>
+    kernel<V>::kernel(const std::vector<std::vector<V>>& ground, V regularization)
+    {
+        const std::size_t n = ground.size();
+        C.resize(n, n, false);
+        V maxC = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            for (std::size_t j = 0; j < n; ++j) {
+                C(i, j) = ground[i][j];
+                maxC = std::max(maxC, ground[i][j]);
+            }
+        }
+        epsilon = regularization * (maxC > 0 ? maxC : 1);
+
+        CT = blaze::trans(C);
+        K = blaze::exp(-C / epsilon);
+        KT = blaze::trans(K);
+        KC = K % C;
+    }
+
+}  // namespace Sinkhorn_details
+
+template <typename V>
+Sinkhorn<V>::Sinkhorn(const std::vector<std::vector<value_type>>& C_, value_type regularization_,
+    std::size_t maxiter_, value_type tolerance_, bool debiased_)
+    : regularization(regularization_)
+    , maxiter(maxiter_)
+    , tolerance(tolerance_)
+    , debiased(debiased_)
+    , is_C_initialized(true)
+    , prepared(C_, regularization_)
+{
+}
+
+template <typename V>
+Sinkhorn<V>::Sinkhorn(std::size_t n, value_type regularization_, std::size_t maxiter_, value_type tolerance_,
+    bool debiased_)
+    : Sinkhorn(EMD_details::default_ground_matrix<value_type>(n, n), regularization_, maxiter_, tolerance_, debiased_)
+{
+}
+
+template <typename V>
+auto Sinkhorn<V>::solve(const Sinkhorn_details::kernel<value_type>& ground, const blaze::DynamicMatrix<value_type>& A,
+    const blaze::DynamicMatrix<value_type>& B) const -> std::vector<value_type>
+{
+    const auto& C = ground.C;
+    const auto& CT = ground.CT;
+    const auto& K = ground.K;
+    const auto& KT = ground.KT;
+    const auto& KC = ground.KC;
+    const value_type epsilon = ground.epsilon;
+
+    const std::size_t n = A.rows();
+    const std::size_t m = A.columns();
+
+    blaze::DynamicMatrix<value_type> logA = blaze::log(A);
+    blaze::DynamicMatrix<value_type> logB = blaze::log(B);
+    blaze::DynamicMatrix<value_type> f(n, m, 0);
+    blaze::DynamicMatrix<value_type> g(n, m, 0);
+    blaze::DynamicMatrix<value_type> L;
+    blaze::DynamicMatrix<value_type> W;
+
+    for (std::size_t iter = 0; iter < maxiter; ++iter) {
+        Sinkhorn_details::log_sum_exp(K, C, g, epsilon, W, L);
+
+        // g fits the column marginals, stop when the rows fit as well
+        if (iter > 0) {
+            value_type error = 0;
+            for (std::size_t b = 0; b < m; ++b) {
+                value_type column_error = 0;
+                for (std::size_t i = 0; i < n; ++i) {
+                    if (A(i, b) > 0) {
+                        column_error += std::abs(std::exp(f(i, b) / epsilon + L(i, b)) - A(i, b));
+                    }
+                }
+                error = std::max(error, column_error);
+            }
+            if (error < tolerance) {
+                break;
+            }
+        }
+
+        f = epsilon * (logA - L);
+        Sinkhorn_details::log_sum_exp(KT, CT, f, epsilon, W, L);
+        g = epsilon * (logB - L);
+    }
+
+    return Sinkhorn_details::transport_cost(K, KC, C, f, g, epsilon);
+}
+
+template <typename V>
+template <typename Container>
+auto Sinkhorn<V>::batch(const Container& query, const std::vector<Container>& candidates) const
+    -> std::vector<distance_type>
+{
+    if (!is_C_initialized) {
+        // the default ground distance depends on the record size, it is not stored to keep calls const
+        const Sinkhorn_details::kernel<value_type> ground(
+            EMD_details::default_ground_matrix<value_type>(query.size(), query.size()), regularization);
+        return batch(ground, query, candidates);
+    }
+    return batch(prepared, query, candidates);
+}
+
+template <typename V>
+template <typename Container>
+auto Sinkhorn<V>::batch(const Sinkhorn_details::kernel<value_type>& ground, const Container& query,
+    const std::vector<Container>& candidates) const -> std::vector<distance_type>
+{
+    const std::size_t n = ground.C.rows();
+    const std::size_t m = candidates.size();
+    if (m == 0) {
+        return {};
+    }
+
+    // columns: query to candidates, then the self transports of candidates and of the query
+    const std::size_t columns = debiased ? 2 * m + 1 : m;
+    blaze::DynamicMatrix<value_type> A(n, columns);
+    blaze::DynamicMatrix<value_type> B(n, columns);
+    for (std::size_t k = 0; k < m; ++k) {
+        Sinkhorn_details::load(query, A, k);
+        Sinkhorn_details::load(candidates[k], B, k);
+        if (debiased) {
+            Sinkhorn_details::load(candidates[k], A, m + k);
+            Sinkhorn_details::load(candidates[k], B, m + k);
+        }
+    }
+    if (debiased) {
+        Sinkhorn_details::load(query, A, 2 * m);
+        Sinkhorn_details::load(query, B, 2 * m);
+    }
+
+    auto cost = solve(ground, A, B);
+
+    std::vector<distance_type> result(m);
+    for (std::size_t k = 0; k < m; ++k) {
+        result[k] = debiased ? std::max(value_type(0), cost[k] - (cost[m + k] + cost[2 * m]) / 2) : cost[k];
+    }
+    return result;
+}
+
+template <typename V>
+template <typename Container>
+auto Sinkhorn<V>::operator()(const Container& a, const Container& b) const -> distance_type
+{
+    return batch(a, std::vector<Container> { b })[0];
+}
+
+}  // namespace metric
+
+#endif
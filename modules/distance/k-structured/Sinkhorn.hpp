@@ -0,0 +1,134 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+#ifndef _METRIC_DISTANCE_K_STRUCTURED_SINKHORN_HPP
+#define _METRIC_DISTANCE_K_STRUCTURED_SINKHORN_HPP
+
+#include "../../../3rdparty/blaze/Math.h"
+#include "EMD.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace metric {
+
+namespace Sinkhorn_details {
+
+    /**
+     * @brief Ground distance prepared for the scaling iterations: the matrix, the kernel exp(-C / epsilon),
+     * the kernel multiplied by the ground distance and the transpositions.
+     */
+    template <typename V>
+    struct kernel {
+        V epsilon = 1;
+        blaze::DynamicMatrix<V> C;
+        blaze::DynamicMatrix<V> CT;
+        blaze::DynamicMatrix<V> K;
+        blaze::DynamicMatrix<V> KT;
+        blaze::DynamicMatrix<V> KC;
+
+        kernel() = default;
+        kernel(const std::vector<std::vector<V>>& ground, V regularization);
+    };
+
+}  // namespace Sinkhorn_details
+
+/**
+ * @class Sinkhorn
+ *
+ * @brief Entropy regularized approximation of the earth mover's distance.
+ *
+ * Histograms are normalized to unit mass and the regularized transportation problem is solved with Sinkhorn matrix
+ * scaling iterations. The iterations run on dual potentials in the log domain, every update is a product of the
+ * ground kernel with a matrix of shifted potentials, one column per pair of histograms, so a whole batch is solved
+ * with the same matrix products. The result is the transport cost of the regularized plan; with debiasing
+ * d(a, b) = W(a, b) - (W(a, a) + W(b, b)) / 2, which is zero for equal histograms.
+ */
+template <typename V = double>
+class Sinkhorn {
+public:
+    using value_type = V;
+    using distance_type = value_type;
+
+    /**
+     * @brief Construct a new Sinkhorn object with default ground distance min(|i - j|, N / 2) of the record size N,
+     * which is prepared for every call
+     */
+    Sinkhorn() = default;
+
+    /**
+     * @brief Construct a new Sinkhorn object with default ground distance min(|i - j|, n / 2) prepared once
+     *
+     * @param n record size
+     * @param regularization_ entropic regularization relative to the maximum ground distance
+     * @param maxiter_ maximum number of scaling iterations
+     * @param tolerance_ L1 error of the marginals to stop iterations
+     * @param debiased_ subtract the self transport costs
+     */
+    explicit Sinkhorn(std::size_t n, value_type regularization_ = 0.05, std::size_t maxiter_ = 1000,
+        value_type tolerance_ = 1e-4, bool debiased_ = true);
+
+    /**
+     * @brief Construct a new Sinkhorn object
+     *
+     * @param C_ ground distance matrix
+     * @param regularization_ entropic regularization relative to the maximum ground distance
+     * @param maxiter_ maximum number of scaling iterations
+     * @param tolerance_ L1 error of the marginals to stop iterations
+     * @param debiased_ subtract the self transport costs
+     */
+    explicit Sinkhorn(const std::vector<std::vector<value_type>>& C_, value_type regularization_ = 0.05,
+        std::size_t maxiter_ = 1000, value_type tolerance_ = 1e-4, bool debiased_ = true);
+
+    /**
+     * @brief Calculate approximate EMD between histograms
+     *
+     * @param a first histogram
+     * @param b second histogram
+     * @return distance
+     */
+    template <typename Container>
+    distance_type operator()(const Container& a, const Container& b) const;
+
+    /**
+     * @brief Calculate approximate EMD between one histogram and a batch of histograms with shared matrix products
+     *
+     * @param query histogram
+     * @param candidates histograms of the query size
+     * @return distances from query to every candidate
+     */
+    template <typename Container>
+    std::vector<distance_type> batch(const Container& query, const std::vector<Container>& candidates) const;
+
+private:
+    value_type regularization = 0.05;
+    std::size_t maxiter = 1000;
+    value_type tolerance = 1e-4;
+    bool debiased = true;
+
+    // prepared in the constructor and never changed, so concurrent calls share it
+    bool is_C_initialized = false;
+    Sinkhorn_details::kernel<value_type> prepared;
+
+    template <typename Container>
+    std::vector<distance_type> batch(const Sinkhorn_details::kernel<value_type>& ground, const Container& query,
+        const std::vector<Container>& candidates) const;
+
+    /**
+     * @brief solve regularized transportation problems for columns of A and B
+     *
+     * @return transport cost for every column
+     */
+    std::vector<value_type> solve(const Sinkhorn_details::kernel<value_type>& ground,
+        const blaze::DynamicMatrix<value_type>& A, const blaze::DynamicMatrix<value_type>& B) const;
+};
+
+}  // namespace metric
+
+#include "Sinkhorn.cpp"
+
+#endif  // Header Guard
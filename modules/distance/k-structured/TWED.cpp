@@ -10,77 +10,192 @@ Copyright (c) 2018 Michael Welsch
 #include "TWED.hpp"
 #include <vector>
 #include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace metric {
 
-/*** distance measure with time elastic cost matrix. ***/
+namespace TWED_details {
+
+    /** values and time stamps of a series, buffers are reused between calls **/
+    template <typename V>
+    struct Workspace {
+        std::vector<V> A;
+        std::vector<V> timeA;
+        std::vector<V> B;
+        std::vector<V> timeB;
+        std::vector<V> stepB;
+        std::vector<V> D0;
+        std::vector<V> Di;
+    };
+
+    template <typename V, typename Container>
+    void load(const Container& s, std::vector<V>& values, std::vector<V>& times)
+    {
+        values.clear();
+        times.clear();
+        values.reserve(s.size());
+        times.reserve(s.size());
+        for (auto it = s.cbegin(); it != s.cend(); ++it) {
+            if constexpr (std::is_same<blaze::CompressedVector<V>, Container>::value) {
+                times.push_back(it->index());  // Read access to the index of the non-zero element.
+                values.push_back(it->value());  // Read access to the value of the non-zero element.
+            } else {
+                times.push_back(std::distance(s.begin(), it));
+                values.push_back(*it);
+            }
+        }
+    }
+
+    /** distance from value to the interval [lo, hi] **/
+    template <typename V>
+    V envelope_distance(V value, V lo, V hi)
+    {
+        return value < lo ? lo - value : (value > hi ? value - hi : V(0));
+    }
+
+    /**
+     * every row i > 0 of the cost matrix is entered exactly once, either by a deletion in A (C1) or by a match (C3),
+     * so the sum of the cheapest possible entries over all rows bounds the distance from below
+     **/
+    template <typename V>
+    V rows_lower_bound(const std::vector<V>& A, const std::vector<V>& timeA, const std::vector<V>& B, V penalty, V elastic)
+    {
+        auto [min_it, max_it] = std::minmax_element(B.begin(), B.end());
+        V sum = 0;
+        for (std::size_t i = 1; i < A.size(); i++) {
+            V deletion = std::abs(A[i - 1] - A[i]) + elastic * (timeA[i] - timeA[i - 1]) + penalty;
+            V match = envelope_distance(A[i], *min_it, *max_it) + envelope_distance(A[i - 1], *min_it, *max_it);
+            sum += std::min(deletion, match);
+        }
+        return sum;
+    }
+
+    template <typename V>
+    V lower_bound(const Workspace<V>& ws, V penalty, V elastic)
+    {
+        V first = std::abs(ws.A[0] - ws.B[0]) + elastic * std::abs(ws.timeA[0]);
+        return first
+            + std::max(rows_lower_bound(ws.A, ws.timeA, ws.B, penalty, elastic),
+                rows_lower_bound(ws.B, ws.timeB, ws.A, penalty, elastic));
+    }
+
+}  // namespace TWED_details
+
 template <typename V>
 template <typename Container>
 auto TWED<V>::operator()(const Container& As, const Container& Bs) const -> distance_type
 {
-    std::vector<value_type> A;
-    A.reserve(As.size());
-    std::vector<value_type> timeA;
-    timeA.reserve(As.size());
+    return operator()(As, Bs, std::numeric_limits<value_type>::infinity());
+}
 
-    std::vector<value_type> B;
-    B.reserve(Bs.size());
+template <typename V>
+template <typename Container>
+auto TWED<V>::lower_bound(const Container& As, const Container& Bs) const -> distance_type
+{
+    thread_local TWED_details::Workspace<value_type> ws;
+    TWED_details::load(As, ws.A, ws.timeA);
+    TWED_details::load(Bs, ws.B, ws.timeB);
+    return TWED_details::lower_bound(ws, penalty, elastic);
+}
 
-    std::vector<value_type> timeB;
-    timeB.reserve(Bs.size());
+/*** distance measure with time elastic cost matrix. ***/
+template <typename V>
+template <typename Container>
+auto TWED<V>::operator()(const Container& As, const Container& Bs, value_type threshold) const -> distance_type
+{
+    constexpr value_type inf = std::numeric_limits<value_type>::infinity();
 
-    for (auto it = As.cbegin(); it != As.cend(); ++it) {
-        if constexpr(std::is_same<blaze::CompressedVector<V>, Container>::value) {
-                timeA.push_back(it->index());  // Read access to the index of the non-zero element.
-                A.push_back(it->value());  // Read access to the value of the non-zero element.
-        } else {
-            timeA.push_back(std::distance(As.begin(), it));  // Read access to the index of the non-zero element.
-            A.push_back(*it);  // Read access to the value of the non-zero element.
-        }
-    }
+    thread_local TWED_details::Workspace<value_type> ws;
+    TWED_details::load(As, ws.A, ws.timeA);
+    TWED_details::load(Bs, ws.B, ws.timeB);
 
-    for (auto it = Bs.cbegin(); it != Bs.cend(); ++it) {
-        if constexpr (std::is_same<blaze::CompressedVector<V>, Container>::value) {
-            timeB.push_back(it->index());  // Read access to the index of the non-zero element.
-            B.push_back(it->value());  // Read access to the value of the non-zero element.
-        } else {
-            timeB.push_back(std::distance(Bs.begin(), it));  // Read access to the index of the non-zero element.
-            B.push_back(*it);  // Read access to the value of the non-zero element.
+    const auto& A = ws.A;
+    const auto& timeA = ws.timeA;
+    const auto& B = ws.B;
+    const auto& timeB = ws.timeB;
+
+    if (threshold < inf) {
+        value_type bound = TWED_details::lower_bound(ws, penalty, elastic);
+        if (bound > threshold) {
+            return bound;
         }
     }
 
-    value_type C1, C2, C3;
+    std::size_t sizeA = A.size();
+    std::size_t sizeB = B.size();
+
+    // columns [lo, hi] of row i inside the band, the band follows the diagonal for series of different length
+    std::size_t width = sizeB;
+    if (band > 0 && sizeA > 1) {
+        width = std::max(band, (sizeB + sizeA - 3) / (sizeA - 1));
+    }
+    auto columns = [&](std::size_t i) {
+        std::size_t center = sizeA > 1 ? i * (sizeB - 1) / (sizeA - 1) : 0;
+        return std::make_pair(center > width ? center - width : 0, std::min(sizeB - 1, center + width));
+    };
 
-    int sizeB = B.size();
-    int sizeA = A.size();
+    // cost of deletion in B
+    auto& stepB = ws.stepB;
+    stepB.resize(sizeB);
+    for (std::size_t j = 1; j < sizeB; j++) {
+        stepB[j] = std::abs(B[j - 1] - B[j]) + elastic * (timeB[j] - timeB[j - 1]) + penalty;
+    }
 
-    std::vector<value_type> D0(sizeB);
-    std::vector<value_type> Di(sizeB);
+    auto& D0 = ws.D0;
+    auto& Di = ws.Di;
+    D0.resize(sizeB);
+    Di.resize(sizeB);
 
     // first element
     D0[0] = std::abs(A[0] - B[0]) + elastic * (std::abs(timeA[0] - 0));  // C3
 
     // first row
-    for (int j = 1; j < sizeB; j++) {
-        D0[j] = D0[j - 1] + std::abs(B[j - 1] - B[j]) + elastic * (timeB[j] - timeB[j - 1]) + penalty;  // C2
+    auto [lo0, hi0] = columns(0);
+    for (std::size_t j = 1; j <= hi0; j++) {
+        D0[j] = D0[j - 1] + stepB[j];  // C2
+    }
+    if (D0[lo0] > threshold) {
+        return D0[lo0];
     }
 
     // second-->last row
-    for (int i = 1; i < sizeA; i++) {
-        // every first element in row
-        Di[0] = D0[0] + std::abs(A[i - 1] - A[i]) + elastic * (timeA[i] - timeA[i - 1]) + penalty;  // C1
+    // cells left and right of the band are set to inf, so the inner loop needs no range checks
+    std::size_t prev_hi = hi0;
+    for (std::size_t i = 1; i < sizeA; i++) {
+        auto [lo, hi] = columns(i);
+        const value_type stepA = std::abs(A[i - 1] - A[i]) + elastic * (timeA[i] - timeA[i - 1]) + penalty;
+
+        for (std::size_t j = prev_hi + 1; j <= hi; j++) {
+            D0[j] = inf;
+        }
+        std::size_t j = lo;
+        if (lo == 0) {
+            // every first element in row
+            Di[0] = D0[0] + stepA;  // C1
+            j = 1;
+        } else {
+            Di[lo - 1] = inf;
+        }
 
         // remaining elements in row
-        for (int j = 1; j < sizeB; j++) {
-            C1 = D0[j] + std::abs(A[i - 1] - A[i]) + elastic * (timeA[i] - timeA[i - 1]) + penalty;
-            C2 = Di[j - 1] + std::abs(B[j - 1] - B[j]) + elastic * (timeB[j] - timeB[j - 1]) + penalty;
+        value_type C1, C2, C3;
+        value_type row_min = lo == 0 ? Di[0] : inf;
+        for (; j <= hi; j++) {
+            C1 = D0[j] + stepA;
+            C2 = Di[j - 1] + stepB[j];
             C3 = D0[j - 1] + std::abs(A[i] - B[j]) + std::abs(A[i - 1] - B[j - 1])
                 + elastic * (std::abs(timeA[i] - timeB[j]) + std::abs(timeA[i - 1] - timeB[j - 1]));
             Di[j] = (C1 < ((C2 < C3) ? C2 : C3)) ? C1 : ((C2 < C3) ? C2 : C3);  // Di[j] = std::min({C1,C2,C3});
-            //std::cout << Di[j] << " [" << C1 << " " << C2 << " " << C3 << "] |  "; // code for debug, added by Max F
+            row_min = std::min(row_min, Di[j]);
         }
-        //std::cout << "\n"; // code for debug, added by Max F
         std::swap(D0, Di);
+        prev_hi = hi;
+
+        // every path crosses every row and costs are not negative
+        if (row_min > threshold) {
+            return row_min;
+        }
     }
 
     distance_type rvalue = D0[sizeB - 1];
@@ -10,6 +10,8 @@ Copyright (c) 2018 Michael Welsch
 
 #include "../../../3rdparty/blaze/Math.h"
 
+#include <cstddef>
+
 namespace metric {
 
 /**
@@ -27,10 +29,12 @@ struct TWED {
      *
      * @param penalty_
      * @param elastic_
+     * @param band_ half width of the Sakoe-Chiba band around the diagonal of the cost matrix, 0 means no band
      */
-    TWED(const value_type& penalty_ = 0, const value_type& elastic_ = 1)
+    TWED(const value_type& penalty_ = 0, const value_type& elastic_ = 1, std::size_t band_ = 0)
         : penalty(penalty_)
         , elastic(elastic_)
+        , band(band_)
     {
     }
 
@@ -44,8 +48,32 @@ struct TWED {
     template <typename Container>
     value_type operator()(const Container& As, const Container& Bs) const;
 
+    /**
+     * @brief Calculate TWE distance, abandon calculation as soon as it exceeds a threshold
+     *
+     * Useful for nearest neighbour search where the threshold is the distance to the current k-th neighbour.
+     *
+     * @param As first container
+     * @param Bs second container
+     * @param threshold
+     * @return TWE distance if it is not greater than threshold, otherwise some lower bound greater than threshold
+     */
+    template <typename Container>
+    value_type operator()(const Container& As, const Container& Bs, value_type threshold) const;
+
+    /**
+     * @brief Calculate lower bound of TWE distance in O(|A| + |B|)
+     *
+     * @param As first container
+     * @param Bs second container
+     * @return lower bound of TWE distance between given containers
+     */
+    template <typename Container>
+    value_type lower_bound(const Container& As, const Container& Bs) const;
+
     value_type penalty = 0;
     value_type elastic = 1;
+    std::size_t band = 0;
     bool is_zero_padded = false;
 };
 
@@ -17,9 +17,11 @@ KNNGraph<Sample, Distance, WeightType, isDense, isSymmetric>::KNNGraph(
     size_t neighbors_num,
     size_t max_bruteforce_size,
     int max_iterations,
-    double update_range
+    double update_range,
+    Distance distance
 )
     : Graph<WeightType, isDense, isSymmetric>(samples.size())
+    , _distance(distance)
     , _nodes(samples)
     , _neighbors_num(neighbors_num)
     , _max_bruteforce_size(max_bruteforce_size)
@@ -33,7 +35,7 @@ template <typename Sample, typename Distance, typename WeightType, bool isDense,
 template <typename Container, typename>
 void KNNGraph<Sample, Distance, WeightType, isDense, isSymmetric>::calculate_distance_matrix(const Container& samples)
 {
-    Distance distance;
+    const Distance& distance = _distance;
 
     for (int i = 0; i < samples.size(); i++) {
         // take each node
@@ -116,7 +118,7 @@ std::vector<std::pair<size_t, size_t>>
 KNNGraph<Sample, Distance, WeightType, isDense, isSymmetric>::random_pair_division(
     const Container& samples, const std::vector<int>& ids, int max_size)
 {
-    Distance d;
+    const Distance& d = _distance;
     std::vector<Sample> A;
     std::vector<Sample> B;
     std::vector<int> A_ids;
@@ -243,7 +245,7 @@ std::vector<size_t> KNNGraph<Sample, Distance, WeightType, isDense, isSymmetric>
     std::vector<distance_type> distances;
     distance_type distance;
 
-    Distance distancer;
+    const Distance& distancer = _distance;
 
     // num_expansions should be less then k(neighbors_num) of the graph
     if (num_expansions > _neighbors_num) {
@@ -430,7 +432,7 @@ KNNGraph<Sample, Distance, WeightType, isDense, isSymmetric>::rnn(const Sample&
     std::vector<distance_type> distances;
     distance_type distance;
 
-    Distance distancer;
+    const Distance& distancer = _distance;
 
     auto num_expansions = _nodes.size();
 
@@ -42,7 +42,8 @@ public:
         size_t neighbors_num,
         size_t max_bruteforce_size,
         int max_iterations = 100,
-        double update_range = 0.02
+        double update_range = 0.02,
+        Distance distance = Distance()
     );
 
     ///**
@@ -170,6 +171,7 @@ protected:
 
     bool _not_more_neighbors = false;
 
+    Distance _distance;
     std::vector<Sample> _nodes;
     std::vector<std::vector<distance_type>> _distance_matrix;
 private:
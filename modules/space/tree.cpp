@@ -525,49 +525,44 @@ bool Tree<RecType, Metric>::erase(const RecType& p)
 
     if (result.second <= 0.0) {
         Node_ptr node_p = result.first;
-        Node_ptr parent_p = node_p->get_parent();
 
-        if (node_p == root) {
-            if (node_p->get_children().empty()) {
-                delete root;
-                root = nullptr;
-                data.clear();
-                index_map.clear();
-                return true;
-            }
-            auto leaf = findAnyLeaf();
-            extractNode(leaf);
-            leaf->set_level(root->get_level());
-            root = leaf;
-            leaf->children.assign(node_p->children.begin(), node_p->children.end());
-            for (auto l : leaf->get_children()) {
-                l->set_parent(leaf);
+        // descendants are inserted again one by one, a subtree moved as a whole
+        // keeps the levels of its old place and breaks the covering
+        std::vector<Node_ptr> descendants;
+        std::stack<Node_ptr> stack;
+        for (auto child : node_p->children) {
+            stack.push(child);
+        }
+        while (!stack.empty()) {
+            Node_ptr q = stack.top();
+            stack.pop();
+            for (auto child : q->children) {
+                stack.push(child);
             }
-            ret_val = true;
-            remove_data(node_p->get_ID());
-            node_p->children.clear();
-            delete node_p;
+            q->children.clear();
+            q->parent = nullptr;
+            q->parent_dist = 0;
+            descendants.push_back(q);
         }
+        node_p->children.clear();
 
-        else {
-            // erase node from parent's list of child
-            unsigned num_children = parent_p->children.size();
-            for (unsigned i = 0; i < num_children; ++i) {
-                if (parent_p->children[i] == node_p) {
-                    parent_p->children[i] = parent_p->children.back();
-                    parent_p->children.pop_back();
-                    break;
-                }
-            }
-            // insert each child of the node in new root again.
-            for (Node_ptr q : node_p->children) {
-                root = Tree<RecType, Metric>::insert_(root, q);
+        if (node_p == root) {
+            root = nullptr;
+        } else {
+            extractNode(node_p);
+        }
+        remove_data(node_p->get_ID());
+        delete node_p;
+
+        for (Node_ptr q : descendants) {
+            q->set_level(0);
+            if (root == nullptr) {
+                root = q;
+            } else {
+                root = insert(root, q);
             }
-            node_p->children.clear();
-            remove_data(node_p->get_ID());
-            delete node_p;
-            ret_val = true;
         }
+        ret_val = true;
     }
     return ret_val;
 }
@@ -20,6 +20,7 @@ Copyright (c) 2018, Michael Welsch
 #include <functional>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <numeric>
 #include <shared_mutex>
 #include <stack>
@@ -501,7 +502,8 @@ private:
         return id;
     }
     const RecType & get_data(std::size_t ID) {
-        return data[index_map[ID]].first;
+        // lookup without insertion, concurrent knn queries read node data
+        return data[index_map.at(ID)].first;
     }
     void remove_data(std::size_t ID) {
         auto p = data.begin();
@@ -511,7 +513,7 @@ private:
         data.erase(p);
         index_map.erase(pi);
         for(auto &kv : index_map) {
-            if(kv.first <= i)
+            if(kv.second <= i)
                 continue;
             kv.second -= 1;
         }
@@ -6,19 +6,44 @@ file, You can obtain one at http://mozilla.org/MPL/2.0/.
 Copyright (c) 2019 PANDA Team
 */
 
+#include "ThreadPool.hpp"
+#include "Semaphore.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
 
 namespace metric {
 
 
 	/**
 	 * @class MetricAutoDetector
-	 * @brief
-	 * 
+	 * @brief Chooses the metric whose Kohonen distance over a trained SOM is the closest to the direct distance
+	 *
+	 * Candidate metrics are evaluated concurrently on a thread pool. With successive halving the first round
+	 * evaluates all candidates on a small subsample of the dataset, every next round keeps the better half of
+	 * candidates and evaluates them on a four times larger subsample, the last round runs on the whole dataset.
 	 */
 	class MetricAutoDetector {
 
 	public:
 
+		/**
+		 * @brief Score and cost of one candidate metric in the last detection
+		 */
+		struct candidate_report {
+			std::string name;
+			// mean relative difference between Kohonen and direct distances in the last evaluated round
+			double score = 0;
+			// records of the subsample in the last evaluated round
+			size_t records = 0;
+			// number of evaluated rounds
+			size_t rounds = 0;
+			// wall time spent on evaluation of the candidate
+			double seconds = 0;
+			bool eliminated = false;
+		};
+
 		/**
 		 * @brief Construct a new MetricAutoDetector object
 		 *
@@ -26,8 +51,13 @@ namespace metric {
 		explicit MetricAutoDetector();
 
 		/**
-		 * @brief
+		 * @brief Detect the best metric for the dataset
 		 *
+		 * @param graph SOM graph
+		 * @param graph_w, graph_h graph size
+		 * @param dataset records
+		 * @param isEstimate train SOMs by estimate with subsampling instead of full train
+		 * @return name of the best metric
 		 */
 		template <typename Record, typename Graph>
 		std::string detect(Graph &graph, int graph_w, int graph_h, std::vector<Record> dataset, bool isEstimate = true);
@@ -41,13 +71,56 @@ namespace metric {
 			verbose = isVerbose;
 		}
 
+		/**
+		 * @brief Set number of threads evaluating candidates, zero means hardware concurrency
+		 *
+		 */
+		void set_threads(size_t threadsNumber)
+		{
+			threads = threadsNumber;
+		}
+
+		/**
+		 * @brief Set time budget of detection, rounds not finished in time are not used
+		 *
+		 * Evaluation of a started candidate is not interrupted, the first round is always finished.
+		 */
+		void set_time_budget(std::chrono::milliseconds budget)
+		{
+			time_budget = budget;
+		}
+
+		/**
+		 * @brief Enable or disable successive halving, when disabled all candidates are evaluated on the whole dataset
+		 *
+		 */
+		void set_successive_halving(bool isHalving)
+		{
+			successive_halving = isHalving;
+		}
+
+		/**
+		 * @brief Scores and timings of candidates in the last detection
+		 *
+		 */
+		const std::vector<candidate_report>& get_report() const
+		{
+			return report;
+		}
+
 	private:
 
 		bool verbose = false;
+		size_t threads = 0;
+		std::chrono::milliseconds time_budget = std::chrono::milliseconds::max();
+		bool successive_halving = true;
+		std::vector<candidate_report> report;
+
+		template <typename Record, typename Graph>
+		double evaluate(const std::string& metric_type, const Graph &graph, int graph_w, int graph_h, const std::vector<Record>& dataset, bool isEstimate);
 
-		
 		template <typename Record, typename Graph, typename Metric>
-		double get_mean_distance_difference(Graph &graph, Metric distance, std::vector<Record> dataset, std::vector<size_t> randomized_indexes, bool isEstimate);
+		double get_mean_distance_difference(const Graph &graph, Metric distance, const std::vector<Record>& dataset, const std::vector<size_t>& randomized_indexes, bool isEstimate);
 	};
 
 
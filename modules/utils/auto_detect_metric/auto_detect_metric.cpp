@@ -6,6 +6,11 @@
   Copyright (c) 2019 PANDA Team
 */
 
+#include <algorithm>
+#include <exception>
+#include <numeric>
+#include <random>
+
 namespace metric {
 
 	MetricAutoDetector::MetricAutoDetector()
@@ -13,6 +18,14 @@ namespace metric {
 	}
 
 	
+	namespace auto_detect_metric_details {
+
+		// smallest subsample of successive halving, the number of records compared pairwise in a round
+		constexpr size_t min_subsample = 20;
+
+	}  // namespace auto_detect_metric_details
+
+
 	template <typename Record, typename Graph>
 	std::string MetricAutoDetector::detect(Graph &graph, int graph_w, int graph_h, std::vector<Record> dataset, bool isEstimate)
 	{
@@ -21,84 +34,149 @@ namespace metric {
 		std::vector<std::string> metric_type_names = {"Euclidean", "Manhatten", "P_norm", "Cosine", "Chebyshev"};
 		//std::vector<std::string> metric_type_names = {"Euclidean", "Manhatten"};
 
-		// Random updating 
+		const auto start_time = std::chrono::steady_clock::now();
+		auto is_expired = [&]() {
+			return time_budget != std::chrono::milliseconds::max()
+				&& std::chrono::steady_clock::now() - start_time > time_budget;
+		};
+
+		report.assign(metric_type_names.size(), candidate_report());
+		for (size_t i = 0; i < metric_type_names.size(); ++i)
+		{
+			report[i].name = metric_type_names[i];
+		}
+
+		// Random updating, subsamples of every round are prefixes of the shuffled dataset
 		std::vector<size_t> randomized_indexes(dataset.size());
 		std::iota(randomized_indexes.begin(), randomized_indexes.end(), 0);
 		// shuffle samples after all was processed		
 		std::shuffle(randomized_indexes.begin(), randomized_indexes.end(), std::mt19937{ std::random_device {}() });
-		
-		double relative_diff_mean;
-		std::vector<double> relative_diff_means;
-		for (auto metric_type : metric_type_names)
+		std::vector<Record> shuffled;
+		shuffled.reserve(dataset.size());
+		for (auto index : randomized_indexes)
 		{
-			if (metric_type == "Euclidean")
-			{
-				// Euclidean
-				metric::Euclidean<double> distance;
-				relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::Euclidean<double>>(graph, distance, dataset, randomized_indexes, isEstimate);
-			}
-			else if (metric_type == "Manhatten")
-			{
-				// Manhatten
-				metric::Manhatten<double> distance;
-				relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::Manhatten<double>>(graph, distance, dataset, randomized_indexes, isEstimate);
-			}
-			else if (metric_type == "P_norm")
+			shuffled.push_back(dataset[index]);
+		}
+
+		// every round halves the candidates and quadruples the subsample, so a round costs about the half of the next one,
+		// the last round evaluates the whole dataset, rounds are not added when the first subsample would be too small
+		size_t rounds = 1;
+		if (successive_halving)
+		{
+			while ((size_t(1) << rounds) < metric_type_names.size()
+				&& (dataset.size() >> (2 * rounds)) >= auto_detect_metric_details::min_subsample)
 			{
-				// P_norm
-				metric::P_norm<double> distance;
-				relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::P_norm<double>>(graph, distance, dataset, randomized_indexes, isEstimate);
+				++rounds;
 			}
-			else if (metric_type == "Euclidean_thresholded")
+		}
+
+		size_t threads_number = threads != 0 ? threads : std::thread::hardware_concurrency();
+		threads_number = std::max<size_t>(1, std::min(threads_number, metric_type_names.size()));
+		ThreadPool pool(threads_number);
+		Semaphore sem;
+
+		std::vector<size_t> survivors(metric_type_names.size());
+		std::iota(survivors.begin(), survivors.end(), 0);
+		// scores of the last round evaluated for all survivors
+		std::vector<double> completed_scores(metric_type_names.size(), 0);
+		std::exception_ptr error;
+
+		for (size_t round = 0; round < rounds; ++round)
+		{
+			if (round > 0 && is_expired())
 			{
-				// Euclidean_thresholded
-				metric::Euclidean_thresholded<double> distance;
-				relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::Euclidean_thresholded<double>>(graph, distance, dataset, randomized_indexes, isEstimate);
+				break;
 			}
-			else if (metric_type == "Cosine")
+
+			const size_t records = dataset.size() >> (2 * (rounds - 1 - round));
+			const std::vector<Record> subset(shuffled.begin(), shuffled.begin() + records);
+
+			std::vector<double> scores(survivors.size(), 0);
+			std::vector<double> seconds(survivors.size(), 0);
+			std::vector<char> evaluated(survivors.size(), false);
+			std::vector<std::exception_ptr> errors(survivors.size());
+			for (size_t k = 0; k < survivors.size(); ++k)
 			{
-				// Cosine
-				metric::Cosine<double> distance;
-				relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::Cosine<double>>(graph, distance, dataset, randomized_indexes, isEstimate);
+				pool.execute([&, k, round]() {
+					if (round == 0 || !is_expired())
+					{
+						auto t1 = std::chrono::steady_clock::now();
+						try
+						{
+							scores[k] = evaluate<Record, Graph>(metric_type_names[survivors[k]], graph, graph_w, graph_h, subset, isEstimate);
+							evaluated[k] = true;
+						}
+						catch (...)
+						{
+							errors[k] = std::current_exception();
+						}
+						auto t2 = std::chrono::steady_clock::now();
+						seconds[k] = std::chrono::duration<double>(t2 - t1).count();
+					}
+					sem.notify();
+				});
 			}
-			else if (metric_type == "Chebyshev")
+			for (size_t k = 0; k < survivors.size(); ++k)
 			{
-				// Chebyshev
-				metric::Chebyshev<double> distance;
-				relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::Chebyshev<double>>(graph, distance, dataset, randomized_indexes, isEstimate);
+				sem.wait();
 			}
-			else if (metric_type == "Earth Mover Distance")
+
+			bool is_complete = true;
+			for (size_t k = 0; k < survivors.size(); ++k)
 			{
-				// Earth Mover Distance
-				auto cost_mat = metric::EMD_details::ground_distance_matrix_of_2dgrid<double>(graph_w, graph_h);
-				auto maxCost = metric::EMD_details::max_in_distance_matrix(cost_mat);
-				metric::EMD<double> distance(cost_mat, maxCost);
-				relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::EMD<double>>(graph, distance, dataset, randomized_indexes, isEstimate);
+				if (errors[k] && !error)
+				{
+					error = errors[k];
+				}
+				if (!evaluated[k])
+				{
+					is_complete = false;
+					continue;
+				}
+				auto& candidate = report[survivors[k]];
+				candidate.score = scores[k];
+				candidate.records = records;
+				candidate.rounds++;
+				candidate.seconds += seconds[k];
+
+				if (verbose)
+				{
+					std::cout << candidate.name << " relative_diff_mean: " << candidate.score << " (records: " << records 
+						<< ", time: " << seconds[k] << "s)" << std::endl;
+				}
 			}
-			else if (metric_type == "SSIM")
+			if (error || !is_complete)
 			{
-				// SSIM
-				metric::SSIM<double, Record> distance;
-				relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::SSIM<double, Record>>(graph, distance, dataset, randomized_indexes, isEstimate);
+				break;
 			}
-			else if (metric_type == "TWED")
+			for (size_t k = 0; k < survivors.size(); ++k)
 			{
-				// TWED
-				metric::TWED<double> distance(0, 1);
-				relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::TWED<double>>(graph, distance, dataset, randomized_indexes, isEstimate);
+				completed_scores[survivors[k]] = scores[k];
 			}
-			relative_diff_means.push_back(relative_diff_mean);
 
-			if (verbose)
+			// keep the better half for the next round
+			if (round + 1 < rounds)
 			{
-				std::cout << metric_type << " relative_diff_mean: " << relative_diff_mean << std::endl;
+				std::stable_sort(survivors.begin(), survivors.end(), 
+					[&](size_t a, size_t b) { return completed_scores[a] < completed_scores[b]; });
+				const size_t keep = (survivors.size() + 1) / 2;
+				for (size_t k = keep; k < survivors.size(); ++k)
+				{
+					report[survivors[k]].eliminated = true;
+				}
+				survivors.resize(keep);
+				std::sort(survivors.begin(), survivors.end());
 			}
 		}
-		
-		//Metrics metric;
+		pool.close();
+
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
 
-		std::vector<double>::iterator min_result = std::min_element(relative_diff_means.begin(), relative_diff_means.end());
-		auto best_index = std::distance(relative_diff_means.begin(), min_result);
+		auto best_index = *std::min_element(survivors.begin(), survivors.end(), 
+			[&](size_t a, size_t b) { return completed_scores[a] < completed_scores[b]; });
 		if (verbose)
 		{
 			std::cout << std::endl;
@@ -107,9 +185,76 @@ namespace metric {
 
 		return metric_type_names[best_index];
 	}
+
+	template <typename Record, typename Graph>
+	double MetricAutoDetector::evaluate(const std::string& metric_type, const Graph &graph, int graph_w, int graph_h, const std::vector<Record>& dataset, bool isEstimate)
+	{
+		std::vector<size_t> indexes(dataset.size());
+		std::iota(indexes.begin(), indexes.end(), 0);
+
+		double relative_diff_mean = 0;
+		if (metric_type == "Euclidean")
+		{
+			// Euclidean
+			metric::Euclidean<double> distance;
+			relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::Euclidean<double>>(graph, distance, dataset, indexes, isEstimate);
+		}
+		else if (metric_type == "Manhatten")
+		{
+			// Manhatten
+			metric::Manhatten<double> distance;
+			relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::Manhatten<double>>(graph, distance, dataset, indexes, isEstimate);
+		}
+		else if (metric_type == "P_norm")
+		{
+			// P_norm
+			metric::P_norm<double> distance;
+			relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::P_norm<double>>(graph, distance, dataset, indexes, isEstimate);
+		}
+		else if (metric_type == "Euclidean_thresholded")
+		{
+			// Euclidean_thresholded
+			metric::Euclidean_thresholded<double> distance;
+			relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::Euclidean_thresholded<double>>(graph, distance, dataset, indexes, isEstimate);
+		}
+		else if (metric_type == "Cosine")
+		{
+			// Cosine
+			metric::Cosine<double> distance;
+			relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::Cosine<double>>(graph, distance, dataset, indexes, isEstimate);
+		}
+		else if (metric_type == "Chebyshev")
+		{
+			// Chebyshev
+			metric::Chebyshev<double> distance;
+			relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::Chebyshev<double>>(graph, distance, dataset, indexes, isEstimate);
+		}
+		else if (metric_type == "Earth Mover Distance")
+		{
+			// Earth Mover Distance
+			auto cost_mat = metric::EMD_details::ground_distance_matrix_of_2dgrid<double>(graph_w, graph_h);
+			auto maxCost = metric::EMD_details::max_in_distance_matrix(cost_mat);
+			metric::EMD<double> distance(cost_mat, maxCost);
+			relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::EMD<double>>(graph, distance, dataset, indexes, isEstimate);
+		}
+		else if (metric_type == "SSIM")
+		{
+			// SSIM
+			metric::SSIM<double, Record> distance;
+			relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::SSIM<double, Record>>(graph, distance, dataset, indexes, isEstimate);
+		}
+		else if (metric_type == "TWED")
+		{
+			// TWED
+			metric::TWED<double> distance(0, 1);
+			relative_diff_mean = get_mean_distance_difference<Record, Graph, metric::TWED<double>>(graph, distance, dataset, indexes, isEstimate);
+		}
+
+		return relative_diff_mean;
+	}
 	
 	template <typename Record, typename Graph, typename Metric>
-	double MetricAutoDetector::get_mean_distance_difference(Graph &graph, Metric distance, std::vector<Record> dataset, std::vector<size_t> randomized_indexes, bool isEstimate)
+	double MetricAutoDetector::get_mean_distance_difference(const Graph &graph, Metric distance, const std::vector<Record>& dataset, const std::vector<size_t>& randomized_indexes, bool isEstimate)
 	{		
 		metric::SOM<Record, Graph, Metric> som(graph, distance);
 		if (isEstimate)
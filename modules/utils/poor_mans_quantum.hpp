@@ -67,6 +67,14 @@ public:
      */
     T rnd();
 
+    /**
+     * @brief sample many random values at once
+     *
+     * @param n number of values
+     * @return random values, drawn in parallel batches for discrete distributions
+     */
+    std::vector<T> rnd(size_t n);
+
     /**
      * @brief 
      * 
@@ -112,6 +120,14 @@ public:
      */
     T cdf(T x);
 
+    /**
+     * @brief cumulative distribution function for many points
+     *
+     * @param x
+     * @return
+     */
+    std::vector<T> cdf(const std::vector<T>& x);
+
     /**
      * @brief 
      * 
@@ -205,5 +221,6 @@ private:
 
 }
 #include "poor_mans_quantum/poor_mans_quantum.cpp"
+#include "poor_mans_quantum/expression.hpp"
 
 #endif  // headerguard
@@ -7,6 +7,9 @@
 #ifndef _METRIC_UTILS_POOR_MANS_QUANTUM_DISTRIBUTIONS_BINOMIAL_CPP
 #define _METRIC_UTILS_POOR_MANS_QUANTUM_DISTRIBUTIONS_BINOMIAL_CPP
 
+#include <cassert>
+#include <cmath>
+
 #include "Binomial.hpp"
 
 namespace metric {
@@ -19,19 +22,24 @@ namespace metric {
 	/*** random sampling ***/
 	float Binomial::rnd()
 	{
-		std::binomial_distribution<float> Binomial_dist(_p1, _p2);
-		return Binomial_dist(_generator);
+		std::binomial_distribution<int> Binomial_dist(int(_p1), _p2);
+		return float(Binomial_dist(_generator));
 	}
 
-	// float  Binomial::mean()
-	// {
-	//     return float(1)/_p1*gamma(float(1)+float(1)/_p2);
-	// }
+	float Binomial::mean()
+	{
+		return _p1 * _p2;
+	}
 
-	// float  Binomial::quantil(float p)
-	// {
-	//     return icdf(p);
-	// }
+	float Binomial::variance()
+	{
+		return _p1 * _p2 * (1 - _p2);
+	}
+
+	float Binomial::quantil(float p)
+	{
+		return icdf(p);
+	}
 
 	// /*** pdf ***/
 	// float  Binomial::pdf(const float x)
@@ -45,11 +53,22 @@ namespace metric {
 
 	// }
 
-	// /*** icdf ***/
-	// float  Binomial::icdf(const float x)
-	// {
-	//    return _p1 * std::pow(-std::log(1-x),1/_p2);
-	// }
+	/*** icdf ***/
+	float Binomial::icdf(const float x)
+	{
+		// binary search of the smallest k with cdf(k) >= x
+		int low = 0;
+		int high = int(_p1);
+		while (low < high) {
+			int middle = low + (high - low) / 2;
+			if (cdf(middle) < x) {
+				low = middle + 1;
+			} else {
+				high = middle;
+			}
+		}
+		return float(low);
+	}
 
 	// template <typename float>
 	float lngamma(float z)
@@ -171,10 +190,17 @@ namespace metric {
 	//param p success probability of single trial
 	float Binomial::cdf(int kk)
 	{
+		int n = int(_p1);
+		if (kk < 0) {
+			return 0;
+		}
+		if (kk >= n) {
+			return 1;
+		}
+		// P(X <= k) = I_{1-p}(n - k, k + 1)
 		float k = float(kk);
-		float n = float(_data.size());
-		float p = _p1;
-		return betai(k, n - k + 1, p);
+		float p = _p2;
+		return betai(float(n) - k, k + 1, 1 - p);
 	}
 
 }
@@ -15,6 +15,8 @@ namespace metric {
  * @class Binomial
  * 
  * @brief Class represents binomial distribution
+ *
+ * _p1 is the number of trials, _p2 the success probability of a single trial.
  */
 
 class Binomial {
@@ -35,14 +37,40 @@ public:
     /**
      * @brief cumulative distribution function 
      * 
-     * @param x 
-     * @return
+     * @param x number of successes
+     * @return probability of at most x successes
      */
     float cdf(const int x);
 
-    // float icdf(const float x);
-    // float mean();
-    // float quantil(float p);
+    /**
+     * @brief inverse cumulative distribution function
+     *
+     * @param x probability
+     * @return smallest number of successes with cdf not below x
+     */
+    float icdf(const float x);
+
+    /**
+     * @brief long-run average value of repetitions of the same experiment
+     *
+     * @return number of trials times the success probability
+     */
+    float mean();
+
+    /**
+     * @brief expectation of the squared deviation of a random variable from its mean
+     *
+     * @return variance value of the Binomial distribution
+     */
+    float variance();
+
+    /**
+     * @brief quantil function, the same as icdf()
+     *
+     * @param p
+     * @return
+     */
+    float quantil(float p);
 
     // float pdf(const float x);
 
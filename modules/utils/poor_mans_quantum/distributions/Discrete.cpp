@@ -8,42 +8,101 @@
 #ifndef _METRIC_UTILS_POOR_MANS_QUANTUM_DISTRIBUTIONS_DISCRETE_CPP
 #define _METRIC_UTILS_POOR_MANS_QUANTUM_DISTRIBUTIONS_DISCRETE_CPP
 
+#include <algorithm>
 #include <random>
+#include <thread>
 #include <vector>
 
 #include "../math_functions.hpp"
 
 namespace metric {
 
+namespace Discrete_details {
+
+    // values sampled from one seed, also the smallest amount of work given to a thread
+    constexpr size_t sample_chunk = 1 << 10;
+
+}  // namespace Discrete_details
+
 template <typename T>
 Discrete<T>::Discrete()
     : _generator(std::random_device {}())
 {
 }
 
+template <typename T>
+void Discrete<T>::seed(size_t seed)
+{
+    _generator.seed(seed);
+}
+
+template <typename T>
+void Discrete<T>::update()
+{
+    _cdf_spline = AkimaSpline<T>(_data, _prob);
+    _quantile_spline = AkimaSpline<T>(_prob, _data);
+}
+
 template <typename T>
 T Discrete<T>::rnd()
 {
     std::uniform_real_distribution<T> Discrete_dist(T(0), T(1));
-    std::vector<T> values;
-    values.push_back(Discrete_dist(_generator));
-    return akimaInterp1(_prob, _data, values)[0];
+    return _quantile_spline(Discrete_dist(_generator));
+}
+
+template <typename T>
+std::vector<T> Discrete<T>::rnd(size_t n)
+{
+    std::vector<T> result(n);
+    const size_t chunk = Discrete_details::sample_chunk;
+    const size_t chunks = (n + chunk - 1) / chunk;
+    std::vector<std::mt19937_64::result_type> seeds(chunks);
+    for (auto& seed : seeds) {
+        seed = _generator();
+    }
+
+    auto sample = [&](size_t c) {
+        std::mt19937_64 generator(seeds[c]);
+        std::uniform_real_distribution<T> Discrete_dist(T(0), T(1));
+        const size_t end = std::min(n, (c + 1) * chunk);
+        for (size_t i = c * chunk; i < end; ++i) {
+            result[i] = _quantile_spline(Discrete_dist(generator));
+        }
+    };
+
+    // every thread gets a contiguous range of about n / threads values, the seeds stay per chunk
+    const size_t threads = std::max<size_t>(std::min<size_t>(chunks, std::thread::hardware_concurrency()), 1);
+    const size_t chunks_per_thread = (chunks + threads - 1) / threads;
+    if (threads == 1) {
+        for (size_t c = 0; c < chunks; ++c) {
+            sample(c);
+        }
+        return result;
+    }
+    std::vector<std::thread> workers;
+    for (size_t begin = 0; begin < chunks; begin += chunks_per_thread) {
+        workers.emplace_back([&, begin]() {
+            for (size_t c = begin; c < std::min(chunks, begin + chunks_per_thread); ++c) {
+                sample(c);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return result;
 }
 
 template <typename T>
 T Discrete<T>::median()
 {
-    std::vector<T> values;
-    values.push_back(0.5);
-    return akimaInterp1(_prob, _data, values)[0];
+    return _quantile_spline(T(0.5));
 }
 
 template <typename T>
 T Discrete<T>::quantil(T p)
 {
-    std::vector<T> values;
-    values.push_back(p);
-    return akimaInterp1(_prob, _data, values)[0];
+    return _quantile_spline(p);
 }
 
 template <typename T>
@@ -88,30 +147,41 @@ T Discrete<T>::cdf(const T x)
 {
 	// Updated cdf calculation by Stepan Mamontov 04.02.2020
 	// Updated by return interpolated func of cumulative propability from distributed value
-    std::vector<T> values;
-    values.push_back(x);
-	T result = akimaInterp1(_data, _prob, values)[0];
-	
+
 	// cut probs over the _data values
 	if (x < _data[0])
 	{
-		result = 0;
+		return 0;
 	}
 	
 	if (x > _data[_data.size() - 1])
 	{
-		result = 1;
+		return 1;
 	}
 
-	return result;
+	return _cdf_spline(x);
+}
+
+template <typename T>
+std::vector<T> Discrete<T>::cdf(const std::vector<T>& x)
+{
+    auto result = _cdf_spline(x);
+    for (size_t i = 0; i < x.size(); ++i) {
+        // cut probs over the _data values
+        if (x[i] < _data[0]) {
+            result[i] = 0;
+        } else if (x[i] > _data[_data.size() - 1]) {
+            result[i] = 1;
+        }
+    }
+    return result;
 }
 
 /*** icdf ***/
 template <typename T>
 T Discrete<T>::icdf(const T x) { 
-
-	// TODO:NEED TO IMPLEMENT!!!
-    return (T) 0;
+    // inverse of the interpolated cdf is the quantile function
+    return quantil(x);
 }
 
 }  // end namespace metric
@@ -10,6 +10,9 @@
 
 #include <random>
 #include <vector>
+
+#include "../math_functions.hpp"
+
 namespace metric {
 
 /**
@@ -40,6 +43,17 @@ public:
      */
     T rnd();
 
+    /**
+     * @brief sample many random values, large batches are sampled in parallel
+     *
+     * Uniforms are drawn in chunks with generators seeded from the distribution generator, so the result does not
+     * depend on the number of threads.
+     *
+     * @param n number of values
+     * @return random values according to the distribution
+     */
+    std::vector<T> rnd(size_t n);
+
     /**
      * @brief 
      * 
@@ -85,6 +99,14 @@ public:
      */
     T cdf(const T x);
 
+    /**
+     * @brief cumulative distribution function for many points, ascending points are evaluated in O(n + m)
+     *
+     * @param x
+     * @return
+     */
+    std::vector<T> cdf(const std::vector<T>& x);
+
     /**
      * @brief  inverse cumulative distribution function 
      * 
@@ -93,6 +115,11 @@ public:
      */
     T icdf(const T x);
 
+    /**
+     * @brief rebuild the cdf and quantile splines, must be called after assigning _data or _prob
+     */
+    void update();
+
     T _p1;
     T _p2;
     std::vector<T> _data;
@@ -100,6 +127,10 @@ public:
 
 private:
     std::mt19937_64 _generator;
+
+    // splines over (_data, _prob) and (_prob, _data), built by update()
+    AkimaSpline<T> _cdf_spline;
+    AkimaSpline<T> _quantile_spline;
 };
 
 }  // end namespace metric
@@ -0,0 +1,173 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this
+  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2020 Panda Team
+*/
+
+#ifndef _METRIC_UTILS_POOR_MANS_QUANTUM_EXPRESSION_CPP
+#define _METRIC_UTILS_POOR_MANS_QUANTUM_EXPRESSION_CPP
+
+#include "expression.hpp"
+
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace metric {
+
+namespace PMQ_details {
+
+    /** inverse cdf sampling with a generator of the variable **/
+    template <typename T, typename Distribution>
+    std::function<std::vector<T>(size_t)> variable_sampler(Distribution dist, size_t seed)
+    {
+        auto state
+            = std::make_shared<std::pair<Distribution, std::mt19937_64>>(std::move(dist), std::mt19937_64(seed));
+        return [state](size_t n) {
+            std::uniform_real_distribution<double> uniform(std::nextafter(0.0, 1.0), 1.0);
+            std::vector<T> values(n);
+            for (auto& value : values) {
+                value = T(state->first.icdf(uniform(state->second)));
+            }
+            return values;
+        };
+    }
+
+    /** discrete variables are sampled in batches, the copy gets its own seed **/
+    template <typename T, typename V>
+    std::function<std::vector<T>(size_t)> variable_sampler(Discrete<V> dist, size_t seed)
+    {
+        dist.seed(seed);
+        auto state = std::make_shared<Discrete<V>>(std::move(dist));
+        return [state](size_t n) {
+            auto values = state->rnd(n);
+            return std::vector<T>(values.begin(), values.end());
+        };
+    }
+
+    template <typename T>
+    T apply(typename expression_node<T>::kind operation, T a, T b)
+    {
+        using kind = typename expression_node<T>::kind;
+        switch (operation) {
+        case kind::plus:
+            return a + b;
+        case kind::minus:
+            return a - b;
+        case kind::multiplies:
+            return a * b;
+        case kind::divides:
+            return a / b;
+        default:
+            throw std::invalid_argument("not a binary operation");
+        }
+    }
+
+    /**
+     * @brief values of the node for every sample, each node is evaluated once per pass
+     *
+     * @param memo values of evaluated nodes, references to them stay valid while the pass runs
+     */
+    template <typename T>
+    const std::vector<T>& evaluate(const expression_node<T>* node, size_t samples,
+        std::unordered_map<const expression_node<T>*, std::vector<T>>& memo)
+    {
+        using kind = typename expression_node<T>::kind;
+        auto found = memo.find(node);
+        if (found != memo.end()) {
+            return found->second;
+        }
+        std::vector<T> values;
+        if (node->type == kind::variable) {
+            values = node->sample(samples);
+        } else if (node->left->type == kind::constant) {
+            auto& right = evaluate(node->right.get(), samples, memo);
+            values.resize(samples);
+            for (size_t i = 0; i < samples; ++i) {
+                values[i] = apply(node->type, node->left->value, right[i]);
+            }
+        } else if (node->right->type == kind::constant) {
+            auto& left = evaluate(node->left.get(), samples, memo);
+            values.resize(samples);
+            for (size_t i = 0; i < samples; ++i) {
+                values[i] = apply(node->type, left[i], node->right->value);
+            }
+        } else {
+            auto& left = evaluate(node->left.get(), samples, memo);
+            auto& right = evaluate(node->right.get(), samples, memo);
+            values.resize(samples);
+            for (size_t i = 0; i < samples; ++i) {
+                values[i] = apply(node->type, left[i], right[i]);
+            }
+        }
+        return memo.emplace(node, std::move(values)).first->second;
+    }
+
+}  // namespace PMQ_details
+
+template <typename T>
+LazyPMQ<T>::LazyPMQ(T constant)
+{
+    auto constant_node = std::make_shared<node_type>();
+    constant_node->type = node_type::kind::constant;
+    constant_node->value = constant;
+    node = constant_node;
+}
+
+template <typename T>
+template <typename Distribution, typename U>
+LazyPMQ<T>::LazyPMQ(const PMQ<Distribution, U>& rv, size_t seed)
+{
+    auto variable = std::make_shared<node_type>();
+    variable->type = node_type::kind::variable;
+    variable->size = rv._dist._data.size();
+    variable->sample = PMQ_details::variable_sampler<T>(rv._dist, seed);
+    node = variable;
+}
+
+template <typename T>
+LazyPMQ<T>::LazyPMQ(typename node_type::kind operation, const LazyPMQ& a, const LazyPMQ& b)
+{
+    auto operation_node = std::make_shared<node_type>();
+    if (a.node->type == node_type::kind::constant && b.node->type == node_type::kind::constant) {
+        // fold constants
+        operation_node->type = node_type::kind::constant;
+        operation_node->value = PMQ_details::apply(operation, a.node->value, b.node->value);
+    } else {
+        operation_node->type = operation;
+        if (a.node->size == 0 || b.node->size == 0) {
+            operation_node->size = a.node->size + b.node->size;
+        } else {
+            operation_node->size = (a.node->size + b.node->size) / 2;
+        }
+        operation_node->left = a.node;
+        operation_node->right = b.node;
+    }
+    node = operation_node;
+}
+
+template <typename T>
+PMQ<Discrete<float>>& LazyPMQ<T>::evaluate() const
+{
+    if (result) {
+        return *result;
+    }
+    if (node->type == node_type::kind::constant) {
+        throw std::invalid_argument("expression has no random variable");
+    }
+    std::vector<float> y;
+    {
+        std::unordered_map<const node_type*, std::vector<T>> memo;
+        auto& values = PMQ_details::evaluate(node.get(), RV_SAMPLES, memo);
+        y.assign(values.begin(), values.end());
+    }
+    // the only sort of the pass, the distribution gets the sorted values without sorting again
+    result = std::make_shared<PMQ<Discrete<float>>>(resize(std::move(y), node->size));
+    return *result;
+}
+
+}  // namespace metric
+#endif  // header guard
@@ -0,0 +1,126 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this
+  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2020 Panda Team
+*/
+
+#ifndef _METRIC_UTILS_POOR_MANS_QUANTUM_EXPRESSION_HPP
+#define _METRIC_UTILS_POOR_MANS_QUANTUM_EXPRESSION_HPP
+
+#include <functional>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <vector>
+
+namespace metric {
+
+namespace PMQ_details {
+
+    /**
+     * @brief node of a lazy PMQ expression: random variable, constant or binary operation on two nodes
+     */
+    template <typename T>
+    struct expression_node {
+        enum class kind { variable, constant, plus, minus, multiplies, divides };
+
+        kind type = kind::constant;
+        T value = 0;
+        // size of the materialized distribution, 0 for constants
+        size_t size = 0;
+        // draws n values of the variable from its own random stream
+        std::function<std::vector<T>(size_t)> sample;
+        std::shared_ptr<const expression_node> left;
+        std::shared_ptr<const expression_node> right;
+    };
+
+}  // namespace PMQ_details
+
+/**
+ * @class LazyPMQ
+ *
+ * @brief Deferred arithmetic on PMQ random variables.
+ *
+ * Operations build an expression graph instead of resampling and sorting a new distribution for every operation.
+ * The graph is evaluated in one pass of RV_SAMPLES values when a statistic of the result is requested: every
+ * variable is sampled once from its own random stream, operations are applied elementwise and only the final values
+ * are sorted. An expression used several times in a graph contributes the same samples each time, so for
+ * auto x = lazy(rv) the difference x - x is zero, while lazy(rv) - lazy(rv) are two independent copies of rv.
+ *
+ * @tparam T value type
+ */
+template <typename T = float>
+class LazyPMQ {
+public:
+    /**
+     * @brief Construct a constant expression
+     *
+     * @param constant
+     */
+    LazyPMQ(T constant);
+
+    /**
+     * @brief Construct an expression of a random variable, the distribution is copied
+     *
+     * @param rv random variable
+     * @param seed seed of the random stream of the variable
+     */
+    template <typename Distribution, typename U>
+    LazyPMQ(const PMQ<Distribution, U>& rv, size_t seed = std::random_device {}());
+
+    /**
+     * @brief evaluate the expression, the result is computed once and kept
+     *
+     * @return distribution of the expression
+     */
+    PMQ<Discrete<float>>& evaluate() const;
+
+    /**
+     * @brief size of the distribution of the expression, the mean size of the operands as for PMQ operations
+     */
+    size_t size() const { return node->size; }
+
+    T cdf(T x) const { return evaluate().cdf(x); }
+    T quantil(T p) const { return evaluate().quantil(p); }
+    T median() const { return evaluate().median(); }
+    T mean() const { return evaluate().mean(); }
+    T variance() const { return evaluate().variance(); }
+
+    std::tuple<PMQ<Discrete<float>>, PMQ<Discrete<float>>> confidence(const T& confidencelevel = 1 - RV_ERROR) const
+    {
+        return evaluate().confidence(confidencelevel);
+    }
+
+    friend LazyPMQ operator+(const LazyPMQ& a, const LazyPMQ& b) { return LazyPMQ(node_type::kind::plus, a, b); }
+    friend LazyPMQ operator-(const LazyPMQ& a, const LazyPMQ& b) { return LazyPMQ(node_type::kind::minus, a, b); }
+    friend LazyPMQ operator*(const LazyPMQ& a, const LazyPMQ& b) { return LazyPMQ(node_type::kind::multiplies, a, b); }
+    friend LazyPMQ operator/(const LazyPMQ& a, const LazyPMQ& b) { return LazyPMQ(node_type::kind::divides, a, b); }
+
+private:
+    using node_type = PMQ_details::expression_node<T>;
+
+    std::shared_ptr<const node_type> node;
+    mutable std::shared_ptr<PMQ<Discrete<float>>> result;
+
+    LazyPMQ(typename node_type::kind operation, const LazyPMQ& a, const LazyPMQ& b);
+};
+
+/**
+ * @brief start a lazy expression with a random variable
+ *
+ * @param rv random variable
+ * @param seed seed of the random stream of the variable
+ * @return expression of the variable
+ */
+template <typename Distribution, typename T>
+LazyPMQ<T> lazy(const PMQ<Distribution, T>& rv, size_t seed = std::random_device {}())
+{
+    return LazyPMQ<T>(rv, seed);
+}
+
+}  // namespace metric
+
+#include "expression.cpp"
+#endif  // header guard
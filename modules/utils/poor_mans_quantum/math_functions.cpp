@@ -11,6 +11,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <cmath>
 
 namespace metric {
 
@@ -38,81 +39,120 @@ linspace(T a, T b, int n)
 
 
 template <typename T>
-std::vector<T>
-akimaInterp1(std::vector<T> const &x, std::vector<T> const &y, std::vector<T> const &xi, bool save_Mode )
+AkimaSpline<T>::AkimaSpline(std::vector<T> const& x, std::vector<T> const& y)
+    : _x(x)
+    , _y(y)
 {
-// check inputs
-
-	//calculate u vector
-	auto uVec = [](std::vector<T> const &x, std::vector<T> const &y) {
-		size_t n = x.size();
-		std::vector<T> u((n + 3));
-		for (size_t i = 1; i < n; ++i)
-		{
-		u[i + 1] = (y[i] - y[i - 1]) / (x[i] - x[i - 1]); // Shift i to i+2
-		}
-
-		auto akima_end = [](const T &u1, const T &u2) {
-		return 2.0 * u1 - u2;
-		};
+    size_t n = x.size();
+    if (n < 2) {
+        return;
+    }
 
-		u[1] = akima_end(u[2], u[3]);
-		u[0] = akima_end(u[1], u[2]);
-		u[n + 1] = akima_end(u[n], u[n - 1]);
-		u[n + 2] = akima_end(u[n + 1], u[n]);
+    // calculate u vector
+    _u.resize(n + 3);
+    for (size_t i = 1; i < n; ++i) {
+        _u[i + 1] = (y[i] - y[i - 1]) / (x[i] - x[i - 1]);  // Shift i to i+2
+    }
 
-		return u;
-	};
-	std::vector<T> u = uVec(x, y);
+    auto akima_end = [](const T& u1, const T& u2) { return 2.0 * u1 - u2; };
+
+    _u[1] = akima_end(_u[2], _u[3]);
+    _u[0] = akima_end(_u[1], _u[2]);
+    _u[n + 1] = akima_end(_u[n], _u[n - 1]);
+    _u[n + 2] = akima_end(_u[n + 1], _u[n]);
+
+    // calculate yp vector
+    _yp.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        auto a = std::abs(_u[i + 3] - _u[i + 2]);
+        auto b = std::abs(_u[i + 1] - _u[i]);
+        if ((a + b) != 0) {
+            _yp[i] = (a * _u[i + 1] + b * _u[i + 2]) / (a + b);
+        } else {
+            _yp[i] = (_u[i + 2] + _u[i + 1]) / 2.0;
+        }
+    }
 
-	// calculate yp vector
-	std::vector<T> yp(x.size());
-	for (size_t i = 0; i < x.size(); ++i)
-	{
-		auto a = std::abs(u[i + 3] - u[i + 2]);
-		auto b = std::abs(u[i + 1] - u[i]);
-		if ((a + b) != 0)
-		{
-		yp[i] = (a * u[i + 1] + b * u[i + 2]) / (a + b);
-		}
-		else
-		{
-		yp[i] = (u[i + 2] + u[i + 1]) / 2.0;
-		}
-	}
+    // equally spaced knots up to rounding
+    T step = (x[n - 1] - x[0]) / T(n - 1);
+    bool uniform = step > 0;
+    for (size_t i = 1; uniform && i < n; ++i) {
+        uniform = std::abs(x[i] - x[0] - T(i) * step) <= step / 4;
+    }
+    if (uniform) {
+        _step = step;
+    }
+}
 
-	// calculte interpolated yi values
-	auto kFind = [](const T &xii, const std::vector<T> &x, int start, int end) {
+template <typename T>
+size_t AkimaSpline<T>::locate(T xi) const
+{
+    // segment k with x[k] <= xi < x[k + 1], the first and the last segment are extended
+    const size_t last = _x.size() - 2;
+    if (_step == 0) {
+        return std::upper_bound(_x.begin() + 1, _x.end() - 1, xi) - _x.begin() - 1;
+    }
+    T t = (xi - _x[0]) / _step;
+    size_t k = t > 0 ? (t < T(last) ? size_t(t) : last) : 0;
+    // the guess is off by one at most due to rounding
+    while (k > 0 && xi < _x[k]) {
+        --k;
+    }
+    while (k < last && !(xi < _x[k + 1])) {
+        ++k;
+    }
+    return k;
+}
 
-		int klo = start;
-		int khi = end;
-		// // Find subinterval by bisection
-		while (khi - klo > 1)
-		{
-		int k = (khi + klo) / 2;
-		x[k] > xii ? khi = k : klo = k;
-		}
-		return klo;
-	};
+template <typename T>
+T AkimaSpline<T>::segment(size_t k, T xi) const
+{
+    // Evaluate Akima polynomial
+    T b = _x[k + 1] - _x[k];
+    T a = xi - _x[k];
+    return _y[k] + _yp[k] * a + (3.0 * _u[k + 2] - 2.0 * _yp[k] - _yp[k + 1]) * a * a / b
+        + (_yp[k] + _yp[k + 1] - 2.0 * _u[k + 2]) * a * a * a / (b * b);
+}
 
-	std::vector<T> yi(xi.size());
-	for (size_t i = 0; i < xi.size(); ++i)
-	{
-		// Find the right place in the table by means of a bisection.
-		int k = kFind(xi[i], x, int(0), x.size() - 1);
+template <typename T>
+T AkimaSpline<T>::operator()(T xi) const
+{
+    if (_x.size() < 2) {
+        return _y.empty() ? T(0) : _y[0];
+    }
+    return segment(locate(xi), xi);
+}
 
-		// Evaluate Akima polynomial
-		T b = x[k + 1] - x[k];
-		T a = xi[i] - x[k];
-		yi[i] = y[k] + yp[k] * a + (3.0 * u[k + 2] - 2.0 * yp[k] - yp[k + 1]) * a * a / b + (yp[k] + yp[k + 1] - 2.0 * u[k + 2]) * a * a * a / (b * b);
+template <typename T>
+std::vector<T> AkimaSpline<T>::operator()(std::vector<T> const& xi) const
+{
+    std::vector<T> yi(xi.size());
+    if (_x.size() < 2) {
+        std::fill(yi.begin(), yi.end(), _y.empty() ? T(0) : _y[0]);
+        return yi;
+    }
 
-		// Differentiate to find the second-order interpolant
-		//ypi[i] = yp[k] + (3.0u[k+2] - 2.0yp[k] - yp[k+1])2a/b + (yp[k] + yp[k+1] - 2.0u[k+2])3aa/(b*b);
+    const size_t last = _x.size() - 2;
+    size_t k = 0;
+    for (size_t i = 0; i < xi.size(); ++i) {
+        if (i > 0 && xi[i] >= xi[i - 1]) {
+            // ascending points: continue from the previous segment
+            while (k < last && _x[k + 1] <= xi[i]) {
+                ++k;
+            }
+        } else {
+            k = locate(xi[i]);
+        }
+        yi[i] = segment(k, xi[i]);
+    }
+    return yi;
+}
 
-		// Differentiate to find the first-order interpolant
-		//yppi[i] = (3.0u[k+2] - 2.0yp[k] - yp[k+1])2/b + (yp[k] + yp[k+1] - 2.0u[k+2])6a/(b*b);
-	}
-	return yi;
+template <typename T>
+std::vector<T>
+akimaInterp1(std::vector<T> const &x, std::vector<T> const &y, std::vector<T> const &xi, bool /*save_Mode*/)
+{
+    return AkimaSpline<T>(x, y)(xi);
 }
 
 template <typename T>
@@ -25,6 +25,58 @@ template <typename T>
 std::vector<T> linspace(T a, T b, int n);
 
 
+/**
+ * @class AkimaSpline
+ *
+ * @brief Akima spline through the points (x, y), x sorted ascending.
+ *
+ * @details The slopes are computed once on construction, every evaluation is a binary search and one cubic segment.
+ * Equally spaced knots, like the probabilities of PMQ samples, are located in O(1).
+ * Ref. : Hiroshi Akima, Journal of the ACM, Vol. 17, No. 4, October 1970, pages 589-602.
+ */
+template <typename T>
+class AkimaSpline {
+public:
+    AkimaSpline() = default;
+
+    /**
+     * @brief Construct a new AkimaSpline object
+     *
+     * @param x sorted knots
+     * @param y values at knots
+     */
+    AkimaSpline(std::vector<T> const& x, std::vector<T> const& y);
+
+    /**
+     * @brief interpolate single point in O(log n), in O(1) for equally spaced knots
+     *
+     * @param xi
+     * @return interpolated value, the end segments are extrapolated
+     */
+    T operator()(T xi) const;
+
+    /**
+     * @brief interpolate many points, ascending points are located by a linear walk over the knots
+     *
+     * @param xi
+     * @return interpolated values
+     */
+    std::vector<T> operator()(std::vector<T> const& xi) const;
+
+private:
+    std::vector<T> _x;
+    std::vector<T> _y;
+    // slopes of the segments, shifted by 2 and extended by two points at both ends
+    std::vector<T> _u;
+    // slopes at the knots
+    std::vector<T> _yp;
+    // knot spacing if the knots are equally spaced, 0 otherwise
+    T _step = 0;
+
+    size_t locate(T xi) const;
+    T segment(size_t k, T xi) const;
+};
+
 /**
  * @brief akima interpolation
  * 
@@ -32,7 +84,7 @@ std::vector<T> linspace(T a, T b, int n);
  * @param x 
  * @param y 
  * @param xi 
- * @param save_Mode 
+ * @param save_Mode unused, kept for compatibility
  * @return
  */
 template <typename T>
@@ -12,9 +12,12 @@
 
 #include "../../../3rdparty/blaze/Math.h"
 
+#include <algorithm>
+#include <functional>
 #include <limits>
 #include <random>
 #include <map>
+#include <type_traits>
 
 #ifdef USE_VECTOR_SORT
 #include "3dparty/vector_sort.hpp"
@@ -23,12 +26,65 @@
 #include "math_functions.hpp"
 #include "distributions/Normal.hpp"
 #include "distributions/Weibull.hpp"
-//#include "distributions/Binomial.hpp"
+#include "distributions/Binomial.hpp"
 #include "distributions/Discrete.hpp"
 
 
 namespace metric {
 
+namespace PMQ_details {
+
+    /** sample any distribution value by value **/
+    template <typename Distribution>
+    auto sample(Distribution& dist, size_t n) -> std::vector<decltype(dist.rnd())>
+    {
+        std::vector<decltype(dist.rnd())> result(n);
+        for (auto& value : result) {
+            value = dist.rnd();
+        }
+        return result;
+    }
+
+    /** parametric distributions evaluate their formulas, there is nothing to rebuild **/
+    template <typename Distribution>
+    void update(Distribution&)
+    {
+    }
+
+    /** interpolation splines of discrete distributions are built from the samples **/
+    template <typename T>
+    void update(Discrete<T>& dist)
+    {
+        dist.update();
+    }
+
+    /** discrete distributions are sampled in batches **/
+    template <typename T>
+    std::vector<T> sample(Discrete<T>& dist, size_t n)
+    {
+        return dist.rnd(n);
+    }
+
+    /**
+     * @brief Monte-Carlo distribution of a binary operation on independent random variables
+     *
+     * Both operands are sampled in one batch of RV_SAMPLES values, the result is resized to the mean size of operands.
+     */
+    template <typename D1, typename D2, typename T1, typename T2, typename Operation>
+    PMQ<Discrete<float>> combine(PMQ<D1, T1>& rv1, PMQ<D2, T2>& rv2, Operation operation)
+    {
+        size_t n = (rv1._dist._data.size() + rv2._dist._data.size()) / 2;
+        auto y1 = rv1.rnd(RV_SAMPLES);
+        auto y2 = rv2.rnd(RV_SAMPLES);
+        std::vector<float> y(RV_SAMPLES);
+        for (size_t i = 0; i < y.size(); ++i) {
+            y[i] = operation(y1[i], y2[i]);
+        }
+        return PMQ<Discrete<float>>(resize(std::move(y), n));
+    }
+
+}  // namespace PMQ_details
+
 
 /*** constructor for univariate distribution ***/
 template <typename Distribution, typename T>
@@ -45,6 +101,7 @@ PMQ<Distribution, T>::PMQ(T par1, T par2, size_t n, Distribution d)
     {
         _dist._data[i] = icdf(_dist._prob[i]);
     }
+    PMQ_details::update(_dist);
 }
 
 /*** constructor for discrete samples ***/
@@ -53,21 +110,26 @@ PMQ<Distribution, T>::PMQ(std::vector<T> data, Distribution d)
     : _dist(d)
     , _generator(std::random_device {}())
 {
-    _dist._data.resize(data.size());
-    for (size_t i = 0; i < data.size(); ++i) {
-        _dist._data[i] = T(data[i]);
+    // results of arithmetic operations are sorted already
+    if constexpr (std::is_same<decltype(_dist._data), std::vector<T>>::value) {
+        _dist._data = std::move(data);
+    } else {
+        _dist._data.assign(data.begin(), data.end());
     }
+    if (!std::is_sorted(_dist._data.begin(), _dist._data.end())) {
 #if USE_VECTOR_SORT
-    vector_sort::sort(_dist._data);
+        vector_sort::sort(_dist._data);
 #else
-    std::sort(_dist._data.begin(), _dist._data.end());
+        std::sort(_dist._data.begin(), _dist._data.end());
 #endif
-    auto prob = linspace(T(0.5) / T(data.size()), T(1) - T(0.5) / T(data.size()), data.size());
+    }
+    auto prob = linspace(T(0.5) / T(_dist._data.size()), T(1) - T(0.5) / T(_dist._data.size()), _dist._data.size());
 
     _dist._prob.resize(prob.size());
     for (size_t i = 0; i < prob.size(); ++i) {
         _dist._prob[i] = T(prob[i]);
     }
+    PMQ_details::update(_dist);
 }
 
 template <typename Distribution, typename T>
@@ -88,19 +150,16 @@ mT PMQ<Distribution, T>::believe(mT rv)
     size_t it2 = std::round((n2)/float(n) * float(RV_SAMPLES));
 
 
-    std::vector<float> y1(it1);
+    auto samples = rnd(it1 + 2 * it2);
+    auto values3 = rv.rnd(it2);
+    std::vector<float> y1(samples.begin(), samples.begin() + it1);
     std::vector<float> y2(it2);
 
-    for (size_t i = 0; i < it1; ++i)
-    {
-        y1[i] = rnd();
-    }
-
     for (size_t i = 0; i < it2; ++i)
     {
-        auto value1 = rnd();
-        auto value2 = rnd();
-        auto value3 = rv.rnd();
+        auto value1 = samples[it1 + 2 * i];
+        auto value2 = samples[it1 + 2 * i + 1];
+        auto value3 = values3[i];
 
         if (std::abs(value3 - value1) < std::abs(value3 - value2))
             y2[i] = value1;
@@ -110,7 +169,7 @@ mT PMQ<Distribution, T>::believe(mT rv)
 
     y1.insert(y1.end(), y2.begin(), y2.end()); // concat vectors
 
-    mT out(resize(y1, n/2));
+    mT out(resize(std::move(y1), n/2));
     return out;
 }
 
@@ -120,6 +179,17 @@ T PMQ<Distribution, T>::rnd()
     return _dist.rnd();
 }
 
+template <typename Distribution, typename T>
+std::vector<T> PMQ<Distribution, T>::rnd(size_t n)
+{
+    auto values = PMQ_details::sample(_dist, n);
+    if constexpr (std::is_same<decltype(values), std::vector<T>>::value) {
+        return values;
+    } else {
+        return std::vector<T>(values.begin(), values.end());
+    }
+}
+
 template <typename Distribution, typename T>
 T PMQ<Distribution, T>::mean()
 {
@@ -150,6 +220,12 @@ T PMQ<Distribution, T>::cdf(T x)
     return _dist.cdf(x);
 }
 
+template <typename Distribution, typename T>
+std::vector<T> PMQ<Distribution, T>::cdf(const std::vector<T>& x)
+{
+    return _dist.cdf(x);
+}
+
 template <typename Distribution, typename T>
 T PMQ<Distribution, T>::icdf(T x)
 {
@@ -168,14 +244,7 @@ template <typename D1, typename D2, typename T1, typename T2>
 PMQ<Discrete<float>>
 operator+(PMQ<D1, T1>& rv1, PMQ<D2, T2>& rv2)
 {
-    size_t n = (rv1._dist._data.size() + rv2._dist._data.size()) / 2;
-    std::vector<float> y(RV_SAMPLES);
-    for (size_t i = 0; i < y.size(); ++i)
-    {
-        y[i] = rv1.rnd() + rv2.rnd();
-    }
-    PMQ<Discrete<float>> out(resize(y, n));
-    return out;
+    return PMQ_details::combine(rv1, rv2, std::plus<>());
 }
 
 template <typename D, typename T>
@@ -239,14 +308,7 @@ template <typename D1, typename D2, typename T1, typename T2>
 PMQ<Discrete<float>>
 operator-(PMQ<D1, T1>& rv1, PMQ<D2, T2>& rv2)
 {
-    size_t n = (rv1._dist._data.size() + rv2._dist._data.size()) / 2;
-    std::vector<float> y(RV_SAMPLES);
-    for (size_t i = 0; i < y.size(); ++i)
-    {
-        y[i] = rv1.rnd() - rv2.rnd();
-    }
-    PMQ<Discrete<float>> out(resize(y, n));
-    return out;
+    return PMQ_details::combine(rv1, rv2, std::minus<>());
 }
 
 template <typename D, typename T>
@@ -310,14 +372,7 @@ template <typename D1, typename D2, typename T1, typename T2>
 PMQ<Discrete<float>>
 operator*(PMQ<D1, T1>& rv1, PMQ<D2, T2>& rv2)
 {
-    size_t n = (rv1._dist._data.size() + rv2._dist._data.size()) / 2;
-    std::vector<float> y(RV_SAMPLES);
-    for (size_t i = 0; i < y.size(); ++i)
-    {
-        y[i] = rv1.rnd() * rv2.rnd();
-    }
-    PMQ<Discrete<float>> out(resize(y, n));
-    return out;
+    return PMQ_details::combine(rv1, rv2, std::multiplies<>());
 }
 
 template <typename D, typename T>
@@ -381,14 +436,7 @@ template <typename D1, typename D2, typename T1, typename T2>
 PMQ<Discrete<float>>
 operator/(PMQ<D1, T1>& rv1, PMQ<D2, T2>& rv2)
 {
-    size_t n = (rv1._dist._data.size() + rv2._dist._data.size()) / 2;
-    std::vector<float> y(RV_SAMPLES);
-    for (size_t i = 0; i < y.size(); ++i)
-    {
-        y[i] = rv1.rnd() / rv2.rnd();
-    }
-    PMQ<Discrete<float>> out(resize(y, n));
-    return out;
+    return PMQ_details::combine(rv1, rv2, std::divides<>());
 }
 
 template <typename D, typename T>
@@ -497,10 +545,11 @@ split(T1 rv)
     size_t n = rv._dist._data.size() / 2;
     std::vector<float> y1(RV_SAMPLES);
     std::vector<float> y2(RV_SAMPLES);
+    auto samples = rv.rnd(2 * y1.size());
     for (size_t i = 0; i < y1.size(); ++i)
     {
-        auto value1 = rv.rnd();
-        auto value2 = rv.rnd();
+        auto value1 = samples[2 * i];
+        auto value2 = samples[2 * i + 1];
 
         if (value1 > value2)
         {
@@ -509,8 +558,8 @@ split(T1 rv)
         y1[i] = value1;
         y2[i] = value2;
     }
-    PMQ<Discrete<float>> out1(resize(y1, n));
-    PMQ<Discrete<float>> out2(resize(y2, n));
+    PMQ<Discrete<float>> out1(resize(std::move(y1), n));
+    PMQ<Discrete<float>> out2(resize(std::move(y2), n));
     return {out1, out2};
 }
 
@@ -0,0 +1,98 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+
+#ifndef _METRIC_UTILS_SUBSAMPLE_WAVES_HPP
+#define _METRIC_UTILS_SUBSAMPLE_WAVES_HPP
+
+#include "ThreadPool.hpp"
+#include "Semaphore.h"
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace metric {
+
+/**
+ * @brief progress of averaged estimation, called after every subsample with
+ * the number of subsamples evaluated, convergence, value of the subsample and the running mean
+ */
+using estimate_logger = std::function<void(size_t, double, double, double)>;
+
+/**
+ * @brief call evaluate(i) for i in [0, count) on a thread pool in waves of the pool size
+ *
+ * After each wave consume(i, value) is called in the order of i, the evaluation stops when it returns true,
+ * so the consumer sees the same sequence as with sequential evaluation. Exceptions of evaluate are rethrown
+ * at the position of their subsample.
+ *
+ * @param count number of evaluations
+ * @param evaluate double(size_t i), called concurrently
+ * @param consume bool(size_t i, double value), called from the calling thread
+ * @param threads pool size, 0 for the number of hardware threads
+ */
+template <typename Evaluate, typename Consume>
+void evaluate_in_waves(size_t count, Evaluate evaluate, Consume consume, size_t threads = 0)
+{
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    threads = std::max<size_t>(1, std::min(threads, count));
+
+    if (threads == 1) {
+        for (size_t i = 0; i < count; ++i) {
+            if (consume(i, evaluate(i))) {
+                return;
+            }
+        }
+        return;
+    }
+
+    ThreadPool pool(threads);
+    Semaphore sem;
+    std::vector<double> values(threads);
+    std::vector<std::exception_ptr> errors(threads);
+    try {
+        for (size_t start = 0; start < count; start += threads) {
+            const size_t wave = std::min(threads, count - start);
+            for (size_t k = 0; k < wave; ++k) {
+                errors[k] = nullptr;
+                pool.execute([&, k, start]() {
+                    try {
+                        values[k] = evaluate(start + k);
+                    } catch (...) {
+                        errors[k] = std::current_exception();
+                    }
+                    sem.notify();
+                });
+            }
+            for (size_t k = 0; k < wave; ++k) {
+                sem.wait();
+            }
+            for (size_t k = 0; k < wave; ++k) {
+                if (errors[k]) {
+                    std::rethrow_exception(errors[k]);
+                }
+                if (consume(start + k, values[k])) {
+                    pool.close();
+                    return;
+                }
+            }
+        }
+    } catch (...) {
+        pool.close();
+        throw;
+    }
+    pool.close();
+}
+
+}  // namespace metric
+
+#endif
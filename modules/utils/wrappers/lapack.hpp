@@ -3,6 +3,9 @@
 
 #include "../../../3rdparty/blaze/Math.h"
 
+#include <algorithm>
+#include <vector>
+
 
 extern "C" {
     extern void dsygv_ (int* itype,
@@ -18,6 +21,8 @@ extern "C" {
                         int* LWORK,
                         int* INFO);
 
+    extern void dsygst_ (int* itype, char* uplo, int* n, double* A, int* LDA, double* B, int* LDB, int* INFO);
+
 }
 
 namespace metric {
@@ -38,6 +43,45 @@ namespace metric {
 
         dsygv(1, 'N', 'U', A.rows(), A.data(), A.spacing(), B.data(), B.spacing(), w.data(), work.data(), lwork, info);
     }
+
+    /**
+     * @brief Cholesky factorization of B in place, the first steps of sygv done once for repeated problems with the same B
+     *
+     * @return LAPACK info, zero on success, positive when B is not positive definite
+     */
+    template <typename MT>
+    int potrf(blaze::DynamicMatrix<MT, blaze::rowMajor>& B)
+    {
+        blaze::blas_int_t info = 0;
+        blaze::potrf('U', B.rows(), B.data(), B.spacing(), &info);
+        return info;
+    }
+
+    /**
+     * @brief Eigenvalues of A x = lambda B x for B factorized by potrf, A is overwritten
+     *
+     * Runs the same reduction and symmetric eigensolver as sygv, so the eigenvalues are the same as sygv(A, B, w).
+     *
+     * @param work buffer reused between calls
+     */
+    template <typename MT, typename VT>
+    void sygv_factorized(blaze::DynamicMatrix<MT, blaze::rowMajor>& A, const blaze::DynamicMatrix<MT, blaze::rowMajor>& factor,
+        blaze::DynamicVector<VT, blaze::columnVector>& w, std::vector<double>& work)
+    {
+        int itype = 1;
+        char uplo = 'U';
+        int n = A.rows();
+        int lda = A.spacing();
+        int ldb = factor.spacing();
+        int info = 0;
+        w.resize(A.rows());
+        int lwork = std::max(1, 3 * n - 1);
+        work.resize(lwork);
+
+        dsygst_(&itype, &uplo, &n, A.data(), &lda, const_cast<double*>(factor.data()), &ldb, &info);
+        blaze::blas_int_t syev_info = 0;
+        blaze::syev('N', 'U', n, A.data(), lda, w.data(), work.data(), lwork, &syev_info);
+    }
 }
 
 #endif  //PANDA_METRIC_LAPACK_HPP
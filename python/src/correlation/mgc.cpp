@@ -75,7 +75,6 @@ void wrap_metric_MGC_direct(py::module& m) {
     mgc.def("xcorr", &Metric::xcorr<T>);      // FIXME: unsupported argument types
     mgc.def("center_distance_matrix", &Metric::center_distance_matrix<T>);
     mgc.def("rank_distance_matrix", &Metric::rank_distance_matrix<T>);
-    mgc.def("rank_distance_matrix", &Metric::rank_distance_matrix<T>);
     mgc.def("center_ranked_distance_matrix", &Metric::center_ranked_distance_matrix<T>);
     mgc.def("local_covariance", &Metric::local_covariance<T>);
     mgc.def("normalize_generalized_correlation", &Metric::normalize_generalized_correlation<T>);
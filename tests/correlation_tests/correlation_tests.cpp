@@ -14,8 +14,10 @@
 #include "modules/distance.hpp"
 #include "modules/utils/graph/connected_components.hpp"
 
-#include <random>
+#include <cmath>
 #include <limits>
+#include <numeric>
+#include <random>
 
 using namespace Catch::literals;
 
@@ -216,3 +218,266 @@ TEST_CASE("MGC_construct")
     metric::MGC<float, func_metric, float, func_metric> m7(f1, f1);
     m7(std::vector<float>{}, std::vector<float>{});
 }
+
+// dense computation of the local correlations, as MGC_direct did before the shared rank tables
+namespace dense_mgc {
+
+blaze::DynamicMatrix<size_t> rank_distance_matrix(const metric::DistanceMatrix<double>& data)
+{
+    blaze::DynamicMatrix<size_t> matrix(data.rows(), data.columns());
+    std::vector<size_t> indexes(data.rows());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    for (size_t i = 0; i < data.rows(); ++i) {
+        auto row = blaze::row(data, i);
+        std::sort(indexes.begin(), indexes.end(), [&row](auto i1, auto i2) { return row[i1] < row[i2]; });
+        for (size_t rank = 0; rank < row.size(); ++rank) {
+            matrix(i, indexes[rank]) = rank;
+        }
+    }
+    return matrix;
+}
+
+blaze::DynamicMatrix<double> center_distance_matrix(const metric::DistanceMatrix<double>& X)
+{
+    blaze::DynamicVector<double, blaze::rowVector> means = blaze::sum<blaze::columnwise>(X);
+    means /= X.rows() - 1;
+    blaze::DynamicMatrix<double> centered(X.rows(), X.columns());
+    for (size_t i = 0; i < X.rows(); ++i) {
+        for (size_t j = 0; j < X.rows(); ++j) {
+            centered(i, j) = i == j ? 0 : X(i, j) - means[j];
+        }
+    }
+    return centered;
+}
+
+blaze::DynamicMatrix<double> local_covariance(const blaze::DynamicMatrix<double>& A,
+    const blaze::DynamicMatrix<double>& B, const blaze::DynamicMatrix<size_t>& RX,
+    const blaze::DynamicMatrix<size_t>& RY)
+{
+    const size_t n = A.rows();
+    const size_t nX = blaze::max(RX) + 1;
+    const size_t nY = blaze::max(RY) + 1;
+    blaze::DynamicMatrix<double> covXY(nX, nY, 0);
+    blaze::DynamicMatrix<double, blaze::columnMajor> EX(nX, 1, 0);
+    blaze::DynamicMatrix<double> EY(1, nY, 0);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < n; ++j) {
+            covXY(RX(i, j), RY(i, j)) += A(i, j) * B(i, j);
+            EX(RX(i, j), 0) += A(i, j);
+            EY(0, RY(i, j)) += B(i, j);
+        }
+    }
+    for (size_t k = 0; k < nX - 1; ++k) {
+        covXY(k + 1, 0) += covXY(k, 0);
+        EX(k + 1, 0) += EX(k, 0);
+    }
+    blaze::DynamicVector<double, blaze::rowVector> covXY0 = blaze::row(covXY, 0);
+    for (size_t l = 0; l < nY - 1; ++l) {
+        covXY0[l + 1] += covXY0[l];
+        EY(0, l + 1) += EY(0, l);
+    }
+    for (size_t k = 0; k < nX - 1; ++k) {
+        for (size_t l = 0; l < nY - 1; ++l) {
+            covXY(k + 1, l + 1) += covXY(k + 1, l) + covXY(k, l + 1) - covXY(k, l);
+        }
+    }
+    covXY -= EX * EY / n / n;
+    return covXY;
+}
+
+void normalize_generalized_correlation(blaze::DynamicMatrix<double>& corr, const blaze::DynamicMatrix<double>& varX,
+    const blaze::DynamicMatrix<double>& varY)
+{
+    for (size_t i = 0; i < corr.rows(); ++i) {
+        for (size_t j = 0; j < corr.rows(); ++j) {
+            corr(i, j) = corr(i, j) / std::sqrt(varX(i, i) * varY(j, j));
+            if (std::isnan(corr(i, j))) {
+                corr(i, j) = 0;
+            } else if (corr(i, j) > 1) {
+                corr(i, j) = 1;
+            }
+        }
+    }
+}
+
+}  // namespace dense_mgc
+
+TEST_CASE("MGC_direct_reference", "[correlation]")
+{
+    std::mt19937 generator(3);
+    std::normal_distribution<double> normal;
+    std::vector<std::vector<double>> dataX(120), dataY(120);
+    for (size_t i = 0; i < dataX.size(); ++i) {
+        double x = normal(generator);
+        dataX[i] = { x, normal(generator) };
+        dataY[i] = { x * x + 0.3 * normal(generator) };
+    }
+    metric::Euclidean<double> euclidean;
+    metric::DistanceMatrix<double> X(dataX.size()), Y(dataY.size());
+    for (size_t i = 0; i < dataX.size(); ++i) {
+        for (size_t j = i + 1; j < dataX.size(); ++j) {
+            X(i, j) = euclidean(dataX[i], dataX[j]);
+            Y(i, j) = euclidean(dataY[i], dataY[j]);
+        }
+    }
+
+    // local covariances from the dense centered and ranked matrices
+    blaze::DynamicMatrix<double> A = dense_mgc::center_distance_matrix(X);
+    blaze::DynamicMatrix<double> B = dense_mgc::center_distance_matrix(Y);
+    blaze::DynamicMatrix<size_t> RXt = dense_mgc::rank_distance_matrix(X);
+    blaze::DynamicMatrix<size_t> RYt = dense_mgc::rank_distance_matrix(Y);
+    blaze::DynamicMatrix<double> At = blaze::trans(A);
+    blaze::DynamicMatrix<double> Bt = blaze::trans(B);
+    blaze::DynamicMatrix<size_t> RX = blaze::trans(RXt);
+    blaze::DynamicMatrix<size_t> RY = blaze::trans(RYt);
+    auto corr = dense_mgc::local_covariance(A, Bt, RX, RYt);
+    auto varX = dense_mgc::local_covariance(A, At, RX, RXt);
+    auto varY = dense_mgc::local_covariance(B, Bt, RY, RYt);
+    dense_mgc::normalize_generalized_correlation(corr, varX, varY);
+    metric::MGC_direct mgc;
+    auto R = mgc.significant_local_correlation(corr);
+    double reference = mgc.optimal_local_generalized_correlation(corr, R);
+
+    REQUIRE(mgc(X, Y) == Approx(reference).margin(1e-12));
+    REQUIRE(mgc(Y, X) == Approx(reference).margin(1e-12));
+}
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+TEST_CASE("MGC_direct_deprecated_helpers", "[correlation]")
+{
+    std::mt19937 generator(5);
+    std::normal_distribution<double> normal;
+    const size_t n = 40;
+    std::vector<double> a(n), b(n);
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = normal(generator);
+        b[i] = a[i] + normal(generator);
+    }
+    metric::DistanceMatrix<double> X(n), Y(n);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i + 1; j < n; ++j) {
+            X(i, j) = std::abs(a[i] - a[j]);
+            Y(i, j) = std::abs(b[i] - b[j]);
+        }
+    }
+
+    // the wrappers over the rank tables give the dense matrices, distinct distances have no ties
+    metric::MGC_direct mgc;
+    blaze::DynamicMatrix<double> A = mgc.center_distance_matrix(X);
+    blaze::DynamicMatrix<double> B = mgc.center_distance_matrix(Y);
+    blaze::DynamicMatrix<size_t> RXt = mgc.rank_distance_matrix(X);
+    blaze::DynamicMatrix<size_t> RYt = mgc.center_ranked_distance_matrix(Y);
+    REQUIRE(blaze::max(blaze::abs(A - dense_mgc::center_distance_matrix(X))) < 1e-12);
+    REQUIRE(RXt == dense_mgc::rank_distance_matrix(X));
+    REQUIRE(RYt == dense_mgc::rank_distance_matrix(Y));
+
+    blaze::DynamicMatrix<double> At = blaze::trans(A);
+    blaze::DynamicMatrix<double> Bt = blaze::trans(B);
+    blaze::DynamicMatrix<size_t> RX = blaze::trans(RXt);
+    blaze::DynamicMatrix<size_t> RY = blaze::trans(RYt);
+    auto corr = mgc.local_covariance(A, Bt, RX, RYt);
+    auto varX = mgc.local_covariance(A, At, RX, RXt);
+    auto varY = mgc.local_covariance(B, Bt, RY, RYt);
+    mgc.normalize_generalized_correlation(corr, varX, varY);
+    auto R = mgc.significant_local_correlation(corr);
+    REQUIRE(mgc(X, Y) == Approx(mgc.optimal_local_generalized_correlation(corr, R)).margin(1e-12));
+}
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+TEST_CASE("MGC_direct_xcorr", "[correlation]")
+{
+    std::mt19937 generator(4);
+    std::normal_distribution<double> normal;
+    const size_t n = 60;
+    std::vector<double> a(n), b(n);
+    for (size_t i = 0; i < n; ++i) {
+        a[i] = normal(generator);
+        // repeated values rank the ties of both directions
+        b[i] = std::round(2 * normal(generator));
+    }
+    metric::DistanceMatrix<double> X(n), Y(n);
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i + 1; j < n; ++j) {
+            X(i, j) = std::abs(a[i] - a[j]);
+            Y(i, j) = std::abs(b[i] - b[j]);
+        }
+    }
+
+    // shifts are ranked from the orders of the whole matrices, as the copied submatrices
+    metric::MGC_direct mgc;
+    const unsigned int lags = 4;
+    auto result = mgc.xcorr(X, Y, lags);
+    REQUIRE(result.size() == 2 * lags + 1);
+    for (int shift = -int(lags); shift <= int(lags); ++shift) {
+        const size_t start = std::abs(shift);
+        const size_t length = n - start;
+        metric::DistanceMatrix<double> Xs = blaze::submatrix(X, shift < 0 ? start : 0, shift < 0 ? start : 0, length, length);
+        metric::DistanceMatrix<double> Ys = blaze::submatrix(Y, shift < 0 ? 0 : start, shift < 0 ? 0 : start, length, length);
+        REQUIRE(result[shift + lags] == mgc(Xs, Ys));
+    }
+
+    auto tail = mgc.xcorr(X, Y, n);
+    REQUIRE(tail.size() == 2 * n + 1);
+    REQUIRE(tail.front() == 0);
+    REQUIRE(tail.back() == 0);
+}
+
+TEST_CASE("MGC_matrix", "[correlation]")
+{
+    std::mt19937 generator(5);
+    std::normal_distribution<double> normal;
+    const size_t n = 50;
+    std::vector<std::vector<std::vector<double>>> channels(4, std::vector<std::vector<double>>(n));
+    for (size_t i = 0; i < n; ++i) {
+        double x = normal(generator);
+        channels[0][i] = { x };
+        channels[1][i] = { x * x + 0.3 * normal(generator) };
+        channels[2][i] = { normal(generator), normal(generator) };
+        channels[3][i] = { std::round(x) };
+    }
+
+    auto mgc = metric::MGC<std::vector<double>, metric::Euclidean<double>, std::vector<double>, metric::Euclidean<double>>();
+    size_t calls = 0;
+    auto result = mgc.matrix(channels, [&](size_t done, size_t total) {
+        ++calls;
+        REQUIRE(done == calls);
+        REQUIRE(total == 4 + 10);
+        return true;
+    });
+    REQUIRE(calls == 4 + 10);
+    REQUIRE(result.rows() == 4);
+    for (size_t i = 0; i < channels.size(); ++i) {
+        for (size_t j = 0; j < channels.size(); ++j) {
+            REQUIRE(result(i, j) == Approx(mgc(channels[i], channels[j])).margin(1e-12));
+        }
+    }
+
+    // cancelled after the channels, pairs are left unevaluated
+    auto cancelled = mgc.matrix(channels, [](size_t done, size_t) { return done < 4; });
+    for (size_t i = 0; i < channels.size(); ++i) {
+        for (size_t j = 0; j < channels.size(); ++j) {
+            REQUIRE(std::isnan(cancelled(i, j)));
+        }
+    }
+
+    // a budget of three channels holds blocks of one channel, channels are prepared again for later blocks
+    const size_t tables = n * n * (sizeof(double) + 2 * sizeof(std::uint32_t));
+    for (size_t threads : { 1, 3 }) {
+        size_t total = 0;
+        auto budgeted = mgc.matrix(channels, [&](size_t, size_t t) {
+            total = t;
+            return true;
+        }, threads, 3 * tables);
+        REQUIRE(total == 4 + 3 + 2 + 1 + 10);
+        for (size_t i = 0; i < channels.size(); ++i) {
+            for (size_t j = 0; j < channels.size(); ++j) {
+                REQUIRE(budgeted(i, j) == result(i, j));
+            }
+        }
+    }
+}
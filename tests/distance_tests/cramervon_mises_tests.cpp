@@ -24,7 +24,7 @@ TEMPLATE_TEST_CASE("basic_use", "[distance]", float, double)
     auto result = distance(samples_1, samples_2);
 
     //TestType t = 5.0; // 5.0%
-    REQUIRE(result == 0.305698_a);
+    REQUIRE(result == 0.301511_a);
 }
 
 TEMPLATE_TEST_CASE("different_dimensions", "[distance]", float, double)
@@ -37,7 +37,7 @@ TEMPLATE_TEST_CASE("different_dimensions", "[distance]", float, double)
     auto result = distance(samples_1, samples_2);
 
     //TestType t = 5.0; // 5.0%
-    REQUIRE(result == 0.81095_a);
+    REQUIRE(result == 0.80904_a);
 }
 
 TEMPLATE_TEST_CASE("equal_samples", "[distance]", float, double)
@@ -62,7 +62,7 @@ TEMPLATE_TEST_CASE("single_value_distribution", "[distance]", float, double)
 
     auto result = distance(samples_1, samples_2);
 	
-    REQUIRE(std::isnan(result));
+    REQUIRE(result == 1.0_a);
 }
 
 TEMPLATE_TEST_CASE("non_intersect_distribution", "[distance]", float, double)
@@ -74,5 +74,21 @@ TEMPLATE_TEST_CASE("non_intersect_distribution", "[distance]", float, double)
 
     auto result = distance(samples_1, samples_2);
 
-    REQUIRE(std::isnan(result));
-}
\ No newline at end of file
+    REQUIRE(result == 3.03315_a);
+}
+
+TEMPLATE_TEST_CASE("batch", "[distance]", float, double)
+{
+	std::vector<TestType> reference = { 3, 1, 4, 1, 5, 9, 2, 6, 5, 3 };
+	std::vector<std::vector<TestType>> samples = { { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 }, { 1, 2, 3, 4, 5 }, { 9, 6, 5, 5, 4, 3, 3, 2, 1, 1 } };
+
+    metric::CramervonMises<std::vector<TestType>, TestType> distance;
+
+    auto result = distance.batch(reference, samples);
+
+    REQUIRE(result.size() == samples.size());
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        REQUIRE(result[i] == Approx(distance(reference, samples[i])));
+    }
+    REQUIRE(result[2] == 0.0_a);
+}
@@ -0,0 +1,141 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+Copyright (c) 2020 Panda Team
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "modules/distance.hpp"
+
+
+TEST_CASE("edit_basic", "[distance]")
+{
+    metric::Edit<char> distance;
+    REQUIRE(distance(std::string("kitten"), std::string("sitting")) == 3);
+    REQUIRE(distance(std::string(""), std::string("abc")) == 3);
+    REQUIRE(distance(std::string("abc"), std::string("abc")) == 0);
+    REQUIRE(distance("flaw", "lawn") == 2);
+
+    std::vector<int> a = { 1, 2, 3, 4, 5 };
+    std::vector<int> b = { 2, 3, 4, 6 };
+    REQUIRE(distance(a, b) == 2);
+}
+
+TEST_CASE("edit_long_strings", "[distance]")
+{
+    // longer than one 64 bit word
+    std::string a(150, 'a');
+    std::string b = a;
+    b[0] = 'b';
+    b[70] = 'b';
+    b.erase(130, 3);
+    metric::Edit<char> distance;
+    REQUIRE(distance(a, b) == 5);
+    REQUIRE(distance(b, a) == 5);
+
+    std::vector<char> va(a.begin(), a.end());
+    std::vector<char> vb(b.begin(), b.end());
+    REQUIRE(distance(va, vb) == 5);
+}
+
+TEST_CASE("edit_bounded", "[distance]")
+{
+    metric::Edit<char> distance;
+    std::string a = "0123456789abcdef";
+    std::string b = "0123x56789abcdyf";
+    REQUIRE(distance(a, b, 5) == 2);
+    REQUIRE(distance(a, b, 1) > 1);
+    REQUIRE(distance(a, std::string("0123"), 3) > 3);
+
+    std::vector<int> va(a.begin(), a.end());
+    std::vector<int> vb(b.begin(), b.end());
+    REQUIRE(distance(va, vb, 2) == 2);
+    REQUIRE(distance(va, vb, 1) > 1);
+}
+
+// reference dynamic programming
+int edit_reference(const std::string& a, const std::string& b)
+{
+    std::vector<int> row(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); ++j) {
+        row[j] = int(j);
+    }
+    for (size_t i = 1; i <= a.size(); ++i) {
+        int diagonal = row[0];
+        row[0] = int(i);
+        for (size_t j = 1; j <= b.size(); ++j) {
+            int up = row[j];
+            row[j] = std::min({ row[j] + 1, row[j - 1] + 1, diagonal + (a[i - 1] == b[j - 1] ? 0 : 1) });
+            diagonal = up;
+        }
+    }
+    return row[b.size()];
+}
+
+TEST_CASE("edit_random_multiword", "[distance]")
+{
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<int> symbol(0, 3);
+    auto random_string = [&](size_t length) {
+        std::string s(length, 'a');
+        for (auto& c : s) {
+            c = char('a' + symbol(generator));
+        }
+        return s;
+    };
+    // a few random edits keep the distance small, so cutoffs around it are meaningful
+    auto edited = [&](std::string s, size_t edits) {
+        for (size_t e = 0; e < edits; ++e) {
+            const size_t position = s.empty() ? 0 : generator() % s.size();
+            switch (generator() % 3) {
+            case 0:
+                s.insert(s.begin() + position, char('a' + symbol(generator)));
+                break;
+            case 1:
+                if (!s.empty()) {
+                    s.erase(s.begin() + position);
+                }
+                break;
+            default:
+                if (!s.empty()) {
+                    s[position] = char('a' + symbol(generator));
+                }
+            }
+        }
+        return s;
+    };
+
+    metric::Edit<char> distance;
+    for (size_t length : { 0, 1, 63, 64, 65, 127, 128, 129, 200 }) {
+        for (size_t trial = 0; trial < 4; ++trial) {
+            const std::string a = random_string(length);
+            for (const std::string& b : { edited(a, 1 + trial * 3), random_string(length + 1 + trial * 20),
+                     random_string(trial * 40) }) {
+                const int expected = edit_reference(a, b);
+                REQUIRE(distance(a, b) == expected);
+                REQUIRE(distance(b, a) == expected);
+
+                std::vector<int> va(a.begin(), a.end());
+                std::vector<int> vb(b.begin(), b.end());
+                REQUIRE(distance(va, vb) == expected);
+
+                for (int cutoff : { 0, expected / 2, std::max(0, expected - 1), expected, expected + 1, expected + 64 }) {
+                    if (expected <= cutoff) {
+                        REQUIRE(distance(a, b, cutoff) == expected);
+                        REQUIRE(distance(vb, va, cutoff) == expected);
+                    } else {
+                        REQUIRE(distance(a, b, cutoff) > cutoff);
+                        REQUIRE(distance(vb, va, cutoff) > cutoff);
+                    }
+                }
+            }
+        }
+    }
+}
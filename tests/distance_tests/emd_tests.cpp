@@ -0,0 +1,158 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+Copyright (c) 2020 Panda Team
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include "modules/distance.hpp"
+
+
+TEST_CASE("emd_basic", "[distance]")
+{
+    std::vector<double> a = { 1, 0, 0, 0 };
+    std::vector<double> b = { 0, 0, 0, 1 };
+    std::vector<std::vector<double>> C = { { 0, 1, 2, 3 }, { 1, 0, 1, 2 }, { 2, 1, 0, 1 }, { 3, 2, 1, 0 } };
+
+    metric::EMD<double> distance(C);
+    REQUIRE(distance(a, a) == 0);
+    REQUIRE(distance(a, b) == Approx(3));
+    REQUIRE(distance(b, a) == Approx(3));
+    REQUIRE(distance.lower_bound(a, b) <= 3);
+    REQUIRE(distance.lower_bound(a, b) > 0);
+}
+
+TEST_CASE("emd_threshold_and_lower_bounds", "[distance]")
+{
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<double> mass(0, 10);
+    std::uniform_real_distribution<double> coordinate(0, 5);
+
+    const std::size_t n = 16;
+    std::vector<std::vector<double>> positions(n, std::vector<double>(2));
+    for (auto& p : positions) {
+        p = { coordinate(gen), coordinate(gen) };
+    }
+    std::vector<std::vector<double>> C(n, std::vector<double>(n));
+    for (std::size_t i = 0; i < n; ++i) {
+        for (std::size_t j = 0; j < n; ++j) {
+            C[i][j] = std::hypot(positions[i][0] - positions[j][0], positions[i][1] - positions[j][1]);
+        }
+    }
+    metric::EMD<double> distance(C);
+    auto euclidean = metric::EMD<double>::euclidean(positions);
+    auto thresholded = metric::EMD<double>::euclidean(positions, 2.0);
+    metric::EMD<double> thresholded_matrix(metric::EMD_details::thresholded_ground_matrix(C, 2.0));
+
+    std::vector<std::vector<double>> histograms(20, std::vector<double>(n));
+    for (auto& h : histograms) {
+        double sum = 0;
+        for (auto& v : h) {
+            v = mass(gen);
+            sum += v;
+        }
+        // equal mass for the geometric bounds
+        for (auto& v : h) {
+            v *= 100 / sum;
+        }
+    }
+
+    auto distances = distance.batch(histograms[0], histograms);
+    REQUIRE(distances[0] == Approx(0).margin(1e-9));
+    for (std::size_t i = 1; i < histograms.size(); ++i) {
+        auto& a = histograms[0];
+        auto& b = histograms[i];
+        auto d = distance(a, b);
+        REQUIRE(distances[i] == Approx(d));
+        REQUIRE(distance.lower_bound(a, b) <= d);
+        REQUIRE(euclidean(a, b) == Approx(d));
+        // geometric bounds of the bin positions are not weaker than the bound of the matrix alone
+        REQUIRE(euclidean.lower_bound(a, b) <= d);
+        REQUIRE(euclidean.lower_bound(a, b) >= distance.lower_bound(a, b));
+        auto t = thresholded(a, b);
+        REQUIRE(t == Approx(thresholded_matrix(a, b)));
+        REQUIRE(t <= d * (1 + 1e-6));
+        REQUIRE(thresholded.lower_bound(a, b) <= t);
+
+        // thresholded call is exact under the threshold and a bound above it otherwise
+        REQUIRE(distance(a, b, d + 1) == Approx(d));
+        auto bound = distance.lower_bound(a, b);
+        if (bound > 0) {
+            REQUIRE(distance(a, b, bound / 2) == Approx(bound));
+        }
+    }
+
+    // candidates far from the query are pruned by the geometric bounds
+    std::vector<std::vector<double>> shifted(histograms.size(), std::vector<double>(n, 0));
+    for (std::size_t i = 0; i < histograms.size(); ++i) {
+        // all the mass at the bin farthest from the first one
+        std::size_t far = 0;
+        for (std::size_t j = 0; j < n; ++j) {
+            far = C[0][j] > C[0][far] ? j : far;
+        }
+        shifted[i][i % 2 == 0 ? 0 : far] = 100;
+    }
+    auto pruned = euclidean.batch(shifted[0], shifted, 1.0);
+    REQUIRE(pruned[0] == Approx(0).margin(1e-9));
+    for (std::size_t i = 1; i < shifted.size(); ++i) {
+        auto exact = euclidean(shifted[0], shifted[i]);
+        REQUIRE(pruned[i] <= exact * (1 + 1e-6));
+        if (i % 2 == 1) {
+            // a single moved bin is bounded up to the rounding of the solver
+            REQUIRE(pruned[i] == Approx(exact).epsilon(1e-3));
+        }
+    }
+}
+
+TEST_CASE("emd_unequal_mass", "[distance]")
+{
+    std::vector<int> a = { 3, 0, 1, 0, 2 };
+    std::vector<int> b = { 0, 1, 0, 4, 0 };
+    std::vector<std::vector<int>> C(5, std::vector<int>(5));
+    for (int i = 0; i < 5; ++i) {
+        for (int j = 0; j < 5; ++j) {
+            C[i][j] = std::min(std::abs(i - j), 3);
+        }
+    }
+
+    metric::EMD<int> distance(C);
+    auto d = distance(a, b);
+    REQUIRE(d == distance(b, a));
+    REQUIRE(distance.lower_bound(a, b) <= d);
+    REQUIRE(distance.lower_bound(b, a) <= d);
+}
+
+TEST_CASE("emd_batch_reuses_solver", "[distance]")
+{
+    // sparse candidates of different mass give flow networks of different size, solved one after another
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> mass(0, 6);
+    std::bernoulli_distribution empty(0.5);
+    const int n = 12;
+    std::vector<std::vector<int>> C(n, std::vector<int>(n));
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            C[i][j] = std::min(std::abs(i - j), 4);
+        }
+    }
+    std::vector<std::vector<int>> histograms(30, std::vector<int>(n));
+    for (auto& h : histograms) {
+        for (auto& v : h) {
+            v = empty(gen) ? 0 : mass(gen);
+        }
+    }
+
+    metric::EMD<int> distance(C);
+    for (auto& query : histograms) {
+        auto distances = distance.batch(query, histograms);
+        for (std::size_t i = 0; i < histograms.size(); ++i) {
+            REQUIRE(distances[i] == distance(query, histograms[i]));
+        }
+    }
+}
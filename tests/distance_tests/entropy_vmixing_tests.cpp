@@ -17,6 +17,10 @@ Copyright (c) 2020 Panda Team
 #include <vector>
 #include <deque>
 #include <array>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
 #include <stdexcept>
 
 using namespace Catch::literals;
@@ -48,6 +52,306 @@ TEMPLATE_TEST_CASE("entropy", "[distance]", float, double)
     REQUIRE(metric::Entropy<void, metric::Edit<int>>(metric::Edit<int>(), 3, 2.0)(v8) == -9.3586210470159283_a); //0.58333333333333337));
 }
 
+TEST_CASE("entropy_parallel_points", "[distance]")
+{
+    std::mt19937 generator(11);
+    std::normal_distribution<double> normal;
+    std::vector<std::vector<double>> data(300, std::vector<double>(3));
+    for (auto& record : data) {
+        for (auto& value : record) {
+            value = normal(generator);
+        }
+    }
+
+    // points are spread over threads in chunks, the terms are reduced in the order of points
+    using Metric = metric::Euclidean<double>;
+    double sequential = metric::Entropy<void, Metric>(Metric(), 7, 70, false, 1)(data);
+    REQUIRE(metric::Entropy<void, Metric>(Metric(), 7, 70, false, 4)(data) == sequential);
+    REQUIRE(metric::Entropy<void, Metric>()(data) == sequential);
+    // value of the sequential implementation before the point loop was parallelized, the batched EP solver
+    // rounds differently in the last digits
+    REQUIRE(sequential == Approx(4.7446399598419235).epsilon(1e-10));
+}
+
+TEST_CASE("entropy_estimate_logger", "[distance]")
+{
+    std::mt19937 generator(7);
+    std::normal_distribution<double> normal;
+    std::vector<std::vector<double>> data(400, std::vector<double>(2));
+    for (auto& record : data) {
+        for (auto& value : record) {
+            value = normal(generator);
+        }
+    }
+
+    auto entropy = metric::Entropy<void, metric::Euclidean<double>>(metric::Euclidean<double>(), 3, 10);
+    size_t calls = 0;
+    double last_mu = 0;
+    double result = entropy.estimate(data, 50, 0.05, 0, [&](size_t n, double, double, double mu) {
+        REQUIRE(n == ++calls);
+        last_mu = mu;
+    });
+    REQUIRE(calls > 0);
+    REQUIRE(calls <= 8);
+    REQUIRE(result == last_mu);
+    REQUIRE(entropy.estimate(data, 50, 0.05, 0) == result);
+}
+
+TEST_CASE("entropy_window", "[distance]")
+{
+    std::mt19937 generator(9);
+    std::normal_distribution<double> normal;
+    std::uniform_int_distribution<int> level(0, 3);
+    using Record = std::vector<double>;
+    using Metric = metric::Euclidean<double>;
+
+    const size_t window = 40;
+    metric::EntropyWindow<Record, Metric> entropy(window, Metric(), 3);
+    std::deque<Record> last;
+    for (size_t t = 0; t < 300; ++t) {
+        // repeated records are merged into points that outlive their first record
+        Record record = t % 5 == 0 ? Record { double(level(generator)), 0 } : Record { normal(generator), normal(generator) };
+        entropy.push(record);
+        last.push_back(record);
+        if (last.size() > window) {
+            last.pop_front();
+        }
+        REQUIRE(entropy.size() == last.size());
+
+        // the reference is rebuilt over the distinct records of the window
+        std::vector<Record> distinct;
+        for (const auto& r : last) {
+            if (std::find(distinct.begin(), distinct.end(), r) == distinct.end()) {
+                distinct.push_back(r);
+            }
+        }
+        if (distinct.size() <= 3) {
+            REQUIRE(std::isnan(entropy()));
+        } else {
+            REQUIRE(entropy() == Approx(metric::EntropySimple<void, Metric>(Metric(), 3)(distinct)));
+        }
+    }
+
+    // records come back after their points expired, while expired nodes are still in the tree
+    std::vector<Record> cycle;
+    for (size_t i = 0; i < 13; ++i) {
+        cycle.push_back({ normal(generator), normal(generator) });
+    }
+    metric::EntropyWindow<Record, Metric> cyclic(8, Metric(), 3);
+    for (size_t t = 0; t < 200; ++t) {
+        cyclic.push(cycle[t % cycle.size()]);
+        if (t >= 7) {
+            std::vector<Record> distinct;
+            for (size_t i = t - 7; i <= t; ++i) {
+                distinct.push_back(cycle[i % cycle.size()]);
+            }
+            REQUIRE(cyclic() == Approx(metric::EntropySimple<void, Metric>(Metric(), 3)(distinct)));
+        }
+    }
+
+    REQUIRE_THROWS_AS((metric::EntropyWindow<Record, Metric>(3, Metric(), 3)), std::invalid_argument);
+}
+
+TEST_CASE("epmgp_batch", "[distance]")
+{
+    std::mt19937 generator(5);
+    std::normal_distribution<double> normal;
+    const size_t n = 3;
+    std::vector<blaze::DynamicVector<double>> m, lowerB, upperB;
+    std::vector<blaze::DynamicMatrix<double>> K;
+    for (size_t j = 0; j < 10; ++j) {
+        blaze::DynamicMatrix<double> B(n, n);
+        blaze::DynamicVector<double> mj(n), lj(n), uj(n);
+        for (size_t r = 0; r < n; ++r) {
+            for (size_t c = 0; c < n; ++c) {
+                B(r, c) = normal(generator);
+            }
+            mj[r] = normal(generator);
+            lj[r] = normal(generator) - 1;
+            uj[r] = lj[r] + std::abs(normal(generator)) + 0.1;
+        }
+        K.push_back(B * blaze::trans(B) + blaze::IdentityMatrix<double>(n) * 0.5);
+        m.push_back(mj);
+        lowerB.push_back(lj);
+        upperB.push_back(uj);
+    }
+
+    // results of the solver before batching, which inverted L instead of the forward substitution
+    const std::vector<double> baseline_logZ = { -6.0977489408998551, -6.4950451720282736, -6.6518303414946187,
+        -6.056969406697398, -5.7577468353368246, -6.465188638002493, -5.2834485066548238, -9.0199047316203878,
+        -10.174838751781742, -7.4505487708915901 };
+    const std::vector<double> baseline_mu = { -0.45206313272846504, 0.28300569362630629, -0.82283943027993789,
+        0.79965409868325821, 0.34303398308786992, 0.22555943514474003, -0.57858402198188752, -0.28528098743256053,
+        -1.8676679807185579, 0.46161556683101729 };
+
+    // problems of the batch converge at different iterations, each must stop at its own
+    epmgp::workspace<double> ws;
+    auto logZ = epmgp::local_gaussian_axis_aligned_hyperrectangles_batch(m, K, lowerB, upperB, ws);
+    REQUIRE(logZ.size() == m.size());
+    for (size_t j = 0; j < m.size(); ++j) {
+        auto single = epmgp::local_gaussian_axis_aligned_hyperrectangles<double>(m[j], K[j], lowerB[j], upperB[j]);
+        REQUIRE(logZ[j] == Approx(std::get<0>(single)));
+        REQUIRE(ws.problems[j].mu[0] == Approx(std::get<1>(single)[0]));
+        REQUIRE(logZ[j] == Approx(baseline_logZ[j]).epsilon(1e-9));
+        REQUIRE(ws.problems[j].mu[0] == Approx(baseline_mu[j]).epsilon(1e-9));
+    }
+}
+
+TEST_CASE("epmgp_independent_moments", "[distance]")
+{
+    // with a diagonal covariance EP is exact: the box probability is the product of the marginal ones,
+    // and the moments are those of independent truncated normals
+    const std::vector<double> mean = { 0.3, -1, 2 };
+    const std::vector<double> variance = { 1, 0.25, 4 };
+    const std::vector<double> lower = { -1, -1.2, 5 };
+    const std::vector<double> upper = { 0.5, 0, 9 };
+    blaze::DynamicVector<double> m(3), l(3), u(3);
+    blaze::DynamicMatrix<double> K(3, 3, 0);
+    for (size_t i = 0; i < 3; ++i) {
+        m[i] = mean[i];
+        l[i] = lower[i];
+        u[i] = upper[i];
+        K(i, i) = variance[i];
+    }
+    auto [logZ, mu, sigma] = epmgp::local_gaussian_axis_aligned_hyperrectangles<double>(m, K, l, u);
+
+    auto cdf = [](double x) { return 0.5 * std::erfc(-x / std::sqrt(2.0)); };
+    auto pdf = [](double x) { return std::exp(-x * x / 2) / std::sqrt(2 * M_PI); };
+    double expected_logZ = 0;
+    for (size_t i = 0; i < 3; ++i) {
+        const double s = std::sqrt(variance[i]);
+        const double alpha = (lower[i] - mean[i]) / s;
+        const double beta = (upper[i] - mean[i]) / s;
+        const double Z = cdf(beta) - cdf(alpha);
+        expected_logZ += std::log(Z);
+        const double shift = (pdf(alpha) - pdf(beta)) / Z;
+        REQUIRE(mu[i] == Approx(mean[i] + s * shift).epsilon(1e-8));
+        REQUIRE(sigma(i, i)
+            == Approx(variance[i] * (1 + (alpha * pdf(alpha) - beta * pdf(beta)) / Z - shift * shift)).epsilon(1e-8));
+    }
+    REQUIRE(logZ == Approx(expected_logZ).epsilon(1e-8));
+}
+
+TEST_CASE("vmixing_joint_tree", "[distance]")
+{
+    std::mt19937 generator(13);
+    std::normal_distribution<double> normal;
+    std::vector<std::vector<double>> X(150), Y(120);
+    for (auto& record : X) {
+        record = { normal(generator), normal(generator) };
+    }
+    for (auto& record : Y) {
+        record = { normal(generator), 0.5 * normal(generator) };
+    }
+    std::vector<std::vector<double>> XY(X);
+    XY.insert(XY.end(), Y.begin(), Y.end());
+
+    // one tree over XY gives the same entropies as separate estimators when there are no ties
+    using Metric = metric::Euclidean<double>;
+    auto es = metric::EntropySimple<void, Metric>(Metric(), 3);
+    auto vms = metric::VMixing_simple<void, Metric>(Metric(), 3);
+    REQUIRE(vms(X, Y) == Approx(2 * es(XY) - es(X) - es(Y)));
+
+    auto e = metric::Entropy<void, Metric>(Metric(), 3, 25);
+    auto vm = metric::VMixing<void, Metric>(Metric(), 3, 25);
+    REQUIRE(vm(X, Y) == Approx(2 * e(XY) - e(X) - e(Y)));
+}
+
+// kpN entropy without a tree, neighbours are sorted by distance and equal distances by the order of records
+double kpn_entropy_reference(const std::vector<std::vector<double>>& data, size_t k, size_t p)
+{
+    namespace details = metric::entropy_details;
+    metric::Euclidean<double> euclidean;
+    const size_t n = data.size();
+    const size_t d = data[0].size();
+    const details::kpn_parameters param(n, k, p);
+    details::kpn_workspace w(param.p, d, n);
+    for (size_t i = 0; i < n; ++i) {
+        std::vector<size_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return euclidean(data[i], data[a]) < euclidean(data[i], data[b]);
+        });
+        details::kpn_problem([&](size_t j) -> const auto& { return data[order[j]]; }, param, d, w.Nodes,
+            w.ep.problems[i]);
+        details::kpn_box(data[i], euclidean(data[i], data[order[param.k - 1]]), d, w.ep.problems[i]);
+    }
+    epmgp::local_gaussian_axis_aligned_hyperrectangles<double>(w.ep, n);
+    std::vector<double> terms(n, 0);
+    std::vector<char> is_result(n, false);
+    for (size_t i = 0; i < n; ++i) {
+        is_result[i] = details::kpn_term(data[i], w.ep.problems[i], d, w.x_vector, terms[i]);
+    }
+    return details::kpn_entropy(terms, is_result, n, k);
+}
+
+TEST_CASE("vmixing_ties", "[distance]")
+{
+    // repeated records of a grid, almost every neighbour list is decided by ties
+    std::vector<std::vector<double>> X { { 0, 1, 0 }, { 0, 0, 0 }, { 1, 1, 0 }, { 1, 0, 0 }, { 0, 0, 0 },
+        { 0, 1, 0 }, { 0, 0, 0 }, { 1, 1, 0 }, { 1, 0, 0 }, { 0, 0, 0 }, { 0, 1, 0 }, { 0, 0, 0 }, { 1, 1, 0 },
+        { 1, 0, 0 }, { 0, 0, 0 } };
+    std::vector<std::vector<double>> Y { { 0, 0, 0 }, { 1, 1, 0 }, { 2, 2, 0 }, { 2, 1, 0 }, { 0, 0, 0 },
+        { 0, 0, 0 }, { 1, 1, 0 }, { 2, 2, 0 }, { 2, 1, 0 }, { 0, 0, 0 }, { 0, 0, 0 }, { 1, 1, 0 }, { 2, 2, 0 },
+        { 2, 1, 0 }, { 0, 0, 0 } };
+    std::vector<std::vector<double>> XY(X);
+    XY.insert(XY.end(), Y.begin(), Y.end());
+
+    // equidistant neighbours are taken in the order of records whatever the shape of the tree
+    using Metric = metric::Euclidean<double>;
+    auto vm = metric::VMixing<void, Metric>(Metric(), 3, 25);
+    const double expected
+        = 2 * kpn_entropy_reference(XY, 3, 25) - kpn_entropy_reference(X, 3, 25) - kpn_entropy_reference(Y, 3, 25);
+    REQUIRE(vm(X, Y) == Approx(expected));
+
+    // samples of 5 records as in the estimate of the vmixing test
+    std::vector<std::vector<double>> X5(X.begin(), X.begin() + 5), Y5(Y.begin(), Y.begin() + 5), XY5(X5);
+    XY5.insert(XY5.end(), Y5.begin(), Y5.end());
+    const double expected5
+        = 2 * kpn_entropy_reference(XY5, 3, 25) - kpn_entropy_reference(X5, 3, 25) - kpn_entropy_reference(Y5, 3, 25);
+    REQUIRE(vm(X5, Y5) == Approx(expected5));
+}
+
+TEST_CASE("vmixing_small_sets", "[distance]")
+{
+    // sets of less than 4 points have no kpN estimate, the result is NaN and not a read past the neighbours
+    std::vector<std::vector<double>> X { { 0, 0 }, { 1, 0.5 } };
+    std::vector<std::vector<double>> Y { { 0, 1 }, { 2, 1 }, { 1, 3 }, { 0.5, 2 }, { 3, 0 } };
+    using Metric = metric::Euclidean<double>;
+    auto vm = metric::VMixing<void, Metric>(Metric(), 1, 25);
+    REQUIRE(std::isnan(vm(X, Y)));
+    REQUIRE(std::isnan(vm(Y, X)));
+}
+
+TEST_CASE("vmixing_matrix", "[distance]")
+{
+    std::mt19937 generator(17);
+    std::normal_distribution<double> normal;
+    std::vector<std::vector<std::vector<double>>> channels(3, std::vector<std::vector<double>>(60));
+    for (size_t i = 0; i < 60; ++i) {
+        double x = normal(generator);
+        channels[0][i] = { x, normal(generator) };
+        channels[1][i] = { x + 0.1 * normal(generator), normal(generator) };
+        channels[2][i] = { normal(generator), 2 * normal(generator) };
+    }
+
+    // entropies of single channels are shared by their pairs, every entry is the pairwise value
+    using Metric = metric::Euclidean<double>;
+    auto vms = metric::VMixing_simple<void, Metric>(Metric(), 3);
+    auto vm = metric::VMixing<void, Metric>(Metric(), 3, 25);
+    auto simple = vms.matrix(channels);
+    auto kpn = vm.matrix(channels);
+    for (size_t i = 0; i < channels.size(); ++i) {
+        for (size_t j = 0; j < channels.size(); ++j) {
+            REQUIRE(simple(i, j) == Approx(vms(channels[i], channels[j])));
+            REQUIRE(kpn(i, j) == Approx(vm(channels[i], channels[j])));
+        }
+    }
+
+    REQUIRE_THROWS_AS((metric::VMixing_simple<void, Metric>(Metric(), 0).matrix(channels)), std::invalid_argument);
+    REQUIRE_THROWS_AS((metric::VMixing<void, Metric>(Metric(), 0, 25).matrix(channels)), std::invalid_argument);
+}
+
 TEMPLATE_TEST_CASE("vmixing", "[distance]", float, double)
 {
     std::vector<std::vector<TestType>> v11 = { { 5, 5 }, { 2, 2 }, { 3, 3 }, { 5, 0 } };
@@ -90,6 +394,8 @@ TEMPLATE_TEST_CASE("vmixing", "[distance]", float, double)
                                           {0, 0, 0}, {1, 1, 0}, {2, 2, 0}, {2, 1, 0}, {0, 0, 0}};
 
     REQUIRE(vms.estimate(ds1, ds2, 5) == 1.2722224834467826_a);
-    REQUIRE(vm.estimate(ds1, ds2, 5) == 0.096469697241235622_a);
+    // was 0.096469697241235622: these duplicated records are all ties, equidistant neighbours are now taken in
+    // the order of records as checked against the reference in vmixing_ties
+    REQUIRE(vm.estimate(ds1, ds2, 5) == 0.82313150691470938_a);
 }
 
@@ -88,3 +88,89 @@ TEMPLATE_TEST_CASE("kohonen", "[distance]", float, double)
 	result = distance_3(train_dataset[0], train_dataset[5]);
 	REQUIRE(result > 2); REQUIRE(result < 4);
 }
+
+TEMPLATE_TEST_CASE("kohonen_bmu_cache", "[distance]", float, double)
+{
+	using Record = std::vector<TestType>;
+
+	std::vector<Record> train_dataset = {
+		{0, 0},
+		{1, 0},
+		{2, 0},
+		{0, 1},
+		{1, 1},
+		{2, 1},
+	};
+
+	metric::Kohonen<TestType, Record> distance(train_dataset, 3, 2);
+	metric::Euclidean<TestType> euclidean;
+
+	REQUIRE(distance.weights().size() == 6);
+	for (auto& record : train_dataset)
+	{
+		auto [index, to_nearest] = distance.bmu(record);
+		REQUIRE(index == distance.som_model.BMU(record));
+		REQUIRE(to_nearest == euclidean(record, distance.weights()[index]));
+		// memoized
+		REQUIRE(distance.bmu(record) == std::make_pair(index, to_nearest));
+	}
+
+	auto result = distance(train_dataset[0], train_dataset[5]);
+	distance.clear_cache();
+	REQUIRE(distance(train_dataset[0], train_dataset[5]) == result);
+
+	distance.cache_capacity = 1;
+	REQUIRE(distance(train_dataset[0], train_dataset[5]) == result);
+}
+
+TEMPLATE_TEST_CASE("kohonen_shortest_paths", "[distance]", float, double)
+{
+	using Record = std::vector<TestType>;
+
+	std::vector<Record> train_dataset;
+	for (size_t i = 0; i < 50; ++i)
+	{
+		train_dataset.push_back({TestType(i % 7), TestType(i % 5), TestType(i % 3)});
+	}
+
+	metric::Kohonen<TestType, Record> distance(train_dataset, 5, 4);
+	metric::Euclidean<TestType> euclidean;
+
+	// Floyd-Warshall over the SOM graph as the reference
+	const auto& weights = distance.weights();
+	const auto& graph = distance.som_model.get_graph().get_matrix();
+	const size_t n = weights.size();
+	std::vector<std::vector<TestType>> reference(n, std::vector<TestType>(n, std::numeric_limits<TestType>::infinity()));
+	for (size_t i = 0; i < n; ++i)
+	{
+		reference[i][i] = 0;
+		for (size_t j = 0; j < n; ++j)
+		{
+			if (i != j && graph(i, j))
+			{
+				reference[i][j] = euclidean(weights[i], weights[j]);
+			}
+		}
+	}
+	for (size_t k = 0; k < n; ++k)
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			for (size_t j = 0; j < n; ++j)
+			{
+				reference[i][j] = std::min(reference[i][j], reference[i][k] + reference[k][j]);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		for (size_t j = 0; j < n; ++j)
+		{
+			REQUIRE(distance.distance_matrix[i][j] == Approx(reference[i][j]).margin(1e-4));
+			auto path = distance.get_shortest_path(i, j);
+			REQUIRE(path.front() == int(i));
+			REQUIRE(path.back() == int(j));
+		}
+	}
+}
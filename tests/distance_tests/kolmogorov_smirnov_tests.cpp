@@ -61,8 +61,7 @@ TEMPLATE_TEST_CASE("single_value_distribution", "[distance]", float, double)
 
     auto result = distance(samples_1, samples_2);
 	
-    TestType t = 0.01; // 0.01%
-	REQUIRE(result == Approx(0.0));
+	REQUIRE(result == Approx(1.0));
 }
 
 TEMPLATE_TEST_CASE("non_intersect_distribution", "[distance]", float, double)
@@ -74,6 +73,21 @@ TEMPLATE_TEST_CASE("non_intersect_distribution", "[distance]", float, double)
 
     auto result = distance(samples_1, samples_2);
 	
-    TestType t = 0.01; // 0.01%
-	REQUIRE(result == Approx(0.0));
-}
\ No newline at end of file
+	REQUIRE(result == Approx(1.0));
+}
+
+TEMPLATE_TEST_CASE("batch", "[distance]", float, double)
+{
+	std::vector<TestType> reference = { 3, 1, 4, 1, 5, 9, 2, 6, 5, 3 };
+	std::vector<std::vector<TestType>> samples = { { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 }, { 1, 2, 3, 4, 5 }, { 9, 6, 5, 5, 4, 3, 3, 2, 1, 1 } };
+
+    metric::KolmogorovSmirnov<std::vector<TestType>, TestType> distance;
+
+    auto result = distance.batch(reference, samples);
+
+    REQUIRE(result.size() == samples.size());
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        REQUIRE(result[i] == Approx(distance(reference, samples[i])));
+    }
+    REQUIRE(result[2] == Approx(0.0));
+}
@@ -0,0 +1,107 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "../../modules/distance/k-related/L1.hpp"
+#include "../../modules/space/matrix.hpp"
+#include "../../modules/space/tree.hpp"
+
+#include <random>
+#include <vector>
+
+namespace {
+
+std::vector<blaze::CompressedVector<double>> make_sparse(size_t count, size_t size, size_t nonzeros)
+{
+    std::mt19937 generator(5);
+    std::uniform_int_distribution<size_t> index(0, size - 1);
+    std::uniform_real_distribution<double> value(0.1, 2.0);
+    std::vector<blaze::CompressedVector<double>> records;
+    for (size_t k = 0; k < count; ++k) {
+        blaze::CompressedVector<double> record(size);
+        for (size_t i = 0; i < nonzeros; ++i) {
+            record[index(generator)] = value(generator);
+        }
+        records.push_back(record);
+    }
+    return records;
+}
+
+std::vector<double> to_dense(const blaze::CompressedVector<double>& v)
+{
+    std::vector<double> dense(v.size(), 0);
+    for (auto it = v.begin(); it != v.end(); ++it) {
+        dense[it->index()] = it->value();
+    }
+    return dense;
+}
+
+template <typename Metric>
+void check_sparse_matches_dense(const Metric& metric)
+{
+    auto records = make_sparse(6, 300, 20);
+    for (auto& a : records) {
+        for (auto& b : records) {
+            REQUIRE(metric(a, b) == Approx(metric(to_dense(a), to_dense(b))));
+        }
+    }
+    auto distances = metric.batch(records[0], records);
+    REQUIRE(distances.size() == records.size());
+    for (size_t k = 0; k < records.size(); ++k) {
+        REQUIRE(distances[k] == Approx(metric(records[0], records[k])));
+    }
+    REQUIRE(distances[0] == 0);
+}
+
+}  // namespace
+
+TEST_CASE("l1_known_values", "[distance]")
+{
+    std::vector<double> a { 0, 1, 2, 0 };
+    std::vector<double> b { 0, 1, 3 };
+    REQUIRE(metric::Sorensen<double>()(a, b) == Approx(1.0 / 7));
+
+    blaze::CompressedVector<double> ca { 0, 1, 2, 0 };
+    blaze::CompressedVector<double> cb { 0, 1, 3, 0 };
+    REQUIRE(metric::Sorensen<double>()(ca, cb) == Approx(1.0 / 7));
+    REQUIRE(metric::sorensen(ca, cb) == Approx(1.0 / 7));
+
+    // 1 - 2/3 and 1 - 1 / (1 + 1 + 1)
+    std::vector<double> c { 0, 2, -1 };
+    std::vector<double> d { 0, 0, 1 };
+    REQUIRE(metric::Hassanat<double>()(c, d) == Approx(2.0 / 3 + 2.0 / 3));
+
+    // 1 - (1 + 2) / (1 + 3)
+    std::vector<double> e { 1, 3, 0 };
+    std::vector<double> f { 1, 2, 0 };
+    REQUIRE(metric::Ruzicka<double>()(e, f) == Approx(0.25));
+}
+
+TEST_CASE("l1_sparse_kernels", "[distance]")
+{
+    check_sparse_matches_dense(metric::Sorensen<double>());
+    check_sparse_matches_dense(metric::Hassanat<double>());
+    check_sparse_matches_dense(metric::Ruzicka<double>());
+}
+
+TEST_CASE("l1_sparse_records_in_space", "[distance]")
+{
+    using Record = blaze::CompressedVector<double>;
+    auto records = make_sparse(20, 1000000, 100);
+
+    metric::Matrix<Record, metric::Ruzicka<double>> matrix(records);
+    REQUIRE(matrix.size() == records.size());
+    REQUIRE(matrix(2, 5) == Approx(metric::Ruzicka<double>()(records[2], records[5])));
+
+    metric::Tree<Record, metric::Sorensen<double>> tree(records);
+    REQUIRE(tree.size() == records.size());
+    auto nearest = tree.nn(records[7]);
+    REQUIRE(metric::Sorensen<double>()(nearest->get_data(), records[7]) == 0);
+}
@@ -0,0 +1,134 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+Copyright (c) 2020 Panda Team
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <random>
+#include <vector>
+#include "modules/distance.hpp"
+#include "modules/space.hpp"
+
+
+std::vector<std::vector<double>> random_records(std::size_t n, std::size_t dim)
+{
+    std::mt19937 gen(7);
+    std::normal_distribution<double> dist(0, 1);
+    std::vector<std::vector<double>> records(n, std::vector<double>(dim));
+    for (auto& r : records) {
+        for (auto& v : r) {
+            v = dist(gen);
+        }
+    }
+    return records;
+}
+
+TEST_CASE("float16_conversion", "[distance]")
+{
+    for (float v : { 0.0f, 1.0f, -2.5f, 65504.0f, 0.000061035156f, 5.9604645e-8f, 3.14159f }) {
+        float back = metric::quantized_details::half_to_float(metric::quantized_details::float_to_half(v));
+        REQUIRE(back == Approx(v).epsilon(1e-3));
+    }
+    REQUIRE(metric::quantized_details::float_to_half(1e6f) == 0x7c00);
+}
+
+TEST_CASE("int8_kernels", "[distance]")
+{
+    auto records = random_records(2, 512);
+    metric::Int8Vector a(records[0]), b(records[1]);
+    metric::Float16Vector ha(records[0]), hb(records[1]);
+
+    metric::Euclidean<double> euclidean;
+    metric::Manhatten<double> manhatten;
+    metric::Cosine<double> cosine;
+
+    auto exact = euclidean(records[0], records[1]);
+    REQUIRE(euclidean(a, b) == Approx(exact).epsilon(0.01));
+    REQUIRE(euclidean(ha, hb) == Approx(exact).epsilon(0.001));
+    REQUIRE(euclidean(a, b) == Approx(euclidean(a.decode(), b.decode())));
+
+    exact = manhatten(records[0], records[1]);
+    REQUIRE(manhatten(a, b) == Approx(exact).epsilon(0.01));
+    REQUIRE(manhatten(ha, hb) == Approx(exact).epsilon(0.001));
+
+    exact = cosine(records[0], records[1]);
+    REQUIRE(cosine(a, b) == Approx(exact).epsilon(0.01));
+    REQUIRE(cosine(ha, hb) == Approx(exact).epsilon(0.001));
+
+    REQUIRE(euclidean(a, a) == 0);
+}
+
+TEST_CASE("quantized_tree_rerank", "[distance]")
+{
+    auto records = random_records(300, 64);
+    std::vector<metric::Int8Vector> quantized;
+    for (auto& r : records) {
+        quantized.emplace_back(r);
+    }
+
+    metric::Tree<metric::Int8Vector, metric::Euclidean<double>> tree(quantized);
+    metric::Matrix<metric::Int8Vector, metric::Euclidean<double>> matrix(quantized);
+    REQUIRE(matrix(0, 1) == Approx(tree.distance(quantized[0], quantized[1])));
+
+    auto query = records[42];
+    auto candidates = tree.knn(metric::Int8Vector(query), 20);
+    std::vector<std::size_t> ids;
+    for (auto& c : candidates) {
+        ids.push_back(c.first->get_ID());
+    }
+
+    auto result = metric::rerank(query, ids, records, 5, metric::Euclidean<double>());
+    REQUIRE(result.size() == 5);
+    REQUIRE(result[0].first == 42);
+    REQUIRE(result[0].second == 0);
+    for (std::size_t i = 1; i < result.size(); ++i) {
+        REQUIRE(result[i - 1].second <= result[i].second);
+    }
+}
+
+TEST_CASE("product_quantizer", "[distance]")
+{
+    auto records = random_records(400, 32);
+    metric::ProductQuantizer<double> pq(records, 8, 16, 50, 1);
+    REQUIRE(pq.subspaces() == 8);
+    REQUIRE(pq.centroids() == 16);
+
+    // codes are stored inline, a record holds no allocation
+    REQUIRE(sizeof(metric::PQCode<double>) <= 16 + sizeof(void*));
+    auto codes = pq.encode(records);
+    REQUIRE(codes[0].codes[8] == 0);
+    REQUIRE(pq.decode(codes[0]).size() == 32);
+    REQUIRE(pq(codes[3], codes[3]) == 0);
+
+    // asymmetric distance is the exact distance from the query to the reconstruction
+    auto query = pq.query(records[5]);
+    metric::Euclidean<double> euclidean;
+    REQUIRE(pq(query, codes[7]) == Approx(euclidean(records[5], pq.decode(codes[7]))));
+    REQUIRE(pq(codes[7], query) == Approx(pq(query, codes[7])));
+
+    // symmetric distance is the distance between reconstructions
+    REQUIRE(pq(codes[1], codes[2]) == Approx(euclidean(pq.decode(codes[1]), pq.decode(codes[2]))));
+
+    metric::Tree<metric::PQCode<double>, metric::ProductQuantizer<double>> tree(codes, -1, pq);
+    auto nn = tree.knn(query, 10);
+    REQUIRE(nn.size() == 10);
+    REQUIRE(nn[0].second <= nn[9].second);
+
+    metric::KNNGraph<metric::PQCode<double>, metric::ProductQuantizer<double>> graph(codes, 5, 20, 100, 0.02, pq);
+    REQUIRE(graph.size() == codes.size());
+
+    // lookup tables are shared by copies of the quantizer
+    metric::ProductQuantizer<double> copy(pq);
+    auto second = pq.query(records[6]);
+    REQUIRE(copy(second, codes[7]) == Approx(euclidean(records[6], pq.decode(codes[7]))));
+    pq.release(query);
+    REQUIRE(copy(second, codes[7]) == Approx(euclidean(records[6], pq.decode(codes[7]))));
+
+    REQUIRE_THROWS_AS(metric::ProductQuantizer<double>(records, 64), std::invalid_argument);
+    REQUIRE_THROWS_AS((metric::ProductQuantizer<double, 4>(records, 8)), std::invalid_argument);
+    REQUIRE_THROWS_AS(metric::ProductQuantizer<double>(random_records(10, 32), 8, 16), std::invalid_argument);
+}
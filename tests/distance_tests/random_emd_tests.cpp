@@ -9,6 +9,7 @@ Copyright (c) 2020 Panda Team
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch.hpp>
 
+#include <random>
 #include <vector>
 #include "modules/distance.hpp"
 
@@ -63,7 +64,7 @@ TEMPLATE_TEST_CASE("single_value_distribution", "[distance]", float, double)
 
     auto result = distance(samples_1, samples_2);
 	
-    REQUIRE(std::isnan(result));
+    REQUIRE(result == Approx(1.0));
 }
 
 TEMPLATE_TEST_CASE("non_intersect_distribution", "[distance]", float, double)
@@ -75,5 +76,50 @@ TEMPLATE_TEST_CASE("non_intersect_distribution", "[distance]", float, double)
 
     auto result = distance(samples_1, samples_2);
 	
-    REQUIRE(std::isnan(result));
+    REQUIRE(result == Approx(10.0));
+}
+
+TEMPLATE_TEST_CASE("exact", "[distance]", float, double)
+{
+	std::vector<TestType> samples_1 = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+	std::vector<TestType> samples_2 = { 5, 4, 3, 2, 1 };
+	std::vector<TestType> samples_3 = { 0, 0, 0, 0, 0, 0, 0 };
+	std::vector<TestType> samples_4 = { 1, 1, 1, 1, 1, 1, 1 };
+
+    metric::RandomEMD<std::vector<TestType>, TestType> distance;
+
+    REQUIRE(distance.exact(samples_1, samples_1) == Approx(0.0));
+    REQUIRE(distance.exact(samples_1, samples_2) == Approx(24.0 / 11));
+    REQUIRE(distance.exact(samples_3, samples_4) == Approx(1.0));
+}
+
+TEMPLATE_TEST_CASE("sketch", "[distance]", float, double)
+{
+	std::mt19937 generator(1);
+	std::normal_distribution<TestType> normal(0, 1);
+	std::vector<TestType> samples_1(100000);
+	std::vector<TestType> samples_2(100000);
+	for (std::size_t i = 0; i < samples_1.size(); ++i) {
+		samples_1[i] = normal(generator);
+		samples_2[i] = normal(generator) + 1;
+	}
+
+    metric::RandomEMD<std::vector<TestType>, TestType> distance;
+
+	// sketch of two halves merged
+	metric::QuantileSketch<TestType> sketch_1(std::vector<TestType>(samples_1.begin(), samples_1.begin() + 50000), 400, 1);
+	sketch_1.merge(metric::QuantileSketch<TestType>(std::vector<TestType>(samples_1.begin() + 50000, samples_1.end()), 400, 2));
+	metric::QuantileSketch<TestType> sketch_2(samples_2, 400, 3);
+
+	REQUIRE(sketch_1.count() == samples_1.size());
+	REQUIRE(sketch_1.size() < 2000);
+	REQUIRE(sketch_1.quantile(0.5) == Approx(0.0).margin(0.05));
+	REQUIRE(sketch_1.cdf(0) == Approx(0.5).margin(0.02));
+	REQUIRE(distance(sketch_1, sketch_2) == Approx(distance.exact(samples_1, samples_2)).margin(0.05));
+
+	// small samples are kept entirely
+	std::vector<TestType> small_1 = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+	std::vector<TestType> small_2 = { 1, 2, 3, 4, 5 };
+	REQUIRE(distance(metric::QuantileSketch<TestType>(small_1), metric::QuantileSketch<TestType>(small_2))
+		== Approx(distance.exact(small_1, small_2)));
 }
@@ -32,3 +32,28 @@ TEMPLATE_TEST_CASE("riemannian_distance", "[distance]", double) {
 }
 
 
+TEMPLATE_TEST_CASE("riemannian_distance_batch", "[distance]", double) {
+
+    auto rd = metric::RiemannianDistance<void, metric::Euclidean<TestType>>();
+
+    std::vector<std::vector<TestType>> reference {{0, 0}, {1, 1}, {2, 2}, {2, 1}};
+    std::vector<std::vector<std::vector<TestType>>> candidates {
+        {{0, 1}, {0, 0}, {1, 1}, {1, 0}},
+        {{0, 0}, {1, 1}, {2, 2}, {2, 1}},
+        {{3, 1}, {0, 2}, {5, 1}, {1, 4}},
+    };
+
+    auto prepared = rd.prepare(reference);
+    auto distances = rd.batch(reference, candidates);
+    auto prepared_distances = rd.batch(prepared, candidates);
+    REQUIRE(distances.size() == candidates.size());
+    REQUIRE(distances[0] == 0.8086438137089399_a);
+    for (size_t k = 0; k < candidates.size(); ++k) {
+        REQUIRE(distances[k] == Approx(rd(candidates[k], reference)));
+        REQUIRE(prepared_distances[k] == Approx(distances[k]));
+        REQUIRE(rd(candidates[k], prepared) == Approx(distances[k]));
+    }
+
+    std::vector<std::vector<TestType>> wrong_size {{0, 0}, {1, 1}};
+    REQUIRE_THROWS_AS(rd(wrong_size, prepared), std::invalid_argument);
+}
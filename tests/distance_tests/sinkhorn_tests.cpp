@@ -0,0 +1,68 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+Copyright (c) 2020 Panda Team
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <random>
+#include <vector>
+#include "modules/distance.hpp"
+#include "modules/space/matrix.hpp"
+
+
+TEST_CASE("sinkhorn_approximates_emd", "[distance]")
+{
+    auto C = metric::EMD_details::ground_distance_matrix_of_2dgrid<double>(6, 6);
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> mass(0, 1);
+
+    std::vector<std::vector<double>> histograms(10, std::vector<double>(C.size()));
+    for (auto& h : histograms) {
+        double sum = 0;
+        for (auto& v : h) {
+            v = mass(gen);
+            sum += v;
+        }
+        for (auto& v : h) {
+            v /= sum;
+        }
+    }
+
+    metric::EMD<double> emd(C);
+    metric::Sinkhorn<double> sinkhorn(C, 0.02);
+    auto distances = sinkhorn.batch(histograms[0], histograms);
+
+    REQUIRE(distances[0] == Approx(0).margin(1e-9));
+    for (std::size_t i = 1; i < histograms.size(); ++i) {
+        REQUIRE(distances[i] == Approx(emd(histograms[0], histograms[i])).epsilon(0.02));
+        REQUIRE(distances[i] == Approx(sinkhorn(histograms[0], histograms[i])).epsilon(1e-3));
+        REQUIRE(sinkhorn(histograms[i], histograms[0]) == Approx(distances[i]).epsilon(1e-3));
+    }
+}
+
+TEST_CASE("sinkhorn_default_ground_distance", "[distance]")
+{
+    std::vector<double> a = { 1, 0, 0, 0 };
+    std::vector<double> b = { 0, 0, 0, 1 };
+    metric::Sinkhorn<double> distance;
+    REQUIRE(distance(a, b) == Approx(metric::EMD<double>()(a, b)).epsilon(0.01));
+    REQUIRE_THROWS_AS(distance(a, std::vector<double>(4, 0)), std::invalid_argument);
+
+    // prepared once for a known record size
+    metric::Sinkhorn<double> sized(a.size());
+    REQUIRE(sized(a, b) == distance(a, b));
+}
+
+TEST_CASE("sinkhorn_matrix", "[distance]")
+{
+    std::vector<std::vector<double>> data = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 1 }, { 1, 1, 1, 1 } };
+    metric::Matrix<std::vector<double>, metric::Sinkhorn<double>> matrix(data);
+    REQUIRE(matrix.size() == data.size());
+    REQUIRE(matrix(0, 0) == 0);
+    REQUIRE(matrix(0, 1) > 0);
+    REQUIRE(matrix(0, 2) > matrix(0, 1));
+}
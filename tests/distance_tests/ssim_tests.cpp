@@ -0,0 +1,74 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+Copyright (c) 2020 Panda Team
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include "modules/distance.hpp"
+
+namespace {
+
+// SSIM distance with explicit 11 x 11 window
+double brute_force_ssim(const std::vector<std::vector<double>>& img1, const std::vector<std::vector<double>>& img2)
+{
+    const std::size_t n = 11;
+    auto gauss = metric::SSIM_details::gaussian_blur(n);
+    double C1 = std::pow(0.01 * 255, 2);
+    double C2 = std::pow(0.03 * 255, 2);
+    double sum = 0;
+    for (std::size_t i = 0; i + n <= img1.size(); ++i) {
+        for (std::size_t j = 0; j + n <= img1[0].size(); ++j) {
+            double mu1 = 0, mu2 = 0, s1 = 0, s2 = 0;
+            for (std::size_t y = 0; y < n; ++y) {
+                for (std::size_t x = 0; x < n; ++x) {
+                    mu1 += gauss[y][x] * img1[i + y][j + x];
+                    mu2 += gauss[y][x] * img2[i + y][j + x];
+                    s1 += gauss[y][x] * img1[i + y][j + x] * img1[i + y][j + x];
+                    s2 += gauss[y][x] * img2[i + y][j + x] * img2[i + y][j + x];
+                }
+            }
+            s1 = std::max(s1 - mu1 * mu1, 0.0);
+            s2 = std::max(s2 - mu2 * mu2, 0.0);
+            double S1 = (2 * mu1 * mu2 + C1) / (mu1 * mu1 + mu2 * mu2 + C1);
+            double S2 = (2 * std::sqrt(s1 * s2) + C2) / (s1 + s2 + C2);
+            sum += std::sqrt(std::max(2 - S1 - S2, 0.0));
+        }
+    }
+    return sum / ((img1.size() - n + 1) * (img1[0].size() - n + 1));
+}
+
+}  // namespace
+
+TEST_CASE("ssim_separable_window", "[distance]")
+{
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<double> pixel(0, 255);
+
+    std::vector<std::vector<double>> img1(23, std::vector<double>(17));
+    auto img2 = img1;
+    for (std::size_t i = 0; i < img1.size(); ++i) {
+        for (std::size_t j = 0; j < img1[0].size(); ++j) {
+            img1[i][j] = pixel(gen);
+            img2[i][j] = std::min(255.0, img1[i][j] + pixel(gen) / 8);
+        }
+    }
+
+    metric::SSIM<double, std::vector<double>> distance;
+    REQUIRE(distance(img1, img1) == Approx(0).margin(1e-6));
+    REQUIRE(distance(img1, img2) == Approx(brute_force_ssim(img1, img2)));
+    REQUIRE(distance(img1, img2) == Approx(distance(img2, img1)));
+}
+
+TEST_CASE("ssim_small_image", "[distance]")
+{
+    std::vector<std::vector<double>> img(5, std::vector<double>(20, 1));
+    metric::SSIM<double, std::vector<double>> distance;
+    REQUIRE_THROWS_AS(distance(img, img), std::invalid_argument);
+}
@@ -0,0 +1,55 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+Copyright (c) 2020 Panda Team
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <random>
+#include <vector>
+#include "modules/distance.hpp"
+
+
+TEST_CASE("twed_basic", "[distance]")
+{
+    std::vector<double> a = { 0, 1, 2, 3, 4, 5 };
+    std::vector<double> b = { 0, 1, 2, 3, 4, 5 };
+    std::vector<double> c = { 1, 2, 0, 4, 2 };
+
+    metric::TWED<double> distance(0, 1);
+    REQUIRE(distance(a, b) == 0);
+    REQUIRE(distance(a, c) == Approx(14));
+    REQUIRE(distance(a, c) == Approx(distance(c, a)));
+}
+
+TEST_CASE("twed_band_and_lower_bound", "[distance]")
+{
+    std::mt19937 gen(3);
+    std::normal_distribution<double> dist(0, 1);
+
+    for (int t = 0; t < 50; ++t) {
+        std::vector<double> a(20 + t % 7), b(25 - t % 5);
+        for (auto& v : a) {
+            v = dist(gen);
+        }
+        for (auto& v : b) {
+            v = dist(gen);
+        }
+
+        metric::TWED<double> full(0.5, 1);
+        metric::TWED<double> banded(0.5, 1, 3);
+        metric::TWED<double> wide(0.5, 1, 100);
+
+        auto d = full(a, b);
+        REQUIRE(wide(a, b) == Approx(d));
+        REQUIRE(banded(a, b) >= d);
+        REQUIRE(full.lower_bound(a, b) <= d);
+
+        // thresholded call is exact under the threshold and a bound above it otherwise
+        REQUIRE(full(a, b, d + 1) == Approx(d));
+        REQUIRE(full(a, b, d / 2) > d / 2);
+    }
+}
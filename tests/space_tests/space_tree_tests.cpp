@@ -95,6 +95,34 @@ TEST_CASE("test_erase_root", "[space]")
     }
 }
 
+TEST_CASE("test_erase_knn", "[space]")
+{
+    // erasing inner nodes keeps the covering of their descendants, so knn stays exact
+    std::vector<int> data;
+    for (int i = 0; i < 200; ++i) {
+        data.push_back((i * 7919) % 1009);
+    }
+    metric::Tree<int, distance<int>> tree;
+    tree.insert(data);
+    for (size_t i = 0; i < data.size(); i += 2) {
+        tree.erase(data[i]);
+        REQUIRE(tree.check_covering());
+    }
+    REQUIRE(tree.size() == data.size() / 2);
+    for (size_t i = 1; i < data.size(); i += 2) {
+        auto result = tree.knn(data[i], 3);
+        std::vector<int> expected;
+        for (size_t j = 1; j < data.size(); j += 2) {
+            expected.push_back(std::abs(data[j] - data[i]));
+        }
+        std::sort(expected.begin(), expected.end());
+        REQUIRE(result.size() == 3);
+        for (size_t k = 0; k < 3; ++k) {
+            REQUIRE(result[k].second == expected[k]);
+        }
+    }
+}
+
 TEMPLATE_TEST_CASE("test_insert_if", "[space]", float, double)
 {
     metric::Tree<int, distance<int>> tree;
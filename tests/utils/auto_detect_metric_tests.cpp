@@ -0,0 +1,113 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "../../modules/mapping.hpp"
+#include "../../modules/utils/auto_detect_metric.hpp"
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::vector<std::vector<double>> make_dataset(size_t size)
+{
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> distribution(0, 10);
+    std::vector<std::vector<double>> dataset(size, std::vector<double>(4));
+    for (auto& record : dataset) {
+        for (auto& value : record) {
+            value = distribution(generator);
+        }
+    }
+    return dataset;
+}
+
+bool is_candidate(const std::vector<metric::MetricAutoDetector::candidate_report>& report, const std::string& name)
+{
+    for (auto& candidate : report) {
+        if (candidate.name == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+TEST_CASE("auto_detect_metric_successive_halving", "[utils]")
+{
+    using Record = std::vector<double>;
+    metric::Grid6 graph(3, 2);
+    auto dataset = make_dataset(400);
+
+    metric::MetricAutoDetector detector;
+    detector.set_threads(2);
+    auto best = detector.detect<Record, metric::Grid6>(graph, 3, 2, dataset, true);
+
+    const auto& report = detector.get_report();
+    REQUIRE(report.size() == 5);
+    REQUIRE(is_candidate(report, best));
+
+    // 5 candidates on 25, 3 on 100 and 2 on 400 records
+    size_t eliminated = 0;
+    for (auto& candidate : report) {
+        REQUIRE(candidate.rounds >= 1);
+        REQUIRE(candidate.seconds >= 0);
+        if (candidate.eliminated) {
+            ++eliminated;
+            REQUIRE(candidate.records < dataset.size());
+        } else {
+            REQUIRE(candidate.rounds == 3);
+            REQUIRE(candidate.records == dataset.size());
+        }
+        if (candidate.name == best) {
+            REQUIRE(!candidate.eliminated);
+        }
+    }
+    REQUIRE(eliminated == 3);
+}
+
+TEST_CASE("auto_detect_metric_time_budget", "[utils]")
+{
+    using Record = std::vector<double>;
+    metric::Grid6 graph(3, 2);
+    auto dataset = make_dataset(400);
+
+    metric::MetricAutoDetector detector;
+    detector.set_time_budget(std::chrono::milliseconds(0));
+    auto best = detector.detect<Record, metric::Grid6>(graph, 3, 2, dataset, true);
+
+    // only the first round is evaluated
+    REQUIRE(is_candidate(detector.get_report(), best));
+    for (auto& candidate : detector.get_report()) {
+        REQUIRE(candidate.rounds == 1);
+        REQUIRE(candidate.records == 25);
+    }
+}
+
+TEST_CASE("auto_detect_metric_without_halving", "[utils]")
+{
+    using Record = std::vector<double>;
+    metric::Grid6 graph(3, 2);
+    auto dataset = make_dataset(60);
+
+    metric::MetricAutoDetector detector;
+    detector.set_successive_halving(false);
+    auto best = detector.detect<Record, metric::Grid6>(graph, 3, 2, dataset, true);
+
+    REQUIRE(is_candidate(detector.get_report(), best));
+    for (auto& candidate : detector.get_report()) {
+        REQUIRE(candidate.rounds == 1);
+        REQUIRE(candidate.records == dataset.size());
+        REQUIRE(!candidate.eliminated);
+    }
+}
@@ -0,0 +1,168 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "modules/utils/poor_mans_quantum.hpp"
+
+TEST_CASE("akima_spline", "[utils]")
+{
+    std::vector<double> x = { 0, 1, 2, 3, 4, 5 };
+    std::vector<double> y = { 0, 1, 4, 9, 16, 25 };
+    metric::AkimaSpline<double> spline(x, y);
+
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        REQUIRE(spline(x[i]) == Approx(y[i]));
+    }
+
+    std::vector<double> xi = { 4.5, -0.5, 0.25, 1.5, 2.5, 6 };
+    auto batch = spline(xi);
+    for (std::size_t i = 0; i < xi.size(); ++i) {
+        REQUIRE(batch[i] == Approx(spline(xi[i])));
+    }
+    REQUIRE(metric::akimaInterp1(x, y, xi) == batch);
+}
+
+TEST_CASE("pmq_discrete_cdf", "[utils]")
+{
+    std::mt19937 gen(1);
+    std::normal_distribution<float> normal(0, 1);
+    std::vector<float> samples(500);
+    for (auto& v : samples) {
+        v = normal(gen);
+    }
+    metric::PMQ<metric::Discrete<float>> rv(samples);
+
+    std::vector<float> points;
+    for (float x = -5; x <= 5; x += 0.1f) {
+        points.push_back(x);
+    }
+    auto values = rv.cdf(points);
+    for (std::size_t i = 0; i < points.size(); ++i) {
+        REQUIRE(values[i] == rv.cdf(points[i]));
+    }
+    REQUIRE(values.front() == 0);
+    REQUIRE(values.back() == 1);
+    REQUIRE(rv.cdf(rv.quantil(0.3f)) == Approx(0.3f).margin(1e-3));
+    REQUIRE(rv.icdf(0.5f) == rv.median());
+}
+
+TEST_CASE("pmq_batch_sampling", "[utils]")
+{
+    std::mt19937 gen(2);
+    std::normal_distribution<float> normal(0, 1);
+    std::vector<float> samples_1(1000);
+    std::vector<float> samples_2(1000);
+    for (size_t i = 0; i < samples_1.size(); ++i) {
+        samples_1[i] = normal(gen);
+        samples_2[i] = 2 * normal(gen) + 3;
+    }
+    metric::PMQ<metric::Discrete<float>> rv1(samples_1);
+    metric::PMQ<metric::Discrete<float>> rv2(samples_2);
+    rv1._dist.seed(1);
+    rv2._dist.seed(2);
+
+    // several chunks of the parallel sampler
+    auto values = rv2.rnd(100000);
+    REQUIRE(values.size() == 100000);
+    float sum = 0;
+    for (auto v : values) {
+        sum += v;
+    }
+    REQUIRE(sum / values.size() == Approx(rv2.mean()).margin(0.05));
+
+    auto rv_sum = rv1 + rv2;
+    REQUIRE(rv_sum.size() == 1000);
+    REQUIRE(rv_sum.mean() == Approx(rv1.mean() + rv2.mean()).margin(0.15));
+    REQUIRE(rv_sum.variance() == Approx(rv1.variance() + rv2.variance()).epsilon(0.1));
+
+    auto rv_difference = rv2 - rv1;
+    REQUIRE(rv_difference.mean() == Approx(rv2.mean() - rv1.mean()).margin(0.15));
+}
+
+TEST_CASE("pmq_discrete_sampling_chunks", "[utils]")
+{
+    // the default number of samples of arithmetic operations is split into several seeded chunks
+    REQUIRE(RV_SAMPLES > 2 * metric::Discrete_details::sample_chunk);
+
+    metric::Discrete<float> dist;
+    dist._data = metric::linspace(-1.0f, 1.0f, 200);
+    dist._prob = metric::linspace(0.0025f, 0.9975f, 200);
+    dist.update();
+
+    dist.seed(4);
+    auto values = dist.rnd(RV_SAMPLES);
+    dist.seed(4);
+    REQUIRE(dist.rnd(RV_SAMPLES) == values);
+
+    // chunks are drawn from different seeds
+    const std::size_t chunk = metric::Discrete_details::sample_chunk;
+    REQUIRE(!std::equal(values.begin(), values.begin() + chunk, values.begin() + chunk));
+    float sum = 0;
+    for (auto v : values) {
+        sum += v;
+    }
+    REQUIRE(sum / values.size() == Approx(dist.mean()).margin(0.05));
+}
+
+TEST_CASE("pmq_lazy_expression", "[utils]")
+{
+    std::mt19937 gen(3);
+    std::normal_distribution<float> normal(0, 1);
+    std::vector<float> samples_1(1000);
+    std::vector<float> samples_2(1000);
+    for (size_t i = 0; i < samples_1.size(); ++i) {
+        samples_1[i] = normal(gen) + 1;
+        samples_2[i] = 2 * normal(gen) + 3;
+    }
+    metric::PMQ<metric::Discrete<float>> rv1(samples_1);
+    metric::PMQ<metric::Discrete<float>> rv2(samples_2);
+    rv1._dist.seed(1);
+    rv2._dist.seed(2);
+
+    auto x = metric::lazy(rv1, 3);
+    auto expression = x * rv2 + 2.0f * x / 4.0f;
+    REQUIRE(expression.size() == 1000);
+    auto eager_product = rv1 * rv2;
+    REQUIRE(expression.mean() == Approx(eager_product.mean() + rv1.mean() / 2).margin(0.3));
+    REQUIRE(expression.median() == expression.quantil(0.5f));
+
+    // the same expression contributes the same samples
+    auto zero = x - x;
+    REQUIRE(zero.mean() == Approx(0.0f).margin(1e-6));
+    REQUIRE(zero.variance() == Approx(0.0f).margin(1e-6));
+
+    auto independent = metric::lazy(rv1, 4) - metric::lazy(rv1, 5);
+    REQUIRE(independent.variance() == Approx(2 * rv1.variance()).epsilon(0.15));
+
+    metric::LazyPMQ<float> constant(1.0f);
+    REQUIRE_THROWS_AS(constant.mean(), std::invalid_argument);
+}
+
+TEST_CASE("pmq_lazy_binomial", "[utils]")
+{
+    metric::PMQ<metric::Binomial> rv(20, 0.3f);
+    REQUIRE(rv.mean() == Approx(6.0f));
+    REQUIRE(rv.icdf(0.5f) == 6.0f);
+    REQUIRE(rv.cdf(20) == 1.0f);
+    REQUIRE(rv.cdf(-1) == 0.0f);
+
+    // parametric distributions are sampled by the inverse cdf
+    auto x = metric::lazy(rv, 6);
+    auto expression = x + 1.0f;
+    REQUIRE(expression.mean() == Approx(7.0f).margin(0.15));
+    REQUIRE(expression.variance() == Approx(rv._dist.variance()).epsilon(0.1));
+    float rounded = std::round(expression.median());
+    REQUIRE(rounded == expression.median());
+}
@@ -0,0 +1,47 @@
+/*
+This Source Code Form is subject to the terms of the Mozilla Public
+License, v. 2.0. If a copy of the MPL was not distributed with this
+file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+Copyright (c) 2020 Panda Team
+*/
+
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "modules/utils/subsample_waves.hpp"
+
+#include <stdexcept>
+#include <vector>
+
+TEST_CASE("evaluate_in_waves_order", "[utils]")
+{
+    for (size_t threads : { 1, 3, 4 }) {
+        std::vector<size_t> consumed;
+        metric::evaluate_in_waves(
+            10, [](size_t i) { return double(i * i); },
+            [&](size_t i, double value) {
+                REQUIRE(value == double(i * i));
+                consumed.push_back(i);
+                return i == 6;
+            },
+            threads);
+        // consumption stops at the same subsample as the sequential evaluation
+        REQUIRE(consumed == std::vector<size_t> { 0, 1, 2, 3, 4, 5, 6 });
+    }
+}
+
+TEST_CASE("evaluate_in_waves_exception", "[utils]")
+{
+    size_t consumed = 0;
+    auto evaluate = [](size_t i) {
+        if (i == 5) {
+            throw std::runtime_error("subsample failed");
+        }
+        return 1.0;
+    };
+    REQUIRE_THROWS_AS(metric::evaluate_in_waves(
+                          10, evaluate, [&](size_t, double) { return ++consumed, false; }, 4),
+        std::runtime_error);
+    REQUIRE(consumed == 5);
+}